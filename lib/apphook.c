@@ -31,6 +31,7 @@
 #include "metrics/metrics.h"
 #include "healthcheck/healthcheck-stats.h"
 #include "logmsg/logmsg.h"
+#include "logmsg/logmsg-allocator.h"
 #include "logsource.h"
 #include "logwriter.h"
 #include "afinter.h"
@@ -45,6 +46,7 @@
 #include "secret-storage/nondumpable-allocator.h"
 #include "secret-storage/secret-storage.h"
 #include "transport/transport-factory-id.h"
+#include "logproto/logproto-buffer-pool.h"
 #include "timeutils/timeutils.h"
 #include "msg-stats.h"
 #include "timeutils/cache.h"
@@ -241,6 +243,7 @@ app_startup(void)
   secret_storage_init();
   transport_factory_id_global_init();
   scratch_buffers_global_init();
+  log_proto_buffer_pool_global_init();
   msg_stats_init();
   timeutils_global_init();
   multi_line_global_init();
@@ -281,6 +284,7 @@ app_shutdown(void)
   value_pairs_global_deinit();
   log_template_global_deinit();
   log_msg_global_deinit();
+  log_proto_buffer_pool_global_deinit();
 
   afinter_global_deinit();
   metrics_global_deinit();
@@ -345,6 +349,7 @@ void
 app_thread_start(void)
 {
   scratch_buffers_allocator_init();
+  log_msg_allocator_thread_init();
   dns_caching_thread_init();
   main_loop_call_thread_init();
   run_application_thread_init_hooks();
@@ -357,5 +362,6 @@ app_thread_stop(void)
   main_loop_call_thread_deinit();
   dns_caching_thread_deinit();
   scratch_buffers_allocator_deinit();
+  log_msg_allocator_thread_deinit();
   timeutils_cache_deinit();
 }
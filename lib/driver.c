@@ -176,10 +176,10 @@ _log_src_driver_register_counters(LogSrcDriver *self)
   stats_lock();
   StatsClusterKey sc_key;
   stats_cluster_logpipe_key_legacy_set(&sc_key, SCS_SOURCE | SCS_GROUP, self->super.group, NULL );
-  stats_register_counter(level, &sc_key, SC_TYPE_PROCESSED,
-                         &self->super.processed_group_messages);
+  stats_register_sharded_counter(level, &sc_key, SC_TYPE_PROCESSED,
+                                 &self->super.processed_group_messages);
   stats_cluster_logpipe_key_legacy_set(&sc_key,  SCS_CENTER, NULL, "received" );
-  stats_register_counter(level, &sc_key, SC_TYPE_PROCESSED, &self->received_global_messages);
+  stats_register_sharded_counter(level, &sc_key, SC_TYPE_PROCESSED, &self->received_global_messages);
   stats_unlock();
 }
 
@@ -222,12 +222,9 @@ log_src_driver_deinit_method(LogPipe *s)
   return TRUE;
 }
 
-void
-log_src_driver_queue_method(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
+static inline void
+_log_src_driver_process_message(LogSrcDriver *self, GlobalConfig *cfg, LogMessage *msg)
 {
-  LogSrcDriver *self = (LogSrcDriver *) s;
-  GlobalConfig *cfg = log_pipe_get_config(s);
-
   /* $SOURCE */
 
   if (msg->flags & LF_LOCAL)
@@ -236,9 +233,28 @@ log_src_driver_queue_method(LogPipe *s, LogMessage *msg, const LogPathOptions *p
   log_msg_set_value(msg, LM_V_SOURCE, self->super.group, self->group_len);
   stats_counter_inc(self->super.processed_group_messages);
   stats_counter_inc(self->received_global_messages);
+}
+
+void
+log_src_driver_queue_method(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
+{
+  LogSrcDriver *self = (LogSrcDriver *) s;
+
+  _log_src_driver_process_message(self, log_pipe_get_config(s), msg);
   log_pipe_forward_msg(s, msg, path_options);
 }
 
+void
+log_src_driver_queue_batch_method(LogPipe *s, LogMessage **msgs, const LogPathOptions **path_options, gint count)
+{
+  LogSrcDriver *self = (LogSrcDriver *) s;
+  GlobalConfig *cfg = log_pipe_get_config(s);
+
+  for (gint i = 0; i < count; i++)
+    _log_src_driver_process_message(self, cfg, msgs[i]);
+  log_pipe_forward_batch(s, msgs, path_options, count);
+}
+
 void
 log_src_driver_init_instance(LogSrcDriver *self, GlobalConfig *cfg)
 {
@@ -247,6 +263,7 @@ log_src_driver_init_instance(LogSrcDriver *self, GlobalConfig *cfg)
   self->super.super.init = log_src_driver_init_method;
   self->super.super.deinit = log_src_driver_deinit_method;
   self->super.super.queue = log_src_driver_queue_method;
+  log_pipe_set_queue_batch(&self->super.super, log_src_driver_queue_batch_method);
   self->super.super.flags |= PIF_SOURCE;
 }
 
@@ -344,10 +361,10 @@ _log_dest_driver_register_counters(LogDestDriver *self)
   stats_lock();
   StatsClusterKey sc_key;
   stats_cluster_logpipe_key_legacy_set(&sc_key, SCS_DESTINATION | SCS_GROUP, self->super.group, NULL );
-  stats_register_counter(level, &sc_key, SC_TYPE_PROCESSED,
-                         &self->super.processed_group_messages);
+  stats_register_sharded_counter(level, &sc_key, SC_TYPE_PROCESSED,
+                                 &self->super.processed_group_messages);
   stats_cluster_logpipe_key_legacy_set(&sc_key, SCS_CENTER, NULL, "queued" );
-  stats_register_counter(level, &sc_key, SC_TYPE_PROCESSED, &self->queued_global_messages);
+  stats_register_sharded_counter(level, &sc_key, SC_TYPE_PROCESSED, &self->queued_global_messages);
   stats_unlock();
 }
 
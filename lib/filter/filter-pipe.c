@@ -53,37 +53,66 @@ log_filter_pipe_init(LogPipe *s)
   return TRUE;
 }
 
-static void
-log_filter_pipe_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
+/* returns TRUE if the message is to be forwarded, otherwise it is dropped */
+static gboolean
+_filter_message(LogFilterPipe *self, LogMessage **pmsg, const LogPathOptions *path_options)
 {
-  LogFilterPipe *self = (LogFilterPipe *) s;
+  LogPipe *s = &self->super;
   gboolean res;
 
   msg_trace(">>>>>> filter rule evaluation begin",
             evt_tag_str("rule", self->name),
             log_pipe_location_tag(s),
-            evt_tag_msg_reference(msg));
+            evt_tag_msg_reference(*pmsg));
 
-  res = filter_expr_eval_root(self->expr, &msg, path_options);
+  res = filter_expr_eval_root(self->expr, pmsg, path_options);
 
   msg_trace("<<<<<< filter rule evaluation result",
             evt_tag_str("result", res ? "matched" : "unmatched"),
             evt_tag_str("rule", self->name),
             log_pipe_location_tag(s),
-            evt_tag_msg_reference(msg));
+            evt_tag_msg_reference(*pmsg));
 
   if (res)
     {
-      log_pipe_forward_msg(s, msg, path_options);
       stats_counter_inc(self->matched);
     }
   else
     {
       if (path_options->matched)
         (*path_options->matched) = FALSE;
-      log_msg_drop(msg, path_options, AT_PROCESSED);
+      log_msg_drop(*pmsg, path_options, AT_PROCESSED);
       stats_counter_inc(self->not_matched);
     }
+  return res;
+}
+
+static void
+log_filter_pipe_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
+{
+  LogFilterPipe *self = (LogFilterPipe *) s;
+
+  if (_filter_message(self, &msg, path_options))
+    log_pipe_forward_msg(s, msg, path_options);
+}
+
+static void
+log_filter_pipe_queue_batch(LogPipe *s, LogMessage **msgs, const LogPathOptions **path_options, gint count)
+{
+  LogFilterPipe *self = (LogFilterPipe *) s;
+  gint n = 0;
+
+  for (gint i = 0; i < count; i++)
+    {
+      if (!_filter_message(self, &msgs[i], path_options[i]))
+        continue;
+      msgs[n] = msgs[i];
+      path_options[n] = path_options[i];
+      n++;
+    }
+
+  if (n > 0)
+    log_pipe_forward_batch(s, msgs, path_options, n);
 }
 
 static LogPipe *
@@ -125,6 +154,7 @@ log_filter_pipe_new(FilterExprNode *expr, GlobalConfig *cfg)
   self->super.flags |= PIF_CONFIG_RELATED + PIF_SYNC_FILTERX;
   self->super.init = log_filter_pipe_init;
   self->super.queue = log_filter_pipe_queue;
+  log_pipe_set_queue_batch(&self->super, log_filter_pipe_queue_batch);
   self->super.free_fn = log_filter_pipe_free;
   self->super.clone = log_filter_pipe_clone;
   self->expr = expr;
@@ -22,6 +22,13 @@
  */
 #include "filterx/expr-boolalg.h"
 #include "filterx/object-primitive.h"
+#include "filterx/expr-literal.h"
+
+static FilterXExpr *
+_boolean_literal_new(gboolean value)
+{
+  return filterx_literal_new(filterx_boolean_new(value));
+}
 
 static FilterXObject *
 _eval_not(FilterXExpr *s)
@@ -41,6 +48,17 @@ _eval_not(FilterXExpr *s)
     return filterx_boolean_new(TRUE);
 }
 
+static FilterXExpr *
+_optimize_not(FilterXExpr *s)
+{
+  FilterXUnaryOp *self = (FilterXUnaryOp *) s;
+
+  filterx_unary_op_optimize_method(s);
+  if (filterx_expr_is_literal(self->operand))
+    return _boolean_literal_new(!filterx_literal_is_truthy(self->operand));
+  return NULL;
+}
+
 FilterXExpr *
 filterx_unary_not_new(FilterXExpr *operand)
 {
@@ -48,6 +66,7 @@ filterx_unary_not_new(FilterXExpr *operand)
 
   filterx_unary_op_init_instance(self, operand);
   self->super.eval = _eval_not;
+  self->super.optimize = _optimize_not;
   return &self->super;
 }
 
@@ -82,6 +101,23 @@ _eval_and(FilterXExpr *s)
   return filterx_boolean_new(TRUE);
 }
 
+/* the rhs is not evaluated if a literal lhs decides the result */
+static FilterXExpr *
+_optimize_and(FilterXExpr *s)
+{
+  FilterXBinaryOp *self = (FilterXBinaryOp *) s;
+
+  filterx_binary_op_optimize_method(s);
+  if (!filterx_expr_is_literal(self->lhs))
+    return NULL;
+
+  if (!filterx_literal_is_truthy(self->lhs))
+    return _boolean_literal_new(FALSE);
+  if (filterx_expr_is_literal(self->rhs))
+    return _boolean_literal_new(filterx_literal_is_truthy(self->rhs));
+  return NULL;
+}
+
 FilterXExpr *
 filterx_binary_and_new(FilterXExpr *lhs, FilterXExpr *rhs)
 {
@@ -89,6 +125,7 @@ filterx_binary_and_new(FilterXExpr *lhs, FilterXExpr *rhs)
 
   filterx_binary_op_init_instance(self, lhs, rhs);
   self->super.eval = _eval_and;
+  self->super.optimize = _optimize_and;
   return &self->super;
 }
 
@@ -123,6 +160,22 @@ _eval_or(FilterXExpr *s)
   return filterx_boolean_new(FALSE);
 }
 
+static FilterXExpr *
+_optimize_or(FilterXExpr *s)
+{
+  FilterXBinaryOp *self = (FilterXBinaryOp *) s;
+
+  filterx_binary_op_optimize_method(s);
+  if (!filterx_expr_is_literal(self->lhs))
+    return NULL;
+
+  if (filterx_literal_is_truthy(self->lhs))
+    return _boolean_literal_new(TRUE);
+  if (filterx_expr_is_literal(self->rhs))
+    return _boolean_literal_new(filterx_literal_is_truthy(self->rhs));
+  return NULL;
+}
+
 FilterXExpr *
 filterx_binary_or_new(FilterXExpr *lhs, FilterXExpr *rhs)
 {
@@ -130,5 +183,6 @@ filterx_binary_or_new(FilterXExpr *lhs, FilterXExpr *rhs)
 
   filterx_binary_op_init_instance(self, lhs, rhs);
   self->super.eval = _eval_or;
+  self->super.optimize = _optimize_or;
   return &self->super;
 }
@@ -30,6 +30,7 @@
 #include "filterx/object-json.h"
 #include "filterx/object-datetime.h"
 #include "filterx/object-message-value.h"
+#include "filterx/expr-literal.h"
 #include "object-primitive.h"
 #include "generic-number.h"
 #include "parse-number.h"
@@ -214,6 +215,17 @@ _eval(FilterXExpr *s)
   return filterx_boolean_new(result);
 }
 
+static FilterXExpr *
+_optimize(FilterXExpr *s)
+{
+  FilterXComparison *self = (FilterXComparison *) s;
+
+  filterx_binary_op_optimize_method(s);
+  if (filterx_expr_is_literal(self->super.lhs) && filterx_expr_is_literal(self->super.rhs))
+    return filterx_expr_fold_constant(s);
+  return NULL;
+}
+
 /* NOTE: takes the object reference */
 FilterXExpr *
 filterx_comparison_new(FilterXExpr *lhs, FilterXExpr *rhs, gint operator)
@@ -222,6 +234,7 @@ filterx_comparison_new(FilterXExpr *lhs, FilterXExpr *rhs, gint operator)
 
   filterx_binary_op_init_instance(&self->super, lhs, rhs);
   self->super.super.eval = _eval;
+  self->super.super.optimize = _optimize;
   self->operator = operator;
   return &self->super.super;
 }
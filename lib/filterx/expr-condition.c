@@ -22,6 +22,7 @@
  */
 
 #include "filterx/expr-condition.h"
+#include "filterx/expr-literal.h"
 #include "filterx/object-primitive.h"
 
 static FilterXConditional *
@@ -75,6 +76,69 @@ exit:
   return result;
 }
 
+static void
+_drop_false_branch(FilterXConditional *self)
+{
+  if (self->false_branch)
+    filterx_expr_unref(&self->false_branch->super);
+  self->false_branch = NULL;
+}
+
+/*
+ * Optimizes an if/elif/else chain, branches behind a literal condition are
+ * decided at configuration time.  Consumes the reference of @c, returns
+ * the new head of the chain, or NULL if none of the branches can match.
+ */
+static FilterXConditional *
+_optimize_chain(FilterXConditional *c)
+{
+  c->condition = filterx_expr_optimize(c->condition);
+  filterx_expr_list_optimize(c->statements);
+  if (c->false_branch)
+    {
+      c->false_branch->super.optimized = TRUE;
+      c->false_branch = _optimize_chain(c->false_branch);
+    }
+
+  if (!c->condition || !filterx_expr_is_literal(c->condition))
+    return c;
+
+  if (filterx_literal_is_truthy(c->condition))
+    {
+      /* without statements, the value of the condition is the result */
+      if (c->statements)
+        {
+          filterx_expr_unref(c->condition);
+          c->condition = FILTERX_CONDITIONAL_NO_CONDITION;
+        }
+      _drop_false_branch(c);
+      return c;
+    }
+
+  FilterXConditional *next = c->false_branch;
+  c->false_branch = NULL;
+  filterx_expr_unref(&c->super);
+  return next;
+}
+
+static FilterXExpr *
+_optimize(FilterXExpr *s)
+{
+  FilterXConditional *self = (FilterXConditional *) s;
+  FilterXConditional *head = _optimize_chain((FilterXConditional *) filterx_expr_ref(s));
+
+  if (head == self)
+    {
+      filterx_expr_unref(s);
+      return NULL;
+    }
+
+  /* a non-matching if without an else evaluates to TRUE, just like an empty codeblock */
+  if (!head)
+    return filterx_conditional_new_codeblock(NULL);
+  return &head->super;
+}
+
 static void
 _free (FilterXExpr *s)
 {
@@ -100,6 +164,7 @@ filterx_conditional_new_conditional_codeblock(FilterXExpr *condition, GList *stm
   FilterXConditional *self = g_new0(FilterXConditional, 1);
   filterx_expr_init_instance(&self->super);
   self->super.eval = _eval;
+  self->super.optimize = _optimize;
   self->super.free_fn = _free;
   self->condition = condition;
   self->statements = stmts;
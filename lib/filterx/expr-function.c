@@ -43,6 +43,12 @@ typedef struct _FilterXSimpleFunction
   FilterXFunction super;
   FilterXFunctionArgs *args;
   FilterXSimpleFunctionProto function_proto;
+
+  /* positional arguments resolved by the optimizer, literal arguments
+   * have their value stored in arg_values */
+  guint64 num_args;
+  FilterXExpr **arg_exprs;
+  FilterXObject **arg_values;
 } FilterXSimpleFunction;
 
 static GPtrArray *
@@ -70,12 +76,44 @@ error:
   return NULL;
 }
 
+static GPtrArray *
+_simple_function_eval_resolved_args(FilterXSimpleFunction *self)
+{
+  if (self->num_args == 0)
+    return NULL;
+
+  GPtrArray *res = g_ptr_array_new_full(self->num_args, (GDestroyNotify) filterx_object_unref);
+
+  for (guint64 i = 0; i < self->num_args; i++)
+    {
+      FilterXObject *obj;
+
+      if (self->arg_values[i])
+        obj = filterx_object_ref(self->arg_values[i]);
+      else
+        obj = filterx_expr_eval(self->arg_exprs[i]);
+
+      if (obj == NULL)
+        {
+          g_ptr_array_free(res, TRUE);
+          return NULL;
+        }
+      g_ptr_array_add(res, obj);
+    }
+
+  return res;
+}
+
 static FilterXObject *
 _simple_eval(FilterXExpr *s)
 {
   FilterXSimpleFunction *self = (FilterXSimpleFunction *) s;
 
-  GPtrArray *args = _simple_function_eval_args(self->args);
+  GPtrArray *args;
+  if (self->arg_exprs)
+    args = _simple_function_eval_resolved_args(self);
+  else
+    args = _simple_function_eval_args(self->args);
 
   FilterXSimpleFunctionProto f = self->function_proto;
 
@@ -90,10 +128,37 @@ _simple_eval(FilterXExpr *s)
   return res;
 }
 
+static FilterXExpr *
+_simple_optimize(FilterXExpr *s)
+{
+  FilterXSimpleFunction *self = (FilterXSimpleFunction *) s;
+
+  filterx_function_args_optimize(self->args);
+
+  self->num_args = filterx_function_args_len(self->args);
+  self->arg_exprs = g_new0(FilterXExpr *, self->num_args + 1);
+  self->arg_values = g_new0(FilterXObject *, self->num_args + 1);
+  for (guint64 i = 0; i < self->num_args; i++)
+    {
+      self->arg_exprs[i] = filterx_function_args_get_expr(self->args, i);
+      if (filterx_expr_is_literal(self->arg_exprs[i]))
+        self->arg_values[i] = filterx_expr_eval(self->arg_exprs[i]);
+    }
+  return NULL;
+}
+
 static void
 _simple_free(FilterXExpr *s)
 {
   FilterXSimpleFunction *self = (FilterXSimpleFunction *) s;
+
+  for (guint64 i = 0; i < self->num_args; i++)
+    {
+      filterx_expr_unref(self->arg_exprs[i]);
+      filterx_object_unref(self->arg_values[i]);
+    }
+  g_free(self->arg_exprs);
+  g_free(self->arg_values);
   filterx_function_args_free(self->args);
   filterx_function_free_method(&self->super);
 }
@@ -106,6 +171,7 @@ filterx_simple_function_new(const gchar *function_name, FilterXFunctionArgs *arg
 
   filterx_function_init_instance(&self->super, function_name);
   self->super.super.eval = _simple_eval;
+  self->super.super.optimize = _simple_optimize;
   self->super.super.free_fn = _simple_free;
   self->args = args;
   self->function_proto = function_proto;
@@ -320,6 +386,23 @@ filterx_function_args_get_named_literal_string(FilterXFunctionArgs *self, const
   return str;
 }
 
+void
+filterx_function_args_optimize(FilterXFunctionArgs *self)
+{
+  filterx_expr_list_optimize(self->positional_args);
+
+  GHashTableIter iter;
+  gpointer value;
+
+  g_hash_table_iter_init(&iter, self->named_args);
+  while (g_hash_table_iter_next(&iter, NULL, &value))
+    {
+      /* replacing the value drops the reference of the original */
+      FilterXExpr *optimized = filterx_expr_optimize(filterx_expr_ref((FilterXExpr *) value));
+      g_hash_table_iter_replace(&iter, optimized);
+    }
+}
+
 void
 filterx_function_args_free(FilterXFunctionArgs *self)
 {
@@ -103,6 +103,16 @@ exit:
   return result;
 }
 
+static FilterXExpr *
+_optimize(FilterXExpr *s)
+{
+  FilterXGetSubscript *self = (FilterXGetSubscript *) s;
+
+  self->operand = filterx_expr_optimize(self->operand);
+  self->key = filterx_expr_optimize(self->key);
+  return NULL;
+}
+
 static void
 _free(FilterXExpr *s)
 {
@@ -122,6 +132,7 @@ filterx_get_subscript_new(FilterXExpr *operand, FilterXExpr *key)
   self->super.eval = _eval;
   self->super.is_set = _isset;
   self->super.unset = _unset;
+  self->super.optimize = _optimize;
   self->super.free_fn = _free;
   self->operand = operand;
   self->key = key;
@@ -76,6 +76,15 @@ exit:
   return result;
 }
 
+static FilterXExpr *
+_optimize(FilterXExpr *s)
+{
+  FilterXGetAttr *self = (FilterXGetAttr *) s;
+
+  self->operand = filterx_expr_optimize(self->operand);
+  return NULL;
+}
+
 static void
 _free(FilterXExpr *s)
 {
@@ -94,6 +103,7 @@ filterx_getattr_new(FilterXExpr *operand, const gchar *attr_name)
   filterx_expr_init_instance(&self->super);
   self->super.eval = _eval;
   self->super.unset = _unset;
+  self->super.optimize = _optimize;
   self->super.free_fn = _free;
   self->operand = operand;
   self->attr = filterx_string_new(attr_name, -1);
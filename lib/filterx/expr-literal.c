@@ -61,3 +61,13 @@ filterx_expr_is_literal(FilterXExpr *expr)
 {
   return expr->eval == _eval;
 }
+
+/* used by the optimizer, doesn't need an evaluation context */
+gboolean
+filterx_literal_is_truthy(FilterXExpr *expr)
+{
+  g_assert(filterx_expr_is_literal(expr));
+
+  FilterXLiteral *self = (FilterXLiteral *) expr;
+  return filterx_object_truthy(self->object);
+}
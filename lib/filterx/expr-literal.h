@@ -28,5 +28,6 @@
 
 FilterXExpr *filterx_literal_new(FilterXObject *object);
 gboolean filterx_expr_is_literal(FilterXExpr *expr);
+gboolean filterx_literal_is_truthy(FilterXExpr *expr);
 
 #endif
@@ -27,6 +27,7 @@
 #include "filterx/object-message-value.h"
 #include "filterx/object-list-interface.h"
 #include "filterx/object-dict-interface.h"
+#include "filterx/expr-literal.h"
 #include "compat/pcre.h"
 
 typedef struct FilterXReMatchState_
@@ -296,6 +297,27 @@ exit:
   return result;
 }
 
+/* the pattern is compiled by the constructor, matching a literal string
+ * is decided at configuration time */
+static FilterXExpr *
+_regexp_match_optimize(FilterXExpr *s)
+{
+  FilterXExprRegexpMatch *self = (FilterXExprRegexpMatch *) s;
+
+  self->lhs = filterx_expr_optimize(self->lhs);
+  if (!filterx_expr_is_literal(self->lhs))
+    return NULL;
+
+  /* other types are reported as an error on each evaluation, keep that */
+  FilterXObject *lhs_value = filterx_expr_eval(self->lhs);
+  gboolean is_string = filterx_object_is_type(lhs_value, &FILTERX_TYPE_NAME(string));
+  filterx_object_unref(lhs_value);
+
+  if (!is_string)
+    return NULL;
+  return filterx_expr_fold_constant(s);
+}
+
 static void
 _regexp_match_free(FilterXExpr *s)
 {
@@ -315,6 +337,7 @@ filterx_expr_regexp_match_new(FilterXExpr *lhs, const gchar *pattern)
 
   filterx_expr_init_instance(&self->super);
   self->super.eval = _regexp_match_eval;
+  self->super.optimize = _regexp_match_optimize;
   self->super.free_fn = _regexp_match_free;
 
   self->lhs = lhs;
@@ -385,6 +408,15 @@ _regexp_search_generator_create_container(FilterXExprGenerator *s, FilterXExpr *
   return result;
 }
 
+static FilterXExpr *
+_regexp_search_generator_optimize(FilterXExpr *s)
+{
+  FilterXExprRegexpSearchGenerator *self = (FilterXExprRegexpSearchGenerator *) s;
+
+  self->lhs = filterx_expr_optimize(self->lhs);
+  return NULL;
+}
+
 static void
 _regexp_search_generator_free(FilterXExpr *s)
 {
@@ -404,6 +436,7 @@ filterx_expr_regexp_search_generator_new(FilterXExpr *lhs, const gchar *pattern)
 
   filterx_generator_init_instance(&self->super.super);
   self->super.generate = _regexp_search_generator_generate;
+  self->super.super.optimize = _regexp_search_generator_optimize;
   self->super.super.free_fn = _regexp_search_generator_free;
   self->super.create_container = _regexp_search_generator_create_container;
 
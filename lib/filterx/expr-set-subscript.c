@@ -85,6 +85,17 @@ exit:
   return result;
 }
 
+static FilterXExpr *
+_optimize(FilterXExpr *s)
+{
+  FilterXSetSubscript *self = (FilterXSetSubscript *) s;
+
+  self->object = filterx_expr_optimize(self->object);
+  self->key = filterx_expr_optimize(self->key);
+  self->new_value = filterx_expr_optimize(self->new_value);
+  return NULL;
+}
+
 static void
 _free(FilterXExpr *s)
 {
@@ -103,6 +114,7 @@ filterx_set_subscript_new(FilterXExpr *object, FilterXExpr *key, FilterXExpr *ne
 
   filterx_expr_init_instance(&self->super);
   self->super.eval = _eval;
+  self->super.optimize = _optimize;
   self->super.free_fn = _free;
   self->object = object;
   self->key = key;
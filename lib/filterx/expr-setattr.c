@@ -72,6 +72,16 @@ exit:
   return result;
 }
 
+static FilterXExpr *
+_optimize(FilterXExpr *s)
+{
+  FilterXSetAttr *self = (FilterXSetAttr *) s;
+
+  self->object = filterx_expr_optimize(self->object);
+  self->new_value = filterx_expr_optimize(self->new_value);
+  return NULL;
+}
+
 static void
 _free(FilterXExpr *s)
 {
@@ -91,6 +101,7 @@ filterx_setattr_new(FilterXExpr *object, const gchar *attr_name, FilterXExpr *ne
 
   filterx_expr_init_instance(&self->super);
   self->super.eval = _eval;
+  self->super.optimize = _optimize;
   self->super.free_fn = _free;
   self->object = object;
   self->attr = filterx_string_new(attr_name, -1);
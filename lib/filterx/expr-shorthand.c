@@ -39,6 +39,15 @@ _eval(FilterXExpr *s)
   return result;
 }
 
+static FilterXExpr *
+_optimize(FilterXExpr *s)
+{
+  FilterXShorthand *self = (FilterXShorthand *) s;
+
+  filterx_expr_list_optimize(self->exprs);
+  return NULL;
+}
+
 static void
 _free(FilterXExpr *s)
 {
@@ -64,6 +73,7 @@ filterx_shorthand_new(void)
 
   filterx_expr_init_instance(&self->super);
   self->super.eval = _eval;
+  self->super.optimize = _optimize;
   self->super.free_fn = _free;
 
   return &self->super;
@@ -31,7 +31,7 @@ typedef struct _FilterXVariableExpr
 {
   FilterXExpr super;
   FilterXObject *variable_name;
-  NVHandle handle;
+  FilterXVariableHandle handle;
   gboolean declared;
 } FilterXVariableExpr;
 
@@ -40,7 +40,8 @@ _pull_variable_from_message(FilterXVariableExpr *self, FilterXEvalContext *conte
 {
   gssize value_len;
   LogMessageValueType t;
-  const gchar *value = log_msg_get_value_if_set_with_type(msg, self->handle, &value_len, &t);
+  const gchar *value = log_msg_get_value_if_set_with_type(msg, filterx_variable_handle_get_nv_handle(self->handle),
+                                                            &value_len, &t);
   if (!value)
     {
       filterx_eval_push_error("No such name-value pair in the log message", &self->super, self->variable_name);
@@ -131,7 +132,7 @@ _isset(FilterXExpr *s)
 
   FilterXEvalContext *context = filterx_eval_get_context();
   LogMessage *msg = context->msgs[0];
-  return log_msg_is_value_set(msg, self->handle);
+  return log_msg_is_value_set(msg, filterx_variable_handle_get_nv_handle(self->handle));
 }
 
 static gboolean
@@ -148,7 +149,7 @@ _unset(FilterXExpr *s)
     }
 
   LogMessage *msg = context->msgs[0];
-  if (log_msg_is_value_set(msg, self->handle))
+  if (log_msg_is_value_set(msg, filterx_variable_handle_get_nv_handle(self->handle)))
     _whiteout_variable(self, context);
 
   return TRUE;
@@ -133,10 +133,18 @@ filterx_eval_store_weak_ref(FilterXObject *object)
 
   if (object && !object->weak_referenced)
     {
+      /* the list is shared with the outermost context, which frees it */
+      FilterXEvalContext *root_context = context;
+      while (root_context->previous_context)
+        root_context = root_context->previous_context;
+
+      /* allocated on demand, most evaluations don't need it at all */
+      if (!root_context->weak_refs)
+        root_context->weak_refs = g_ptr_array_new_with_free_func((GDestroyNotify) filterx_object_unref);
+
       /* avoid putting object to the list multiple times */
       object->weak_referenced = TRUE;
-      g_assert(context->weak_refs);
-      g_ptr_array_add(context->weak_refs, filterx_object_ref(object));
+      g_ptr_array_add(root_context->weak_refs, filterx_object_ref(object));
     }
 }
 
@@ -220,11 +228,6 @@ filterx_eval_init_context(FilterXEvalContext *context, FilterXEvalContext *previ
   memset(context, 0, sizeof(*context));
   context->template_eval_options = DEFAULT_TEMPLATE_EVAL_OPTIONS;
   context->scope = scope;
-
-  if (previous_context)
-    context->weak_refs = previous_context->weak_refs;
-  else
-    context->weak_refs = g_ptr_array_new_with_free_func((GDestroyNotify) filterx_object_unref);
   context->previous_context = previous_context;
 
   filterx_eval_set_context(context);
@@ -233,7 +236,7 @@ filterx_eval_init_context(FilterXEvalContext *context, FilterXEvalContext *previ
 void
 filterx_eval_deinit_context(FilterXEvalContext *context)
 {
-  if (!context->previous_context)
+  if (!context->previous_context && context->weak_refs)
     g_ptr_array_free(context->weak_refs, TRUE);
   filterx_scope_unref(context->scope);
   filterx_eval_set_context(context->previous_context);
@@ -42,6 +42,7 @@ struct _FilterXEvalContext
   FilterXScope *scope;
   FilterXError error;
   LogTemplateEvalOptions template_eval_options;
+  /* only set in the outermost context, see filterx_eval_store_weak_ref() */
   GPtrArray *weak_refs;
   FilterXEvalContext *previous_context;
 };
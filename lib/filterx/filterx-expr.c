@@ -22,8 +22,16 @@
  */
 
 #include "filterx/filterx-expr.h"
+#include "filterx/expr-literal.h"
+#include "filterx/filterx-eval.h"
 #include "cfg-source.h"
 #include "messages.h"
+#include "scratch-buffers.h"
+
+/* FilterXExpr instances are created and freed by the main thread only,
+ * these are used to report the effect of the optimizer */
+static gint filterx_expr_instances;
+static gint filterx_expr_optimized_instances;
 
 void
 filterx_expr_set_location(FilterXExpr *self, CfgLexer *lexer, CFG_LTYPE *lloc)
@@ -45,10 +53,109 @@ filterx_expr_format_location_tag(FilterXExpr *self)
                         self->expr_text ? : "n/a");
 }
 
+static void
+_inherit_location(FilterXExpr *self, FilterXExpr *original)
+{
+  if (self->lloc.name)
+    return;
+
+  self->lloc = original->lloc;
+  if (!self->expr_text && original->expr_text)
+    self->expr_text = g_strdup(original->expr_text);
+}
+
+/* NOTE: consumes the reference of self, returns a reference to the optimized expression */
+FilterXExpr *
+filterx_expr_optimize(FilterXExpr *self)
+{
+  if (!self || self->optimized)
+    return self;
+
+  self->optimized = TRUE;
+  filterx_expr_optimized_instances++;
+  if (!self->optimize)
+    return self;
+
+  FilterXExpr *optimized = self->optimize(self);
+  if (!optimized)
+    return self;
+
+  optimized->optimized = TRUE;
+  _inherit_location(optimized, self);
+  filterx_expr_unref(self);
+  return optimized;
+}
+
+void
+filterx_expr_list_optimize(GList *expressions)
+{
+  for (GList *elem = expressions; elem; elem = elem->next)
+    elem->data = filterx_expr_optimize((FilterXExpr *) elem->data);
+}
+
+/* optimizes the statements of a filterx block in place */
+void
+filterx_expr_optimize_statements(GList *stmts)
+{
+  if (!stmts)
+    return;
+
+  gint instances_before = filterx_expr_instances;
+  filterx_expr_optimized_instances = 0;
+
+  filterx_expr_list_optimize(stmts);
+
+  gint exprs_before = filterx_expr_optimized_instances;
+  gint exprs_after = exprs_before + filterx_expr_instances - instances_before;
+  msg_debug("FilterX: block optimized",
+            filterx_expr_format_location_tag((FilterXExpr *) stmts->data),
+            evt_tag_int("exprs_before", exprs_before),
+            evt_tag_int("exprs_after", exprs_after));
+}
+
+/*
+ * Evaluates an expression that only depends on literals at configuration
+ * time and returns a literal with the result, or NULL if the expression
+ * can't be folded.  Only frozen results (e.g. booleans) are folded, as the
+ * literal is shared between the worker threads.
+ *
+ * There is no message being processed at this point, the expression is
+ * evaluated in a temporary context, errors are left to the runtime
+ * evaluation to report.
+ */
+FilterXExpr *
+filterx_expr_fold_constant(FilterXExpr *self)
+{
+  FilterXEvalContext *previous_context = filterx_eval_get_context();
+  FilterXEvalContext eval_context;
+  ScratchBuffersMarker marker;
+
+  filterx_eval_init_context(&eval_context, NULL);
+  scratch_buffers_mark(&marker);
+
+  FilterXObject *result = filterx_expr_eval(self);
+
+  filterx_eval_clear_errors();
+  scratch_buffers_reclaim_marked(marker);
+  filterx_eval_deinit_context(&eval_context);
+  filterx_eval_set_context(previous_context);
+
+  if (!result)
+    return NULL;
+
+  if (!filterx_object_is_frozen(result))
+    {
+      filterx_object_unref(result);
+      return NULL;
+    }
+  return filterx_literal_new(result);
+}
+
 void
 filterx_expr_free_method(FilterXExpr *self)
 {
   g_free(self->expr_text);
+  filterx_expr_instances--;
 }
 
 void
@@ -56,6 +163,7 @@ filterx_expr_init_instance(FilterXExpr *self)
 {
   self->ref_cnt = 1;
   self->free_fn = filterx_expr_free_method;
+  filterx_expr_instances++;
 }
 
 FilterXExpr *
@@ -89,6 +197,15 @@ filterx_expr_unref(FilterXExpr *self)
     }
 }
 
+FilterXExpr *
+filterx_unary_op_optimize_method(FilterXExpr *s)
+{
+  FilterXUnaryOp *self = (FilterXUnaryOp *) s;
+
+  self->operand = filterx_expr_optimize(self->operand);
+  return NULL;
+}
+
 void
 filterx_unary_op_free_method(FilterXExpr *s)
 {
@@ -102,10 +219,21 @@ void
 filterx_unary_op_init_instance(FilterXUnaryOp *self, FilterXExpr *operand)
 {
   filterx_expr_init_instance(&self->super);
+  self->super.optimize = filterx_unary_op_optimize_method;
   self->super.free_fn = filterx_unary_op_free_method;
   self->operand = operand;
 }
 
+FilterXExpr *
+filterx_binary_op_optimize_method(FilterXExpr *s)
+{
+  FilterXBinaryOp *self = (FilterXBinaryOp *) s;
+
+  self->lhs = filterx_expr_optimize(self->lhs);
+  self->rhs = filterx_expr_optimize(self->rhs);
+  return NULL;
+}
+
 void
 filterx_binary_op_free_method(FilterXExpr *s)
 {
@@ -120,6 +248,7 @@ void
 filterx_binary_op_init_instance(FilterXBinaryOp *self, FilterXExpr *lhs, FilterXExpr *rhs)
 {
   filterx_expr_init_instance(&self->super);
+  self->super.optimize = filterx_binary_op_optimize_method;
   self->super.free_fn = filterx_binary_op_free_method;
   self->lhs = lhs;
   self->rhs = rhs;
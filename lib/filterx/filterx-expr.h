@@ -33,7 +33,7 @@ struct _FilterXExpr
 {
   guint32 ref_cnt;
   const gchar *type;
-  guint32 ignore_falsy_result:1;
+  guint32 ignore_falsy_result:1, optimized:1;
 
   /* evaluate expression */
   FilterXObject *(*eval)(FilterXExpr *self);
@@ -49,6 +49,11 @@ struct _FilterXExpr
   /* unset the expression */
   gboolean (*unset)(FilterXExpr *self);
 
+  /* optimize the expression once, after the configuration is parsed:
+   * optimize child expressions and return a (new reference of an)
+   * equivalent, cheaper expression, or NULL to keep this one */
+  FilterXExpr *(*optimize)(FilterXExpr *self);
+
   void (*free_fn)(FilterXExpr *self);
   CFG_LTYPE lloc;
   gchar *expr_text;
@@ -132,6 +137,11 @@ filterx_expr_unset(FilterXExpr *self)
   return FALSE;
 }
 
+FilterXExpr *filterx_expr_optimize(FilterXExpr *self);
+void filterx_expr_list_optimize(GList *expressions);
+void filterx_expr_optimize_statements(GList *stmts);
+FilterXExpr *filterx_expr_fold_constant(FilterXExpr *self);
+
 void filterx_expr_set_location(FilterXExpr *self, CfgLexer *lexer, CFG_LTYPE *lloc);
 EVTTAG *filterx_expr_format_location_tag(FilterXExpr *self);
 void filterx_expr_init_instance(FilterXExpr *self);
@@ -146,6 +156,7 @@ typedef struct _FilterXUnaryOp
   FilterXExpr *operand;
 } FilterXUnaryOp;
 
+FilterXExpr *filterx_unary_op_optimize_method(FilterXExpr *s);
 void filterx_unary_op_free_method(FilterXExpr *s);
 void filterx_unary_op_init_instance(FilterXUnaryOp *self, FilterXExpr *operand);
 
@@ -155,6 +166,7 @@ typedef struct _FilterXBinaryOp
   FilterXExpr *lhs, *rhs;
 } FilterXBinaryOp;
 
+FilterXExpr *filterx_binary_op_optimize_method(FilterXExpr *s);
 void filterx_binary_op_free_method(FilterXExpr *s);
 void filterx_binary_op_init_instance(FilterXBinaryOp *self, FilterXExpr *lhs, FilterXExpr *rhs);
 
@@ -0,0 +1,221 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "filterx/filterx-freelist.h"
+#include "stats/stats-registry.h"
+#include "stats/stats-cluster-single.h"
+#include "apphook.h"
+#include "tls-support.h"
+
+typedef struct _FilterXFreeBlock FilterXFreeBlock;
+struct _FilterXFreeBlock
+{
+  FilterXFreeBlock *next;
+};
+
+typedef struct _FilterXFreelist
+{
+  FilterXFreeBlock *head;
+  gint length;
+} FilterXFreelist;
+
+/* block sizes of the classes, class N is at index N-1 */
+static const gsize freelist_class_sizes[FILTERX_FREELIST_NUM_CLASSES] =
+{
+  16, 32, 48, 64, 96, 128
+};
+
+/* local counters are published to stats after this many allocations */
+#define FILTERX_FREELIST_STATS_PERIOD 1024
+
+TLS_BLOCK_START
+{
+  FilterXFreelist freelists[FILTERX_FREELIST_NUM_CLASSES];
+  gsize freelist_allocated;
+  gsize freelist_reused;
+  gsize freelist_reported_allocated;
+  gsize freelist_reported_reused;
+}
+TLS_BLOCK_END;
+
+#define freelists __tls_deref(freelists)
+#define freelist_allocated __tls_deref(freelist_allocated)
+#define freelist_reused __tls_deref(freelist_reused)
+#define freelist_reported_allocated __tls_deref(freelist_reported_allocated)
+#define freelist_reported_reused __tls_deref(freelist_reported_reused)
+
+static StatsCounterItem *stats_filterx_objects_allocated;
+static StatsCounterItem *stats_filterx_objects_reused;
+
+static void
+_publish_stats(void)
+{
+  stats_counter_add(stats_filterx_objects_allocated, freelist_allocated - freelist_reported_allocated);
+  stats_counter_add(stats_filterx_objects_reused, freelist_reused - freelist_reported_reused);
+  freelist_reported_allocated = freelist_allocated;
+  freelist_reported_reused = freelist_reused;
+}
+
+static inline void
+_account_allocation(gsize *counter)
+{
+  (*counter)++;
+  if (G_UNLIKELY(freelist_allocated + freelist_reused -
+                 freelist_reported_allocated - freelist_reported_reused >= FILTERX_FREELIST_STATS_PERIOD))
+    _publish_stats();
+}
+
+static inline guint
+_lookup_class(gsize size)
+{
+  for (guint i = 0; i < FILTERX_FREELIST_NUM_CLASSES; i++)
+    {
+      if (size <= freelist_class_sizes[i])
+        return i + 1;
+    }
+  return FILTERX_FREELIST_NONE;
+}
+
+/*
+ * Returns an uninitialized block of at least @size bytes, the size class
+ * of the block is returned in @freelist_class and needs to be passed to
+ * filterx_freelist_free().
+ */
+gpointer
+filterx_freelist_alloc(gsize size, guint *freelist_class)
+{
+  guint cls = _lookup_class(size);
+
+  *freelist_class = cls;
+  if (cls == FILTERX_FREELIST_NONE)
+    {
+      _account_allocation(&freelist_allocated);
+      return g_malloc(size);
+    }
+
+  FilterXFreelist *freelist = &freelists[cls - 1];
+  FilterXFreeBlock *block = freelist->head;
+  if (block)
+    {
+      freelist->head = block->next;
+      freelist->length--;
+      _account_allocation(&freelist_reused);
+      return block;
+    }
+
+  _account_allocation(&freelist_allocated);
+  return g_malloc(freelist_class_sizes[cls - 1]);
+}
+
+void
+filterx_freelist_free(gpointer block, guint freelist_class)
+{
+  if (freelist_class == FILTERX_FREELIST_NONE)
+    {
+      g_free(block);
+      return;
+    }
+
+  FilterXFreelist *freelist = &freelists[freelist_class - 1];
+  if (freelist->length >= FILTERX_FREELIST_MAX_BLOCKS)
+    {
+      g_free(block);
+      return;
+    }
+
+  FilterXFreeBlock *free_block = (FilterXFreeBlock *) block;
+  free_block->next = freelist->head;
+  freelist->head = free_block;
+  freelist->length++;
+}
+
+/* returns the number of allocations of the current thread, for tests */
+void
+filterx_freelist_get_local_stats(gsize *allocated, gsize *reused)
+{
+  *allocated = freelist_allocated;
+  *reused = freelist_reused;
+}
+
+static void
+_drain_freelists(gpointer user_data)
+{
+  for (gint i = 0; i < FILTERX_FREELIST_NUM_CLASSES; i++)
+    {
+      FilterXFreelist *freelist = &freelists[i];
+
+      while (freelist->head)
+        {
+          FilterXFreeBlock *block = freelist->head;
+
+          freelist->head = block->next;
+          g_free(block);
+        }
+      freelist->length = 0;
+    }
+  _publish_stats();
+}
+
+static void
+_register_stats(void)
+{
+  StatsClusterKey sc_key;
+
+  stats_lock();
+  stats_cluster_single_key_set(&sc_key, "filterx_objects_allocated_total", NULL, 0);
+  stats_register_sharded_counter(0, &sc_key, SC_TYPE_SINGLE_VALUE, &stats_filterx_objects_allocated);
+  stats_cluster_single_key_set(&sc_key, "filterx_objects_reused_total", NULL, 0);
+  stats_register_sharded_counter(0, &sc_key, SC_TYPE_SINGLE_VALUE, &stats_filterx_objects_reused);
+  stats_unlock();
+}
+
+static void
+_unregister_stats(void)
+{
+  StatsClusterKey sc_key;
+
+  if (!stats_filterx_objects_allocated)
+    return;
+
+  stats_lock();
+  stats_cluster_single_key_set(&sc_key, "filterx_objects_allocated_total", NULL, 0);
+  stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, &stats_filterx_objects_allocated);
+  stats_cluster_single_key_set(&sc_key, "filterx_objects_reused_total", NULL, 0);
+  stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, &stats_filterx_objects_reused);
+  stats_unlock();
+}
+
+void
+filterx_freelist_global_init(void)
+{
+  register_application_hook(AH_RUNNING, (ApplicationHookFunc) _register_stats, NULL, AHM_RUN_ONCE);
+  register_application_thread_deinit_hook(_drain_freelists, NULL);
+}
+
+void
+filterx_freelist_global_deinit(void)
+{
+  /* the main thread doesn't run the thread deinit hooks */
+  _drain_freelists(NULL);
+  _unregister_stats();
+}
@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef FILTERX_FREELIST_H_INCLUDED
+#define FILTERX_FREELIST_H_INCLUDED
+
+#include "syslog-ng.h"
+
+/*
+ * Per-thread freelists for FilterXObject allocations.
+ *
+ * Most objects produced during evaluation (integers, strings, datetimes)
+ * are short lived temporaries that are freed by the same thread that
+ * allocated them, which makes it possible to recycle their memory without
+ * any locking.  Blocks are grouped into a handful of size classes, the
+ * class of a block is recorded by the caller (see
+ * FilterXObject->freelist_class) and passed back when it is freed.
+ *
+ * Class 0 means that the block was allocated with g_malloc() and is not
+ * recycled, this is used for objects larger than the largest size class.
+ */
+
+#define FILTERX_FREELIST_NONE 0
+#define FILTERX_FREELIST_NUM_CLASSES 6
+
+/* number of blocks retained per size class and thread */
+#define FILTERX_FREELIST_MAX_BLOCKS 512
+
+gpointer filterx_freelist_alloc(gsize size, guint *freelist_class);
+void filterx_freelist_free(gpointer block, guint freelist_class);
+
+void filterx_freelist_get_local_stats(gsize *allocated, gsize *reused);
+
+void filterx_freelist_global_init(void);
+void filterx_freelist_global_deinit(void);
+
+#endif
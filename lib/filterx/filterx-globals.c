@@ -22,6 +22,8 @@
  */
 #include "filterx/filterx-globals.h"
 #include "filterx/filterx-private.h"
+#include "filterx/filterx-scope.h"
+#include "filterx/filterx-freelist.h"
 #include "filterx/object-primitive.h"
 #include "filterx/object-null.h"
 #include "filterx/object-string.h"
@@ -181,17 +183,23 @@ filterx_global_init(void)
   filterx_type_init(&FILTERX_TYPE_NAME(datetime));
   filterx_type_init(&FILTERX_TYPE_NAME(message_value));
 
+  filterx_freelist_global_init();
   filterx_primitive_global_init();
   filterx_null_global_init();
+  filterx_string_global_init();
   filterx_builtin_functions_init();
+  filterx_scope_global_init();
 }
 
 void
 filterx_global_deinit(void)
 {
+  filterx_scope_global_deinit();
   filterx_builtin_functions_deinit();
+  filterx_string_global_deinit();
   filterx_null_global_deinit();
   filterx_primitive_global_deinit();
+  filterx_freelist_global_deinit();
   filterx_types_deinit();
 }
 
@@ -26,6 +26,7 @@
 #include "filterx/object-primitive.h"
 #include "filterx/object-string.h"
 #include "filterx/filterx-globals.h"
+#include "filterx/filterx-freelist.h"
 
 FilterXObject *
 filterx_object_getattr_string(FilterXObject *self, const gchar *attr_name)
@@ -101,10 +102,38 @@ filterx_object_init_instance(FilterXObject *self, FilterXType *type)
   self->readonly = !type->is_mutable;
 }
 
+/*
+ * Allocates memory for an object of @size bytes from the per-thread
+ * freelists.  Only the FilterXObject header is cleared, the rest of the
+ * block is uninitialized, use filterx_object_alloc0() to clear all of it.
+ * The object is released by filterx_object_unref() as usual.
+ */
+gpointer
+filterx_object_alloc(gsize size)
+{
+  guint freelist_class;
+  FilterXObject *self = filterx_freelist_alloc(size, &freelist_class);
+
+  memset(self, 0, sizeof(*self));
+  self->freelist_class = freelist_class;
+  return self;
+}
+
+gpointer
+filterx_object_alloc0(gsize size)
+{
+  guint freelist_class;
+  FilterXObject *self = filterx_freelist_alloc(size, &freelist_class);
+
+  memset(self, 0, size);
+  self->freelist_class = freelist_class;
+  return self;
+}
+
 FilterXObject *
 filterx_object_new(FilterXType *type)
 {
-  FilterXObject *self = g_new0(FilterXObject, 1);
+  FilterXObject *self = filterx_object_alloc0(sizeof(FilterXObject));
   filterx_object_init_instance(self, type);
   return self;
 }
@@ -184,7 +213,9 @@ filterx_object_unref(FilterXObject *self)
 
       g_assert(self->thread_index == (guint16) main_loop_worker_get_thread_index());
       self->type->free_fn(self);
-      g_free(self);
+      /* objects allocated with g_new0() have a freelist_class of 0, which
+       * g_free()s them */
+      filterx_freelist_free(self, self->freelist_class);
     }
 }
 
@@ -85,15 +85,19 @@ struct _FilterXObject
    *                          FilterXObject was changed
    *     readonly          -- marks the object as unmodifiable,
    *                          propagates to the inner elements lazily
+   *     freelist_class    -- the freelist size class the object was
+   *                          allocated from, see filterx-freelist.h
    *
    */
-  guint thread_index:16, modified_in_place:1, readonly:1, weak_referenced:1;
+  guint thread_index:16, modified_in_place:1, readonly:1, weak_referenced:1, freelist_class:3;
   FilterXType *type;
 };
 
 FilterXObject *filterx_object_getattr_string(FilterXObject *self, const gchar *attr_name);
 gboolean filterx_object_setattr_string(FilterXObject *self, const gchar *attr_name, FilterXObject **new_value);
 
+gpointer filterx_object_alloc(gsize size);
+gpointer filterx_object_alloc0(gsize size);
 FilterXObject *filterx_object_new(FilterXType *type);
 FilterXObject *filterx_object_ref(FilterXObject *self);
 void filterx_object_unref(FilterXObject *self);
@@ -119,7 +123,9 @@ filterx_object_is_type(FilterXObject *object, FilterXType *type)
 static inline void
 filterx_object_make_readonly(FilterXObject *self)
 {
-  self->readonly = TRUE;
+  /* frozen objects may be shared between threads, don't write them needlessly */
+  if (!self->readonly)
+    self->readonly = TRUE;
 }
 
 static inline FilterXObject *
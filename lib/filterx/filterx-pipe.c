@@ -45,57 +45,127 @@ log_filterx_pipe_init(LogPipe *s)
 }
 
 
-static void
-log_filterx_pipe_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
+static gboolean
+_eval_message(LogFilterXPipe *self, FilterXEvalContext *eval_context, LogMessage *msg,
+              const LogPathOptions *path_options)
 {
-  LogFilterXPipe *self = (LogFilterXPipe *) s;
-  FilterXEvalContext eval_context;
-  LogPathOptions local_path_options;
   gboolean res;
 
-  path_options = log_path_options_chain(&local_path_options, path_options);
-  filterx_eval_init_context(&eval_context, path_options->filterx_context);
+  filterx_eval_init_context(eval_context, path_options->filterx_context);
 
   msg_trace(">>>>>> filterx rule evaluation begin",
             evt_tag_str("rule", self->name),
-            log_pipe_location_tag(s),
+            log_pipe_location_tag(&self->super),
             evt_tag_msg_reference(msg));
 
-  NVTable *payload = nv_table_ref(msg->payload);
-  res = filterx_eval_exec_statements(&eval_context, self->stmts, msg);
+  res = filterx_eval_exec_statements(eval_context, self->stmts, msg);
 
   msg_trace("<<<<<< filterx rule evaluation result",
             evt_tag_str("result", res ? "matched" : "unmatched"),
             evt_tag_str("rule", self->name),
-            log_pipe_location_tag(s),
-            evt_tag_int("dirty", filterx_scope_is_dirty(eval_context.scope)),
+            log_pipe_location_tag(&self->super),
+            evt_tag_int("dirty", filterx_scope_is_dirty(eval_context->scope)),
             evt_tag_msg_reference(msg));
+  return res;
+}
+
+static void
+_drop_message(LogMessage *msg, const LogPathOptions *path_options)
+{
+  if (path_options->matched)
+    (*path_options->matched) = FALSE;
+  log_msg_drop(msg, path_options, AT_PROCESSED);
+}
+
+static void
+log_filterx_pipe_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
+{
+  LogFilterXPipe *self = (LogFilterXPipe *) s;
+  FilterXEvalContext eval_context;
+  LogPathOptions local_path_options;
+  gboolean res;
+
+  path_options = log_path_options_chain(&local_path_options, path_options);
+
+  NVTable *payload = nv_table_ref(msg->payload);
+  res = _eval_message(self, &eval_context, msg, path_options);
 
   local_path_options.filterx_context = &eval_context;
   if (res)
-    {
-      log_pipe_forward_msg(s, msg, path_options);
-    }
+    log_pipe_forward_msg(s, msg, path_options);
   else
-    {
-      if (path_options->matched)
-        (*path_options->matched) = FALSE;
-      log_msg_drop(msg, path_options, AT_PROCESSED);
-    }
+    _drop_message(msg, path_options);
 
   filterx_eval_deinit_context(&eval_context);
   nv_table_unref(payload);
 }
 
+/*
+ * The whole batch is evaluated before any of the messages is forwarded,
+ * so the statements are executed back-to-back and the rest of the
+ * pipeline receives the matching messages as a single batch.
+ *
+ * Every message gets its own eval context, as the scope of a message is
+ * needed by the rest of the pipeline until the batch returns.  The scopes
+ * released at the end are recycled by the next batch, see
+ * filterx_scope_new().
+ */
+static void
+log_filterx_pipe_queue_batch(LogPipe *s, LogMessage **msgs, const LogPathOptions **path_options, gint count)
+{
+  LogFilterXPipe *self = (LogFilterXPipe *) s;
+  FilterXEvalContext *saved_context = filterx_eval_get_context();
+  FilterXEvalContext eval_contexts[LOG_PIPE_BATCH_MAX];
+  LogPathOptions local_path_options[LOG_PIPE_BATCH_MAX];
+  NVTable *payloads[LOG_PIPE_BATCH_MAX];
+  gint n = 0;
+
+  g_assert(count <= LOG_PIPE_BATCH_MAX);
+
+  for (gint i = 0; i < count; i++)
+    {
+      LogMessage *msg = msgs[i];
+      const LogPathOptions *msg_path_options = log_path_options_chain(&local_path_options[i], path_options[i]);
+
+      payloads[i] = nv_table_ref(msg->payload);
+      gboolean res = _eval_message(self, &eval_contexts[i], msg, msg_path_options);
+
+      local_path_options[i].filterx_context = &eval_contexts[i];
+      if (res)
+        {
+          msgs[n] = msg;
+          path_options[n] = msg_path_options;
+          n++;
+        }
+      else
+        {
+          _drop_message(msg, msg_path_options);
+        }
+    }
+
+  if (n > 0)
+    log_pipe_forward_batch(s, msgs, path_options, n);
+
+  for (gint i = count - 1; i >= 0; i--)
+    {
+      filterx_eval_deinit_context(&eval_contexts[i]);
+      nv_table_unref(payloads[i]);
+    }
+  filterx_eval_set_context(saved_context);
+}
+
+static LogFilterXPipe *log_filterx_pipe_new_instance(GList *stmts, GlobalConfig *cfg);
+
 static LogPipe *
 log_filterx_pipe_clone(LogPipe *s)
 {
   LogFilterXPipe *self = (LogFilterXPipe *) s;
   GList *cloned_stmts = g_list_copy_deep(self->stmts, (GCopyFunc) filterx_expr_ref, NULL);
 
-  LogPipe *cloned = log_filterx_pipe_new(cloned_stmts, s->cfg);
-  ((LogFilterXPipe *)cloned)->name = g_strdup(self->name);
-  return cloned;
+  /* the statements are shared with the original, they are optimized already */
+  LogFilterXPipe *cloned = log_filterx_pipe_new_instance(cloned_stmts, s->cfg);
+  cloned->name = g_strdup(self->name);
+  return &cloned->super;
 }
 
 static void
@@ -108,8 +178,8 @@ log_filterx_pipe_free(LogPipe *s)
   log_pipe_free_method(s);
 }
 
-LogPipe *
-log_filterx_pipe_new(GList *stmts, GlobalConfig *cfg)
+static LogFilterXPipe *
+log_filterx_pipe_new_instance(GList *stmts, GlobalConfig *cfg)
 {
   LogFilterXPipe *self = g_new0(LogFilterXPipe, 1);
 
@@ -117,8 +187,16 @@ log_filterx_pipe_new(GList *stmts, GlobalConfig *cfg)
   self->super.flags = (self->super.flags | PIF_CONFIG_RELATED);
   self->super.init = log_filterx_pipe_init;
   self->super.queue = log_filterx_pipe_queue;
+  log_pipe_set_queue_batch(&self->super, log_filterx_pipe_queue_batch);
   self->super.free_fn = log_filterx_pipe_free;
   self->super.clone = log_filterx_pipe_clone;
   self->stmts = stmts;
-  return &self->super;
+  return self;
+}
+
+LogPipe *
+log_filterx_pipe_new(GList *stmts, GlobalConfig *cfg)
+{
+  filterx_expr_optimize_statements(stmts);
+  return &log_filterx_pipe_new_instance(stmts, cfg)->super;
 }
@@ -22,13 +22,19 @@
  */
 #include "filterx/filterx-scope.h"
 #include "scratch-buffers.h"
+#include "apphook.h"
+#include "tls-support.h"
 
 #define FILTERX_HANDLE_FLOATING_BIT (1UL << 31)
+#define FILTERX_HANDLE_SLOT_SHIFT 32
 #define FILTERX_SCOPE_MAX_GENERATION ((1UL << 20) - 1)
 
 struct _FilterXVariable
 {
-  /* the MSB indicates that the variable is a floating one */
+  /*
+   * the lower 32 bits are the NVHandle with the MSB indicating that the
+   * variable is a floating one, the upper 32 bits are the slot index
+   */
   FilterXVariableHandle handle;
   /*
    * assigned -- Indicates that the variable was assigned to a new value
@@ -47,6 +53,18 @@ filterx_variable_handle_is_floating(FilterXVariableHandle handle)
   return !!(handle & FILTERX_HANDLE_FLOATING_BIT);
 }
 
+NVHandle
+filterx_variable_handle_get_nv_handle(FilterXVariableHandle handle)
+{
+  return ((NVHandle) handle) & ~FILTERX_HANDLE_FLOATING_BIT;
+}
+
+static inline guint32
+filterx_variable_handle_get_slot(FilterXVariableHandle handle)
+{
+  return (guint32) (handle >> FILTERX_HANDLE_SLOT_SHIFT);
+}
+
 gboolean
 filterx_variable_is_floating(FilterXVariable *v)
 {
@@ -56,7 +74,7 @@ filterx_variable_is_floating(FilterXVariable *v)
 static NVHandle
 filterx_variable_get_nv_handle(FilterXVariable *v)
 {
-  return v->handle & ~FILTERX_HANDLE_FLOATING_BIT;
+  return filterx_variable_handle_get_nv_handle(v->handle);
 }
 
 FilterXObject *
@@ -92,44 +110,117 @@ _variable_free(FilterXVariable *v)
   filterx_object_unref(v->value);
 }
 
+/*
+ * Variable slots
+ *
+ * Each variable referenced by the configuration gets a slot index when its
+ * expression is compiled, the index is stored in the upper half of the
+ * FilterXVariableHandle.  Scopes map slots to their variables with a
+ * direct index, so looking up a variable is O(1).
+ *
+ * Slots are allocated from the main thread at config parse time, and are
+ * never released: the same names map to the same slots across reloads.
+ */
+static GHashTable *filterx_variable_slots;
+
+static guint32
+_allocate_slot(FilterXVariableHandle key)
+{
+  gpointer slot;
+
+  if (g_hash_table_lookup_extended(filterx_variable_slots, GUINT_TO_POINTER(key), NULL, &slot))
+    return GPOINTER_TO_UINT(slot);
+
+  guint32 new_slot = g_hash_table_size(filterx_variable_slots);
+  g_hash_table_insert(filterx_variable_slots, GUINT_TO_POINTER(key), GUINT_TO_POINTER(new_slot));
+  return new_slot;
+}
+
+#define FILTERX_SCOPE_MIN_VARIABLES 16
+
 struct _FilterXScope
 {
   GAtomicCounter ref_cnt;
-  GArray *variables;
   guint32 generation:20, write_protected, dirty, syncable;
+
+  /* the variables registered in this scope, in order of registration */
+  FilterXVariable *variables;
+  guint32 num_variables;
+  guint32 variables_size;
+
+  /* indexed by slot, the position of the slot's variable in variables + 1,
+   * 0 if it is not registered.  It is grown on demand, up to the highest
+   * slot registered in this scope, so a scope doesn't pay for the
+   * variables of the whole configuration. */
+  guint32 *slot_index;
+  guint32 slot_index_size;
 };
 
-static gboolean
-_lookup_variable(FilterXScope *self, FilterXVariableHandle handle, FilterXVariable **v_slot)
+/*
+ * Scope recycling
+ *
+ * An eval context creates a scope for every message it processes, which
+ * is released once the message has passed through the rest of the
+ * pipeline.  Instead of freeing them, released scopes are cleared and kept
+ * in a small per-thread cache, so that the next message can reuse their
+ * arrays.  The cache holds the scopes of a full batch (see
+ * LOG_PIPE_BATCH_MAX), as long as they fit in
+ * FILTERX_SCOPE_CACHE_MAX_BYTES.
+ */
+#define FILTERX_SCOPE_CACHE_SIZE 64
+#define FILTERX_SCOPE_CACHE_MAX_BYTES (64 * 1024)
+
+TLS_BLOCK_START
 {
-  gint l, h, m;
+  FilterXScope *scope_cache[FILTERX_SCOPE_CACHE_SIZE];
+  gint scope_cache_len;
+  gsize scope_cache_bytes;
+}
+TLS_BLOCK_END;
 
-  /* open-coded binary search */
-  l = 0;
-  h = self->variables->len - 1;
-  while (l <= h)
-    {
-      m = (l + h) >> 1;
+#define scope_cache __tls_deref(scope_cache)
+#define scope_cache_len __tls_deref(scope_cache_len)
+#define scope_cache_bytes __tls_deref(scope_cache_bytes)
 
-      FilterXVariable *m_elem = &g_array_index(self->variables, FilterXVariable, m);
+static void
+_ensure_slot(FilterXScope *self, guint32 slot)
+{
+  if (G_LIKELY(slot < self->slot_index_size))
+    return;
 
-      FilterXVariableHandle mv = m_elem->handle;
-      if (mv == handle)
-        {
-          *v_slot = m_elem;
-          return TRUE;
-        }
-      else if (mv > handle)
-        {
-          h = m - 1;
-        }
-      else
-        {
-          l = m + 1;
-        }
+  guint32 new_size = MAX(self->slot_index_size * 2, slot + 1);
+
+  self->slot_index = g_renew(guint32, self->slot_index, new_size);
+  memset(&self->slot_index[self->slot_index_size], 0, (new_size - self->slot_index_size) * sizeof(guint32));
+  self->slot_index_size = new_size;
+}
+
+static FilterXVariable *
+_append_variable(FilterXScope *self, guint32 slot)
+{
+  if (self->num_variables == self->variables_size)
+    {
+      self->variables_size = MAX(self->variables_size * 2, FILTERX_SCOPE_MIN_VARIABLES);
+      self->variables = g_renew(FilterXVariable, self->variables, self->variables_size);
     }
-  *v_slot = &g_array_index(self->variables, FilterXVariable, l);
-  return FALSE;
+
+  _ensure_slot(self, slot);
+  self->slot_index[slot] = ++self->num_variables;
+  return &self->variables[self->num_variables - 1];
+}
+
+static inline FilterXVariable *
+_lookup_variable(FilterXScope *self, FilterXVariableHandle handle)
+{
+  guint32 slot = filterx_variable_handle_get_slot(handle);
+
+  if (G_UNLIKELY(slot >= self->slot_index_size))
+    return NULL;
+
+  guint32 index = self->slot_index[slot];
+  if (!index)
+    return NULL;
+  return &self->variables[index - 1];
 }
 
 void
@@ -148,18 +239,22 @@ FilterXVariableHandle
 filterx_scope_map_variable_to_handle(const gchar *name, FilterXVariableType type)
 {
   NVHandle nv_handle = log_msg_get_value_handle(name);
+  FilterXVariableHandle handle = (FilterXVariableHandle) nv_handle;
 
-  if (type == FX_VAR_MESSAGE)
-    return (FilterXVariableHandle) nv_handle;
-  return (FilterXVariableHandle) nv_handle | FILTERX_HANDLE_FLOATING_BIT;
+  g_assert(!filterx_variable_handle_is_floating(handle));
+  if (type != FX_VAR_MESSAGE)
+    handle |= FILTERX_HANDLE_FLOATING_BIT;
+
+  guint32 slot = _allocate_slot(handle);
+  return handle | ((FilterXVariableHandle) slot << FILTERX_HANDLE_SLOT_SHIFT);
 }
 
 FilterXVariable *
 filterx_scope_lookup_variable(FilterXScope *self, FilterXVariableHandle handle)
 {
-  FilterXVariable *v;
+  FilterXVariable *v = _lookup_variable(self, handle);
 
-  if (_lookup_variable(self, handle, &v))
+  if (v)
     {
       if (filterx_variable_handle_is_floating(handle) &&
           !v->declared && v->generation != self->generation)
@@ -174,35 +269,32 @@ _register_variable(FilterXScope *self,
                    FilterXVariableHandle handle,
                    FilterXObject *initial_value)
 {
-  FilterXVariable v, *v_slot;
+  FilterXVariable *v = _lookup_variable(self, handle);
 
-  if (_lookup_variable(self, handle, &v_slot))
+  if (v)
     {
       /* already present */
-      if (v_slot->generation != self->generation)
+      if (v->generation != self->generation)
         {
           /* existing value is from a previous generation, override it as if
            * it was a new value */
 
-          v_slot->generation = self->generation;
-          filterx_variable_set_value(v_slot, initial_value);
+          v->generation = self->generation;
+          filterx_variable_set_value(v, initial_value);
           /* consider this to be unset just as an initial registration is */
-          v_slot->assigned = FALSE;
+          v->assigned = FALSE;
         }
-      return v_slot;
+      return v;
     }
-  /* turn v_slot into an index */
-  gsize v_index = ((guint8 *) v_slot - (guint8 *) self->variables->data) / sizeof(FilterXVariable);
-  g_assert(v_index <= self->variables->len);
-  g_assert(&g_array_index(self->variables, FilterXVariable, v_index) == v_slot);
 
-  v.handle = handle;
-  v.assigned = FALSE;
-  v.value = filterx_object_ref(initial_value);
-  v.generation = self->generation;
-  g_array_insert_val(self->variables, v_index, v);
+  v = _append_variable(self, filterx_variable_handle_get_slot(handle));
+  v->handle = handle;
+  v->assigned = FALSE;
+  v->declared = FALSE;
+  v->value = filterx_object_ref(initial_value);
+  v->generation = self->generation;
 
-  return &g_array_index(self->variables, FilterXVariable, v_index);
+  return v;
 }
 
 FilterXVariable *
@@ -257,9 +349,9 @@ filterx_scope_sync(FilterXScope *self, LogMessage *msg)
 
   GString *buffer = scratch_buffers_alloc();
 
-  for (gint i = 0; i < self->variables->len; i++)
+  for (guint32 i = 0; i < self->num_variables; i++)
     {
-      FilterXVariable *v = &g_array_index(self->variables, FilterXVariable, i);
+      FilterXVariable *v = &self->variables[i];
 
       /* we don't need to sync the value if:
        *
@@ -287,7 +379,7 @@ filterx_scope_sync(FilterXScope *self, LogMessage *msg)
           msg_trace("Filterx sync: whiteout variable, unsetting in message",
                     evt_tag_str("variable", log_msg_get_value_name(filterx_variable_get_nv_handle(v), NULL)));
           /* we need to unset */
-          log_msg_unset_value(msg, v->handle);
+          log_msg_unset_value(msg, filterx_variable_get_nv_handle(v));
           v->assigned = FALSE;
         }
       else if (v->assigned || v->value->modified_in_place)
@@ -300,7 +392,7 @@ filterx_scope_sync(FilterXScope *self, LogMessage *msg)
           g_string_truncate(buffer, 0);
           if (!filterx_object_marshal(v->value, buffer, &t))
             g_assert_not_reached();
-          log_msg_set_value_with_type(msg, v->handle, buffer->str, buffer->len, t);
+          log_msg_set_value_with_type(msg, filterx_variable_get_nv_handle(v), buffer->str, buffer->len, t);
           v->value->modified_in_place = FALSE;
           v->assigned = FALSE;
         }
@@ -313,14 +405,33 @@ filterx_scope_sync(FilterXScope *self, LogMessage *msg)
   self->dirty = FALSE;
 }
 
+static gsize
+_allocated_size(FilterXScope *self)
+{
+  return sizeof(*self) + self->variables_size * sizeof(FilterXVariable) + self->slot_index_size * sizeof(guint32);
+}
+
+static FilterXScope *
+_reuse_cached_scope(void)
+{
+  FilterXScope *self = scope_cache[--scope_cache_len];
+
+  scope_cache_bytes -= _allocated_size(self);
+  return self;
+}
+
+/* the arrays are allocated on the first registration */
 FilterXScope *
 filterx_scope_new(void)
 {
-  FilterXScope *self = g_new0(FilterXScope, 1);
+  FilterXScope *self;
+
+  if (scope_cache_len > 0)
+    self = _reuse_cached_scope();
+  else
+    self = g_new0(FilterXScope, 1);
 
   g_atomic_counter_set(&self->ref_cnt, 1);
-  self->variables = g_array_sized_new(FALSE, TRUE, sizeof(FilterXVariable), 16);
-  g_array_set_clear_func(self->variables, (GDestroyNotify) _variable_free);
   return self;
 }
 
@@ -329,27 +440,26 @@ filterx_scope_clone(FilterXScope *other)
 {
   FilterXScope *self = filterx_scope_new();
 
-  for (gint src_index = 0, dst_index = 0; src_index < other->variables->len; src_index++)
+  for (guint32 i = 0; i < other->num_variables; i++)
     {
-      FilterXVariable *v = &g_array_index(other->variables, FilterXVariable, src_index);
+      FilterXVariable *v = &other->variables[i];
 
       if (v->declared || !filterx_variable_is_floating(v))
         {
-          g_array_append_val(self->variables, *v);
-          FilterXVariable *v_clone = &g_array_index(self->variables, FilterXVariable, dst_index);
+          FilterXVariable *v_clone = _append_variable(self, filterx_variable_handle_get_slot(v->handle));
 
+          *v_clone = *v;
           v_clone->generation = 0;
           if (v->value)
             v_clone->value = filterx_object_clone(v->value);
           else
             v_clone->value = NULL;
-          dst_index++;
           msg_trace("Filterx scope, cloning scope variable",
-                    evt_tag_str("variable", log_msg_get_value_name((v->handle & ~FILTERX_HANDLE_FLOATING_BIT), NULL)));
+                    evt_tag_str("variable", log_msg_get_value_name(filterx_variable_get_nv_handle(v), NULL)));
         }
     }
 
-  if (other->variables->len > 0)
+  if (other->num_variables > 0)
     self->dirty = other->dirty;
   self->syncable = other->syncable;
   msg_trace("Filterx clone finished",
@@ -385,13 +495,54 @@ filterx_scope_make_writable(FilterXScope **pself)
   return *pself;
 }
 
+/* only the registered slots are touched, so this is cheap for large configs too */
 static void
-_free(FilterXScope *self)
+_clear(FilterXScope *self)
+{
+  for (guint32 i = 0; i < self->num_variables; i++)
+    {
+      FilterXVariable *v = &self->variables[i];
+
+      self->slot_index[filterx_variable_handle_get_slot(v->handle)] = 0;
+      _variable_free(v);
+    }
+  self->num_variables = 0;
+  self->generation = 0;
+  self->write_protected = FALSE;
+  self->dirty = FALSE;
+  self->syncable = FALSE;
+}
+
+static void
+_destroy(FilterXScope *self)
 {
-  g_array_free(self->variables, TRUE);
+  g_free(self->variables);
+  g_free(self->slot_index);
   g_free(self);
 }
 
+static void
+_free(FilterXScope *self)
+{
+  _clear(self);
+
+  gsize size = _allocated_size(self);
+  if (scope_cache_len < FILTERX_SCOPE_CACHE_SIZE && scope_cache_bytes + size <= FILTERX_SCOPE_CACHE_MAX_BYTES)
+    {
+      scope_cache[scope_cache_len++] = self;
+      scope_cache_bytes += size;
+      return;
+    }
+  _destroy(self);
+}
+
+static void
+_drain_scope_cache(gpointer user_data)
+{
+  while (scope_cache_len > 0)
+    _destroy(_reuse_cached_scope());
+}
+
 FilterXScope *
 filterx_scope_ref(FilterXScope *self)
 {
@@ -406,3 +557,19 @@ filterx_scope_unref(FilterXScope *self)
   if (self && (g_atomic_counter_dec_and_test(&self->ref_cnt)))
     _free(self);
 }
+
+void
+filterx_scope_global_init(void)
+{
+  filterx_variable_slots = g_hash_table_new(g_direct_hash, g_direct_equal);
+  register_application_thread_deinit_hook(_drain_scope_cache, NULL);
+}
+
+void
+filterx_scope_global_deinit(void)
+{
+  /* the main thread doesn't run the thread deinit hooks */
+  _drain_scope_cache(NULL);
+  g_hash_table_destroy(filterx_variable_slots);
+  filterx_variable_slots = NULL;
+}
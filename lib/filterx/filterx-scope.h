@@ -27,7 +27,7 @@
 #include "logmsg/logmsg.h"
 
 typedef struct _FilterXVariable FilterXVariable;
-typedef guint32 FilterXVariableHandle;
+typedef guint64 FilterXVariableHandle;
 typedef enum
 {
   FX_VAR_MESSAGE,
@@ -37,6 +37,7 @@ typedef enum
 
 gboolean filterx_variable_is_floating(FilterXVariable *v);
 gboolean filterx_variable_handle_is_floating(FilterXVariableHandle handle);
+NVHandle filterx_variable_handle_get_nv_handle(FilterXVariableHandle handle);
 FilterXObject *filterx_variable_get_value(FilterXVariable *v);
 void filterx_variable_set_value(FilterXVariable *v, FilterXObject *new_value);
 void filterx_variable_unset_value(FilterXVariable *v);
@@ -52,6 +53,11 @@ gboolean filterx_variable_is_set(FilterXVariable *v);
  * Floating values are "temp" values that are not synced to the LogMessage
  * upon the exit from the scope.
  *
+ * Variables are stored in an array in order of registration, and are
+ * found through an index by the slot assigned to the variable when its
+ * handle was mapped at config parse time.  Both are grown on demand, so a
+ * scope only pays for the variables it actually uses.
+ *
  */
 typedef struct _FilterXScope FilterXScope;
 
@@ -76,4 +82,7 @@ FilterXScope *filterx_scope_new(void);
 FilterXScope *filterx_scope_ref(FilterXScope *self);
 void filterx_scope_unref(FilterXScope *self);
 
+void filterx_scope_global_init(void);
+void filterx_scope_global_deinit(void);
+
 #endif
\ No newline at end of file
@@ -98,7 +98,7 @@ _map_to_json(FilterXObject *s, struct json_object **object, FilterXObject **asso
 FilterXObject *
 filterx_datetime_new(const UnixTime *ut)
 {
-  FilterXDateTime *self = g_new0(FilterXDateTime, 1);
+  FilterXDateTime *self = filterx_object_alloc0(sizeof(FilterXDateTime));
 
   filterx_object_init_instance(&self->super, &FILTERX_TYPE_NAME(datetime));
   self->ut = *ut;
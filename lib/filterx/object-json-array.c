@@ -21,11 +21,8 @@
  *
  */
 #include "filterx/object-json-internal.h"
-#include "filterx/object-null.h"
-#include "filterx/object-primitive.h"
 #include "filterx/object-string.h"
 #include "filterx/object-message-value.h"
-#include "filterx/filterx-weakrefs.h"
 #include "filterx/object-list-interface.h"
 
 #include "scanner/list-scanner/list-scanner.h"
@@ -36,8 +33,8 @@
 struct FilterXJsonArray_
 {
   FilterXList super;
-  FilterXWeakRef root_container;
-  struct json_object *jso;
+  FilterXObject *parent;
+  GPtrArray *elements;
 };
 
 static gboolean
@@ -46,32 +43,28 @@ _truthy(FilterXObject *s)
   return TRUE;
 }
 
-static gboolean
-_marshal_to_json_literal_append(FilterXJsonArray *self, GString *repr, LogMessageValueType *t)
-{
-  *t = LM_VT_JSON;
-
-  const gchar *json_repr = json_object_to_json_string_ext(self->jso, JSON_C_TO_STRING_PLAIN);
-  g_string_append(repr, json_repr);
-
-  return TRUE;
-}
-
 static gboolean
 _marshal(FilterXObject *s, GString *repr, LogMessageValueType *t)
 {
   FilterXJsonArray *self = (FilterXJsonArray *) s;
+  gsize orig_len = repr->len;
 
-  for (gint i = 0; i < json_object_array_length(self->jso); i++)
+  for (guint i = 0; i < self->elements->len; i++)
     {
-      struct json_object *el = json_object_array_get_idx(self->jso, i);
-      if (json_object_get_type(el) != json_type_string)
-        return _marshal_to_json_literal_append(self, repr, t);
+      gsize str_len;
+      const gchar *str = filterx_string_get_value(g_ptr_array_index(self->elements, i), &str_len);
+
+      if (!str)
+        {
+          g_string_truncate(repr, orig_len);
+          *t = LM_VT_JSON;
+          return filterx_json_marshal_append(s, repr);
+        }
 
       if (i != 0)
         g_string_append_c(repr, ',');
 
-      str_repr_encode_append(repr, json_object_get_string(el), -1, NULL);
+      str_repr_encode_append(repr, str, str_len, NULL);
     }
 
   *t = LM_VT_LIST;
@@ -83,20 +76,45 @@ _map_to_json(FilterXObject *s, struct json_object **jso, FilterXObject **assoc_o
 {
   FilterXJsonArray *self = (FilterXJsonArray *) s;
 
-  *jso = json_object_get(self->jso);
+  *jso = json_object_new_array();
+  for (guint i = 0; i < self->elements->len; i++)
+    {
+      struct json_object *value = NULL;
+      FilterXObject *value_assoc_object = NULL;
+
+      gboolean success = filterx_object_map_to_json(g_ptr_array_index(self->elements, i), &value, &value_assoc_object);
+      filterx_object_unref(value_assoc_object);
+      if (!success)
+        goto error;
+
+      if (json_object_array_add(*jso, value) != 0)
+        {
+          json_object_put(value);
+          goto error;
+        }
+    }
   return TRUE;
+
+error:
+  json_object_put(*jso);
+  *jso = NULL;
+  return FALSE;
 }
 
 static FilterXObject *
 _clone(FilterXObject *s)
 {
   FilterXJsonArray *self = (FilterXJsonArray *) s;
+  FilterXJsonArray *clone = (FilterXJsonArray *) filterx_json_array_new_empty();
 
-  struct json_object *jso = filterx_json_deep_copy(self->jso);
-  if (!jso)
-    return NULL;
+  for (guint i = 0; i < self->elements->len; i++)
+    {
+      FilterXObject *cloned_value = filterx_object_clone(g_ptr_array_index(self->elements, i));
 
-  return filterx_json_array_new_sub(jso, NULL);
+      g_ptr_array_add(clone->elements, filterx_json_adopt_value(&clone->super.super, cloned_value));
+      filterx_object_unref(cloned_value);
+    }
+  return &clone->super.super;
 }
 
 static FilterXObject *
@@ -104,11 +122,10 @@ _get_subscript(FilterXList *s, guint64 index)
 {
   FilterXJsonArray *self = (FilterXJsonArray *) s;
 
-  struct json_object *jso = json_object_array_get_idx(self->jso, index);
-  if (!jso)
+  if (index >= self->elements->len)
     return NULL;
 
-  return filterx_json_convert_json_to_object_cached(&s->super, &self->root_container, jso);
+  return filterx_object_ref(g_ptr_array_index(self->elements, index));
 }
 
 static guint64
@@ -116,7 +133,7 @@ _len(FilterXList *s)
 {
   FilterXJsonArray *self = (FilterXJsonArray *) s;
 
-  return json_object_array_length(self->jso);
+  return self->elements->len;
 }
 
 static gboolean
@@ -124,34 +141,18 @@ _append(FilterXList *s, FilterXObject **new_value)
 {
   FilterXJsonArray *self = (FilterXJsonArray *) s;
 
-  if (G_UNLIKELY(_len(s) >= JSON_ARRAY_MAX_SIZE))
+  if (G_UNLIKELY(self->elements->len >= JSON_ARRAY_MAX_SIZE))
     return FALSE;
 
-  struct json_object *jso = NULL;
-  FilterXObject *assoc_object = NULL;
-  if (!filterx_object_map_to_json(*new_value, &jso, &assoc_object))
+  FilterXObject *value = filterx_json_adopt_value(&s->super, *new_value);
+  if (!value)
     return FALSE;
 
-  filterx_json_associate_cached_object(jso, assoc_object);
-
-  if (json_object_array_add(self->jso, jso) != 0)
-    {
-      filterx_object_unref(assoc_object);
-      json_object_put(jso);
-      return FALSE;
-    }
-
-  self->super.super.modified_in_place = TRUE;
-  FilterXObject *root_container = filterx_weakref_get(&self->root_container);
-  if (root_container)
-    {
-      root_container->modified_in_place = TRUE;
-      filterx_object_unref(root_container);
-    }
+  g_ptr_array_add(self->elements, value);
+  filterx_json_mark_modified(&s->super);
 
   filterx_object_unref(*new_value);
-  *new_value = assoc_object;
-
+  *new_value = filterx_object_ref(value);
   return TRUE;
 }
 
@@ -160,34 +161,23 @@ _set_subscript(FilterXList *s, guint64 index, FilterXObject **new_value)
 {
   FilterXJsonArray *self = (FilterXJsonArray *) s;
 
-  if (G_UNLIKELY(index >= JSON_ARRAY_MAX_SIZE))
+  if (G_UNLIKELY(index >= self->elements->len))
     return FALSE;
 
-  struct json_object *jso = NULL;
-  FilterXObject *assoc_object = NULL;
-  if (!filterx_object_map_to_json(*new_value, &jso, &assoc_object))
+  FilterXObject *value = filterx_json_adopt_value(&s->super, *new_value);
+  if (!value)
     return FALSE;
 
-  filterx_json_associate_cached_object(jso, assoc_object);
-
-  if (json_object_array_put_idx(self->jso, index, jso) != 0)
-    {
-      filterx_object_unref(assoc_object);
-      json_object_put(jso);
-      return FALSE;
-    }
-
-  self->super.super.modified_in_place = TRUE;
-  FilterXObject *root_container = filterx_weakref_get(&self->root_container);
-  if (root_container)
-    {
-      root_container->modified_in_place = TRUE;
-      filterx_object_unref(root_container);
-    }
+  FilterXObject *old_value = g_ptr_array_index(self->elements, index);
+  self->elements->pdata[index] = value;
+  if (old_value != value)
+    filterx_json_release_value(&s->super, old_value);
+  else
+    filterx_object_unref(old_value);
+  filterx_json_mark_modified(&s->super);
 
   filterx_object_unref(*new_value);
-  *new_value = assoc_object;
-
+  *new_value = filterx_object_ref(value);
   return TRUE;
 }
 
@@ -196,41 +186,29 @@ _unset_index(FilterXList *s, guint64 index)
 {
   FilterXJsonArray *self = (FilterXJsonArray *) s;
 
-  if (G_UNLIKELY(index >= JSON_ARRAY_MAX_SIZE))
+  if (G_UNLIKELY(index >= self->elements->len))
     return FALSE;
 
-  if (json_object_array_del_idx(self->jso, index, 1) != 0)
-    return FALSE;
-
-  self->super.super.modified_in_place = TRUE;
-  FilterXObject *root_container = filterx_weakref_get(&self->root_container);
-  if (root_container)
-    {
-      root_container->modified_in_place = TRUE;
-      filterx_object_unref(root_container);
-    }
-
+  filterx_json_release_value(&s->super, g_ptr_array_remove_index(self->elements, index));
+  filterx_json_mark_modified(&s->super);
   return TRUE;
 }
 
-/* NOTE: consumes root ref */
-FilterXObject *
-filterx_json_array_new_sub(struct json_object *jso, FilterXObject *root)
+FilterXObject **
+filterx_json_array_get_parent_slot(FilterXObject *s)
 {
-  FilterXJsonArray *self = g_new0(FilterXJsonArray, 1);
-  filterx_list_init_instance(&self->super, &FILTERX_TYPE_NAME(json_array));
+  FilterXJsonArray *self = (FilterXJsonArray *) s;
 
-  self->super.get_subscript = _get_subscript;
-  self->super.set_subscript = _set_subscript;
-  self->super.append = _append;
-  self->super.unset_index = _unset_index;
-  self->super.len = _len;
+  return &self->parent;
+}
 
-  filterx_weakref_set(&self->root_container, root);
-  filterx_object_unref(root);
-  self->jso = jso;
+void
+filterx_json_array_freeze_children(FilterXObject *s, GPtrArray *frozen_objects)
+{
+  FilterXJsonArray *self = (FilterXJsonArray *) s;
 
-  return &self->super.super;
+  for (guint i = 0; i < self->elements->len; i++)
+    filterx_json_deep_freeze(g_ptr_array_index(self->elements, i), frozen_objects);
 }
 
 static void
@@ -238,8 +216,9 @@ _free(FilterXObject *s)
 {
   FilterXJsonArray *self = (FilterXJsonArray *) s;
 
-  json_object_put(self->jso);
-  filterx_weakref_clear(&self->root_container);
+  for (guint i = 0; i < self->elements->len; i++)
+    filterx_json_release_value(s, g_ptr_array_index(self->elements, i));
+  g_ptr_array_free(self->elements, TRUE);
 }
 
 FilterXObject *
@@ -266,26 +245,26 @@ filterx_json_array_new_from_repr(const gchar *repr, gssize repr_len)
       return NULL;
     }
 
-  return filterx_json_array_new_sub(jso, NULL);
+  return filterx_json_new_from_object(jso);
 }
 
 FilterXObject *
 filterx_json_array_new_from_syslog_ng_list(const gchar *repr, gssize repr_len)
 {
-  struct json_object *jso = json_object_new_array();
+  FilterXJsonArray *self = (FilterXJsonArray *) filterx_json_array_new_empty();
 
   ListScanner scanner;
   list_scanner_init(&scanner);
   list_scanner_input_string(&scanner, repr, repr_len);
-  for (gint i = 0; list_scanner_scan_next(&scanner); i++)
+  while (list_scanner_scan_next(&scanner))
     {
-      json_object_array_put_idx(jso, i,
-                                json_object_new_string_len(list_scanner_get_current_value(&scanner),
-                                                           list_scanner_get_current_value_len(&scanner)));
+      g_ptr_array_add(self->elements,
+                      filterx_string_new(list_scanner_get_current_value(&scanner),
+                                         list_scanner_get_current_value_len(&scanner)));
     }
   list_scanner_deinit(&scanner);
 
-  return filterx_json_array_new_sub(jso, NULL);
+  return &self->super.super;
 }
 
 FilterXObject *
@@ -333,17 +312,26 @@ error:
 FilterXObject *
 filterx_json_array_new_empty(void)
 {
-  return filterx_json_array_new_sub(json_object_new_array(), NULL);
+  FilterXJsonArray *self = g_new0(FilterXJsonArray, 1);
+  filterx_list_init_instance(&self->super, &FILTERX_TYPE_NAME(json_array));
+
+  self->super.get_subscript = _get_subscript;
+  self->super.set_subscript = _set_subscript;
+  self->super.append = _append;
+  self->super.unset_index = _unset_index;
+  self->super.len = _len;
+
+  self->elements = g_ptr_array_new();
+
+  return &self->super.super;
 }
 
 const gchar *
 filterx_json_array_to_json_literal(FilterXObject *s)
 {
-  FilterXJsonArray *self = (FilterXJsonArray *) s;
-
   if (!filterx_object_is_type(s, &FILTERX_TYPE_NAME(json_array)))
     return NULL;
-  return json_object_to_json_string_ext(self->jso, JSON_C_TO_STRING_PLAIN);
+  return filterx_json_format_literal(s);
 }
 
 FILTERX_DEFINE_TYPE(json_array, FILTERX_TYPE_NAME(list),
@@ -25,14 +25,30 @@
 #define OBJECT_JSON_INTERNAL_H_INCLUDED
 
 #include "object-json.h"
-#include "filterx/filterx-weakrefs.h"
 
-FilterXObject *filterx_json_convert_json_to_object_cached(FilterXObject *self, FilterXWeakRef *root_container,
-                                                          struct json_object *jso);
+/*
+ * FilterX dicts and lists are stored natively, holding FilterXObject
+ * values directly.  json-c is only used when parsing JSON and when
+ * formatting the containers as JSON.
+ *
+ * A native container is held by at most one other container (its parent),
+ * so that in-place modifications can be propagated to the object stored in
+ * the scope.  The parent pointer is not a reference, it is cleared by the
+ * parent when it lets the child go.
+ */
+
+FilterXObject *filterx_json_convert_json_to_object(struct json_object *jso);
+
+FilterXObject *filterx_json_adopt_value(FilterXObject *container, FilterXObject *value);
+void filterx_json_release_value(FilterXObject *container, FilterXObject *value);
+void filterx_json_mark_modified(FilterXObject *container);
 
-struct json_object *filterx_json_deep_copy(struct json_object *jso);
+gboolean filterx_json_marshal_append(FilterXObject *s, GString *repr);
+const gchar *filterx_json_format_literal(FilterXObject *s);
 
-FilterXObject *filterx_json_object_new_sub(struct json_object *jso, FilterXObject *root);
-FilterXObject *filterx_json_array_new_sub(struct json_object *jso, FilterXObject *root);
+FilterXObject **filterx_json_object_get_parent_slot(FilterXObject *s);
+FilterXObject **filterx_json_array_get_parent_slot(FilterXObject *s);
+void filterx_json_object_freeze_children(FilterXObject *s, GPtrArray *frozen_objects);
+void filterx_json_array_freeze_children(FilterXObject *s, GPtrArray *frozen_objects);
 
 #endif
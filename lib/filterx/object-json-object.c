@@ -21,57 +21,209 @@
  *
  */
 #include "filterx/object-json-internal.h"
-#include "filterx/object-null.h"
-#include "filterx/object-primitive.h"
 #include "filterx/object-string.h"
-#include "filterx/filterx-weakrefs.h"
 #include "filterx/object-dict-interface.h"
 
+/* small objects are stored in the object itself, without a separate allocation */
+#define JSON_OBJECT_INLINE_ENTRIES 4
+/* above this size, keys are looked up through a hash table */
+#define JSON_OBJECT_INDEX_THRESHOLD 16
+
+typedef struct _FilterXJsonObjectEntry
+{
+  FilterXObject *key;
+  FilterXObject *value;
+} FilterXJsonObjectEntry;
+
 struct FilterXJsonObject_
 {
   FilterXDict super;
-  FilterXWeakRef root_container;
-  struct json_object *jso;
+  FilterXObject *parent;
+
+  /* in insertion order */
+  FilterXJsonObjectEntry *entries;
+  guint32 num_entries;
+  guint32 allocated_entries;
+
+  /* maps keys to entry indexes, built on demand for large objects */
+  GHashTable *index;
+  FilterXJsonObjectEntry inline_entries[JSON_OBJECT_INLINE_ENTRIES];
 };
 
+static guint
+_key_hash(gconstpointer k)
+{
+  gsize len;
+  const gchar *str = filterx_string_get_value((FilterXObject *) k, &len);
+  guint hash = 5381;
+
+  for (gsize i = 0; i < len; i++)
+    hash = (hash << 5) + hash + (guchar) str[i];
+  return hash;
+}
+
 static gboolean
-_truthy(FilterXObject *s)
+_key_equal(gconstpointer a, gconstpointer b)
 {
-  return TRUE;
+  if (a == b)
+    return TRUE;
+
+  gsize a_len, b_len;
+  const gchar *a_str = filterx_string_get_value((FilterXObject *) a, &a_len);
+  const gchar *b_str = filterx_string_get_value((FilterXObject *) b, &b_len);
+
+  return a_len == b_len && memcmp(a_str, b_str, a_len) == 0;
+}
+
+static void
+_build_index(FilterXJsonObject *self)
+{
+  self->index = g_hash_table_new(_key_hash, _key_equal);
+  for (guint32 i = 0; i < self->num_entries; i++)
+    g_hash_table_insert(self->index, self->entries[i].key, GUINT_TO_POINTER(i));
+}
+
+static void
+_drop_index(FilterXJsonObject *self)
+{
+  if (self->index)
+    g_hash_table_destroy(self->index);
+  self->index = NULL;
 }
 
 static gboolean
-_marshal(FilterXObject *s, GString *repr, LogMessageValueType *t)
+_lookup_entry(FilterXJsonObject *self, FilterXObject *key, guint32 *index)
 {
-  FilterXJsonObject *self = (FilterXJsonObject *) s;
+  if (self->num_entries > JSON_OBJECT_INDEX_THRESHOLD)
+    {
+      gpointer value;
+
+      if (!self->index)
+        _build_index(self);
+      if (!g_hash_table_lookup_extended(self->index, key, NULL, &value))
+        return FALSE;
+      *index = GPOINTER_TO_UINT(value);
+      return TRUE;
+    }
 
-  *t = LM_VT_JSON;
+  /* keys coming from literals are the same object, try that first */
+  for (guint32 i = 0; i < self->num_entries; i++)
+    {
+      if (self->entries[i].key == key)
+        {
+          *index = i;
+          return TRUE;
+        }
+    }
 
-  const gchar *json_repr = json_object_to_json_string_ext(self->jso, JSON_C_TO_STRING_PLAIN);
-  g_string_append(repr, json_repr);
+  for (guint32 i = 0; i < self->num_entries; i++)
+    {
+      if (_key_equal(self->entries[i].key, key))
+        {
+          *index = i;
+          return TRUE;
+        }
+    }
+  return FALSE;
+}
+
+static void
+_append_entry(FilterXJsonObject *self, FilterXObject *key, FilterXObject *value)
+{
+  if (self->num_entries == self->allocated_entries)
+    {
+      self->allocated_entries *= 2;
+      if (self->entries == self->inline_entries)
+        {
+          self->entries = g_new(FilterXJsonObjectEntry, self->allocated_entries);
+          memcpy(self->entries, self->inline_entries, sizeof(self->inline_entries));
+        }
+      else
+        {
+          self->entries = g_renew(FilterXJsonObjectEntry, self->entries, self->allocated_entries);
+        }
+    }
+
+  guint32 index = self->num_entries++;
+  self->entries[index].key = filterx_object_ref(key);
+  self->entries[index].value = value;
+  if (self->index)
+    g_hash_table_insert(self->index, key, GUINT_TO_POINTER(index));
+}
+
+static void
+_remove_entry(FilterXJsonObject *self, guint32 index)
+{
+  filterx_json_release_value(&self->super.super, self->entries[index].value);
+  filterx_object_unref(self->entries[index].key);
+
+  self->num_entries--;
+  memmove(&self->entries[index], &self->entries[index + 1],
+          (self->num_entries - index) * sizeof(FilterXJsonObjectEntry));
+
+  /* indexes have shifted, rebuilt when needed */
+  _drop_index(self);
+}
 
+static gboolean
+_truthy(FilterXObject *s)
+{
   return TRUE;
 }
 
+static gboolean
+_marshal(FilterXObject *s, GString *repr, LogMessageValueType *t)
+{
+  *t = LM_VT_JSON;
+  return filterx_json_marshal_append(s, repr);
+}
+
 static gboolean
 _map_to_json(FilterXObject *s, struct json_object **jso, FilterXObject **assoc_object)
 {
   FilterXJsonObject *self = (FilterXJsonObject *) s;
 
-  *jso = json_object_get(self->jso);
+  *jso = json_object_new_object();
+  for (guint32 i = 0; i < self->num_entries; i++)
+    {
+      struct json_object *value = NULL;
+      FilterXObject *value_assoc_object = NULL;
+
+      gboolean success = filterx_object_map_to_json(self->entries[i].value, &value, &value_assoc_object);
+      filterx_object_unref(value_assoc_object);
+      if (!success)
+        goto error;
+
+      /* FilterX strings are always NUL terminated. */
+      if (json_object_object_add(*jso, filterx_string_get_value(self->entries[i].key, NULL), value) != 0)
+        {
+          json_object_put(value);
+          goto error;
+        }
+    }
   return TRUE;
+
+error:
+  json_object_put(*jso);
+  *jso = NULL;
+  return FALSE;
 }
 
 static FilterXObject *
 _clone(FilterXObject *s)
 {
   FilterXJsonObject *self = (FilterXJsonObject *) s;
+  FilterXObject *clone = filterx_json_object_new_empty();
 
-  struct json_object *jso = filterx_json_deep_copy(self->jso);
-  if (!jso)
-    return NULL;
+  for (guint32 i = 0; i < self->num_entries; i++)
+    {
+      FilterXObject *cloned_value = filterx_object_clone(self->entries[i].value);
+      FilterXObject *value = filterx_json_adopt_value(clone, cloned_value);
 
-  return filterx_json_object_new_sub(jso, NULL);
+      filterx_object_unref(cloned_value);
+      _append_entry((FilterXJsonObject *) clone, self->entries[i].key, value);
+    }
+  return clone;
 }
 
 static FilterXObject *
@@ -79,15 +231,14 @@ _get_subscript(FilterXDict *s, FilterXObject *key)
 {
   FilterXJsonObject *self = (FilterXJsonObject *) s;
 
-  const gchar *key_str = filterx_string_get_value(key, NULL);
-  if (!key_str)
+  if (!filterx_object_is_type(key, &FILTERX_TYPE_NAME(string)))
     return NULL;
 
-  struct json_object *jso = NULL;
-  if (!json_object_object_get_ex(self->jso, key_str, &jso))
+  guint32 index;
+  if (!_lookup_entry(self, key, &index))
     return NULL;
 
-  return filterx_json_convert_json_to_object_cached(&s->super, &self->root_container, jso);
+  return filterx_object_ref(self->entries[index].value);
 }
 
 static gboolean
@@ -95,35 +246,33 @@ _set_subscript(FilterXDict *s, FilterXObject *key, FilterXObject **new_value)
 {
   FilterXJsonObject *self = (FilterXJsonObject *) s;
 
-  const gchar *key_str = filterx_string_get_value(key, NULL);
-  if (!key_str)
+  if (!filterx_object_is_type(key, &FILTERX_TYPE_NAME(string)))
     return FALSE;
 
-  struct json_object *jso = NULL;
-  FilterXObject *assoc_object = NULL;
-  if (!filterx_object_map_to_json(*new_value, &jso, &assoc_object))
+  FilterXObject *value = filterx_json_adopt_value(&s->super, *new_value);
+  if (!value)
     return FALSE;
 
-  filterx_json_associate_cached_object(jso, assoc_object);
-
-  if (json_object_object_add(self->jso, key_str, jso) != 0)
+  guint32 index;
+  if (_lookup_entry(self, key, &index))
     {
-      filterx_object_unref(assoc_object);
-      json_object_put(jso);
-      return FALSE;
-    }
+      FilterXObject *old_value = self->entries[index].value;
 
-  self->super.super.modified_in_place = TRUE;
-  FilterXObject *root_container = filterx_weakref_get(&self->root_container);
-  if (root_container)
+      self->entries[index].value = value;
+      if (old_value != value)
+        filterx_json_release_value(&s->super, old_value);
+      else
+        filterx_object_unref(old_value);
+    }
+  else
     {
-      root_container->modified_in_place = TRUE;
-      filterx_object_unref(root_container);
+      _append_entry(self, key, value);
     }
 
-  filterx_object_unref(*new_value);
-  *new_value = assoc_object;
+  filterx_json_mark_modified(&s->super);
 
+  filterx_object_unref(*new_value);
+  *new_value = filterx_object_ref(value);
   return TRUE;
 }
 
@@ -132,20 +281,14 @@ _unset_key(FilterXDict *s, FilterXObject *key)
 {
   FilterXJsonObject *self = (FilterXJsonObject *) s;
 
-  const gchar *key_str = filterx_string_get_value(key, NULL);
-  if (!key_str)
+  if (!filterx_object_is_type(key, &FILTERX_TYPE_NAME(string)))
     return FALSE;
 
-  json_object_object_del(self->jso, key_str);
-
-  self->super.super.modified_in_place = TRUE;
-  FilterXObject *root_container = filterx_weakref_get(&self->root_container);
-  if (root_container)
-    {
-      root_container->modified_in_place = TRUE;
-      filterx_object_unref(root_container);
-    }
+  guint32 index;
+  if (_lookup_entry(self, key, &index))
+    _remove_entry(self, index);
 
+  filterx_json_mark_modified(&s->super);
   return TRUE;
 }
 
@@ -154,41 +297,71 @@ _len(FilterXDict *s)
 {
   FilterXJsonObject *self = (FilterXJsonObject *) s;
 
-  return json_object_object_length(self->jso);
+  return self->num_entries;
 }
 
 static gboolean
-_iter_inner(FilterXJsonObject *self, const gchar *obj_key, struct json_object *jso,
-            FilterXDictIterFunc func, gpointer user_data)
+_iter(FilterXDict *s, FilterXDictIterFunc func, gpointer user_data)
 {
-  FilterXObject *key = filterx_string_new(obj_key, -1);
-  FilterXObject *value = filterx_json_convert_json_to_object_cached(&self->super.super, &self->root_container,
-                         jso);
+  FilterXJsonObject *self = (FilterXJsonObject *) s;
+
+  for (guint32 i = 0; i < self->num_entries; i++)
+    {
+      /* the callback might change the object, let's keep the entry alive */
+      FilterXObject *key = filterx_object_ref(self->entries[i].key);
+      FilterXObject *value = filterx_object_ref(self->entries[i].value);
 
-  gboolean result = func(key, value, user_data);
+      gboolean result = func(key, value, user_data);
 
-  filterx_object_unref(key);
-  filterx_object_unref(value);
-  return result;
+      filterx_object_unref(key);
+      filterx_object_unref(value);
+      if (!result)
+        return FALSE;
+    }
+  return TRUE;
 }
 
-static gboolean
-_iter(FilterXDict *s, FilterXDictIterFunc func, gpointer user_data)
+FilterXObject **
+filterx_json_object_get_parent_slot(FilterXObject *s)
 {
   FilterXJsonObject *self = (FilterXJsonObject *) s;
 
-  struct json_object_iter itr;
-  json_object_object_foreachC(self->jso, itr)
-  {
-    if (!_iter_inner(self, itr.key, itr.val, func, user_data))
-      return FALSE;
-  }
-  return TRUE;
+  return &self->parent;
+}
+
+void
+filterx_json_object_freeze_children(FilterXObject *s, GPtrArray *frozen_objects)
+{
+  FilterXJsonObject *self = (FilterXJsonObject *) s;
+
+  /* frozen objects are shared between threads, the index can't be built lazily */
+  if (self->num_entries > JSON_OBJECT_INDEX_THRESHOLD && !self->index)
+    _build_index(self);
+
+  for (guint32 i = 0; i < self->num_entries; i++)
+    {
+      filterx_json_deep_freeze(self->entries[i].key, frozen_objects);
+      filterx_json_deep_freeze(self->entries[i].value, frozen_objects);
+    }
+}
+
+static void
+_free(FilterXObject *s)
+{
+  FilterXJsonObject *self = (FilterXJsonObject *) s;
+
+  for (guint32 i = 0; i < self->num_entries; i++)
+    {
+      filterx_json_release_value(s, self->entries[i].value);
+      filterx_object_unref(self->entries[i].key);
+    }
+  if (self->entries != self->inline_entries)
+    g_free(self->entries);
+  _drop_index(self);
 }
 
-/* NOTE: consumes root ref */
 FilterXObject *
-filterx_json_object_new_sub(struct json_object *jso, FilterXObject *root)
+filterx_json_object_new_empty(void)
 {
   FilterXJsonObject *self = g_new0(FilterXJsonObject, 1);
   filterx_dict_init_instance(&self->super, &FILTERX_TYPE_NAME(json_object));
@@ -199,22 +372,12 @@ filterx_json_object_new_sub(struct json_object *jso, FilterXObject *root)
   self->super.len = _len;
   self->super.iter = _iter;
 
-  filterx_weakref_set(&self->root_container, root);
-  filterx_object_unref(root);
-  self->jso = jso;
+  self->entries = self->inline_entries;
+  self->allocated_entries = JSON_OBJECT_INLINE_ENTRIES;
 
   return &self->super.super;
 }
 
-static void
-_free(FilterXObject *s)
-{
-  FilterXJsonObject *self = (FilterXJsonObject *) s;
-
-  json_object_put(self->jso);
-  filterx_weakref_clear(&self->root_container);
-}
-
 FilterXObject *
 filterx_json_object_new_from_repr(const gchar *repr, gssize repr_len)
 {
@@ -229,23 +392,25 @@ filterx_json_object_new_from_repr(const gchar *repr, gssize repr_len)
     }
 
   json_tokener_free(tokener);
-  return jso ? filterx_json_object_new_sub(jso, NULL) : NULL;
-}
 
-FilterXObject *
-filterx_json_object_new_empty(void)
-{
-  return filterx_json_object_new_sub(json_object_new_object(), NULL);
+  if (!jso)
+    return NULL;
+
+  if (!json_object_is_type(jso, json_type_object))
+    {
+      json_object_put(jso);
+      return NULL;
+    }
+
+  return filterx_json_new_from_object(jso);
 }
 
 const gchar *
 filterx_json_object_to_json_literal(FilterXObject *s)
 {
-  FilterXJsonObject *self = (FilterXJsonObject *) s;
-
   if (!filterx_object_is_type(s, &FILTERX_TYPE_NAME(json_object)))
     return NULL;
-  return json_object_to_json_string_ext(self->jso, JSON_C_TO_STRING_PLAIN);
+  return filterx_json_format_literal(s);
 }
 
 FILTERX_DEFINE_TYPE(json_object, FILTERX_TYPE_NAME(dict),
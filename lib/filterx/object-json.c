@@ -25,57 +25,65 @@
 #include "filterx/object-primitive.h"
 #include "filterx/object-string.h"
 #include "filterx/object-message-value.h"
-#include "filterx/filterx-weakrefs.h"
-#include "filterx/filterx-eval.h"
+#include "filterx/object-dict-interface.h"
+#include "filterx/object-list-interface.h"
+#include "scratch-buffers.h"
 
-#include "scanner/list-scanner/list-scanner.h"
-#include "str-repr/encode.h"
+static FilterXObject *
+_convert_json_object(struct json_object *jso)
+{
+  FilterXObject *result = filterx_json_object_new_empty();
+  struct json_object_iter itr;
+
+  json_object_object_foreachC(jso, itr)
+  {
+    FilterXObject *key = filterx_string_new(itr.key, -1);
+    FilterXObject *value = filterx_json_convert_json_to_object(itr.val);
+    gboolean success = filterx_object_set_subscript(result, key, &value);
+
+    filterx_object_unref(key);
+    filterx_object_unref(value);
+    if (!success)
+      {
+        filterx_object_unref(result);
+        return NULL;
+      }
+  }
+
+  /* freshly parsed, it was not modified compared to its JSON source */
+  result->modified_in_place = FALSE;
+  return result;
+}
 
-static int
-_deep_copy_filterx_object_ref(json_object *src, json_object *parent, const char *key, size_t index, json_object **dst)
+static FilterXObject *
+_convert_json_array(struct json_object *jso)
 {
-  int result = json_c_shallow_copy_default(src, parent, key, index, dst);
+  FilterXObject *result = filterx_json_array_new_empty();
 
-  if (*dst != NULL)
+  for (gsize i = 0; i < json_object_array_length(jso); i++)
     {
-      /* we need to copy the userdata for primitive types */
+      FilterXObject *value = filterx_json_convert_json_to_object(json_object_array_get_idx(jso, i));
+      gboolean success = filterx_list_append(result, &value);
 
-      switch (json_object_get_type(src))
-        {
-        case json_type_null:
-        case json_type_boolean:
-        case json_type_double:
-        case json_type_int:
-        case json_type_string:
+      filterx_object_unref(value);
+      if (!success)
         {
-          FilterXObject *fobj = json_object_get_userdata(src);
-          if (fobj)
-            filterx_json_associate_cached_object(*dst, fobj);
-          break;
-        }
-        default:
-          break;
+          filterx_object_unref(result);
+          return NULL;
         }
-      return 2;
     }
-  return result;
-}
-
-struct json_object *
-filterx_json_deep_copy(struct json_object *jso)
-{
-  struct json_object *clone = NULL;
-  if (json_object_deep_copy(jso, &clone, _deep_copy_filterx_object_ref) != 0)
-    return NULL;
 
-  return clone;
+  result->modified_in_place = FALSE;
+  return result;
 }
 
-static FilterXObject *
-_convert_json_to_object(FilterXObject *self, FilterXWeakRef *root_container, struct json_object *jso)
+FilterXObject *
+filterx_json_convert_json_to_object(struct json_object *jso)
 {
   switch (json_object_get_type(jso))
     {
+    case json_type_null:
+      return filterx_null_new();
     case json_type_double:
       return filterx_double_new(json_object_get_double(jso));
     case json_type_boolean:
@@ -83,61 +91,232 @@ _convert_json_to_object(FilterXObject *self, FilterXWeakRef *root_container, str
     case json_type_int:
       return filterx_integer_new(json_object_get_int64(jso));
     case json_type_string:
-      return filterx_string_new(json_object_get_string(jso), -1);
+      return filterx_string_new(json_object_get_string(jso), json_object_get_string_len(jso));
     case json_type_array:
-      return filterx_json_array_new_sub(json_object_get(jso),
-                                        filterx_weakref_get(root_container) ? : filterx_object_ref(self));
+      return _convert_json_array(jso);
     case json_type_object:
-      return filterx_json_object_new_sub(json_object_get(jso),
-                                         filterx_weakref_get(root_container) ? : filterx_object_ref(self));
+      return _convert_json_object(jso);
     default:
       g_assert_not_reached();
     }
 }
 
+static FilterXObject **
+_get_parent_slot(FilterXObject *s)
+{
+  /* NOTE: the free_fn identifies our implementation, even if the type was
+   * derived from ours */
+  if (s->type->free_fn == FILTERX_TYPE_NAME(json_object).free_fn)
+    return filterx_json_object_get_parent_slot(s);
+  if (s->type->free_fn == FILTERX_TYPE_NAME(json_array).free_fn)
+    return filterx_json_array_get_parent_slot(s);
+  return NULL;
+}
+
+static gboolean
+_is_stored_as_is(FilterXObject *value)
+{
+  return filterx_object_is_type(value, &FILTERX_TYPE_NAME(string)) ||
+         filterx_object_is_type(value, &FILTERX_TYPE_NAME(integer)) ||
+         filterx_object_is_type(value, &FILTERX_TYPE_NAME(double)) ||
+         filterx_object_is_type(value, &FILTERX_TYPE_NAME(boolean)) ||
+         filterx_object_is_type(value, &FILTERX_TYPE_NAME(null));
+}
+
+static gboolean
+_add_elem_to_native_dict(FilterXObject *key, FilterXObject *value, gpointer user_data)
+{
+  FilterXObject *dict = (FilterXObject *) user_data;
+  FilterXObject *cloned = filterx_object_clone(value);
+
+  gboolean success = filterx_object_set_subscript(dict, key, &cloned);
+  filterx_object_unref(cloned);
+  return success;
+}
+
+static FilterXObject *
+_convert_foreign_dict(FilterXObject *value)
+{
+  FilterXObject *result = filterx_json_object_new_empty();
+
+  if (!filterx_dict_iter(value, _add_elem_to_native_dict, result))
+    {
+      filterx_object_unref(result);
+      return NULL;
+    }
+  return result;
+}
+
+static FilterXObject *
+_convert_foreign_list(FilterXObject *value)
+{
+  FilterXObject *result = filterx_json_array_new_empty();
+  guint64 len;
+
+  if (!filterx_object_len(value, &len))
+    goto error;
+
+  for (guint64 i = 0; i < len; i++)
+    {
+      FilterXObject *elem = filterx_list_get_subscript(value, i);
+      if (!elem)
+        goto error;
+
+      FilterXObject *cloned = filterx_object_clone(elem);
+      filterx_object_unref(elem);
+
+      gboolean success = filterx_list_append(result, &cloned);
+      filterx_object_unref(cloned);
+      if (!success)
+        goto error;
+    }
+  return result;
+
+error:
+  filterx_object_unref(result);
+  return NULL;
+}
+
+static FilterXObject *
+_convert_value_for_storage(FilterXObject *value)
+{
+  if (filterx_object_is_type(value, &FILTERX_TYPE_NAME(message_value)))
+    return filterx_object_unmarshal(value);
+
+  if (filterx_object_is_type(value, &FILTERX_TYPE_NAME(dict)))
+    return _convert_foreign_dict(value);
+
+  if (filterx_object_is_type(value, &FILTERX_TYPE_NAME(list)))
+    return _convert_foreign_list(value);
+
+  /* anything else is stored as the object that represents it in JSON */
+  struct json_object *jso = NULL;
+  FilterXObject *assoc_object = NULL;
+  if (!filterx_object_map_to_json(value, &jso, &assoc_object))
+    {
+      filterx_object_unref(assoc_object);
+      return NULL;
+    }
+  json_object_put(jso);
+  return assoc_object;
+}
+
+/*
+ * Returns the object to be stored in @container for @value, or NULL if
+ * @value cannot be represented in JSON.  Native containers are linked to
+ * @container, containers already held by another one are cloned.
+ */
 FilterXObject *
-filterx_json_convert_json_to_object_cached(FilterXObject *self, FilterXWeakRef *root_container,
-                                           struct json_object *jso)
+filterx_json_adopt_value(FilterXObject *container, FilterXObject *value)
 {
-  FilterXObject *filterx_obj;
+  FilterXObject **parent = _get_parent_slot(value);
 
-  if (!jso || json_object_get_type(jso) == json_type_null)
-    return filterx_null_new();
+  if (parent)
+    {
+      /* read-only containers are never modified, they can be shared */
+      if (value->readonly)
+        return filterx_object_ref(value);
+
+      if (*parent && *parent != container)
+        {
+          FilterXObject *cloned = filterx_object_clone(value);
+          FilterXObject *result = filterx_json_adopt_value(container, cloned);
+
+          filterx_object_unref(cloned);
+          return result;
+        }
+
+      *parent = container;
+      return filterx_object_ref(value);
+    }
 
-  if (json_object_get_type(jso) == json_type_double)
+  if (_is_stored_as_is(value))
+    return filterx_object_ref(value);
+
+  FilterXObject *converted = _convert_value_for_storage(value);
+  if (!converted)
+    return NULL;
+
+  FilterXObject *result = converted;
+  if (converted != value)
     {
-      /* this is a workaround to ditch builtin serializer for double objects
-       * that are set when parsing from a string representation.
-       * json_object_double_new_ds() will set userdata to the string
-       * representation of the number, as extracted from the JSON source.
-       *
-       * Changing the value of the double to the same value, ditches this,
-       * but only if necessary.
-       */
-
-      json_object_set_double(jso, json_object_get_double(jso));
+      result = filterx_json_adopt_value(container, converted);
+      filterx_object_unref(converted);
     }
+  return result;
+}
 
-  /* NOTE: userdata is a weak reference */
-  filterx_obj = json_object_get_userdata(jso);
-  if (filterx_obj)
-    return filterx_object_ref(filterx_obj);
+/* NOTE: consumes the value reference */
+void
+filterx_json_release_value(FilterXObject *container, FilterXObject *value)
+{
+  FilterXObject **parent = _get_parent_slot(value);
 
-  filterx_obj = _convert_json_to_object(self, root_container, jso);
-  if (!filterx_object_is_frozen(self))
-    filterx_json_associate_cached_object(jso, filterx_obj);
-  return filterx_obj;
+  if (parent && *parent == container)
+    *parent = NULL;
+  filterx_object_unref(value);
 }
 
 void
-filterx_json_associate_cached_object(struct json_object *jso, FilterXObject *filterx_obj)
+filterx_json_mark_modified(FilterXObject *container)
 {
-  filterx_eval_store_weak_ref(filterx_obj);
+  while (container)
+    {
+      container->modified_in_place = TRUE;
 
-  /* we are not storing a reference in userdata to avoid circular
-   * references.  That ref is retained by the filterx_scope_store_weak_ref()
-   * call above, which is automatically terminated when the scope ends */
-  json_object_set_userdata(jso, filterx_obj, NULL);
+      FilterXObject **parent = _get_parent_slot(container);
+      container = parent ? *parent : NULL;
+    }
+}
+
+gboolean
+filterx_json_marshal_append(FilterXObject *s, GString *repr)
+{
+  struct json_object *jso = NULL;
+  FilterXObject *assoc_object = NULL;
+
+  if (!filterx_object_map_to_json(s, &jso, &assoc_object))
+    {
+      filterx_object_unref(assoc_object);
+      return FALSE;
+    }
+
+  g_string_append(repr, json_object_to_json_string_ext(jso, JSON_C_TO_STRING_PLAIN));
+  json_object_put(jso);
+  filterx_object_unref(assoc_object);
+  return TRUE;
+}
+
+/* NOTE: the result is stored in a scratch buffer */
+const gchar *
+filterx_json_format_literal(FilterXObject *s)
+{
+  GString *literal = scratch_buffers_alloc();
+
+  if (!filterx_json_marshal_append(s, literal))
+    return NULL;
+  return literal->str;
+}
+
+/*
+ * Freezes @s along with everything it holds, so that it can be shared
+ * between threads.  The object must be exclusively owned (e.g. freshly
+ * parsed).  Objects frozen here are appended to @frozen_objects, containers
+ * before their elements, which is the order they need to be unfrozen with
+ * filterx_object_unfreeze_and_free().
+ */
+void
+filterx_json_deep_freeze(FilterXObject *s, GPtrArray *frozen_objects)
+{
+  filterx_object_make_readonly(s);
+  if (!filterx_object_freeze(s))
+    return;
+  g_ptr_array_add(frozen_objects, s);
+
+  if (s->type->free_fn == FILTERX_TYPE_NAME(json_object).free_fn)
+    filterx_json_object_freeze_children(s, frozen_objects);
+  else if (s->type->free_fn == FILTERX_TYPE_NAME(json_array).free_fn)
+    filterx_json_array_freeze_children(s, frozen_objects);
 }
 
 FilterXObject *
@@ -194,13 +373,14 @@ error:
 FilterXObject *
 filterx_json_new_from_object(struct json_object *jso)
 {
-  if (json_object_get_type(jso) == json_type_object)
-    return filterx_json_object_new_sub(jso, NULL);
+  FilterXObject *result = NULL;
 
-  if (json_object_get_type(jso) == json_type_array)
-    return filterx_json_array_new_sub(jso, NULL);
+  if (json_object_get_type(jso) == json_type_object ||
+      json_object_get_type(jso) == json_type_array)
+    result = filterx_json_convert_json_to_object(jso);
 
-  return NULL;
+  json_object_put(jso);
+  return result;
 }
 
 const gchar *
@@ -43,12 +43,13 @@ FilterXObject *filterx_json_array_new_empty(void);
 FilterXObject *filterx_json_new_from_args(GPtrArray *args);
 FilterXObject *filterx_json_array_new_from_args(GPtrArray *args);
 
+/* NOTE: consumes the json_object reference */
 FilterXObject *filterx_json_new_from_object(struct json_object *object);
 
 const gchar *filterx_json_to_json_literal(FilterXObject *s);
 const gchar *filterx_json_object_to_json_literal(FilterXObject *s);
 const gchar *filterx_json_array_to_json_literal(FilterXObject *s);
 
-void filterx_json_associate_cached_object(struct json_object *jso, FilterXObject *filterx_object);
+void filterx_json_deep_freeze(FilterXObject *s, GPtrArray *frozen_objects);
 
 #endif
@@ -34,6 +34,8 @@ typedef struct _FilterXString
   gchar str[];
 } FilterXString;
 
+static FilterXObject *empty_string;
+
 const gchar *
 filterx_string_get_value(FilterXObject *s, gsize *length)
 {
@@ -120,18 +122,26 @@ _string_repr(FilterXObject *s, GString *repr)
   return TRUE;
 }
 
-FilterXObject *
-filterx_string_new(const gchar *str, gssize str_len)
+static FilterXString *
+_string_new(FilterXType *type, const gchar *str, gssize str_len)
 {
   if (str_len < 0)
     str_len = strlen(str);
-  FilterXString *self = g_malloc(sizeof(FilterXString) + str_len + 1);
-  memset(self, 0, sizeof(FilterXString));
-  filterx_object_init_instance(&self->super, &FILTERX_TYPE_NAME(string));
+  FilterXString *self = filterx_object_alloc(sizeof(FilterXString) + str_len + 1);
+  filterx_object_init_instance(&self->super, type);
   self->str_len = str_len;
   memcpy(self->str, str, str_len);
   self->str[str_len] = 0;
-  return &self->super;
+  return self;
+}
+
+FilterXObject *
+filterx_string_new(const gchar *str, gssize str_len)
+{
+  if (str_len == 0 || (str_len < 0 && str[0] == 0))
+    return filterx_object_ref(empty_string);
+
+  return &_string_new(&FILTERX_TYPE_NAME(string), str, str_len)->super;
 }
 
 static inline gsize
@@ -193,17 +203,13 @@ _bytes_repr(FilterXObject *s, GString *repr)
 FilterXObject *
 filterx_bytes_new(const gchar *mem, gssize mem_len)
 {
-  FilterXString *self = (FilterXString *) filterx_string_new(mem, mem_len);
-  self->super.type = &FILTERX_TYPE_NAME(bytes);
-  return &self->super;
+  return &_string_new(&FILTERX_TYPE_NAME(bytes), mem, mem_len)->super;
 }
 
 FilterXObject *
 filterx_protobuf_new(const gchar *mem, gssize mem_len)
 {
-  FilterXString *self = (FilterXString *) filterx_bytes_new(mem, mem_len);
-  self->super.type = &FILTERX_TYPE_NAME(protobuf);
-  return &self->super;
+  return &_string_new(&FILTERX_TYPE_NAME(protobuf), mem, mem_len)->super;
 }
 
 FilterXObject *
@@ -318,3 +324,15 @@ FILTERX_DEFINE_TYPE(protobuf, FILTERX_TYPE_NAME(object),
                     .truthy = _truthy,
                     .repr = _bytes_repr,
                    );
+
+void
+filterx_string_global_init(void)
+{
+  filterx_cache_object(&empty_string, &_string_new(&FILTERX_TYPE_NAME(string), "", 0)->super);
+}
+
+void
+filterx_string_global_deinit(void)
+{
+  filterx_uncache_object(&empty_string);
+}
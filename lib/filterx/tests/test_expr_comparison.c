@@ -33,6 +33,7 @@
 #include "filterx/object-null.h"
 #include "filterx/object-datetime.h"
 #include "filterx/object-message-value.h"
+#include "filterx/expr-template.h"
 
 #include "apphook.h"
 #include "scratch-buffers.h"
@@ -651,6 +652,33 @@ Test(expr_comparison, test_type_aware_fallback_type_and_value_based_comparison)
 
 }
 
+Test(expr_comparison, test_literal_comparison_is_folded_by_the_optimizer)
+{
+  FilterXExpr *cmp = filterx_comparison_new(filterx_literal_new(filterx_integer_new(5)),
+                                            filterx_literal_new(filterx_integer_new(6)),
+                                            FCMPX_LT | FCMPX_NUM_BASED);
+
+  cmp = filterx_expr_optimize(cmp);
+  cr_assert(filterx_expr_is_literal(cmp));
+
+  FilterXObject *result = filterx_expr_eval(cmp);
+  cr_assert(filterx_object_is_type(result, &FILTERX_TYPE_NAME(boolean)));
+  cr_assert(filterx_object_truthy(result));
+  filterx_object_unref(result);
+  filterx_expr_unref(cmp);
+}
+
+Test(expr_comparison, test_non_literal_comparison_is_not_folded_by_the_optimizer)
+{
+  FilterXExpr *cmp = filterx_comparison_new(filterx_template_new(compile_template("$HOST")),
+                                            filterx_literal_new(filterx_string_new("bzorp", -1)),
+                                            FCMPX_EQ | FCMPX_STRING_BASED);
+
+  cmp = filterx_expr_optimize(cmp);
+  cr_assert_not(filterx_expr_is_literal(cmp));
+  filterx_expr_unref(cmp);
+}
+
 static void
 setup(void)
 {
@@ -418,6 +418,71 @@ Test(expr_condition, test_condition_with_complex_expression_to_check_memory_leak
   filterx_object_unref(res);
 }
 
+Test(expr_condition, test_optimizer_keeps_only_the_statements_of_a_true_literal_condition)
+{
+  GList *stmts = g_list_append(NULL, filterx_literal_new(filterx_string_new("matched", -1)));
+  GList *else_stmts = g_list_append(NULL, filterx_literal_new(filterx_string_new("else", -1)));
+
+  FilterXExpr *cond = filterx_conditional_new_conditional_codeblock(filterx_literal_new(filterx_boolean_new(TRUE)),
+                      stmts);
+  cond = filterx_conditional_add_false_branch((FilterXConditional *)cond,
+                                              (FilterXConditional *)filterx_conditional_new_codeblock(else_stmts));
+  cond = filterx_expr_optimize(cond);
+
+  FilterXConditional *optimized = (FilterXConditional *) cond;
+  cr_assert_null(optimized->condition);
+  cr_assert_null(optimized->false_branch);
+
+  FilterXObject *res = filterx_expr_eval(cond);
+  cr_assert_eq(_assert_cmp_string_to_filterx_object("matched", res), 0);
+
+  filterx_expr_unref(cond);
+  filterx_object_unref(res);
+}
+
+Test(expr_condition, test_optimizer_drops_branches_with_false_literal_conditions)
+{
+  GList *stmts = g_list_append(NULL, filterx_literal_new(filterx_string_new("if", -1)));
+  GList *elif_stmts = g_list_append(NULL, filterx_literal_new(filterx_string_new("elif", -1)));
+
+  FilterXExpr *cond = filterx_conditional_new_conditional_codeblock(filterx_literal_new(filterx_boolean_new(FALSE)),
+                      stmts);
+  cond = filterx_conditional_add_false_branch((FilterXConditional *)cond,
+                                              (FilterXConditional *)filterx_conditional_new_conditional_codeblock(
+                                                filterx_msg_variable_expr_new("$control-value"), elif_stmts));
+  cond = filterx_expr_optimize(cond);
+
+  FilterXConditional *optimized = (FilterXConditional *) cond;
+  cr_assert_not_null(optimized->condition);
+  cr_assert_not(filterx_expr_is_literal(optimized->condition));
+  cr_assert_null(optimized->false_branch);
+
+  FilterXObject *res = filterx_expr_eval(cond);
+  cr_assert_eq(_assert_cmp_string_to_filterx_object("elif", res), 0);
+
+  filterx_expr_unref(cond);
+  filterx_object_unref(res);
+}
+
+Test(expr_condition, test_optimizer_replaces_non_matching_if_without_else_with_empty_codeblock)
+{
+  GList *stmts = g_list_append(NULL, filterx_literal_new(filterx_string_new("if", -1)));
+
+  FilterXExpr *cond = filterx_conditional_new_conditional_codeblock(filterx_literal_new(filterx_integer_new(0)), stmts);
+  cond = filterx_expr_optimize(cond);
+
+  FilterXConditional *optimized = (FilterXConditional *) cond;
+  cr_assert_null(optimized->condition);
+  cr_assert_null(optimized->statements);
+
+  FilterXObject *res = filterx_expr_eval(cond);
+  cr_assert(filterx_object_is_type(res, &FILTERX_TYPE_NAME(boolean)));
+  cr_assert(filterx_object_truthy(res));
+
+  filterx_expr_unref(cond);
+  filterx_object_unref(res);
+}
+
 static void
 setup(void)
 {
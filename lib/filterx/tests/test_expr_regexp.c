@@ -30,6 +30,7 @@
 #include "filterx/object-primitive.h"
 #include "filterx/object-dict-interface.h"
 #include "filterx/object-list-interface.h"
+#include "filterx/filterx-eval.h"
 #include "apphook.h"
 
 static gboolean
@@ -75,6 +76,41 @@ Test(filterx_expr_regexp, regexp_match)
   _assert_match_init_error("abc", "(");
 }
 
+/* the optimizer runs at configuration time, without an evaluation context */
+static FilterXExpr *
+_optimize_without_eval_context(FilterXExpr *expr)
+{
+  FilterXEvalContext *context = filterx_eval_get_context();
+
+  filterx_eval_set_context(NULL);
+  expr = filterx_expr_optimize(expr);
+  cr_assert_null(filterx_eval_get_context());
+  filterx_eval_set_context(context);
+
+  return expr;
+}
+
+Test(filterx_expr_regexp, regexp_match_on_a_literal_string_is_folded_by_the_optimizer)
+{
+  FilterXExpr *expr = filterx_expr_regexp_match_new(filterx_literal_new(filterx_string_new("foo", -1)), "fo+");
+
+  expr = _optimize_without_eval_context(expr);
+  cr_assert(filterx_expr_is_literal(expr));
+  cr_assert(filterx_literal_is_truthy(expr));
+
+  filterx_expr_unref(expr);
+}
+
+Test(filterx_expr_regexp, regexp_match_on_a_non_string_literal_is_not_folded)
+{
+  FilterXExpr *expr = filterx_expr_regexp_match_new(filterx_literal_new(filterx_integer_new(42)), "42");
+
+  expr = _optimize_without_eval_context(expr);
+  cr_assert_not(filterx_expr_is_literal(expr));
+
+  filterx_expr_unref(expr);
+}
+
 static FilterXObject *
 _search(const gchar *lhs, const gchar *pattern)
 {
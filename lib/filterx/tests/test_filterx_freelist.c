@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#include <criterion/criterion.h>
+
+#include "filterx/filterx-freelist.h"
+#include "filterx/object-primitive.h"
+#include "filterx/object-string.h"
+#include "apphook.h"
+#include "scratch-buffers.h"
+
+Test(filterx_freelist, test_freed_blocks_are_reused_within_their_size_class)
+{
+  guint freelist_class, other_class;
+  gsize allocated, reused;
+
+  gpointer block = filterx_freelist_alloc(24, &freelist_class);
+  cr_assert_neq(freelist_class, FILTERX_FREELIST_NONE);
+  filterx_freelist_free(block, freelist_class);
+
+  filterx_freelist_get_local_stats(&allocated, &reused);
+
+  /* same size class, even if the size is different */
+  gpointer reused_block = filterx_freelist_alloc(32, &other_class);
+  cr_assert_eq(other_class, freelist_class);
+  cr_assert_eq(reused_block, block);
+
+  gsize new_allocated, new_reused;
+  filterx_freelist_get_local_stats(&new_allocated, &new_reused);
+  cr_assert_eq(new_allocated, allocated);
+  cr_assert_eq(new_reused, reused + 1);
+
+  filterx_freelist_free(reused_block, other_class);
+}
+
+Test(filterx_freelist, test_large_blocks_are_not_pooled)
+{
+  guint freelist_class;
+
+  gpointer block = filterx_freelist_alloc(4096, &freelist_class);
+  cr_assert_eq(freelist_class, FILTERX_FREELIST_NONE);
+  filterx_freelist_free(block, freelist_class);
+}
+
+Test(filterx_freelist, test_freelists_are_bounded)
+{
+  gpointer blocks[FILTERX_FREELIST_MAX_BLOCKS + 1];
+  guint freelist_class;
+
+  for (gint i = 0; i < G_N_ELEMENTS(blocks); i++)
+    blocks[i] = filterx_freelist_alloc(64, &freelist_class);
+  for (gint i = 0; i < G_N_ELEMENTS(blocks); i++)
+    filterx_freelist_free(blocks[i], freelist_class);
+
+  gsize allocated, reused;
+  filterx_freelist_get_local_stats(&allocated, &reused);
+
+  for (gint i = 0; i < G_N_ELEMENTS(blocks); i++)
+    blocks[i] = filterx_freelist_alloc(64, &freelist_class);
+
+  gsize new_allocated, new_reused;
+  filterx_freelist_get_local_stats(&new_allocated, &new_reused);
+  cr_assert_eq(new_reused, reused + FILTERX_FREELIST_MAX_BLOCKS);
+  cr_assert_eq(new_allocated, allocated + 1);
+
+  for (gint i = 0; i < G_N_ELEMENTS(blocks); i++)
+    filterx_freelist_free(blocks[i], freelist_class);
+}
+
+Test(filterx_freelist, test_temporary_objects_are_recycled)
+{
+  FilterXObject *value = filterx_integer_new(G_MAXINT32);
+  filterx_object_unref(value);
+
+  FilterXObject *next_value = filterx_string_new("foobar", -1);
+  cr_assert_eq(next_value, value);
+  cr_assert_str_eq(filterx_string_get_value(next_value, NULL), "foobar");
+  cr_assert_not(next_value->modified_in_place);
+  filterx_object_unref(next_value);
+}
+
+Test(filterx_freelist, test_empty_strings_are_shared)
+{
+  FilterXObject *empty = filterx_string_new("", -1);
+  FilterXObject *other_empty = filterx_string_new("foo", 0);
+
+  cr_assert_eq(empty, other_empty);
+  cr_assert(filterx_object_is_frozen(empty));
+  cr_assert_str_eq(filterx_string_get_value(empty, NULL), "");
+
+  /* bytes are a different type, these are never shared */
+  FilterXObject *empty_bytes = filterx_bytes_new("", 0);
+  cr_assert_neq(empty_bytes, empty);
+  cr_assert(filterx_object_is_type(empty_bytes, &FILTERX_TYPE_NAME(bytes)));
+
+  filterx_object_unref(empty_bytes);
+  filterx_object_unref(other_empty);
+  filterx_object_unref(empty);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+}
+
+static void
+teardown(void)
+{
+  scratch_buffers_explicit_gc();
+  app_shutdown();
+}
+
+TestSuite(filterx_freelist, .init = setup, .fini = teardown);
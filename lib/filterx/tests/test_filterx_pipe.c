@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#include <criterion/criterion.h>
+
+#include "filterx/filterx-pipe.h"
+#include "filterx/filterx-eval.h"
+#include "filterx/expr-assign.h"
+#include "filterx/expr-variable.h"
+#include "apphook.h"
+#include "cfg.h"
+#include "scratch-buffers.h"
+
+typedef struct _CollectorPipe
+{
+  LogPipe super;
+  gint queue_calls;
+  gint queue_batch_calls;
+  GPtrArray *results;
+} CollectorPipe;
+
+/* stores the value of $result, after syncing the filterx scope to the message */
+static void
+_collect_message(CollectorPipe *self, LogMessage *msg, const LogPathOptions *path_options)
+{
+  filterx_eval_sync_message(path_options->filterx_context, &msg, path_options);
+  g_ptr_array_add(self->results, g_strdup(log_msg_get_value_by_name(msg, "result", NULL)));
+  log_msg_drop(msg, path_options, AT_PROCESSED);
+}
+
+static void
+collector_pipe_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
+{
+  CollectorPipe *self = (CollectorPipe *) s;
+
+  self->queue_calls++;
+  _collect_message(self, msg, path_options);
+}
+
+static void
+collector_pipe_queue_batch(LogPipe *s, LogMessage **msgs, const LogPathOptions **path_options, gint count)
+{
+  CollectorPipe *self = (CollectorPipe *) s;
+
+  self->queue_batch_calls++;
+  for (gint i = 0; i < count; i++)
+    _collect_message(self, msgs[i], path_options[i]);
+}
+
+static void
+collector_pipe_free(LogPipe *s)
+{
+  CollectorPipe *self = (CollectorPipe *) s;
+
+  g_ptr_array_free(self->results, TRUE);
+  log_pipe_free_method(s);
+}
+
+static CollectorPipe *
+collector_pipe_new(void)
+{
+  CollectorPipe *self = g_new0(CollectorPipe, 1);
+
+  log_pipe_init_instance(&self->super, configuration);
+  self->super.queue = collector_pipe_queue;
+  self->super.free_fn = collector_pipe_free;
+  log_pipe_set_queue_batch(&self->super, collector_pipe_queue_batch);
+  self->results = g_ptr_array_new_with_free_func(g_free);
+  return self;
+}
+
+/*
+ * $MSG;
+ * $result = $MSG;
+ */
+static LogPipe *
+_construct_filterx_pipe(CollectorPipe *collector)
+{
+  GList *stmts = NULL;
+
+  stmts = g_list_append(stmts, filterx_msg_variable_expr_new("MSG"));
+  stmts = g_list_append(stmts, filterx_assign_new(filterx_msg_variable_expr_new("result"),
+                                                  filterx_msg_variable_expr_new("MSG")));
+
+  LogPipe *pipe = log_filterx_pipe_new(stmts, configuration);
+  log_pipe_append(pipe, &collector->super);
+  cr_assert(log_pipe_init(pipe));
+  cr_assert(log_pipe_init(&collector->super));
+  return pipe;
+}
+
+static void
+_free_pipes(LogPipe *pipe, CollectorPipe *collector)
+{
+  log_pipe_deinit(pipe);
+  log_pipe_deinit(&collector->super);
+  log_pipe_unref(pipe);
+  log_pipe_unref(&collector->super);
+}
+
+static gint
+_fill_batch(LogMessage **msgs, LogPathOptions *path_options, const LogPathOptions **batch_path_options,
+            gboolean *matched, gint count)
+{
+  for (gint i = 0; i < count; i++)
+    {
+      gchar value[32] = "";
+
+      /* every third message has an empty $MSG, which is falsy */
+      if (i % 3 != 2)
+        g_snprintf(value, sizeof(value), "message %d", i);
+
+      msgs[i] = log_msg_new_empty();
+      log_msg_set_value(msgs[i], LM_V_MESSAGE, value, -1);
+
+      matched[i] = TRUE;
+      path_options[i] = (LogPathOptions) LOG_PATH_OPTIONS_INIT_NOACK;
+      path_options[i].matched = &matched[i];
+      batch_path_options[i] = &path_options[i];
+    }
+  return count;
+}
+
+Test(filterx_pipe, test_batch_is_evaluated_per_message_and_forwarded_as_a_batch)
+{
+  CollectorPipe *collector = collector_pipe_new();
+  LogPipe *pipe = _construct_filterx_pipe(collector);
+  LogMessage *msgs[LOG_PIPE_BATCH_MAX];
+  LogPathOptions path_options[LOG_PIPE_BATCH_MAX];
+  const LogPathOptions *batch_path_options[LOG_PIPE_BATCH_MAX];
+  gboolean matched[LOG_PIPE_BATCH_MAX];
+  gint count = _fill_batch(msgs, path_options, batch_path_options, matched, 9);
+
+  log_pipe_queue_batch(pipe, msgs, batch_path_options, count);
+
+  cr_assert_eq(collector->queue_batch_calls, 1);
+  cr_assert_eq(collector->queue_calls, 0);
+  cr_assert_eq(collector->results->len, 6);
+
+  gint result_index = 0;
+  for (gint i = 0; i < count; i++)
+    {
+      if (i % 3 == 2)
+        {
+          cr_assert_not(matched[i], "message %d should have been dropped", i);
+          continue;
+        }
+
+      gchar expected[32];
+      g_snprintf(expected, sizeof(expected), "message %d", i);
+      cr_assert(matched[i]);
+      cr_assert_str_eq(g_ptr_array_index(collector->results, result_index), expected);
+      result_index++;
+    }
+
+  cr_assert_null(filterx_eval_get_context());
+  _free_pipes(pipe, collector);
+}
+
+Test(filterx_pipe, test_single_messages_are_still_evaluated)
+{
+  CollectorPipe *collector = collector_pipe_new();
+  LogPipe *pipe = _construct_filterx_pipe(collector);
+  LogMessage *msgs[2];
+  LogPathOptions path_options[2];
+  const LogPathOptions *batch_path_options[2];
+  gboolean matched[2];
+
+  _fill_batch(msgs, path_options, batch_path_options, matched, 2);
+  log_pipe_queue(pipe, msgs[0], batch_path_options[0]);
+  log_pipe_queue(pipe, msgs[1], batch_path_options[1]);
+
+  cr_assert_eq(collector->queue_calls, 2);
+  cr_assert_eq(collector->queue_batch_calls, 0);
+  cr_assert_str_eq(g_ptr_array_index(collector->results, 0), "message 0");
+  cr_assert_str_eq(g_ptr_array_index(collector->results, 1), "message 1");
+
+  _free_pipes(pipe, collector);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  configuration = cfg_new_snippet();
+  cr_assert(cfg_init(configuration));
+}
+
+static void
+teardown(void)
+{
+  scratch_buffers_explicit_gc();
+  cfg_free(configuration);
+  app_shutdown();
+}
+
+TestSuite(filterx_pipe, .init = setup, .fini = teardown);
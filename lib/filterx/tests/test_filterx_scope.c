@@ -0,0 +1,195 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#include <criterion/criterion.h>
+
+#include "filterx/filterx-scope.h"
+#include "filterx/object-string.h"
+#include "apphook.h"
+#include "scratch-buffers.h"
+
+static void
+_assert_variable_value(FilterXVariable *v, const gchar *expected)
+{
+  cr_assert_not_null(v);
+
+  FilterXObject *value = filterx_variable_get_value(v);
+  cr_assert_str_eq(filterx_string_get_value(value, NULL), expected);
+  filterx_object_unref(value);
+}
+
+static void
+_register_string(FilterXScope *scope, FilterXVariableHandle handle, const gchar *value)
+{
+  FilterXObject *obj = filterx_string_new(value, -1);
+  filterx_scope_register_variable(scope, handle, obj);
+  filterx_object_unref(obj);
+}
+
+Test(filterx_scope, test_handles_of_the_same_variable_map_to_the_same_slot)
+{
+  FilterXVariableHandle foo = filterx_scope_map_variable_to_handle("foo", FX_VAR_FLOATING);
+  FilterXVariableHandle bar = filterx_scope_map_variable_to_handle("bar", FX_VAR_FLOATING);
+  FilterXVariableHandle msg_foo = filterx_scope_map_variable_to_handle("foo", FX_VAR_MESSAGE);
+
+  cr_assert_eq(filterx_scope_map_variable_to_handle("foo", FX_VAR_FLOATING), foo);
+  cr_assert_neq(foo, bar);
+  cr_assert_neq(foo, msg_foo);
+
+  cr_assert(filterx_variable_handle_is_floating(foo));
+  cr_assert_not(filterx_variable_handle_is_floating(msg_foo));
+  cr_assert_eq(filterx_variable_handle_get_nv_handle(foo), filterx_variable_handle_get_nv_handle(msg_foo));
+  cr_assert_eq(filterx_variable_handle_get_nv_handle(msg_foo), log_msg_get_value_handle("foo"));
+}
+
+Test(filterx_scope, test_registered_variables_can_be_looked_up)
+{
+  FilterXVariableHandle foo = filterx_scope_map_variable_to_handle("foo", FX_VAR_FLOATING);
+  FilterXVariableHandle bar = filterx_scope_map_variable_to_handle("bar", FX_VAR_FLOATING);
+  FilterXScope *scope = filterx_scope_new();
+
+  cr_assert_null(filterx_scope_lookup_variable(scope, foo));
+
+  _register_string(scope, foo, "foovalue");
+  _assert_variable_value(filterx_scope_lookup_variable(scope, foo), "foovalue");
+  cr_assert_null(filterx_scope_lookup_variable(scope, bar));
+
+  filterx_scope_unref(scope);
+}
+
+Test(filterx_scope, test_variables_mapped_after_the_scope_was_created_can_be_registered)
+{
+  FilterXScope *scope = filterx_scope_new();
+  gchar name[32];
+  FilterXVariableHandle handles[64];
+
+  for (gint i = 0; i < G_N_ELEMENTS(handles); i++)
+    {
+      g_snprintf(name, sizeof(name), "late_variable_%d", i);
+      handles[i] = filterx_scope_map_variable_to_handle(name, FX_VAR_FLOATING);
+      _register_string(scope, handles[i], name);
+    }
+
+  for (gint i = 0; i < G_N_ELEMENTS(handles); i++)
+    {
+      g_snprintf(name, sizeof(name), "late_variable_%d", i);
+      _assert_variable_value(filterx_scope_lookup_variable(scope, handles[i]), name);
+    }
+
+  filterx_scope_unref(scope);
+}
+
+Test(filterx_scope, test_recycled_scopes_start_out_empty)
+{
+  FilterXVariableHandle low = filterx_scope_map_variable_to_handle("low_slot", FX_VAR_FLOATING);
+  FilterXVariableHandle high = filterx_scope_map_variable_to_handle("high_slot", FX_VAR_MESSAGE);
+  gchar name[32];
+
+  for (gint i = 0; i < 256; i++)
+    {
+      g_snprintf(name, sizeof(name), "padding_variable_%d", i);
+      high = filterx_scope_map_variable_to_handle(name, FX_VAR_MESSAGE);
+    }
+
+  FilterXScope *scope = filterx_scope_new();
+  _register_string(scope, high, "highvalue");
+  _register_string(scope, low, "lowvalue");
+  filterx_scope_unref(scope);
+
+  /* the next scope of this thread reuses the arrays of the previous one */
+  scope = filterx_scope_new();
+  cr_assert_null(filterx_scope_lookup_variable(scope, high));
+  cr_assert_null(filterx_scope_lookup_variable(scope, low));
+
+  _register_string(scope, low, "newvalue");
+  _assert_variable_value(filterx_scope_lookup_variable(scope, low), "newvalue");
+  cr_assert_null(filterx_scope_lookup_variable(scope, high));
+
+  filterx_scope_unref(scope);
+}
+
+Test(filterx_scope, test_floating_variables_are_invalidated_by_the_next_generation)
+{
+  FilterXVariableHandle floating = filterx_scope_map_variable_to_handle("floating", FX_VAR_FLOATING);
+  FilterXVariableHandle declared = filterx_scope_map_variable_to_handle("declared", FX_VAR_FLOATING);
+  FilterXVariableHandle msg_value = filterx_scope_map_variable_to_handle("msg_value", FX_VAR_MESSAGE);
+  FilterXScope *scope = filterx_scope_new();
+  FilterXObject *value = filterx_string_new("declaredvalue", -1);
+
+  filterx_scope_make_writable(&scope);
+  _register_string(scope, floating, "floatingvalue");
+  _register_string(scope, msg_value, "msgvalue");
+  filterx_scope_register_declared_variable(scope, declared, value);
+  filterx_object_unref(value);
+
+  filterx_scope_make_writable(&scope);
+  cr_assert_null(filterx_scope_lookup_variable(scope, floating));
+  _assert_variable_value(filterx_scope_lookup_variable(scope, declared), "declaredvalue");
+  _assert_variable_value(filterx_scope_lookup_variable(scope, msg_value), "msgvalue");
+
+  filterx_scope_unref(scope);
+}
+
+Test(filterx_scope, test_write_protected_scope_is_cloned_without_floating_variables)
+{
+  FilterXVariableHandle floating = filterx_scope_map_variable_to_handle("floating", FX_VAR_FLOATING);
+  FilterXVariableHandle declared = filterx_scope_map_variable_to_handle("declared", FX_VAR_FLOATING);
+  FilterXVariableHandle msg_value = filterx_scope_map_variable_to_handle("msg_value", FX_VAR_MESSAGE);
+  FilterXScope *scope = filterx_scope_new();
+  FilterXObject *value = filterx_string_new("declaredvalue", -1);
+
+  filterx_scope_make_writable(&scope);
+  _register_string(scope, floating, "floatingvalue");
+  _register_string(scope, msg_value, "msgvalue");
+  filterx_scope_register_declared_variable(scope, declared, value);
+  filterx_object_unref(value);
+
+  FilterXScope *original = filterx_scope_ref(scope);
+  filterx_scope_write_protect(scope);
+  filterx_scope_make_writable(&scope);
+  cr_assert_neq(scope, original);
+
+  cr_assert_null(filterx_scope_lookup_variable(scope, floating));
+  _assert_variable_value(filterx_scope_lookup_variable(scope, declared), "declaredvalue");
+  _assert_variable_value(filterx_scope_lookup_variable(scope, msg_value), "msgvalue");
+
+  /* the original scope is left intact */
+  _assert_variable_value(filterx_scope_lookup_variable(original, floating), "floatingvalue");
+
+  filterx_scope_unref(original);
+  filterx_scope_unref(scope);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+}
+
+static void
+teardown(void)
+{
+  scratch_buffers_explicit_gc();
+  app_shutdown();
+}
+
+TestSuite(filterx_scope, .init = setup, .fini = teardown);
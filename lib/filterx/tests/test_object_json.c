@@ -22,10 +22,13 @@
  */
 #include <criterion/criterion.h>
 #include "libtest/filterx-lib.h"
+#include "libtest/stopwatch.h"
 
 #include "filterx/object-json.h"
 #include "filterx/object-string.h"
 #include "filterx/object-message-value.h"
+#include "filterx/object-primitive.h"
+#include "filterx/object-list-interface.h"
 #include "filterx/expr-function.h"
 #include "apphook.h"
 
@@ -164,6 +167,226 @@ Test(filterx_json, test_json_array_function)
   filterx_object_unref(fobj);
 }
 
+static FilterXObject *
+_get_attr(FilterXObject *dict, const gchar *key)
+{
+  return filterx_object_getattr_string(dict, key);
+}
+
+static void
+_set_attr(FilterXObject *dict, const gchar *key, FilterXObject *value)
+{
+  cr_assert(filterx_object_setattr_string(dict, key, &value));
+  filterx_object_unref(value);
+}
+
+Test(filterx_json, test_json_object_keeps_insertion_order)
+{
+  FilterXObject *fobj = filterx_json_object_new_empty();
+
+  _set_attr(fobj, "foo", filterx_integer_new(1));
+  _set_attr(fobj, "bar", filterx_integer_new(2));
+  _set_attr(fobj, "baz", filterx_integer_new(3));
+  _set_attr(fobj, "foo", filterx_string_new("replaced", -1));
+  assert_object_json_equals(fobj, "{\"foo\":\"replaced\",\"bar\":2,\"baz\":3}");
+
+  FilterXObject *key = filterx_string_new("bar", -1);
+  cr_assert(filterx_object_unset_key(fobj, key));
+  filterx_object_unref(key);
+  assert_object_json_equals(fobj, "{\"foo\":\"replaced\",\"baz\":3}");
+
+  filterx_object_unref(fobj);
+}
+
+Test(filterx_json, test_large_json_object_lookups)
+{
+  FilterXObject *fobj = filterx_json_object_new_empty();
+  gchar key[32];
+
+  for (gint i = 0; i < 100; i++)
+    {
+      g_snprintf(key, sizeof(key), "key%d", i);
+      _set_attr(fobj, key, filterx_integer_new(i));
+    }
+
+  for (gint i = 0; i < 100; i += 2)
+    {
+      g_snprintf(key, sizeof(key), "key%d", i);
+      FilterXObject *key_obj = filterx_string_new(key, -1);
+      cr_assert(filterx_object_unset_key(fobj, key_obj));
+      filterx_object_unref(key_obj);
+    }
+
+  guint64 len;
+  cr_assert(filterx_object_len(fobj, &len));
+  cr_assert_eq(len, 50);
+
+  for (gint i = 0; i < 100; i++)
+    {
+      g_snprintf(key, sizeof(key), "key%d", i);
+      FilterXObject *value = _get_attr(fobj, key);
+
+      if (i % 2 == 0)
+        {
+          cr_assert_null(value);
+          continue;
+        }
+
+      gint64 v;
+      cr_assert(filterx_integer_unwrap(value, &v));
+      cr_assert_eq(v, i);
+      filterx_object_unref(value);
+    }
+
+  filterx_object_unref(fobj);
+}
+
+Test(filterx_json, test_modifying_nested_containers_marks_the_root_modified)
+{
+  FilterXObject *fobj = filterx_json_new_from_repr("{\"foo\": {\"bar\": [1, 2]}}", -1);
+  cr_assert_not(fobj->modified_in_place);
+
+  FilterXObject *foo = _get_attr(fobj, "foo");
+  FilterXObject *bar = _get_attr(foo, "bar");
+  FilterXObject *value = filterx_integer_new(3);
+
+  cr_assert(filterx_list_append(bar, &value));
+  filterx_object_unref(value);
+
+  cr_assert(bar->modified_in_place);
+  cr_assert(foo->modified_in_place);
+  cr_assert(fobj->modified_in_place);
+  assert_object_json_equals(fobj, "{\"foo\":{\"bar\":[1,2,3]}}");
+
+  filterx_object_unref(bar);
+  filterx_object_unref(foo);
+  filterx_object_unref(fobj);
+}
+
+Test(filterx_json, test_containers_stored_in_two_places_are_copied)
+{
+  FilterXObject *first = filterx_json_object_new_empty();
+  FilterXObject *second = filterx_json_object_new_empty();
+  FilterXObject *inner = filterx_json_array_new_empty();
+
+  FilterXObject *stored = filterx_object_ref(inner);
+  cr_assert(filterx_object_setattr_string(first, "list", &stored));
+  cr_assert_eq(stored, inner);
+  filterx_object_unref(stored);
+
+  stored = filterx_object_ref(inner);
+  cr_assert(filterx_object_setattr_string(second, "list", &stored));
+  cr_assert_neq(stored, inner);
+  filterx_object_unref(stored);
+
+  FilterXObject *value = filterx_string_new("foo", -1);
+  cr_assert(filterx_list_append(inner, &value));
+  filterx_object_unref(value);
+
+  assert_object_json_equals(first, "{\"list\":[\"foo\"]}");
+  assert_object_json_equals(second, "{\"list\":[]}");
+  cr_assert(first->modified_in_place);
+
+  filterx_object_unref(inner);
+  filterx_object_unref(first);
+  filterx_object_unref(second);
+}
+
+Test(filterx_json, test_deep_frozen_json_is_readonly)
+{
+  FilterXObject *fobj = filterx_json_new_from_repr("{\"foo\": {\"bar\": \"baz\"}}", -1);
+  GPtrArray *frozen_objects = g_ptr_array_new();
+
+  filterx_json_deep_freeze(fobj, frozen_objects);
+  cr_assert(filterx_object_is_frozen(fobj));
+  cr_assert(fobj->readonly);
+
+  FilterXObject *foo = _get_attr(fobj, "foo");
+  cr_assert(filterx_object_is_frozen(foo));
+  cr_assert(foo->readonly);
+
+  FilterXObject *bar = _get_attr(foo, "bar");
+  cr_assert(filterx_object_is_frozen(bar));
+  cr_assert_str_eq(filterx_string_get_value(bar, NULL), "baz");
+
+  g_ptr_array_foreach(frozen_objects, (GFunc) filterx_object_unfreeze_and_free, NULL);
+  g_ptr_array_free(frozen_objects, TRUE);
+}
+
+#define OTEL_ATTRIBUTES 20
+#define PERF_ITERATIONS 100000
+
+static FilterXObject *
+_create_otel_attributes(FilterXObject *keys[OTEL_ATTRIBUTES])
+{
+  FilterXObject *attributes = filterx_json_object_new_empty();
+
+  for (gint i = 0; i < OTEL_ATTRIBUTES; i++)
+    {
+      gchar key[32];
+
+      g_snprintf(key, sizeof(key), "attribute.%d", i);
+      keys[i] = filterx_string_new(key, -1);
+
+      FilterXObject *value = filterx_string_new("value", -1);
+      cr_assert(filterx_object_set_subscript(attributes, keys[i], &value));
+      filterx_object_unref(value);
+    }
+  return attributes;
+}
+
+Test(filterx_json, test_otel_attribute_manipulation_performance)
+{
+  FilterXObject *keys[OTEL_ATTRIBUTES];
+  FilterXObject *attributes = _create_otel_attributes(keys);
+
+  start_stopwatch();
+  for (gint i = 0; i < PERF_ITERATIONS; i++)
+    {
+      FilterXObject *key = keys[i % OTEL_ATTRIBUTES];
+      FilterXObject *value = filterx_object_get_subscript(attributes, key);
+      filterx_object_unref(value);
+    }
+  stop_stopwatch_and_display_result(PERF_ITERATIONS, "getting attributes");
+
+  start_stopwatch();
+  for (gint i = 0; i < PERF_ITERATIONS; i++)
+    {
+      FilterXObject *value = filterx_integer_new(i);
+      filterx_object_set_subscript(attributes, keys[i % OTEL_ATTRIBUTES], &value);
+      filterx_object_unref(value);
+    }
+  stop_stopwatch_and_display_result(PERF_ITERATIONS, "setting attributes");
+
+  start_stopwatch();
+  for (gint i = 0; i < PERF_ITERATIONS; i++)
+    {
+      FilterXObject *key = keys[i % OTEL_ATTRIBUTES];
+      FilterXObject *value = filterx_string_new("value", -1);
+
+      filterx_object_unset_key(attributes, key);
+      filterx_object_set_subscript(attributes, key, &value);
+      filterx_object_unref(value);
+    }
+  stop_stopwatch_and_display_result(PERF_ITERATIONS, "unsetting and re-adding attributes");
+
+  GString *repr = g_string_new("");
+  LogMessageValueType t;
+  start_stopwatch();
+  for (gint i = 0; i < PERF_ITERATIONS / 10; i++)
+    {
+      FilterXObject *cloned = filterx_object_clone(attributes);
+      filterx_object_marshal(cloned, repr, &t);
+      filterx_object_unref(cloned);
+    }
+  stop_stopwatch_and_display_result(PERF_ITERATIONS / 10, "cloning and marshalling attributes");
+  g_string_free(repr, TRUE);
+
+  for (gint i = 0; i < OTEL_ATTRIBUTES; i++)
+    filterx_object_unref(keys[i]);
+  filterx_object_unref(attributes);
+}
+
 static void
 setup(void)
 {
@@ -24,30 +24,70 @@
 #include "find-crlf.h"
 
 #include <string.h>
-/**
- * This is an optimized version of finding either a CR or LF or NUL
- * character in a buffer.  It is used to find these line terminators in
- * syslog traffic.
- *
- * It uses an algorithm very similar to what there's in libc memchr/strchr.
- **/
-gchar *
-find_cr_or_lf_or_nul(gchar *s, gsize n)
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FIND_EOL_X86_SIMD 1
+#include <immintrin.h>
+#else
+#define FIND_EOL_X86_SIMD 0
+#endif
+
+/*
+ * The scanners below locate every line terminator in a buffer in a single
+ * pass and store their offsets (relative to the start of the buffer) into
+ * @positions, up to @max_positions.  The set of terminators is described
+ * by @eol_set, which always contains 3 characters (with repetitions if less
+ * characters are needed).
+ */
+typedef gsize (*FindEOLPositionsFunc)(const guchar *s, gsize n, const guchar *eol_set,
+                                      guint32 *positions, gsize max_positions);
+
+static inline gboolean
+_is_eol_char(guchar c, const guchar *eol_set)
 {
-  gchar *char_ptr;
-  gulong *longword_ptr;
-  gulong longword, magic_bits, cr_charmask, lf_charmask;
-  const char CR = '\r';
-  const char LF = '\n';
+  return c == eol_set[0] || c == eol_set[1] || c == eol_set[2];
+}
 
-  /* align input to long boundary */
-  for (char_ptr = s; n > 0 && ((gulong) char_ptr & (sizeof(longword) - 1)) != 0; ++char_ptr, n--)
+/* returns TRUE if @positions is full */
+static inline gboolean
+_scan_bytes(const guchar *s, const guchar *start, const guchar *end, const guchar *eol_set,
+            guint32 *positions, gsize *found, gsize max_positions)
+{
+  for (const guchar *char_ptr = start; char_ptr < end; char_ptr++)
     {
-      if (*char_ptr == CR || *char_ptr == LF || *char_ptr == 0)
-        return char_ptr;
+      if (_is_eol_char(*char_ptr, eol_set))
+        {
+          positions[(*found)++] = char_ptr - s;
+          if (*found == max_positions)
+            return TRUE;
+        }
     }
+  return FALSE;
+}
 
-  longword_ptr = (gulong *) char_ptr;
+static inline gboolean
+_has_zero_byte(gulong longword, gulong magic_bits)
+{
+  return (((longword + magic_bits) ^ ~longword) & ~magic_bits) != 0;
+}
+
+/**
+ * This is the portable version, it uses an algorithm very similar to what
+ * there's in libc memchr/strchr.
+ **/
+static gsize
+_find_eol_positions_scalar(const guchar *s, gsize n, const guchar *eol_set, guint32 *positions, gsize max_positions)
+{
+  const guchar *end = s + n;
+  const guchar *char_ptr;
+  gulong magic_bits, charmask[3];
+  gsize found = 0;
+
+  /* align input to long boundary */
+  char_ptr = (const guchar *) (((gulong) s + sizeof(gulong) - 1) & ~(sizeof(gulong) - 1));
+  char_ptr = MIN(char_ptr, end);
+  if (_scan_bytes(s, s, char_ptr, eol_set, positions, &found, max_positions))
+    return found;
 
 #if GLIB_SIZEOF_LONG == 8
   magic_bits = 0x7efefefefefefeffL;
@@ -56,38 +96,191 @@ find_cr_or_lf_or_nul(gchar *s, gsize n)
 #else
 #error "unknown architecture"
 #endif
-  memset(&cr_charmask, CR, sizeof(cr_charmask));
-  memset(&lf_charmask, LF, sizeof(lf_charmask));
+  for (gint i = 0; i < G_N_ELEMENTS(charmask); i++)
+    memset(&charmask[i], eol_set[i], sizeof(charmask[i]));
 
-  while (n > sizeof(longword))
+  while ((gsize) (end - char_ptr) > sizeof(gulong))
     {
-      longword = *longword_ptr++;
-      if ((((longword + magic_bits) ^ ~longword) & ~magic_bits) != 0 ||
-          ((((longword ^ cr_charmask) + magic_bits) ^ ~(longword ^ cr_charmask)) & ~magic_bits) != 0 ||
-          ((((longword ^ lf_charmask) + magic_bits) ^ ~(longword ^ lf_charmask)) & ~magic_bits) != 0)
+      gulong longword = *(const gulong *) char_ptr;
+
+      if (_has_zero_byte(longword ^ charmask[0], magic_bits) ||
+          _has_zero_byte(longword ^ charmask[1], magic_bits) ||
+          _has_zero_byte(longword ^ charmask[2], magic_bits))
         {
-          gint i;
+          if (_scan_bytes(s, char_ptr, char_ptr + sizeof(gulong), eol_set, positions, &found, max_positions))
+            return found;
+        }
+      char_ptr += sizeof(gulong);
+    }
 
-          char_ptr = (gchar *) (longword_ptr - 1);
+  _scan_bytes(s, char_ptr, end, eol_set, positions, &found, max_positions);
+  return found;
+}
 
-          for (i = 0; i < sizeof(longword); i++)
-            {
-              if (*char_ptr == CR || *char_ptr == LF || *char_ptr == 0)
-                return char_ptr;
-              char_ptr++;
-            }
+#if FIND_EOL_X86_SIMD
+
+__attribute__((target("sse2")))
+static gsize
+_find_eol_positions_sse2(const guchar *s, gsize n, const guchar *eol_set, guint32 *positions, gsize max_positions)
+{
+  const __m128i c0 = _mm_set1_epi8(eol_set[0]);
+  const __m128i c1 = _mm_set1_epi8(eol_set[1]);
+  const __m128i c2 = _mm_set1_epi8(eol_set[2]);
+  gsize found = 0;
+  gsize i;
+
+  for (i = 0; i + sizeof(__m128i) <= n; i += sizeof(__m128i))
+    {
+      __m128i block = _mm_loadu_si128((const __m128i *) (s + i));
+      __m128i eq = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, c0),
+                                             _mm_cmpeq_epi8(block, c1)),
+                                _mm_cmpeq_epi8(block, c2));
+      guint32 mask = (guint32) _mm_movemask_epi8(eq);
+
+      while (mask)
+        {
+          positions[found++] = i + __builtin_ctz(mask);
+          if (found == max_positions)
+            return found;
+          mask &= mask - 1;
         }
-      n -= sizeof(longword);
     }
 
-  char_ptr = (gchar *) longword_ptr;
+  _scan_bytes(s, s + i, s + n, eol_set, positions, &found, max_positions);
+  return found;
+}
 
-  while (n-- > 0)
+__attribute__((target("avx2")))
+static gsize
+_find_eol_positions_avx2(const guchar *s, gsize n, const guchar *eol_set, guint32 *positions, gsize max_positions)
+{
+  const __m256i c0 = _mm256_set1_epi8(eol_set[0]);
+  const __m256i c1 = _mm256_set1_epi8(eol_set[1]);
+  const __m256i c2 = _mm256_set1_epi8(eol_set[2]);
+  gsize found = 0;
+  gsize i;
+
+  for (i = 0; i + sizeof(__m256i) <= n; i += sizeof(__m256i))
     {
-      if (*char_ptr == CR || *char_ptr == LF || *char_ptr == 0)
-        return char_ptr;
-      ++char_ptr;
+      __m256i block = _mm256_loadu_si256((const __m256i *) (s + i));
+      __m256i eq = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(block, c0),
+                                                   _mm256_cmpeq_epi8(block, c1)),
+                                   _mm256_cmpeq_epi8(block, c2));
+      guint32 mask = (guint32) _mm256_movemask_epi8(eq);
+
+      while (mask)
+        {
+          positions[found++] = i + __builtin_ctz(mask);
+          if (found == max_positions)
+            return found;
+          mask &= mask - 1;
+        }
     }
 
+  _scan_bytes(s, s + i, s + n, eol_set, positions, &found, max_positions);
+  return found;
+}
+
+#endif
+
+static FindEOLPositionsFunc find_eol_positions_impl = _find_eol_positions_scalar;
+
+static FindEOLPositionsFunc
+_lookup_implementation(FindEOLImplementation impl)
+{
+  switch (impl)
+    {
+    case FIND_EOL_IMPL_SCALAR:
+      return _find_eol_positions_scalar;
+#if FIND_EOL_X86_SIMD
+    case FIND_EOL_IMPL_SSE2:
+      if (__builtin_cpu_supports("sse2"))
+        return _find_eol_positions_sse2;
+      break;
+    case FIND_EOL_IMPL_AVX2:
+      if (__builtin_cpu_supports("avx2"))
+        return _find_eol_positions_avx2;
+      break;
+#endif
+    case FIND_EOL_IMPL_AUTO:
+    {
+      FindEOLPositionsFunc func;
+
+      if ((func = _lookup_implementation(FIND_EOL_IMPL_AVX2)))
+        return func;
+      if ((func = _lookup_implementation(FIND_EOL_IMPL_SSE2)))
+        return func;
+      return _find_eol_positions_scalar;
+    }
+    default:
+      break;
+    }
   return NULL;
 }
+
+/* the best implementation is selected when the library is loaded, so no
+ * synchronization is needed when it is used */
+static void __attribute__((constructor))
+_select_best_implementation(void)
+{
+#if FIND_EOL_X86_SIMD
+  __builtin_cpu_init();
+#endif
+  find_eol_positions_impl = _lookup_implementation(FIND_EOL_IMPL_AUTO);
+}
+
+/*
+ * Overrides the automatically selected implementation, used by the unit
+ * tests.  Returns FALSE if the CPU does not support @impl.
+ */
+gboolean
+find_eol_set_implementation(FindEOLImplementation impl)
+{
+  FindEOLPositionsFunc func = _lookup_implementation(impl);
+
+  if (!func)
+    return FALSE;
+  find_eol_positions_impl = func;
+  return TRUE;
+}
+
+/*
+ * Locates the line terminators specified by @eol_chars (a combination of
+ * FIND_EOL_* flags) in @s, in a single pass.  The offsets of the first
+ * @max_positions terminators are stored in @positions, the number of
+ * terminators found is returned.
+ */
+gsize
+find_eol_positions(const guchar *s, gsize n, guint eol_chars, guint32 *positions, gsize max_positions)
+{
+  guchar eol_set[3];
+  gint len = 0;
+
+  g_assert(eol_chars != 0 && max_positions > 0);
+
+  if (eol_chars & FIND_EOL_NL)
+    eol_set[len++] = '\n';
+  if (eol_chars & FIND_EOL_CR)
+    eol_set[len++] = '\r';
+  if (eol_chars & FIND_EOL_NUL)
+    eol_set[len++] = '\0';
+  while (len < G_N_ELEMENTS(eol_set))
+    eol_set[len++] = eol_set[0];
+
+  return find_eol_positions_impl(s, n, eol_set, positions, max_positions);
+}
+
+/**
+ * This is an optimized version of finding either a CR or LF or NUL
+ * character in a buffer.  It is used to find these line terminators in
+ * syslog traffic.
+ **/
+gchar *
+find_cr_or_lf_or_nul(gchar *s, gsize n)
+{
+  guint32 pos;
+
+  if (find_eol_positions((const guchar *) s, n, FIND_EOL_NL | FIND_EOL_CR | FIND_EOL_NUL, &pos, 1) == 0)
+    return NULL;
+  return s + pos;
+}
@@ -26,6 +26,25 @@
 
 #include "syslog-ng.h"
 
+/* line terminator characters for find_eol_positions() */
+enum
+{
+  FIND_EOL_NL = 0x01,
+  FIND_EOL_CR = 0x02,
+  FIND_EOL_NUL = 0x04,
+};
+
+typedef enum
+{
+  FIND_EOL_IMPL_AUTO,
+  FIND_EOL_IMPL_SCALAR,
+  FIND_EOL_IMPL_SSE2,
+  FIND_EOL_IMPL_AVX2,
+} FindEOLImplementation;
+
+gsize find_eol_positions(const guchar *s, gsize n, guint eol_chars, guint32 *positions, gsize max_positions);
+gboolean find_eol_set_implementation(FindEOLImplementation impl);
+
 gchar *find_cr_or_lf_or_nul(gchar *s, gsize n);
 
 #endif
@@ -181,6 +181,104 @@ log_multiplexer_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_op
   log_pipe_forward_msg(s, msg, path_options);
 }
 
+static inline gboolean
+_is_hop_skipped_in_pass(LogPipe *next_hop, gint fallback)
+{
+  if (fallback == 0)
+    return (next_hop->flags & PIF_BRANCH_FALLBACK) != 0;
+  return (next_hop->flags & PIF_BRANCH_FALLBACK) == 0;
+}
+
+/*
+ * Same as log_multiplexer_queue(), but each next hop receives the whole
+ * batch at once.  Each message has its own "matched" and "delivered"
+ * state, which is what the per-message variant keeps on its stack.
+ */
+static void
+log_multiplexer_queue_batch(LogPipe *s, LogMessage **msgs, const LogPathOptions **path_options, gint count)
+{
+  LogMultiplexer *self = (LogMultiplexer *) s;
+  gboolean matched[LOG_PIPE_BATCH_MAX];
+  gboolean delivered[LOG_PIPE_BATCH_MAX];
+  gboolean finished[LOG_PIPE_BATCH_MAX];
+  LogPathOptions local_path_options[LOG_PIPE_BATCH_MAX];
+  LogMessage *hop_msgs[LOG_PIPE_BATCH_MAX];
+  const LogPathOptions *hop_path_options[LOG_PIPE_BATCH_MAX];
+  gint hop_index[LOG_PIPE_BATCH_MAX];
+  gboolean multiple_arcs = _has_multiple_arcs(self);
+  gint undelivered = count;
+  gint fallback, i, j;
+
+  for (j = 0; j < count; j++)
+    {
+      log_path_options_push_junction(&local_path_options[j], &matched[j], path_options[j]);
+      if (multiple_arcs)
+        {
+          filterx_eval_prepare_for_fork(path_options[j]->filterx_context, &msgs[j], path_options[j]);
+          log_msg_write_protect(msgs[j]);
+        }
+      delivered[j] = FALSE;
+    }
+
+  for (fallback = 0; (fallback == 0) || (fallback == 1 && self->fallback_exists && undelivered > 0); fallback++)
+    {
+      for (j = 0; j < count; j++)
+        finished[j] = fallback && delivered[j];
+
+      for (i = 0; i < self->next_hops->len; i++)
+        {
+          LogPipe *next_hop = g_ptr_array_index(self->next_hops, i);
+          gint n = 0;
+
+          if (G_UNLIKELY(_is_hop_skipped_in_pass(next_hop, fallback)))
+            continue;
+
+          for (j = 0; j < count; j++)
+            {
+              if (finished[j])
+                continue;
+
+              matched[j] = TRUE;
+              log_msg_add_ack(msgs[j], &local_path_options[j]);
+              hop_msgs[n] = log_msg_ref(msgs[j]);
+              hop_path_options[n] = &local_path_options[j];
+              hop_index[n] = j;
+              n++;
+            }
+          if (n == 0)
+            break;
+
+          log_pipe_queue_batch(next_hop, hop_msgs, hop_path_options, n);
+
+          for (gint k = 0; k < n; k++)
+            {
+              j = hop_index[k];
+              if (!matched[j])
+                continue;
+
+              if (!delivered[j])
+                {
+                  delivered[j] = TRUE;
+                  undelivered--;
+                }
+              if (G_UNLIKELY(next_hop->flags & PIF_BRANCH_FINAL))
+                finished[j] = TRUE;
+            }
+        }
+    }
+
+  /* see the comment in log_multiplexer_queue() on delivery propagation */
+  if (self->delivery_propagation)
+    {
+      for (j = 0; j < count; j++)
+        {
+          if (!delivered[j] && path_options[j]->matched)
+            *path_options[j]->matched = FALSE;
+        }
+    }
+  log_pipe_forward_batch(s, msgs, path_options, count);
+}
+
 static void
 log_multiplexer_free(LogPipe *s)
 {
@@ -223,6 +321,7 @@ log_multiplexer_new(GlobalConfig *cfg)
   self->super.init = log_multiplexer_init;
   self->super.deinit = log_multiplexer_deinit;
   self->super.queue = log_multiplexer_queue;
+  log_pipe_set_queue_batch(&self->super, log_multiplexer_queue_batch);
   self->super.free_fn = log_multiplexer_free;
   self->next_hops = g_ptr_array_new();
   self->super.arcs = _arcs;
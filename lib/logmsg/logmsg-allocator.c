@@ -0,0 +1,456 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#include "logmsg/logmsg-allocator.h"
+#include "stats/stats-registry.h"
+#include "stats/stats-cluster-single.h"
+#include "tls-support.h"
+
+#include <string.h>
+
+/*
+ * LogMessage block allocator
+ *
+ * LogMessage instances are allocated together with their queue nodes and
+ * their initial NVTable in a single block (see log_msg_alloc()), which is
+ * usually 0.5-4kB in size.  Allocating and freeing these blocks through
+ * the system allocator at high message rates is expensive, so we keep
+ * freed blocks around and reuse them.
+ *
+ * The design follows the "magazine" allocator idea:
+ *
+ *   - blocks are grouped into power-of-two size classes, anything larger
+ *     than the largest class goes directly to g_malloc()/g_free()
+ *
+ *   - each thread has two magazines per size class (the "loaded" and the
+ *     "previous" ones), each holding up to LMA_MAGAZINE_ROUNDS free blocks.
+ *     Allocations and frees are served from these without any locking.
+ *
+ *   - whenever a thread runs out of blocks or has too many of them, it
+ *     exchanges a complete magazine with the per-class depot, which is
+ *     protected by a mutex.  The mutex is thus taken once per
+ *     LMA_MAGAZINE_ROUNDS operations.
+ *
+ *   - messages are usually allocated by a source thread and freed by a
+ *     destination thread, in which case the destination thread collects the
+ *     freed blocks in its magazines and passes them to the depot in
+ *     batches, where source threads can pick them up, again in batches.
+ *
+ *   - the depot is bounded (LMA_DEPOT_MAX_BYTES per size class), excess
+ *     blocks are released to the system allocator.
+ *
+ * Threads that have not called log_msg_allocator_thread_init() (or the
+ * process after log_msg_allocator_global_deinit()) fall back to
+ * g_malloc()/g_free() directly, blocks are compatible in both directions.
+ */
+
+#define LMA_MIN_CLASS_SHIFT   8
+#define LMA_NUM_CLASSES       6
+#define LMA_CLASS_LARGE       LMA_NUM_CLASSES
+#define LMA_MAGAZINE_ROUNDS   32
+#define LMA_DEPOT_MAX_BYTES   (4 * 1024 * 1024)
+
+/* keep the payload aligned the same way as malloc() would */
+#define LMA_HEADER_SIZE       16
+
+typedef struct _LogMessageAllocatorMagazine LogMessageAllocatorMagazine;
+struct _LogMessageAllocatorMagazine
+{
+  LogMessageAllocatorMagazine *next;
+  gint rounds;
+  gpointer blocks[LMA_MAGAZINE_ROUNDS];
+};
+
+typedef struct _LogMessageAllocatorDepot
+{
+  GMutex lock;
+  LogMessageAllocatorMagazine *full;
+  LogMessageAllocatorMagazine *empty;
+  gint num_full;
+  gint max_full;
+} LogMessageAllocatorDepot;
+
+TLS_BLOCK_START
+{
+  gboolean lma_thread_initialized;
+  LogMessageAllocatorMagazine *lma_loaded[LMA_NUM_CLASSES];
+  LogMessageAllocatorMagazine *lma_previous[LMA_NUM_CLASSES];
+
+  /* counted locally, published to stats when we visit the depot */
+  gssize lma_hits;
+  gssize lma_misses;
+}
+TLS_BLOCK_END;
+
+#define lma_thread_initialized  __tls_deref(lma_thread_initialized)
+#define lma_loaded              __tls_deref(lma_loaded)
+#define lma_previous            __tls_deref(lma_previous)
+#define lma_hits                __tls_deref(lma_hits)
+#define lma_misses              __tls_deref(lma_misses)
+
+static LogMessageAllocatorDepot depots[LMA_NUM_CLASSES];
+static gboolean lma_global_initialized;
+
+static StatsCounterItem *count_cache_hits;
+static StatsCounterItem *count_cache_misses;
+static StatsCounterItem *count_depot_exchanges;
+static StatsCounterItem *count_depot_bytes;
+
+static inline gsize
+_class_block_size(gint size_class)
+{
+  return ((gsize) 1) << (size_class + LMA_MIN_CLASS_SHIFT);
+}
+
+static inline gint
+_size_to_class(gsize size)
+{
+  gsize block_size = size + LMA_HEADER_SIZE;
+
+  for (gint size_class = 0; size_class < LMA_NUM_CLASSES; size_class++)
+    {
+      if (block_size <= _class_block_size(size_class))
+        return size_class;
+    }
+  return LMA_CLASS_LARGE;
+}
+
+static inline gpointer
+_block_to_user(gpointer block)
+{
+  return ((gchar *) block) + LMA_HEADER_SIZE;
+}
+
+static inline gpointer
+_user_to_block(gpointer user)
+{
+  return ((gchar *) user) - LMA_HEADER_SIZE;
+}
+
+static inline guint32
+_block_get_class(gpointer block)
+{
+  return *(guint32 *) block;
+}
+
+static gpointer
+_block_new(gint size_class, gsize size)
+{
+  gsize block_size = size_class == LMA_CLASS_LARGE ? size + LMA_HEADER_SIZE : _class_block_size(size_class);
+  gpointer block = g_malloc(block_size);
+
+  *(guint32 *) block = size_class;
+  return block;
+}
+
+static void
+_publish_local_stats(void)
+{
+  stats_counter_add(count_cache_hits, lma_hits);
+  stats_counter_add(count_cache_misses, lma_misses);
+  lma_hits = 0;
+  lma_misses = 0;
+}
+
+static void
+_magazine_free_blocks(LogMessageAllocatorMagazine *magazine)
+{
+  for (gint i = 0; i < magazine->rounds; i++)
+    g_free(magazine->blocks[i]);
+  magazine->rounds = 0;
+}
+
+/* takes a full magazine from the depot in exchange of an empty one,
+ * returns NULL if the depot has no full magazines */
+static LogMessageAllocatorMagazine *
+_depot_exchange_empty(gint size_class, LogMessageAllocatorMagazine *empty)
+{
+  LogMessageAllocatorDepot *depot = &depots[size_class];
+  LogMessageAllocatorMagazine *full = NULL;
+
+  g_mutex_lock(&depot->lock);
+  if (depot->full)
+    {
+      full = depot->full;
+      depot->full = full->next;
+      depot->num_full--;
+
+      empty->next = depot->empty;
+      depot->empty = empty;
+    }
+  g_mutex_unlock(&depot->lock);
+
+  if (full)
+    {
+      stats_counter_inc(count_depot_exchanges);
+      stats_counter_sub(count_depot_bytes, full->rounds * _class_block_size(size_class));
+    }
+  _publish_local_stats();
+  return full;
+}
+
+/* passes a full magazine to the depot in exchange of an empty one */
+static LogMessageAllocatorMagazine *
+_depot_exchange_full(gint size_class, LogMessageAllocatorMagazine *full)
+{
+  LogMessageAllocatorDepot *depot = &depots[size_class];
+  LogMessageAllocatorMagazine *empty = NULL;
+  gsize bytes = full->rounds * _class_block_size(size_class);
+  gboolean stored = FALSE;
+
+  g_mutex_lock(&depot->lock);
+  if (depot->num_full < depot->max_full)
+    {
+      full->next = depot->full;
+      depot->full = full;
+      depot->num_full++;
+      stored = TRUE;
+    }
+  if (stored && depot->empty)
+    {
+      empty = depot->empty;
+      depot->empty = empty->next;
+    }
+  g_mutex_unlock(&depot->lock);
+
+  if (stored)
+    {
+      stats_counter_inc(count_depot_exchanges);
+      stats_counter_add(count_depot_bytes, bytes);
+    }
+  else
+    {
+      /* depot is at capacity, give the memory back to the system */
+      _magazine_free_blocks(full);
+      empty = full;
+    }
+  _publish_local_stats();
+
+  if (!empty)
+    empty = g_new0(LogMessageAllocatorMagazine, 1);
+  empty->next = NULL;
+  return empty;
+}
+
+static inline void
+_thread_cache_swap(gint size_class)
+{
+  LogMessageAllocatorMagazine *tmp = lma_loaded[size_class];
+
+  lma_loaded[size_class] = lma_previous[size_class];
+  lma_previous[size_class] = tmp;
+}
+
+static inline gpointer
+_thread_cache_alloc(gint size_class)
+{
+  if (G_UNLIKELY(lma_loaded[size_class]->rounds == 0))
+    {
+      if (lma_previous[size_class]->rounds > 0)
+        {
+          _thread_cache_swap(size_class);
+        }
+      else
+        {
+          /* both magazines are empty: trade one of them for a full one in the depot */
+          LogMessageAllocatorMagazine *full = _depot_exchange_empty(size_class, lma_previous[size_class]);
+
+          if (!full)
+            return NULL;
+          lma_previous[size_class] = lma_loaded[size_class];
+          lma_loaded[size_class] = full;
+        }
+    }
+
+  LogMessageAllocatorMagazine *loaded = lma_loaded[size_class];
+  lma_hits++;
+  return loaded->blocks[--loaded->rounds];
+}
+
+static inline void
+_thread_cache_free(gint size_class, gpointer block)
+{
+  if (G_UNLIKELY(lma_loaded[size_class]->rounds == LMA_MAGAZINE_ROUNDS))
+    {
+      if (lma_previous[size_class]->rounds < LMA_MAGAZINE_ROUNDS)
+        {
+          _thread_cache_swap(size_class);
+        }
+      else
+        {
+          /* both magazines are full: pass one of them to the depot and continue with an empty one */
+          LogMessageAllocatorMagazine *empty = _depot_exchange_full(size_class, lma_previous[size_class]);
+
+          lma_previous[size_class] = lma_loaded[size_class];
+          lma_loaded[size_class] = empty;
+        }
+    }
+
+  LogMessageAllocatorMagazine *loaded = lma_loaded[size_class];
+  loaded->blocks[loaded->rounds++] = block;
+}
+
+gpointer
+log_msg_allocator_alloc(gsize size)
+{
+  gint size_class = _size_to_class(size);
+  gpointer block = NULL;
+
+  if (size_class != LMA_CLASS_LARGE && lma_thread_initialized)
+    {
+      block = _thread_cache_alloc(size_class);
+      if (!block)
+        lma_misses++;
+    }
+
+  if (!block)
+    block = _block_new(size_class, size);
+  return _block_to_user(block);
+}
+
+void
+log_msg_allocator_free(gpointer user)
+{
+  gpointer block = _user_to_block(user);
+  guint32 size_class = _block_get_class(block);
+
+  if (size_class == LMA_CLASS_LARGE || !lma_thread_initialized)
+    {
+      g_free(block);
+      return;
+    }
+  _thread_cache_free(size_class, block);
+}
+
+void
+log_msg_allocator_thread_init(void)
+{
+  if (!lma_global_initialized || lma_thread_initialized)
+    return;
+
+  for (gint size_class = 0; size_class < LMA_NUM_CLASSES; size_class++)
+    {
+      lma_loaded[size_class] = g_new0(LogMessageAllocatorMagazine, 1);
+      lma_previous[size_class] = g_new0(LogMessageAllocatorMagazine, 1);
+    }
+  lma_thread_initialized = TRUE;
+}
+
+static void
+_thread_cache_flush_magazine(gint size_class, LogMessageAllocatorMagazine *magazine)
+{
+  if (lma_global_initialized && magazine->rounds == LMA_MAGAZINE_ROUNDS)
+    {
+      /* a complete magazine is worth keeping for other threads */
+      LogMessageAllocatorMagazine *empty = _depot_exchange_full(size_class, magazine);
+      g_free(empty);
+      return;
+    }
+  _magazine_free_blocks(magazine);
+  g_free(magazine);
+}
+
+void
+log_msg_allocator_thread_deinit(void)
+{
+  if (!lma_thread_initialized)
+    return;
+
+  lma_thread_initialized = FALSE;
+  for (gint size_class = 0; size_class < LMA_NUM_CLASSES; size_class++)
+    {
+      _thread_cache_flush_magazine(size_class, lma_loaded[size_class]);
+      _thread_cache_flush_magazine(size_class, lma_previous[size_class]);
+      lma_loaded[size_class] = NULL;
+      lma_previous[size_class] = NULL;
+    }
+  _publish_local_stats();
+}
+
+void
+log_msg_allocator_register_stats(void)
+{
+  StatsClusterKey sc_key;
+
+  stats_lock();
+  stats_cluster_single_key_set(&sc_key, "msg_allocator_cache_hits_total", NULL, 0);
+  stats_register_counter(1, &sc_key, SC_TYPE_SINGLE_VALUE, &count_cache_hits);
+
+  stats_cluster_single_key_set(&sc_key, "msg_allocator_cache_misses_total", NULL, 0);
+  stats_register_counter(1, &sc_key, SC_TYPE_SINGLE_VALUE, &count_cache_misses);
+
+  stats_cluster_single_key_set(&sc_key, "msg_allocator_depot_exchanges_total", NULL, 0);
+  stats_register_counter(1, &sc_key, SC_TYPE_SINGLE_VALUE, &count_depot_exchanges);
+
+  stats_cluster_single_key_set(&sc_key, "msg_allocator_depot_bytes", NULL, 0);
+  stats_register_counter(1, &sc_key, SC_TYPE_SINGLE_VALUE, &count_depot_bytes);
+  stats_unlock();
+}
+
+void
+log_msg_allocator_global_init(void)
+{
+  for (gint size_class = 0; size_class < LMA_NUM_CLASSES; size_class++)
+    {
+      LogMessageAllocatorDepot *depot = &depots[size_class];
+
+      g_mutex_init(&depot->lock);
+      depot->full = NULL;
+      depot->empty = NULL;
+      depot->num_full = 0;
+      depot->max_full = MAX(1, LMA_DEPOT_MAX_BYTES / (LMA_MAGAZINE_ROUNDS * _class_block_size(size_class)));
+    }
+  lma_global_initialized = TRUE;
+  log_msg_allocator_thread_init();
+}
+
+static void
+_depot_free_magazines(LogMessageAllocatorMagazine *magazine)
+{
+  while (magazine)
+    {
+      LogMessageAllocatorMagazine *next = magazine->next;
+
+      _magazine_free_blocks(magazine);
+      g_free(magazine);
+      magazine = next;
+    }
+}
+
+void
+log_msg_allocator_global_deinit(void)
+{
+  log_msg_allocator_thread_deinit();
+  lma_global_initialized = FALSE;
+
+  for (gint size_class = 0; size_class < LMA_NUM_CLASSES; size_class++)
+    {
+      LogMessageAllocatorDepot *depot = &depots[size_class];
+
+      _depot_free_magazines(depot->full);
+      _depot_free_magazines(depot->empty);
+      depot->full = NULL;
+      depot->empty = NULL;
+      depot->num_full = 0;
+      g_mutex_clear(&depot->lock);
+    }
+}
@@ -79,7 +79,8 @@ _serialize_message(LogMessageSerializationState *state)
   serialize_write_uint8(sa, msg->alloc_sdata);
   serialize_write_uint32_array(sa, (guint32 *) msg->sdata, msg->num_sdata);
 
-  if (state->flags & LMSF_COMPACTION)
+  /* overlays only hold part of the payload, their serialized form is always flattened */
+  if ((state->flags & LMSF_COMPACTION) || msg->payload->base)
     nv_table_serialize_with_compaction(state, msg->payload);
   else
     nv_table_serialize(state, msg->payload);
@@ -204,6 +205,9 @@ _deserialize_message_version_2x(LogMessageSerializationState *state)
 
   if (!log_msg_fixup_handles_after_deserialization(state))
     return FALSE;
+
+  /* handles may have been renumbered by the fixup above */
+  nv_table_update_index_hash(msg->payload);
   return TRUE;
 }
 
@@ -30,6 +30,7 @@
 #include "timeutils/cache.h"
 #include "timeutils/misc.h"
 #include "logmsg/nvtable.h"
+#include "logmsg/logmsg-allocator.h"
 #include "stats/stats-registry.h"
 #include "stats/stats-cluster-single.h"
 #include "template/templates.h"
@@ -563,6 +564,19 @@ log_msg_free_queue_node(LogMessageQueueNode *node)
     g_slice_free(LogMessageQueueNode, node);
 }
 
+/*
+ * A clone shares the payload of the message it was cloned from until it
+ * is first changed.  Instead of copying the entire payload at that point,
+ * we layer an overlay on top of the shared one, which stays alive and
+ * unchanged as long as we hold self->original.
+ */
+static void
+log_msg_own_payload(LogMessage *self, gint additional_space)
+{
+  self->payload = nv_table_new_overlay(self->payload, additional_space);
+  log_msg_set_flag(self, LF_STATE_OWN_PAYLOAD);
+}
+
 static gboolean
 _log_name_value_updates(LogMessage *self)
 {
@@ -627,8 +641,7 @@ log_msg_set_value_with_type(LogMessage *self, NVHandle handle,
 
   if (!log_msg_chk_flag(self, LF_STATE_OWN_PAYLOAD))
     {
-      self->payload = nv_table_clone(self->payload, name_len + value_len + 2);
-      log_msg_set_flag(self, LF_STATE_OWN_PAYLOAD);
+      log_msg_own_payload(self, name_len + value_len + 2);
       self->allocated_bytes += self->payload->size;
       stats_counter_add(count_allocated_bytes, self->payload->size);
     }
@@ -682,10 +695,7 @@ log_msg_unset_value(LogMessage *self, NVHandle handle)
     }
 
   if (!log_msg_chk_flag(self, LF_STATE_OWN_PAYLOAD))
-    {
-      self->payload = nv_table_clone(self->payload, 0);
-      log_msg_set_flag(self, LF_STATE_OWN_PAYLOAD);
-    }
+    log_msg_own_payload(self, 0);
 
   while (!nv_table_unset_value(self->payload, handle))
     {
@@ -747,10 +757,7 @@ log_msg_set_value_indirect_with_type(LogMessage *self, NVHandle handle,
     }
 
   if (!log_msg_chk_flag(self, LF_STATE_OWN_PAYLOAD))
-    {
-      self->payload = nv_table_clone(self->payload, name_len + 1);
-      log_msg_set_flag(self, LF_STATE_OWN_PAYLOAD);
-    }
+    log_msg_own_payload(self, name_len + 1);
 
   NVReferencedSlice referenced_slice =
   {
@@ -1432,7 +1439,7 @@ log_msg_alloc(gsize payload_size)
       payload_ofs = alloc_size;
       alloc_size += payload_space;
     }
-  msg = g_malloc(alloc_size);
+  msg = log_msg_allocator_alloc(alloc_size);
 
   memset(msg, 0, sizeof(LogMessage));
 
@@ -1625,7 +1632,7 @@ log_msg_free(LogMessage *self)
 
   stats_counter_sub(count_allocated_bytes, self->allocated_bytes);
 
-  g_free(self);
+  log_msg_allocator_free(self);
 }
 
 /**
@@ -2099,6 +2106,8 @@ log_msg_register_stats(void)
   stats_cluster_single_key_add_legacy_alias(&sc_key, SCS_GLOBAL, "msg_allocated_bytes", NULL);
   stats_register_counter(1, &sc_key, SC_TYPE_SINGLE_VALUE, &count_allocated_bytes);
   stats_unlock();
+
+  log_msg_allocator_register_stats();
 }
 
 void
@@ -2107,6 +2116,7 @@ log_msg_global_init(void)
   log_msg_registry_init();
   log_tags_global_init();
   log_msg_tags_init();
+  log_msg_allocator_global_init();
 
   /* NOTE: we always initialize counters as they are on stats-level(0),
    * however we need to defer that as the stats subsystem may not be
@@ -2124,6 +2134,7 @@ log_msg_get_handle_name(NVHandle handle, gssize *length)
 void
 log_msg_global_deinit(void)
 {
+  log_msg_allocator_global_deinit();
   log_tags_global_deinit();
   log_msg_registry_deinit();
 }
@@ -111,11 +111,21 @@ _read_metadata(SerializeArchive *sa, NVTableMetaData *meta_data)
   return TRUE;
 }
 
+/* the smallest table with our header that holds the serialized index and payload */
+static inline gsize
+_calculate_required_size(guint32 used, guint16 index_size, guint8 num_static_entries)
+{
+  return sizeof(NVTable) + num_static_entries * sizeof(guint32) +
+         index_size * sizeof(NVIndexEntry) + used;
+}
+
 static gboolean
 _read_header(SerializeArchive *sa, NVTable **nvtable)
 {
   NVTable *res = NULL;
-  guint32 size;
+  guint32 size, used;
+  guint16 index_size;
+  guint8 num_static_entries;
 
   g_assert(*nvtable == NULL);
 
@@ -125,16 +135,13 @@ _read_header(SerializeArchive *sa, NVTable **nvtable)
   if (size > NV_TABLE_MAX_BYTES)
     goto error;
 
-  res = (NVTable *) g_malloc(size);
-  res->size = size;
-
-  if (!serialize_read_uint32(sa, &res->used))
+  if (!serialize_read_uint32(sa, &used))
     goto error;
 
-  if (!serialize_read_uint16(sa, &res->index_size))
+  if (!serialize_read_uint16(sa, &index_size))
     goto error;
 
-  if (!serialize_read_uint8(sa, &res->num_static_entries))
+  if (!serialize_read_uint8(sa, &num_static_entries))
     goto error;
 
   /* static entries has to be known by this syslog-ng, if they are over
@@ -142,15 +149,33 @@ _read_header(SerializeArchive *sa, NVTable **nvtable)
    * entries don't contain names.  If there are less static entries, that
    * can be ok. */
 
-  if (res->num_static_entries > LM_V_MAX)
+  if (num_static_entries > LM_V_MAX)
     goto error;
 
+  /* The table may have been serialized by a version with a smaller NVTable
+   * header, in which case it only grows by the difference.  A table
+   * serialized by this version is allocated with its original size, so
+   * round trips (e.g. disk-buffer reloads) don't grow it. */
+  gsize required_size = _calculate_required_size(used, index_size, num_static_entries);
+  if (required_size > NV_TABLE_MAX_BYTES)
+    goto error;
+
+  size = MAX(size, required_size);
+
+  res = (NVTable *) g_malloc(size);
+  res->size = size;
+  res->used = used;
+  res->index_size = index_size;
+  res->num_static_entries = num_static_entries;
+
   /* validates self->used and self->index_size value as compared to "size" */
   if (!nv_table_alloc_check(res, 0))
     goto error;
 
   res->borrowed = FALSE;
   res->ref_cnt = 1;
+  res->base = NULL;
+  res->index_hash = NULL;
   *nvtable = res;
   return TRUE;
 
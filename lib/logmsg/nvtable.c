@@ -27,6 +27,26 @@
 #include <string.h>
 #include <stdlib.h>
 
+/* overlays are only worth it if copying the base is more expensive than
+ * the additional lookups */
+#define NV_TABLE_OVERLAY_MIN_BASE_BYTES 512
+#define NV_TABLE_OVERLAY_MAX_DEPTH 4
+#define NV_TABLE_OVERLAY_INDEX_SIZE_HINT 16
+#define NV_TABLE_OVERLAY_INIT_LENGTH 256
+
+/* below this many dynamic values a binary search is just as fast */
+#define NV_TABLE_INDEX_HASH_THRESHOLD 64
+
+/* open-addressing (linear probing) hash of handle -> ofs pairs, an empty
+ * slot has a zero handle.  Entries are never removed from the index, so
+ * there are no tombstones either. */
+struct _NVIndexHash
+{
+  guint32 bits;
+  guint32 count;
+  NVIndexEntry slots[];
+};
+
 static GMutex nv_registry_lock;
 
 const gchar *null_string = "";
@@ -314,11 +334,115 @@ NVEntry *
 nv_table_get_entry_slow(NVTable *self, NVHandle handle, NVIndexEntry **index_entry, NVIndexEntry **index_slot)
 {
   *index_entry = _find_index_entry(nv_table_get_index(self), self->index_size, handle, index_slot);
-  if (*index_entry)
+  if (*index_entry && (*index_entry)->ofs)
     return nv_table_get_entry_at_ofs(self, (*index_entry)->ofs);
+
+  /* index_entry and index_slot keep pointing into the overlay, that's
+   * where the handle is to be stored if it gets changed */
+  if (self->base)
+    return nv_table_get_base_entry(self, handle);
   return NULL;
 }
 
+NVEntry *
+nv_table_get_base_entry(NVTable *self, NVHandle handle)
+{
+  return nv_table_get_entry(self->base, handle, NULL, NULL);
+}
+
+static inline guint32
+_index_hash_capacity(NVIndexHash *self)
+{
+  return 1 << self->bits;
+}
+
+static inline NVIndexEntry *
+_index_hash_find_slot(NVIndexHash *self, NVHandle handle)
+{
+  guint32 mask = _index_hash_capacity(self) - 1;
+
+  /* fibonacci hashing, handles are mostly sequential */
+  guint32 i = (handle * 2654435769U) >> (32 - self->bits);
+
+  while (self->slots[i].handle && self->slots[i].handle != handle)
+    i = (i + 1) & mask;
+  return &self->slots[i];
+}
+
+static void
+_index_hash_set(NVIndexHash *self, NVHandle handle, guint32 ofs)
+{
+  NVIndexEntry *slot = _index_hash_find_slot(self, handle);
+
+  if (!slot->handle)
+    {
+      slot->handle = handle;
+      self->count++;
+    }
+  slot->ofs = ofs;
+}
+
+static inline gboolean
+_index_hash_is_full(NVIndexHash *self)
+{
+  /* keep the load factor at most 1/2 */
+  return (self->count + 1) * 2 > _index_hash_capacity(self);
+}
+
+static void
+nv_table_free_index_hash(NVTable *self)
+{
+  g_free(self->index_hash);
+  self->index_hash = NULL;
+}
+
+/* (re)builds the hash of the dynamic index, if the index is large enough */
+void
+nv_table_update_index_hash(NVTable *self)
+{
+  nv_table_free_index_hash(self);
+  if (self->index_size < NV_TABLE_INDEX_HASH_THRESHOLD)
+    return;
+
+  guint32 bits = g_bit_storage(self->index_size) + 2;
+  NVIndexHash *hash = g_malloc0(sizeof(NVIndexHash) + (1 << bits) * sizeof(NVIndexEntry));
+  hash->bits = bits;
+
+  NVIndexEntry *index_table = nv_table_get_index(self);
+  for (gint i = 0; i < self->index_size; i++)
+    _index_hash_set(hash, index_table[i].handle, index_table[i].ofs);
+  self->index_hash = hash;
+}
+
+NVEntry *
+nv_table_get_entry_hashed(NVTable *self, NVHandle handle)
+{
+  NVIndexEntry *slot = _index_hash_find_slot(self->index_hash, handle);
+
+  if (slot->handle && slot->ofs)
+    return nv_table_get_entry_at_ofs(self, slot->ofs);
+
+  if (self->base)
+    return nv_table_get_base_entry(self, handle);
+  return NULL;
+}
+
+static inline void
+nv_table_add_to_index_hash(NVTable *self, NVHandle handle, guint32 ofs)
+{
+  if (!self->index_hash || _index_hash_is_full(self->index_hash))
+    nv_table_update_index_hash(self);
+  else
+    _index_hash_set(self->index_hash, handle, ofs);
+}
+
+/* entries of the base table are read-only for an overlay */
+static inline gboolean
+nv_table_owns_entry(NVTable *self, NVEntry *entry)
+{
+  return (gchar *) entry > (gchar *) self && (gchar *) entry < nv_table_get_top(self);
+}
+
 static inline gboolean
 _alloc_index_entry(NVTable *self, NVHandle handle, NVIndexEntry **index_entry, NVIndexEntry *index_slot)
 {
@@ -344,6 +468,9 @@ _alloc_index_entry(NVTable *self, NVHandle handle, NVIndexEntry **index_entry, N
       (*index_entry)->handle = handle;
       (*index_entry)->ofs    = 0;
       self->index_size++;
+
+      if (self->index_hash || self->index_size >= NV_TABLE_INDEX_HASH_THRESHOLD)
+        nv_table_add_to_index_hash(self, handle, 0);
     }
   return TRUE;
 }
@@ -361,6 +488,8 @@ nv_table_set_table_entry(NVTable *self, NVHandle handle, guint32 ofs, NVIndexEnt
       /* this is a dynamic value */
       (*index_entry).handle = handle;
       (*index_entry).ofs    = ofs;
+      if (self->index_hash)
+        _index_hash_set(self->index_hash, handle, ofs);
     }
 }
 
@@ -465,7 +594,8 @@ nv_table_add_value(NVTable *self, NVHandle handle,
   if (!nv_table_break_references_to_entry(self, handle, entry))
     return FALSE;
 
-  if (entry && entry->alloc_len >= NV_ENTRY_DIRECT_SIZE(entry->name_len, value_len))
+  if (entry && nv_table_owns_entry(self, entry)
+      && entry->alloc_len >= NV_ENTRY_DIRECT_SIZE(entry->name_len, value_len))
     {
       _overwrite_with_a_direct_entry(self, handle, entry, name, name_len, value, value_len, type);
       return TRUE;
@@ -503,11 +633,21 @@ nv_table_add_value(NVTable *self, NVHandle handle,
   return TRUE;
 }
 
+/* an entry of the base is shadowed by an (unset) copy in the overlay */
+static NVEntry *
+nv_table_shadow_base_entry(NVTable *self, NVHandle handle, NVEntry *entry)
+{
+  const gchar *name = entry->name_len ? nv_entry_get_name(entry) : NULL;
+
+  if (!nv_table_add_value(self, handle, name, entry->name_len, null_string, 0, entry->type, NULL))
+    return NULL;
+  return nv_table_get_entry(self, handle, NULL, NULL);
+}
+
 gboolean
 nv_table_unset_value(NVTable *self, NVHandle handle)
 {
-  NVIndexEntry *index_entry;
-  NVEntry *entry = nv_table_get_entry(self, handle, &index_entry, NULL);
+  NVEntry *entry = nv_table_get_entry(self, handle, NULL, NULL);
 
   if (!entry)
     return TRUE;
@@ -515,6 +655,16 @@ nv_table_unset_value(NVTable *self, NVHandle handle)
   if (!nv_table_break_references_to_entry(self, handle, entry))
     return FALSE;
 
+  if (!nv_table_owns_entry(self, entry))
+    {
+      if (entry->unset)
+        return TRUE;
+
+      entry = nv_table_shadow_base_entry(self, handle, entry);
+      if (!entry)
+        return FALSE;
+    }
+
   entry->unset = TRUE;
 
   /* make sure the actual value is also set to the null_string just in case
@@ -601,6 +751,13 @@ nv_table_add_value_indirect(NVTable *self, NVHandle handle, const gchar *name, g
       return nv_table_copy_referenced_value(self, ref_entry, handle, name, name_len, referenced_slice, type, new_entry);
     }
 
+  if (ref_entry && !nv_table_owns_entry(self, ref_entry))
+    {
+      /* the referenced value is in the base, which we can't mark as
+       * referenced, copy it as well */
+      return nv_table_copy_referenced_value(self, ref_entry, handle, name, name_len, referenced_slice, type, new_entry);
+    }
+
   entry = nv_table_get_entry(self, handle, &index_entry, &index_slot);
   if ((!entry && !new_entry && referenced_slice->len == 0) || !ref_entry)
     {
@@ -615,7 +772,7 @@ nv_table_add_value_indirect(NVTable *self, NVHandle handle, const gchar *name, g
   if (!nv_table_break_references_to_entry(self, handle, entry))
     return FALSE;
 
-  if (entry && (entry->alloc_len >= NV_ENTRY_INDIRECT_SIZE(name_len)))
+  if (entry && nv_table_owns_entry(self, entry) && (entry->alloc_len >= NV_ENTRY_INDIRECT_SIZE(name_len)))
     {
       /* this value already exists and the new reference fits in the old space */
       nv_table_set_indirect_entry(self, handle, entry, name, name_len, referenced_slice, type);
@@ -671,38 +828,57 @@ nv_table_foreach(NVTable *self, NVRegistry *registry, NVTableForeachFunc func, g
   return nv_table_foreach_entry(self, nv_table_call_foreach, data);
 }
 
-gboolean
-nv_table_foreach_entry(NVTable *self, NVTableForeachEntryFunc func, gpointer user_data)
+/* entries of a base table are skipped if they are shadowed by an overlay above */
+static inline gboolean
+_is_entry_visible(NVTable *self, NVTable *layer, NVHandle handle, NVEntry *entry)
+{
+  return layer == self || nv_table_get_entry(self, handle, NULL, NULL) == entry;
+}
+
+static gboolean
+_foreach_entry_in_layer(NVTable *self, NVTable *layer, NVTableForeachEntryFunc func, gpointer user_data)
 {
   NVIndexEntry *index_table;
   NVEntry *entry;
   gint i;
 
-  for (i = 0; i < self->num_static_entries; i++)
+  for (i = 0; i < layer->num_static_entries; i++)
     {
-      entry = nv_table_get_entry_at_ofs(self, self->static_entries[i]);
-      if (!entry)
+      entry = nv_table_get_entry_at_ofs(layer, layer->static_entries[i]);
+      if (!entry || !_is_entry_visible(self, layer, i + 1, entry))
         continue;
 
       if (func(i + 1, entry, NULL, user_data))
         return TRUE;
     }
 
-  index_table = nv_table_get_index(self);
-  for (i = 0; i < self->index_size; i++)
+  index_table = nv_table_get_index(layer);
+  for (i = 0; i < layer->index_size; i++)
     {
-      entry = nv_table_get_entry_at_ofs(self, index_table[i].ofs);
+      entry = nv_table_get_entry_at_ofs(layer, index_table[i].ofs);
 
-      if (!entry)
+      if (!entry || !_is_entry_visible(self, layer, index_table[i].handle, entry))
         continue;
 
-      if (func(index_table[i].handle, entry, &index_table[i], user_data))
+      /* the index of a base table is not ours to change */
+      if (func(index_table[i].handle, entry, layer == self ? &index_table[i] : NULL, user_data))
         return TRUE;
     }
 
   return FALSE;
 }
 
+gboolean
+nv_table_foreach_entry(NVTable *self, NVTableForeachEntryFunc func, gpointer user_data)
+{
+  for (NVTable *layer = self; layer; layer = layer->base)
+    {
+      if (_foreach_entry_in_layer(self, layer, func, user_data))
+        return TRUE;
+    }
+  return FALSE;
+}
+
 void
 nv_table_init(NVTable *self, gsize alloc_length, gint num_static_entries)
 {
@@ -713,6 +889,8 @@ nv_table_init(NVTable *self, gsize alloc_length, gint num_static_entries)
   self->num_static_entries = num_static_entries;
   self->ref_cnt = 1;
   self->borrowed = FALSE;
+  self->base = NULL;
+  self->index_hash = NULL;
   memset(&self->static_entries[0], 0, self->num_static_entries * sizeof(self->static_entries[0]));
 }
 
@@ -780,6 +958,10 @@ nv_table_realloc(NVTable *self, NVTable **new_nv_table)
               NV_TABLE_ADDR(self, old_size - self->used),
               self->used);
 
+      /* the hash belongs to the original */
+      (*new_nv_table)->index_hash = NULL;
+      nv_table_update_index_hash(*new_nv_table);
+
       nv_table_unref(self);
     }
   return TRUE;
@@ -795,12 +977,16 @@ nv_table_ref(NVTable *self)
 void
 nv_table_unref(NVTable *self)
 {
-  if ((--self->ref_cnt == 0) && !self->borrowed)
+  if (--self->ref_cnt == 0)
     {
-      g_free(self);
+      nv_table_free_index_hash(self);
+      if (!self->borrowed)
+        g_free(self);
     }
 }
 
+static NVTable *nv_table_flatten(NVTable *self, gint additional_space);
+
 /**
  * nv_table_clone:
  * @self: payload to clone
@@ -814,6 +1000,9 @@ nv_table_clone(NVTable *self, gint additional_space)
   NVTable *new;
   gint new_size;
 
+  if (self->base)
+    return nv_table_flatten(self, additional_space);
+
   if (nv_table_get_bottom(self) - nv_table_get_ofs_table_top(self) < additional_space)
     new_size = self->size;
   else
@@ -833,6 +1022,8 @@ nv_table_clone(NVTable *self, gint additional_space)
          NV_TABLE_ADDR(self, self->size - self->used),
          self->used);
 
+  new->index_hash = NULL;
+  nv_table_update_index_hash(new);
   return new;
 }
 
@@ -894,10 +1085,16 @@ _compact_foreach_entry(NVHandle handle, NVEntry *entry, NVIndexEntry *index_entr
   return FALSE;
 }
 
-NVTable *
-nv_table_compact(NVTable *self)
+static NVTable *
+nv_table_flatten(NVTable *self, gint additional_space)
 {
-  gint new_size = self->size;
+  gsize new_size = NV_TABLE_BOUND(additional_space);
+
+  /* the sum of all layers is enough to hold the visible entries */
+  for (NVTable *layer = self; layer; layer = layer->base)
+    new_size += layer->size;
+  new_size = MIN(new_size, NV_TABLE_MAX_BYTES);
+
   NVTable *new = g_malloc(new_size);
   gpointer args[2] = { self, new };
 
@@ -906,3 +1103,42 @@ nv_table_compact(NVTable *self)
   nv_table_foreach_entry(self, _compact_foreach_entry, args);
   return new;
 }
+
+NVTable *
+nv_table_compact(NVTable *self)
+{
+  return nv_table_flatten(self, 0);
+}
+
+static gint
+_get_overlay_depth(NVTable *self)
+{
+  gint depth = 0;
+
+  for (NVTable *layer = self->base; layer; layer = layer->base)
+    depth++;
+  return depth;
+}
+
+/**
+ * nv_table_new_overlay:
+ * @base: the table to be layered on, it must not be changed or freed while
+ *        the overlay exists
+ * @additional_space: specifies how much space is needed for the changes
+ *                    expected right away
+ *
+ * Returns a writable NVTable that shares the entries of @base, see
+ * "Overlays" in nvtable.h.  Small or deeply layered bases are cloned
+ * instead, as copying those is cheaper than the indirection.
+ **/
+NVTable *
+nv_table_new_overlay(NVTable *base, gint additional_space)
+{
+  if (base->used < NV_TABLE_OVERLAY_MIN_BASE_BYTES || _get_overlay_depth(base) >= NV_TABLE_OVERLAY_MAX_DEPTH)
+    return nv_table_clone(base, additional_space);
+
+  NVTable *self = nv_table_new(base->num_static_entries, NV_TABLE_OVERLAY_INDEX_SIZE_HINT,
+                               additional_space + NV_TABLE_OVERLAY_INIT_LENGTH);
+  self->base = base;
+  return self;
+}
@@ -32,6 +32,7 @@ typedef struct _NVTable NVTable;
 typedef struct _NVRegistry NVRegistry;
 typedef struct _NVIndexEntry NVIndexEntry;
 typedef struct _NVEntry NVEntry;
+typedef struct _NVIndexHash NVIndexHash;
 typedef guint32 NVHandle;
 typedef guint8 NVType;
 typedef gboolean (*NVTableForeachFunc)(NVHandle handle, const gchar *name,
@@ -232,6 +233,11 @@ nv_entry_get_name(NVEntry *self)
  * Dynamic values:
  *   - a dynamically sized NVIndexEntry array (contains ID + offset)
  *   - dynamic values are sorted by the global ID to make handle->entry lookups fast
+ *   - once there are NV_TABLE_INDEX_HASH_THRESHOLD dynamic values, an
+ *     open-addressing hash of the same (ID, offset) pairs is maintained
+ *     next to the sorted array, which serves plain lookups in O(1).  The
+ *     hash is allocated separately and is not part of the serialized
+ *     format, the sorted array remains the authoritative index.
  *
  * Memory allocation
  * =================
@@ -251,6 +257,27 @@ nv_entry_get_name(NVEntry *self)
  *   - It is possible to clone an NVTable, which basically copies the
  *     underlying memory contents.
  *
+ * Overlays
+ * ========
+ *   - an overlay is an NVTable layered on top of a read-only "base" table,
+ *     see nv_table_new_overlay().  It only stores the entries that were
+ *     changed after the overlay was created, lookups that miss the overlay
+ *     are served by the base.  This way a cloned LogMessage that changes a
+ *     few values does not have to copy the entire payload of the original.
+ *
+ *   - the base is not reference counted by the overlay (its refcount is not
+ *     thread safe while the base is shared between clones processed by
+ *     different threads), the owner of the overlay must keep it alive,
+ *     LogMessage does that by referencing the original message.
+ *
+ *   - entries of the base are never modified through the overlay, changed
+ *     values are added to the overlay and unset values are recorded as
+ *     unset entries in the overlay.
+ *
+ *   - overlays are flattened into a self-contained NVTable by
+ *     nv_table_compact() and nv_table_clone(), so the serialized format
+ *     is not affected.
+ *
  * Limits
  * ======
  * There might be various assumptions here and there in the code that fields
@@ -277,6 +304,12 @@ struct _NVTable
   guint8 ref_cnt:7,
          borrowed:1; /* specifies if the memory used by NVTable was borrowed from the container struct */
 
+  /* the read-only table this one is an overlay of, NULL for self-contained tables */
+  NVTable *base;
+
+  /* handle -> offset hash of large dynamic indexes, see nv_table_update_index_hash() */
+  NVIndexHash *index_hash;
+
   /* variable data, see memory layout in the comment above */
   union
   {
@@ -315,6 +348,8 @@ NVTable *nv_table_init_borrowed(gpointer space, gsize space_len, gint num_static
 gboolean nv_table_realloc(NVTable *self, NVTable **new_nv_table);
 NVTable *nv_table_compact(NVTable *self);
 NVTable *nv_table_clone(NVTable *self, gint additional_space);
+NVTable *nv_table_new_overlay(NVTable *base, gint additional_space);
+void nv_table_update_index_hash(NVTable *self);
 NVTable *nv_table_ref(NVTable *self);
 void nv_table_unref(NVTable *self);
 
@@ -368,6 +403,8 @@ nv_table_alloc_check(NVTable *self, gsize alloc_size)
 
 /* private declarations for inline functions */
 NVEntry *nv_table_get_entry_slow(NVTable *self, NVHandle handle, NVIndexEntry **index_entry, NVIndexEntry **index_slot);
+NVEntry *nv_table_get_base_entry(NVTable *self, NVHandle handle);
+NVEntry *nv_table_get_entry_hashed(NVTable *self, NVHandle handle);
 const gchar *nv_table_resolve_indirect(NVTable *self, NVEntry *entry, gssize *len);
 
 
@@ -378,6 +415,9 @@ __nv_table_get_entry(NVTable *self, NVHandle handle, guint16 num_static_entries,
   guint32 ofs;
   NVIndexEntry *t1, *t2;
 
+  /* the hash can only serve lookups that are not interested in the position within the index */
+  gboolean plain_lookup = !index_entry && !index_slot;
+
   if (!index_entry)
     index_entry = &t1;
   if (!index_slot)
@@ -396,11 +436,13 @@ __nv_table_get_entry(NVTable *self, NVHandle handle, guint16 num_static_entries,
       *index_entry = NULL;
       *index_slot = NULL;
       if (G_UNLIKELY(!ofs))
-        return NULL;
+        return G_UNLIKELY(self->base) ? nv_table_get_base_entry(self, handle) : NULL;
       return (NVEntry *) (nv_table_get_top(self) - ofs);
     }
   else
     {
+      if (plain_lookup && self->index_hash)
+        return nv_table_get_entry_hashed(self, handle);
       return nv_table_get_entry_slow(self, handle, index_entry, index_slot);
     }
 }
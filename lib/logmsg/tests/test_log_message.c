@@ -946,3 +946,65 @@ Test(log_message, test_cow_unset_value)
   log_msg_unref(orig_msg);
   log_msg_unref(msg);
 }
+
+static LogMessage *
+_construct_log_message_with_large_payload(void)
+{
+  LogMessage *msg = _construct_log_message();
+  gchar large_value[4096];
+
+  memset(large_value, 'x', sizeof(large_value) - 1);
+  large_value[sizeof(large_value) - 1] = 0;
+  log_msg_set_value_by_name(msg, "large_name", large_value, -1);
+  log_msg_set_value_by_name(msg, "orig_name", "orig_value", -1);
+  return msg;
+}
+
+Test(log_message, test_cow_clones_share_a_large_payload)
+{
+  LogMessage *msg = _construct_log_message_with_large_payload();
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  LogMessage *cloned1 = log_msg_clone_cow(msg, &path_options);
+  LogMessage *cloned2 = log_msg_clone_cow(msg, &path_options);
+
+  log_msg_set_value_by_name(cloned1, "orig_name", "modified_value1", -1);
+  log_msg_set_value_by_name(cloned2, "orig_name", "modified_value2", -1);
+  log_msg_unset_value_by_name(cloned2, "large_name");
+
+  /* only the changes are stored by the clones */
+  cr_assert_eq(cloned1->payload->base, msg->payload);
+  cr_assert_eq(cloned2->payload->base, msg->payload);
+  cr_assert_lt(cloned1->payload->size, msg->payload->size);
+
+  cr_assert_str_eq(log_msg_get_value_by_name(msg, "orig_name", NULL), "orig_value");
+  cr_assert_str_eq(log_msg_get_value_by_name(cloned1, "orig_name", NULL), "modified_value1");
+  cr_assert_str_eq(log_msg_get_value_by_name(cloned2, "orig_name", NULL), "modified_value2");
+  cr_assert_eq(strlen(log_msg_get_value_by_name(msg, "large_name", NULL)), 4095);
+  cr_assert_eq(strlen(log_msg_get_value_by_name(cloned1, "large_name", NULL)), 4095);
+  cr_assert_null(log_msg_get_value_if_set(cloned2, log_msg_get_value_handle("large_name"), NULL));
+
+  log_msg_unref(cloned2);
+  log_msg_unref(cloned1);
+  log_msg_unref(msg);
+}
+
+Test(log_message, test_cow_clone_of_a_clone_with_overlay)
+{
+  LogMessage *msg = _construct_log_message_with_large_payload();
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  LogMessage *cloned = log_msg_clone_cow(msg, &path_options);
+
+  log_msg_set_value_by_name(cloned, "orig_name", "modified_value", -1);
+
+  LogMessage *cloned_again = log_msg_clone_cow(cloned, &path_options);
+  log_msg_set_value_by_name(cloned_again, "new_name", "new_value", -1);
+
+  cr_assert_str_eq(log_msg_get_value_by_name(cloned_again, "orig_name", NULL), "modified_value");
+  cr_assert_str_eq(log_msg_get_value_by_name(cloned_again, "new_name", NULL), "new_value");
+  cr_assert_eq(strlen(log_msg_get_value_by_name(cloned_again, "large_name", NULL)), 4095);
+  cr_assert_null(log_msg_get_value_if_set(cloned, log_msg_get_value_handle("new_name"), NULL));
+
+  log_msg_unref(cloned_again);
+  log_msg_unref(cloned);
+  log_msg_unref(msg);
+}
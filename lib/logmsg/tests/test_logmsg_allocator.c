@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#include <criterion/criterion.h>
+#include "libtest/stopwatch.h"
+
+#include "logmsg/logmsg.h"
+#include "logmsg/logmsg-allocator.h"
+#include "apphook.h"
+
+#define NUM_BLOCKS 1024
+#define PERF_ITERATIONS 1000000
+#define PERF_BATCH 64
+
+Test(logmsg_allocator, test_blocks_are_usable_and_reused)
+{
+  gpointer blocks[NUM_BLOCKS];
+
+  for (gint i = 0; i < NUM_BLOCKS; i++)
+    {
+      gsize size = 64 + (i * 37) % 8192;
+
+      blocks[i] = log_msg_allocator_alloc(size);
+      cr_assert_eq(((gsize) blocks[i]) % 8, 0, "allocated block is not aligned");
+      memset(blocks[i], i & 0xff, size);
+    }
+
+  for (gint i = 0; i < NUM_BLOCKS; i++)
+    log_msg_allocator_free(blocks[i]);
+
+  /* the last freed block of a size class is handed out first */
+  gpointer block = log_msg_allocator_alloc(1000);
+  gpointer reused = block;
+  log_msg_allocator_free(block);
+  block = log_msg_allocator_alloc(1000);
+  cr_assert_eq(block, reused);
+  log_msg_allocator_free(block);
+}
+
+Test(logmsg_allocator, test_large_blocks_bypass_the_cache)
+{
+  gpointer block = log_msg_allocator_alloc(128 * 1024);
+
+  memset(block, 0, 128 * 1024);
+  log_msg_allocator_free(block);
+}
+
+static gpointer
+_free_messages_thread(gpointer user_data)
+{
+  GPtrArray *msgs = (GPtrArray *) user_data;
+
+  log_msg_allocator_thread_init();
+  for (gint i = 0; i < msgs->len; i++)
+    log_msg_unref(g_ptr_array_index(msgs, i));
+  log_msg_allocator_thread_deinit();
+  return NULL;
+}
+
+Test(logmsg_allocator, test_messages_freed_in_another_thread)
+{
+  GPtrArray *msgs = g_ptr_array_new();
+
+  for (gint i = 0; i < NUM_BLOCKS; i++)
+    {
+      LogMessage *msg = log_msg_new_empty();
+
+      log_msg_set_value(msg, LM_V_MESSAGE, "foobar", -1);
+      g_ptr_array_add(msgs, msg);
+    }
+
+  GThread *thread = g_thread_new("free", _free_messages_thread, msgs);
+  g_thread_join(thread);
+  g_ptr_array_free(msgs, TRUE);
+
+  /* blocks returned by the other thread are available through the depot */
+  for (gint i = 0; i < NUM_BLOCKS; i++)
+    {
+      LogMessage *msg = log_msg_new_empty();
+
+      log_msg_set_value(msg, LM_V_MESSAGE, "foobar", -1);
+      cr_assert_str_eq(log_msg_get_value(msg, LM_V_MESSAGE, NULL), "foobar");
+      log_msg_unref(msg);
+    }
+}
+
+static void
+_perftest_alloc_free(const gchar *name, gpointer (*alloc_fn)(gsize), void (*free_fn)(gpointer), gsize size)
+{
+  gpointer blocks[PERF_BATCH];
+
+  start_stopwatch();
+  for (gint i = 0; i < PERF_ITERATIONS / PERF_BATCH; i++)
+    {
+      for (gint j = 0; j < PERF_BATCH; j++)
+        blocks[j] = alloc_fn(size);
+      for (gint j = 0; j < PERF_BATCH; j++)
+        free_fn(blocks[j]);
+    }
+  stop_stopwatch_and_display_result(PERF_ITERATIONS, "%s, alloc/free of %" G_GSIZE_FORMAT " bytes", name, size);
+}
+
+Test(logmsg_allocator, test_allocator_performance)
+{
+  gsize sizes[] = { 512, 1024, 2048, 4000 };
+
+  for (gint i = 0; i < G_N_ELEMENTS(sizes); i++)
+    {
+      _perftest_alloc_free("g_malloc", g_malloc, g_free, sizes[i]);
+      _perftest_alloc_free("log_msg_allocator", log_msg_allocator_alloc, log_msg_allocator_free, sizes[i]);
+    }
+
+  start_stopwatch();
+  for (gint i = 0; i < PERF_ITERATIONS; i++)
+    log_msg_unref(log_msg_new_empty());
+  stop_stopwatch_and_display_result(PERF_ITERATIONS, "log_msg_new_empty() + log_msg_unref()");
+}
+
+TestSuite(logmsg_allocator, .init = app_startup, .fini = app_shutdown);
@@ -34,6 +34,7 @@
 #include "cfg.h"
 #include "plugin.h"
 #include "logmsg/logmsg-serialize.h"
+#include "logpipe.h"
 
 #define RAW_MSG "<132>1 2006-10-29T01:59:59.156+01:00 mymachine evntslog - - [exampleSDID@0 iut=\"3\" eventSource=\"Application\"] An application event log entry..."
 
@@ -226,6 +227,70 @@ Test(logmsg_serialize, simple_serialization)
   g_string_free(stream, TRUE);
 }
 
+Test(logmsg_serialize, serialization_of_a_cloned_message_flattens_the_payload)
+{
+  LogMessage *msg = _create_message_to_be_serialized(RAW_MSG, strlen(RAW_MSG));
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  LogMessage *cloned = log_msg_clone_cow(msg, &path_options);
+  GString *stream = g_string_sized_new(512);
+  SerializeArchive *sa = serialize_string_archive_new(stream);
+
+  log_msg_set_value_by_name(cloned, "aaa", "changed", -1);
+  cr_assert_not_null(cloned->payload->base);
+
+  log_msg_serialize(cloned, sa, 0);
+  log_msg_unref(cloned);
+  log_msg_unref(msg);
+
+  msg = log_msg_new_empty();
+  cr_assert(log_msg_deserialize(msg, sa), ERROR_MSG);
+  cr_assert_null(msg->payload->base);
+  cr_assert_str_eq(log_msg_get_value_by_name(msg, "aaa", NULL), "changed");
+  cr_assert_str_eq(log_msg_get_value_by_name(msg, ".normal.dynamic.field3", NULL), "value");
+
+  gssize value_len;
+  const gchar *value = log_msg_get_value_by_name(msg, "indirect_1", &value_len);
+  cr_assert_eq(value_len, 3);
+  cr_assert(strncmp(value, "val", value_len) == 0);
+
+  log_msg_unref(msg);
+  serialize_archive_free(sa);
+  g_string_free(stream, TRUE);
+}
+
+Test(logmsg_serialize, repeated_round_trips_do_not_grow_the_payload)
+{
+  LogMessage *msg = _create_message_to_be_serialized(RAW_MSG, strlen(RAW_MSG));
+  GString *stream = g_string_sized_new(512);
+  SerializeArchive *sa = serialize_string_archive_new(stream);
+
+  log_msg_serialize(msg, sa, 0);
+  log_msg_unref(msg);
+  msg = log_msg_new_empty();
+  cr_assert(log_msg_deserialize(msg, sa), ERROR_MSG);
+
+  guint32 payload_size = msg->payload->size;
+  for (gint i = 0; i < 5; i++)
+    {
+      serialize_string_archive_reset(sa);
+      g_string_truncate(stream, 0);
+
+      log_msg_serialize(msg, sa, 0);
+      log_msg_unref(msg);
+      msg = log_msg_new_empty();
+      cr_assert(log_msg_deserialize(msg, sa), ERROR_MSG);
+
+      cr_assert_eq(msg->payload->size, payload_size,
+                   "payload grew during a serialization round trip, expected=%u, got=%u",
+                   payload_size, msg->payload->size);
+    }
+  cr_assert_str_eq(log_msg_get_value_by_name(msg, ".normal.dynamic.field3", NULL), "value");
+
+  log_msg_unref(msg);
+  serialize_archive_free(sa);
+  g_string_free(stream, TRUE);
+}
+
 Test(logmsg_serialize, given_ts_processed)
 {
   LogMessage *msg = _create_message_to_be_serialized(RAW_MSG, strlen(RAW_MSG));
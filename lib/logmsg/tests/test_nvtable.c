@@ -23,6 +23,7 @@
  */
 
 #include <criterion/criterion.h>
+#include "libtest/stopwatch.h"
 
 #include "logmsg/nvtable.h"
 #include "apphook.h"
@@ -1166,3 +1167,262 @@ Test(nvtable, test_nvtable_compact_skips_unset_values)
 
   nv_table_unref(tab2);
 }
+
+static NVTable *
+_create_overlay_base(void)
+{
+  NVTable *tab = nv_table_new(STATIC_VALUES, STATIC_VALUES, 4096);
+  gchar large_value[1024];
+
+  memset(large_value, 'x', sizeof(large_value));
+  cr_assert(nv_table_add_value(tab, STATIC_HANDLE, STATIC_NAME, strlen(STATIC_NAME), "static-foo", 10, 0, NULL));
+  cr_assert(nv_table_add_value(tab, STATIC_HANDLE + 1, "VAL2", 4, large_value, sizeof(large_value), 0, NULL));
+  cr_assert(nv_table_add_value(tab, DYN_HANDLE, DYN_NAME, strlen(DYN_NAME), "dyn-foo", 7, 0, NULL));
+  return tab;
+}
+
+Test(nvtable, test_nvtable_overlay_shares_the_base)
+{
+  NVTable *base = _create_overlay_base();
+  NVTable *overlay = nv_table_new_overlay(base, 0);
+
+  cr_assert_eq(overlay->base, base);
+  cr_assert_lt(overlay->size, base->size);
+  assert_nvtable(overlay, STATIC_HANDLE, "static-foo", 10);
+  assert_nvtable(overlay, DYN_HANDLE, "dyn-foo", 7);
+
+  cr_assert(nv_table_add_value(overlay, STATIC_HANDLE, STATIC_NAME, strlen(STATIC_NAME), "changed", 7, 0, NULL));
+  cr_assert(nv_table_add_value(overlay, DYN_HANDLE, DYN_NAME, strlen(DYN_NAME), "dyn-changed", 11, 0, NULL));
+  cr_assert(nv_table_add_value(overlay, DYN_HANDLE + 1, "VAL18", 5, "new", 3, 0, NULL));
+  cr_assert(nv_table_unset_value(overlay, STATIC_HANDLE + 1));
+
+  assert_nvtable(overlay, STATIC_HANDLE, "changed", 7);
+  assert_nvtable(overlay, DYN_HANDLE, "dyn-changed", 11);
+  assert_nvtable(overlay, DYN_HANDLE + 1, "new", 3);
+  cr_assert_null(nv_table_get_value(overlay, STATIC_HANDLE + 1, NULL, NULL));
+
+  /* the base is left intact */
+  assert_nvtable(base, STATIC_HANDLE, "static-foo", 10);
+  assert_nvtable(base, DYN_HANDLE, "dyn-foo", 7);
+  cr_assert_not(nv_table_is_value_set(base, DYN_HANDLE + 1));
+  cr_assert_not_null(nv_table_get_value(base, STATIC_HANDLE + 1, NULL, NULL));
+
+  nv_table_unref(overlay);
+  nv_table_unref(base);
+}
+
+Test(nvtable, test_nvtable_overlay_keeps_references_of_the_base)
+{
+  NVTable *base = _create_overlay_base();
+  const gchar *indirect_nv_name = "indirect-name";
+
+  nv_table_add_value_indirect(base, DYN_HANDLE + 1, indirect_nv_name, strlen(indirect_nv_name),
+                              &(NVReferencedSlice)
+  {
+    STATIC_HANDLE, 1, 5
+  }, 0, NULL);
+
+  NVTable *overlay = nv_table_new_overlay(base, 0);
+  cr_assert(nv_table_add_value(overlay, STATIC_HANDLE, STATIC_NAME, strlen(STATIC_NAME), "changed", 7, 0, NULL));
+  assert_nvtable(overlay, STATIC_HANDLE, "changed", 7);
+  assert_nvtable(overlay, DYN_HANDLE + 1, "tatic", 5);
+
+  /* a reference to a value of the base is stored as a copy */
+  nv_table_add_value_indirect(overlay, DYN_HANDLE + 2, indirect_nv_name, strlen(indirect_nv_name),
+                              &(NVReferencedSlice)
+  {
+    DYN_HANDLE, 4, 3
+  }, 0, NULL);
+  assert_nvtable(overlay, DYN_HANDLE + 2, "foo", 3);
+  cr_assert(nv_table_unset_value(overlay, DYN_HANDLE));
+  assert_nvtable(overlay, DYN_HANDLE + 2, "foo", 3);
+  assert_nvtable(base, DYN_HANDLE, "dyn-foo", 7);
+
+  nv_table_unref(overlay);
+  nv_table_unref(base);
+}
+
+static gboolean
+_count_entries(NVHandle handle, NVEntry *entry, NVIndexEntry *index_entry, gpointer user_data)
+{
+  gint *count = (gint *) user_data;
+
+  (*count)++;
+  return FALSE;
+}
+
+Test(nvtable, test_nvtable_overlay_is_flattened_by_compact)
+{
+  NVTable *base = _create_overlay_base();
+  NVTable *overlay = nv_table_new_overlay(base, 0);
+
+  cr_assert(nv_table_add_value(overlay, DYN_HANDLE, DYN_NAME, strlen(DYN_NAME), "dyn-changed", 11, 0, NULL));
+  cr_assert(nv_table_add_value(overlay, DYN_HANDLE + 1, "VAL18", 5, "new", 3, 0, NULL));
+  cr_assert(nv_table_unset_value(overlay, STATIC_HANDLE));
+
+  gint count = 0;
+  nv_table_foreach_entry(overlay, _count_entries, &count);
+  cr_assert_eq(count, 4, "shadowed entries of the base should not be visited, count: %d", count);
+
+  NVTable *compacted = nv_table_compact(overlay);
+  cr_assert_null(compacted->base);
+  cr_assert_not(nv_table_is_value_set(compacted, STATIC_HANDLE));
+  assert_nvtable(compacted, DYN_HANDLE, "dyn-changed", 11);
+  assert_nvtable(compacted, DYN_HANDLE + 1, "new", 3);
+  cr_assert_not_null(nv_table_get_value(compacted, STATIC_HANDLE + 1, NULL, NULL));
+
+  NVTable *cloned = nv_table_clone(overlay, 0);
+  cr_assert_null(cloned->base);
+  assert_nvtable(cloned, DYN_HANDLE, "dyn-changed", 11);
+
+  nv_table_unref(cloned);
+  nv_table_unref(compacted);
+  nv_table_unref(overlay);
+  nv_table_unref(base);
+}
+
+Test(nvtable, test_nvtable_small_base_is_cloned_instead_of_overlaid)
+{
+  NVTable *base = nv_table_new(STATIC_VALUES, STATIC_VALUES, 1024);
+  cr_assert(nv_table_add_value(base, STATIC_HANDLE, STATIC_NAME, strlen(STATIC_NAME), "static-foo", 10, 0, NULL));
+
+  NVTable *overlay = nv_table_new_overlay(base, 0);
+  cr_assert_null(overlay->base);
+  assert_nvtable(overlay, STATIC_HANDLE, "static-foo", 10);
+
+  nv_table_unref(overlay);
+  nv_table_unref(base);
+}
+
+static NVTable *
+_create_table_with_dynamic_values(gint num_values, gboolean shuffled)
+{
+  NVTable *tab = nv_table_new(STATIC_VALUES, 16, 256);
+
+  for (gint i = 0; i < num_values; i++)
+    {
+      /* reverse order exercises the worst case of the sorted index */
+      NVHandle handle = shuffled ? DYN_HANDLE + num_values - i - 1 : DYN_HANDLE + i;
+      gchar name[32];
+
+      g_snprintf(name, sizeof(name), "VAL%d", handle);
+      while (!nv_table_add_value(tab, handle, name, strlen(name), name, strlen(name), 0, NULL))
+        cr_assert(nv_table_realloc(tab, &tab));
+    }
+  return tab;
+}
+
+static void
+_assert_dynamic_values(NVTable *tab, gint num_values)
+{
+  for (gint i = 0; i < num_values; i++)
+    {
+      gchar name[32];
+
+      g_snprintf(name, sizeof(name), "VAL%d", DYN_HANDLE + i);
+      assert_nvtable(tab, DYN_HANDLE + i, name, strlen(name));
+    }
+  cr_assert_not(nv_table_is_value_set(tab, DYN_HANDLE + num_values));
+  cr_assert_not(nv_table_is_value_set(tab, DYN_HANDLE + 100000));
+}
+
+Test(nvtable, test_nvtable_index_hash_is_used_for_large_tables)
+{
+  NVTable *tab = _create_table_with_dynamic_values(10, TRUE);
+  cr_assert_null(tab->index_hash);
+  nv_table_unref(tab);
+
+  tab = _create_table_with_dynamic_values(1000, TRUE);
+  cr_assert_not_null(tab->index_hash);
+  _assert_dynamic_values(tab, 1000);
+
+  /* changed values are reallocated to a new offset */
+  gchar value[64];
+  memset(value, 'x', sizeof(value));
+  cr_assert(nv_table_add_value(tab, DYN_HANDLE + 500, "VAL517", 6, value, sizeof(value), 0, NULL));
+  assert_nvtable(tab, DYN_HANDLE + 500, value, sizeof(value));
+  cr_assert(nv_table_unset_value(tab, DYN_HANDLE + 501));
+  cr_assert_not(nv_table_is_value_set(tab, DYN_HANDLE + 501));
+
+  NVTable *compacted = nv_table_compact(tab);
+  cr_assert_not_null(compacted->index_hash);
+  assert_nvtable(compacted, DYN_HANDLE + 500, value, sizeof(value));
+  cr_assert_not(nv_table_is_value_set(compacted, DYN_HANDLE + 501));
+  nv_table_unref(compacted);
+  nv_table_unref(tab);
+}
+
+Test(nvtable, test_nvtable_index_hash_survives_realloc_and_clone)
+{
+  NVTable *tab = _create_table_with_dynamic_values(200, FALSE);
+  NVTable *tab_ref = nv_table_ref(tab);
+
+  cr_assert(nv_table_realloc(tab, &tab));
+  cr_assert_neq(tab, tab_ref);
+  cr_assert_not_null(tab->index_hash);
+  cr_assert_neq(tab->index_hash, tab_ref->index_hash);
+  _assert_dynamic_values(tab, 200);
+  _assert_dynamic_values(tab_ref, 200);
+  nv_table_unref(tab_ref);
+
+  NVTable *cloned = nv_table_clone(tab, 0);
+  cr_assert_not_null(cloned->index_hash);
+  cr_assert_neq(cloned->index_hash, tab->index_hash);
+  _assert_dynamic_values(cloned, 200);
+  nv_table_unref(cloned);
+
+  NVTable *overlay = nv_table_new_overlay(tab, 0);
+  _assert_dynamic_values(overlay, 200);
+  nv_table_unref(overlay);
+
+  nv_table_unref(tab);
+}
+
+#define INDEX_PERF_LOOKUPS 1000000
+
+static void
+_perftest_index_insert(gint num_values, gboolean shuffled)
+{
+  gint iterations = MAX(INDEX_PERF_LOOKUPS / num_values / 10, 1);
+
+  start_stopwatch();
+  for (gint i = 0; i < iterations; i++)
+    nv_table_unref(_create_table_with_dynamic_values(num_values, shuffled));
+  stop_stopwatch_and_display_result(iterations * num_values, "insert of %d %s values", num_values,
+                                    shuffled ? "reverse ordered" : "ordered");
+}
+
+static void
+_perftest_index_lookup(gint num_values)
+{
+  NVTable *tab = _create_table_with_dynamic_values(num_values, TRUE);
+  NVIndexEntry *index_entry;
+  gsize found = 0;
+
+  /* asking for the index entry forces a binary search */
+  start_stopwatch();
+  for (gint i = 0; i < INDEX_PERF_LOOKUPS; i++)
+    found += !!nv_table_get_entry(tab, DYN_HANDLE + i % num_values, &index_entry, NULL);
+  stop_stopwatch_and_display_result(INDEX_PERF_LOOKUPS, "binary search lookup among %d values", num_values);
+
+  start_stopwatch();
+  for (gint i = 0; i < INDEX_PERF_LOOKUPS; i++)
+    found += !!nv_table_get_entry(tab, DYN_HANDLE + i % num_values, NULL, NULL);
+  stop_stopwatch_and_display_result(INDEX_PERF_LOOKUPS, "%s lookup among %d values",
+                                    tab->index_hash ? "hashed" : "binary search", num_values);
+
+  cr_assert_eq(found, 2 * INDEX_PERF_LOOKUPS);
+  nv_table_unref(tab);
+}
+
+Test(nvtable, test_nvtable_index_performance)
+{
+  gint sizes[] = { 10, 100, 1000 };
+
+  for (gint i = 0; i < G_N_ELEMENTS(sizes); i++)
+    {
+      _perftest_index_insert(sizes[i], FALSE);
+      _perftest_index_insert(sizes[i], TRUE);
+      _perftest_index_lookup(sizes[i]);
+    }
+}
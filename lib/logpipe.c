@@ -48,6 +48,57 @@ void log_pipe_detach_expr_node(LogPipe *self)
   self->expr_node = NULL;
 }
 
+void
+log_pipe_set_queue_batch(LogPipe *self, LogPipeQueueBatchFunc queue_batch)
+{
+  self->queue_batch = queue_batch;
+  self->queue_batch_of = self->queue;
+}
+
+static inline gboolean
+_has_queue_batch(LogPipe *self)
+{
+  /* if queue() was overridden since queue_batch() was set up, the
+   * override would be bypassed, in that case we unroll the batch */
+  return self->queue_batch && self->queue_batch_of == (gpointer) self->queue;
+}
+
+void
+log_pipe_queue_batch(LogPipe *s, LogMessage **msgs, const LogPathOptions **path_options, gint count)
+{
+  LogPathOptions local_path_options[LOG_PIPE_BATCH_MAX];
+  gint i, n = 0;
+
+  g_assert(count <= LOG_PIPE_BATCH_MAX);
+
+  if (s->queue && !_has_queue_batch(s))
+    {
+      for (i = 0; i < count; i++)
+        log_pipe_queue(s, msgs[i], path_options[i]);
+      return;
+    }
+
+  for (i = 0; i < count; i++)
+    {
+      LogMessage *msg = msgs[i];
+      const LogPathOptions *lpo = path_options[i];
+
+      if (!log_pipe_queue_prologue(s, &msg, &lpo, &local_path_options[n]))
+        continue;
+      msgs[n] = msg;
+      path_options[n] = lpo;
+      n++;
+    }
+
+  if (n == 0)
+    return;
+
+  if (_has_queue_batch(s))
+    s->queue_batch(s, msgs, path_options, n);
+  else
+    log_pipe_forward_batch(s, msgs, path_options, n);
+}
+
 static GList *
 _arcs(LogPipe *self)
 {
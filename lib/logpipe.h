@@ -192,6 +192,29 @@
  *
  *     - once the hook is invoked, it should take care about calling the
  *       original function
+ *
+ * Batched delivery
+ *
+ *   Sources that fetch several messages in one go (e.g. LogReader) may
+ *   push them along the pipeline as a single batch using
+ *   log_pipe_queue_batch(), instead of calling log_pipe_queue() for each
+ *   of them.  A batch is a pair of arrays: the messages and the
+ *   LogPathOptions that belong to each message.  Every message in the
+ *   batch carries its own path options, as junctions and filters track
+ *   their "matched" state per message.
+ *
+ *   Pipes may implement the queue_batch() method to process the whole
+ *   batch in one call and pass the survivors on using
+ *   log_pipe_forward_batch().  Pipes that don't implement it (or whose
+ *   queue() method was overridden after queue_batch() was set up, see
+ *   "Plugin overrides" above) get the batch unrolled into individual
+ *   queue() calls.  Pipes that simply forward messages (queue == NULL)
+ *   forward the batch as is.
+ *
+ *   The arrays passed to queue_batch() are owned by the caller, but the
+ *   callee is free to modify them in place (e.g. to compact the batch
+ *   after dropping messages), so the caller must not rely on their
+ *   contents once the call returns.
  **/
 
 struct _LogPathOptions
@@ -298,6 +321,12 @@ struct _LogPipeOptions
   gboolean internal;
 };
 
+/* upper limit on the number of messages passed in a single batch */
+#define LOG_PIPE_BATCH_MAX 64
+
+typedef void (*LogPipeQueueBatchFunc)(LogPipe *self, LogMessage **msgs, const LogPathOptions **path_options,
+                                      gint count);
+
 struct _LogPipe
 {
   GAtomicCounter ref_cnt;
@@ -305,6 +334,11 @@ struct _LogPipe
 
   void (*queue)(LogPipe *self, LogMessage *msg, const LogPathOptions *path_options);
 
+  /* batch variant of queue(), only used as long as queue() is the same
+   * method it was set up with, see log_pipe_set_queue_batch() */
+  LogPipeQueueBatchFunc queue_batch;
+  gpointer queue_batch_of;
+
   GlobalConfig *cfg;
   LogExprNode *expr_node;
   LogPipe *pipe_next;
@@ -361,6 +395,8 @@ void log_pipe_forward_notify(LogPipe *self, gint notify_code, gpointer user_data
 EVTTAG *log_pipe_location_tag(LogPipe *pipe);
 void log_pipe_attach_expr_node(LogPipe *self, LogExprNode *expr_node);
 void log_pipe_detach_expr_node(LogPipe *self);
+void log_pipe_set_queue_batch(LogPipe *self, LogPipeQueueBatchFunc queue_batch);
+void log_pipe_queue_batch(LogPipe *s, LogMessage **msgs, const LogPathOptions **path_options, gint count);
 
 static inline GlobalConfig *
 log_pipe_get_config(LogPipe *s)
@@ -452,41 +488,58 @@ log_pipe_forward_msg(LogPipe *self, LogMessage *msg, const LogPathOptions *path_
     }
 }
 
-static inline void
-log_pipe_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
+/*
+ * Steps to be performed on a message right before it enters a LogPipe,
+ * shared by log_pipe_queue() and log_pipe_queue_batch().  Returns FALSE if
+ * the message was dropped.  If the path options need to be changed, they
+ * are copied to @local_path_options and *path_options is updated to point
+ * there.
+ */
+static inline gboolean
+log_pipe_queue_prologue(LogPipe *s, LogMessage **pmsg, const LogPathOptions **path_options,
+                        LogPathOptions *local_path_options)
 {
-  LogPathOptions local_path_options;
   g_assert((s->flags & PIF_INITIALIZED) != 0);
 
   if (G_UNLIKELY(pipe_single_step_hook))
     {
-      if (!pipe_single_step_hook(s, msg, path_options))
+      if (!pipe_single_step_hook(s, *pmsg, *path_options))
         {
-          log_msg_drop(msg, path_options, AT_PROCESSED);
-          return;
+          log_msg_drop(*pmsg, *path_options, AT_PROCESSED);
+          return FALSE;
         }
     }
 
   if ((s->flags & PIF_SYNC_FILTERX))
-    filterx_eval_sync_message(path_options->filterx_context, &msg, path_options);
+    filterx_eval_sync_message((*path_options)->filterx_context, pmsg, *path_options);
 
   if (G_UNLIKELY(s->flags & (PIF_HARD_FLOW_CONTROL | PIF_JUNCTION_END | PIF_CONDITIONAL_MIDPOINT)))
     {
-      path_options = log_path_options_chain(&local_path_options, path_options);
+      *path_options = log_path_options_chain(local_path_options, *path_options);
       if (s->flags & PIF_HARD_FLOW_CONTROL)
         {
-          local_path_options.flow_control_requested = 1;
+          local_path_options->flow_control_requested = 1;
           msg_trace("Requesting flow control", log_pipe_location_tag(s));
         }
       if (s->flags & PIF_JUNCTION_END)
         {
-          log_path_options_pop_junction(&local_path_options);
+          log_path_options_pop_junction(local_path_options);
         }
       if (s->flags & PIF_CONDITIONAL_MIDPOINT)
         {
-          log_path_options_pop_conditional(&local_path_options);
+          log_path_options_pop_conditional(local_path_options);
         }
     }
+  return TRUE;
+}
+
+static inline void
+log_pipe_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
+{
+  LogPathOptions local_path_options;
+
+  if (!log_pipe_queue_prologue(s, &msg, &path_options, &local_path_options))
+    return;
 
   if (s->queue)
     {
@@ -499,6 +552,20 @@ log_pipe_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
 
 }
 
+static inline void
+log_pipe_forward_batch(LogPipe *self, LogMessage **msgs, const LogPathOptions **path_options, gint count)
+{
+  if (self->pipe_next)
+    {
+      log_pipe_queue_batch(self->pipe_next, msgs, path_options, count);
+    }
+  else
+    {
+      for (gint i = 0; i < count; i++)
+        log_msg_drop(msgs[i], path_options[i], AT_PROCESSED);
+    }
+}
+
 static inline LogPipe *
 log_pipe_clone(LogPipe *self)
 {
@@ -0,0 +1,215 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "logproto/logproto-buffer-pool.h"
+#include "apphook.h"
+#include "tls-support.h"
+
+/* log2(LOG_PROTO_BUFFER_POOL_MAX_SIZE / LOG_PROTO_BUFFER_POOL_MIN_SIZE) + 1 */
+#define NUM_SIZE_CLASSES 9
+
+/* the free buffers are chained through their first bytes */
+typedef struct _PooledBuffer PooledBuffer;
+struct _PooledBuffer
+{
+  PooledBuffer *next;
+};
+
+static GMutex pool_lock;
+static PooledBuffer *free_buffers[NUM_SIZE_CLASSES];
+static gsize pooled_bytes;
+
+/* buffers released by a thread are kept in a thread local cache first, so
+ * that a connection releasing and reacquiring its buffer between two
+ * poll wakeups does not need to take pool_lock */
+TLS_BLOCK_START
+{
+  PooledBuffer *cached_buffers[NUM_SIZE_CLASSES];
+  gsize cached_bytes;
+}
+TLS_BLOCK_END;
+
+#define cached_buffers __tls_deref(cached_buffers)
+#define cached_bytes __tls_deref(cached_bytes)
+
+static gint
+_size_class(gsize size)
+{
+  if (size < LOG_PROTO_BUFFER_POOL_MIN_SIZE || size > LOG_PROTO_BUFFER_POOL_MAX_SIZE || (size & (size - 1)) != 0)
+    return -1;
+
+  gint size_class = 0;
+  for (gsize s = LOG_PROTO_BUFFER_POOL_MIN_SIZE; s < size; s <<= 1)
+    size_class++;
+  return size_class;
+}
+
+static PooledBuffer *
+_acquire_from_thread_cache(gint size_class, gsize size)
+{
+  PooledBuffer *buffer = cached_buffers[size_class];
+
+  if (buffer)
+    {
+      cached_buffers[size_class] = buffer->next;
+      cached_bytes -= size;
+    }
+  return buffer;
+}
+
+static gboolean
+_release_to_thread_cache(PooledBuffer *buffer, gint size_class, gsize size)
+{
+  if (cached_bytes + size > LOG_PROTO_BUFFER_POOL_THREAD_CACHE_MAX_BYTES)
+    return FALSE;
+
+  buffer->next = cached_buffers[size_class];
+  cached_buffers[size_class] = buffer;
+  cached_bytes += size;
+  return TRUE;
+}
+
+static PooledBuffer *
+_acquire_from_global_pool(gint size_class, gsize size)
+{
+  g_mutex_lock(&pool_lock);
+  PooledBuffer *buffer = free_buffers[size_class];
+  if (buffer)
+    {
+      free_buffers[size_class] = buffer->next;
+      pooled_bytes -= size;
+    }
+  g_mutex_unlock(&pool_lock);
+  return buffer;
+}
+
+static gboolean
+_release_to_global_pool(PooledBuffer *buffer, gint size_class, gsize size)
+{
+  gboolean result = FALSE;
+
+  g_mutex_lock(&pool_lock);
+  if (pooled_bytes + size <= LOG_PROTO_BUFFER_POOL_MAX_BYTES)
+    {
+      buffer->next = free_buffers[size_class];
+      free_buffers[size_class] = buffer;
+      pooled_bytes += size;
+      result = TRUE;
+    }
+  g_mutex_unlock(&pool_lock);
+  return result;
+}
+
+guchar *
+log_proto_buffer_pool_acquire(gsize size)
+{
+  gint size_class = _size_class(size);
+  PooledBuffer *buffer = NULL;
+
+  if (size_class >= 0)
+    {
+      buffer = _acquire_from_thread_cache(size_class, size);
+      if (!buffer)
+        buffer = _acquire_from_global_pool(size_class, size);
+    }
+
+  if (!buffer)
+    return g_malloc(size);
+  return (guchar *) buffer;
+}
+
+void
+log_proto_buffer_pool_release(guchar *buffer, gsize size)
+{
+  gint size_class = _size_class(size);
+
+  if (!buffer)
+    return;
+
+  if (size_class >= 0)
+    {
+      PooledBuffer *pooled = (PooledBuffer *) buffer;
+
+      if (_release_to_thread_cache(pooled, size_class, size) ||
+          _release_to_global_pool(pooled, size_class, size))
+        return;
+    }
+  g_free(buffer);
+}
+
+/* moves the buffers cached by the current thread to the global pool */
+static void
+_flush_thread_cache(gpointer user_data)
+{
+  gsize size = LOG_PROTO_BUFFER_POOL_MIN_SIZE;
+
+  for (gint i = 0; i < NUM_SIZE_CLASSES; i++, size <<= 1)
+    {
+      while (cached_buffers[i])
+        {
+          PooledBuffer *buffer = cached_buffers[i];
+
+          cached_buffers[i] = buffer->next;
+          if (!_release_to_global_pool(buffer, i, size))
+            g_free(buffer);
+        }
+    }
+  cached_bytes = 0;
+}
+
+/* the bytes held by the global pool and by the cache of the current thread */
+gsize
+log_proto_buffer_pool_get_pooled_bytes(void)
+{
+  g_mutex_lock(&pool_lock);
+  gsize result = pooled_bytes;
+  g_mutex_unlock(&pool_lock);
+  return result + cached_bytes;
+}
+
+void
+log_proto_buffer_pool_global_init(void)
+{
+  register_application_thread_deinit_hook(_flush_thread_cache, NULL);
+}
+
+void
+log_proto_buffer_pool_global_deinit(void)
+{
+  /* the main thread doesn't run the thread deinit hooks */
+  _flush_thread_cache(NULL);
+
+  g_mutex_lock(&pool_lock);
+  for (gint i = 0; i < NUM_SIZE_CLASSES; i++)
+    {
+      while (free_buffers[i])
+        {
+          PooledBuffer *buffer = free_buffers[i];
+
+          free_buffers[i] = buffer->next;
+          g_free(buffer);
+        }
+    }
+  pooled_bytes = 0;
+  g_mutex_unlock(&pool_lock);
+}
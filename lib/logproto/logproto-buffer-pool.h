@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef LOGPROTO_BUFFER_POOL_H_INCLUDED
+#define LOGPROTO_BUFFER_POOL_H_INCLUDED
+
+#include "syslog-ng.h"
+
+/*
+ * A process wide pool of input buffers.  Connections return their
+ * buffers here while idle, so that the memory is reused by the busy ones
+ * instead of being pinned by thousands of idle peers.
+ *
+ * Buffers with a power-of-two size in the range of
+ * [LOG_PROTO_BUFFER_POOL_MIN_SIZE, LOG_PROTO_BUFFER_POOL_MAX_SIZE] are
+ * pooled, others are simply allocated and freed.  The pool holds at most
+ * LOG_PROTO_BUFFER_POOL_MAX_BYTES of memory, in addition each thread
+ * caches up to LOG_PROTO_BUFFER_POOL_THREAD_CACHE_MAX_BYTES of the buffers
+ * it released, without locking.
+ */
+#define LOG_PROTO_BUFFER_POOL_MIN_SIZE 4096
+#define LOG_PROTO_BUFFER_POOL_MAX_SIZE (1024 * 1024)
+#define LOG_PROTO_BUFFER_POOL_MAX_BYTES (16 * 1024 * 1024)
+#define LOG_PROTO_BUFFER_POOL_THREAD_CACHE_MAX_BYTES (256 * 1024)
+
+guchar *log_proto_buffer_pool_acquire(gsize size);
+void log_proto_buffer_pool_release(guchar *buffer, gsize size);
+gsize log_proto_buffer_pool_get_pooled_bytes(void);
+
+void log_proto_buffer_pool_global_init(void);
+void log_proto_buffer_pool_global_deinit(void);
+
+#endif
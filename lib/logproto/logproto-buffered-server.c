@@ -22,6 +22,7 @@
  *
  */
 #include "logproto-buffered-server.h"
+#include "logproto-buffer-pool.h"
 #include "logproto.h"
 #include "messages.h"
 #include "serialize.h"
@@ -68,6 +69,58 @@ _log_proto_buffered_server_fallback_non_persistent(LogProtoBufferedServer *self)
   return self->persist_state == NULL;
 }
 
+static void
+log_proto_buffered_server_allocate_buffer(LogProtoBufferedServer *self, LogProtoBufferedServerState *state,
+                                          gsize buffer_size)
+{
+  self->buffer = log_proto_buffer_pool_acquire(buffer_size);
+  self->buffer_high_watermark = 0;
+  self->super.buffer_bytes = buffer_size;
+  state->buffer_size = buffer_size;
+}
+
+static void
+log_proto_buffered_server_resize_buffer(LogProtoBufferedServer *self, LogProtoBufferedServerState *state,
+                                        gsize buffer_size)
+{
+  /* pooled buffers are allocated by g_malloc(), so they can be reallocated */
+  self->buffer = g_realloc(self->buffer, buffer_size);
+  self->super.buffer_bytes = buffer_size;
+  state->buffer_size = buffer_size;
+}
+
+static void
+log_proto_buffered_server_release_buffer(LogProtoBufferedServer *self, LogProtoBufferedServerState *state)
+{
+  gsize buffer_size = self->super.buffer_bytes;
+
+  log_proto_buffer_pool_release(self->buffer, buffer_size);
+  self->buffer = NULL;
+  self->super.buffer_bytes = 0;
+  self->read_saturated = FALSE;
+
+  /* state->buffer_size is the size of the next allocation: shrink if
+   * this buffer was mostly unused */
+  if (self->buffer_high_watermark <= buffer_size / 4 && buffer_size / 2 >= LOG_PROTO_BUFFERED_SERVER_MIN_BUFFER_SIZE)
+    state->buffer_size = buffer_size / 2;
+}
+
+static gsize
+log_proto_buffered_server_get_initial_buffer_size(LogProtoBufferedServer *self, LogProtoBufferedServerState *state)
+{
+  gsize init_buffer_size = self->super.options->init_buffer_size;
+
+  /* datagrams and records need to fit in the buffer in one go */
+  if (!self->stream_based)
+    return init_buffer_size;
+
+  /* the buffer was released while the connection was idle */
+  if (state->buffer_size)
+    return state->buffer_size;
+
+  return MIN(LOG_PROTO_BUFFERED_SERVER_MIN_BUFFER_SIZE, init_buffer_size);
+}
+
 static gboolean
 log_proto_buffered_server_convert_from_raw(LogProtoBufferedServer *self, const guchar *raw_buffer, gsize raw_buffer_len)
 {
@@ -127,11 +180,9 @@ log_proto_buffered_server_convert_from_raw(LogProtoBufferedServer *self, const g
 
               if (state->buffer_size < self->super.options->max_buffer_size)
                 {
-                  state->buffer_size *= 2;
-                  if (state->buffer_size > self->super.options->max_buffer_size)
-                    state->buffer_size = self->super.options->max_buffer_size;
-
-                  self->buffer = g_realloc(self->buffer, state->buffer_size);
+                  log_proto_buffered_server_resize_buffer(self, state,
+                                                          MIN(state->buffer_size * 2,
+                                                              self->super.options->max_buffer_size));
                 }
               else
                 {
@@ -191,9 +242,8 @@ log_proto_buffered_server_apply_state(LogProtoBufferedServer *self, PersistEntry
 
   if (!self->buffer)
     {
-      gssize buffer_size = MAX(state->buffer_size, self->super.options->init_buffer_size);
-      self->buffer = g_malloc(buffer_size);
-      state->buffer_size = buffer_size;
+      log_proto_buffered_server_allocate_buffer(self, state,
+                                                MAX(state->buffer_size, self->super.options->init_buffer_size));
     }
   state->pending_buffer_end = 0;
 
@@ -410,10 +460,13 @@ log_proto_buffered_server_convert_state(LogProtoBufferedServer *self, guint8 per
           goto error_converting_v3;
         }
 
-      if (!self->buffer || state->buffer_size < buffer_len)
+      if (!self->buffer)
         {
-          gsize buffer_size = MAX(self->super.options->init_buffer_size, buffer_len);
-          self->buffer = g_realloc(self->buffer, buffer_size);
+          log_proto_buffered_server_allocate_buffer(self, state, MAX(self->super.options->init_buffer_size, buffer_len));
+        }
+      else if (state->buffer_size < buffer_len)
+        {
+          log_proto_buffered_server_resize_buffer(self, state, MAX(self->super.options->init_buffer_size, buffer_len));
         }
       serialize_archive_free(archive);
 
@@ -675,6 +728,23 @@ log_proto_buffered_server_get_raw_size_of_buffer(LogProtoBufferedServer *self, c
     }
 }
 
+/*
+ * Without character conversion, the buffer is used in a ring-like
+ * fashion: new data is appended after the partial message as long as
+ * there is a reasonable amount of free space at the end, and the partial
+ * message is moved to the beginning of the buffer only when the end is
+ * reached, instead of at every refill.
+ */
+static inline gboolean
+log_proto_buffered_server_has_room_at_the_end(LogProtoBufferedServer *self, LogProtoBufferedServerState *state)
+{
+  gsize room = state->buffer_size - state->pending_buffer_end;
+
+  if (self->convert != (GIConv) -1)
+    return FALSE;
+  return room > 0 && room >= state->buffer_size / 4;
+}
+
 static void
 log_proto_buffered_server_split_buffer(LogProtoBufferedServer *self, LogProtoBufferedServerState *state,
                                        const guchar **buffer_start, gsize buffer_bytes)
@@ -682,6 +752,9 @@ log_proto_buffered_server_split_buffer(LogProtoBufferedServer *self, LogProtoBuf
   if (*buffer_start == self->buffer)
     return;
 
+  if (log_proto_buffered_server_has_room_at_the_end(self, state))
+    return;
+
   /* move partial message to the beginning of the buffer to make space for new data */
   memmove(self->buffer, *buffer_start, buffer_bytes);
   state->pending_buffer_pos = 0;
@@ -720,7 +793,6 @@ log_proto_buffered_server_fetch_from_buffer(LogProtoBufferedServer *self, const
   LogProtoBufferedServerState *state = log_proto_buffered_server_get_state(self);
   gboolean success = FALSE;
 
-  buffer_start = self->buffer + state->pending_buffer_pos;
   buffer_bytes = state->pending_buffer_end - state->pending_buffer_pos;
 
   if (buffer_bytes == 0)
@@ -742,6 +814,7 @@ log_proto_buffered_server_fetch_from_buffer(LogProtoBufferedServer *self, const
       goto exit;
     }
 
+  buffer_start = self->buffer + state->pending_buffer_pos;
   success = self->fetch_from_buffer(self, buffer_start, buffer_bytes, msg, msg_len);
 
   if (!success)
@@ -756,11 +829,29 @@ exit:
   return success;
 }
 
-static inline void
-log_proto_buffered_server_allocate_buffer(LogProtoBufferedServer *self, LogProtoBufferedServerState *state)
+static void
+log_proto_buffered_server_grow_buffer_if_needed(LogProtoBufferedServer *self, LogProtoBufferedServerState *state)
+{
+  gsize max_buffer_size = self->super.options->init_buffer_size;
+  gboolean buffer_full = state->pending_buffer_end == state->buffer_size;
+
+  if (state->buffer_size >= max_buffer_size)
+    return;
+
+  if (!buffer_full && !self->read_saturated)
+    return;
+
+  log_proto_buffered_server_resize_buffer(self, state, MIN(state->buffer_size * 2, max_buffer_size));
+  self->read_saturated = FALSE;
+}
+
+static void
+log_proto_buffered_server_release_buffer_if_idle(LogProtoBufferedServer *self, LogProtoBufferedServerState *state)
 {
-  state->buffer_size = self->super.options->init_buffer_size;
-  self->buffer = g_malloc(state->buffer_size);
+  if (state->pending_buffer_end != 0 || state->raw_buffer_leftover_size != 0)
+    return;
+
+  log_proto_buffered_server_release_buffer(self, state);
 }
 
 static inline gint
@@ -783,10 +874,13 @@ log_proto_buffered_server_fetch_into_buffer(LogProtoBufferedServer *self)
   GIOStatus result = G_IO_STATUS_NORMAL;
 
   if (G_UNLIKELY(!self->buffer))
-    log_proto_buffered_server_allocate_buffer(self, state);
+    log_proto_buffered_server_allocate_buffer(self, state, log_proto_buffered_server_get_initial_buffer_size(self, state));
 
   if (self->convert == (GIConv) -1)
     {
+      if (self->stream_based)
+        log_proto_buffered_server_grow_buffer_if_needed(self, state);
+
       /* no conversion, we read directly into our buffer */
       raw_buffer = self->buffer + state->pending_buffer_end;
       avail = state->buffer_size - state->pending_buffer_end;
@@ -811,6 +905,8 @@ log_proto_buffered_server_fetch_into_buffer(LogProtoBufferedServer *self)
         {
           /* ok we don't have any more data to read, return to main poll loop */
           result = G_IO_STATUS_AGAIN;
+          if (self->stream_based)
+            log_proto_buffered_server_release_buffer_if_idle(self, state);
         }
       else
         {
@@ -835,6 +931,7 @@ log_proto_buffered_server_fetch_into_buffer(LogProtoBufferedServer *self)
     }
   else
     {
+      self->read_saturated = (rc == avail);
       state->pending_raw_buffer_size += rc;
       rc += state->raw_buffer_leftover_size;
       state->raw_buffer_leftover_size = 0;
@@ -847,6 +944,8 @@ log_proto_buffered_server_fetch_into_buffer(LogProtoBufferedServer *self)
         {
           result = G_IO_STATUS_ERROR;
         }
+      self->buffer_high_watermark = MAX(self->buffer_high_watermark,
+                                        state->pending_buffer_end - state->pending_buffer_pos);
     }
 exit:
   log_proto_buffered_server_put_state(self);
@@ -934,7 +1033,6 @@ log_proto_buffered_server_flush(LogProtoBufferedServer *self, const guchar **msg
 {
   LogProtoBufferedServerState *state = log_proto_buffered_server_get_state(self);
 
-  const guchar *buffer_start = self->buffer + state->pending_buffer_pos;
   gsize buffer_bytes = state->pending_buffer_end - state->pending_buffer_pos;
 
   if (buffer_bytes == 0)
@@ -945,7 +1043,7 @@ log_proto_buffered_server_flush(LogProtoBufferedServer *self, const guchar **msg
       return;
     }
 
-  *msg = buffer_start;
+  *msg = self->buffer + state->pending_buffer_pos;
   *msg_len = buffer_bytes;
   state->pending_buffer_pos = state->pending_buffer_end;
 
@@ -1062,7 +1160,7 @@ log_proto_buffered_server_free_method(LogProtoServer *s)
 
   log_transport_aux_data_destroy(&self->buffer_aux);
 
-  g_free(self->buffer);
+  log_proto_buffer_pool_release(self->buffer, self->super.buffer_bytes);
   if (self->state1)
     {
       g_free(self->state1);
@@ -27,6 +27,18 @@
 #include "logproto-server.h"
 #include "persistable-state-header.h"
 
+/*
+ * Stream based servers start with a buffer of this size (or
+ * init_buffer_size if that is smaller), and grow it by doubling, up to
+ * init_buffer_size, when a partial message fills the buffer, or when a
+ * read fills all the free space, which indicates a high volume peer.
+ *
+ * Idle connections return their (empty) buffer to the shared buffer pool,
+ * a buffer that was used only up to a quarter of its size is halved at
+ * that point.
+ */
+#define LOG_PROTO_BUFFERED_SERVER_MIN_BUFFER_SIZE 4096
+
 enum
 {
   LPBSF_FETCHING_FROM_INPUT,
@@ -83,7 +95,9 @@ struct _LogProtoBufferedServer
                stream_based:1,
 
                no_multi_read:1,
-               flush_partial_message:1;
+               flush_partial_message:1,
+               /* the last read filled all the free space of the buffer */
+               read_saturated:1;
   gint fetch_state;
   GIOStatus io_status;
   LogProtoBufferedServerState *state1;
@@ -91,6 +105,8 @@ struct _LogProtoBufferedServer
   PersistEntryHandle persist_handle;
   GIConv convert;
   guchar *buffer;
+  /* the most bytes pending in the buffer (pending_buffer_end - pending_buffer_pos) since it was allocated */
+  guint32 buffer_high_watermark;
 
   GIConv reverse_convert;
   gchar *reverse_buffer;
@@ -48,12 +48,24 @@ log_proto_dgram_server_fetch_from_buffer(LogProtoBufferedServer *s, const guchar
   return TRUE;
 }
 
+static LogProtoPrepareAction
+log_proto_dgram_server_prepare(LogProtoServer *s, GIOCondition *cond, gint *timeout)
+{
+  LogProtoPrepareAction action = log_proto_buffered_server_prepare(s, cond, timeout);
+  if (action != LPPA_POLL_IO)
+    return action;
+
+  /* datagrams received in a batch are not signalled by the fd anymore */
+  return log_transport_has_pending_input(s->transport) ? LPPA_FORCE_SCHEDULE_FETCH : LPPA_POLL_IO;
+}
+
 LogProtoServer *
 log_proto_dgram_server_new(LogTransport *transport, const LogProtoServerOptions *options)
 {
   LogProtoDGramServer *self = g_new0(LogProtoDGramServer, 1);
 
   log_proto_buffered_server_init(&self->super, transport, options);
+  self->super.super.prepare = log_proto_dgram_server_prepare;
   self->super.fetch_from_buffer = log_proto_dgram_server_fetch_from_buffer;
   self->super.stream_based = FALSE;
   return &self->super.super;
@@ -25,21 +25,16 @@
 #include "logproto-text-client.h"
 #include "messages.h"
 
-#define LPFCS_FRAME_SEND    0
-#define LPFCS_MESSAGE_SEND  1
+/* the frame header: the length of the message (at most 7 digits) and a space */
+#define LOG_PROTO_FRAMED_CLIENT_MAX_FRAME_HDR_LEN 9
 
-typedef struct _LogProtoFramedClient
-{
-  LogProtoTextClient super;
-  guchar frame_hdr_buf[9];
-} LogProtoFramedClient;
+G_STATIC_ASSERT(LOG_PROTO_FRAMED_CLIENT_MAX_FRAME_HDR_LEN <= LOG_PROTO_TEXT_CLIENT_MAX_HEADER_LEN);
 
 static LogProtoStatus
 log_proto_framed_client_post(LogProtoClient *s, LogMessage *logmsg, guchar *msg, gsize msg_len, gboolean *consumed)
 {
-  LogProtoFramedClient *self = (LogProtoFramedClient *) s;
+  guchar frame_hdr_buf[LOG_PROTO_FRAMED_CLIENT_MAX_FRAME_HDR_LEN];
   gint frame_hdr_len;
-  LogProtoStatus status;
 
   if (msg_len > 9999999)
     {
@@ -54,34 +49,17 @@ log_proto_framed_client_post(LogProtoClient *s, LogMessage *logmsg, guchar *msg,
       msg_len = 9999999;
     }
 
-  status = LPS_SUCCESS;
-  while (status == LPS_SUCCESS && !(*consumed) && self->super.partial == NULL)
-    {
-      switch (self->super.state)
-        {
-        case LPFCS_FRAME_SEND:
-          frame_hdr_len = g_snprintf((gchar *) self->frame_hdr_buf, sizeof(self->frame_hdr_buf), "%" G_GSIZE_FORMAT" ", msg_len);
-          status = log_proto_text_client_submit_write(s, self->frame_hdr_buf, frame_hdr_len, NULL, LPFCS_MESSAGE_SEND);
-          break;
-        case LPFCS_MESSAGE_SEND:
-          *consumed = TRUE;
-          status = log_proto_text_client_submit_write(s, msg, msg_len, (GDestroyNotify) g_free, LPFCS_FRAME_SEND);
-          break;
-        default:
-          g_assert_not_reached();
-        }
-    }
-
-  return status;
+  /* the frame header is sent together with the message, in the same batch */
+  frame_hdr_len = g_snprintf((gchar *) frame_hdr_buf, sizeof(frame_hdr_buf), "%" G_GSIZE_FORMAT" ", msg_len);
+  return log_proto_text_client_post_with_header(s, frame_hdr_buf, frame_hdr_len, msg, msg_len, consumed);
 }
 
 LogProtoClient *
 log_proto_framed_client_new(LogTransport *transport, const LogProtoClientOptions *options)
 {
-  LogProtoFramedClient *self = g_new0(LogProtoFramedClient, 1);
+  LogProtoTextClient *self = g_new0(LogProtoTextClient, 1);
 
-  log_proto_text_client_init(&self->super, transport, options);
-  self->super.super.post = log_proto_framed_client_post;
-  self->super.state = LPFCS_FRAME_SEND;
-  return &self->super.super;
+  log_proto_text_client_init(self, transport, options);
+  self->super.post = log_proto_framed_client_post;
+  return &self->super;
 }
@@ -224,6 +224,7 @@ _ensure_buffer(LogProtoFramedServer *self)
 
   self->buffer_size = self->super.options->init_buffer_size;
   self->buffer = g_malloc(self->buffer_size);
+  self->super.buffer_bytes = self->buffer_size;
 }
 
 static LogProtoFramedServerStateControl
@@ -28,77 +28,26 @@
 #include "plugin.h"
 #include "plugin-types.h"
 #include "ack-tracker/ack_tracker_factory.h"
+#include "find-crlf.h"
 
 /**
  * Find the character terminating the buffer.
  *
  * NOTE: when looking for the end-of-message here, it either needs to be
  * terminated via NUL or via NL, when terminating via NL we have to make
- * sure that there's no NUL left in the message. This function iterates over
- * the input data and returns a pointer to the first occurrence of NL or NUL.
- *
- * It uses an algorithm similar to what there's in libc memchr/strchr.
+ * sure that there's no NUL left in the message. This function returns a
+ * pointer to the first occurrence of NL or NUL.
  *
  * NOTE: find_eom is not static as it is used by a unit test program.
  **/
 const guchar *
 find_eom(const guchar *s, gsize n)
 {
-  const guchar *char_ptr;
-  const gulong *longword_ptr;
-  gulong longword, magic_bits, charmask;
-  gchar c;
-
-  c = '\n';
-
-  /* align input to long boundary */
-  for (char_ptr = s; n > 0 && ((gulong) char_ptr & (sizeof(longword) - 1)) != 0; ++char_ptr, n--)
-    {
-      if (*char_ptr == c || *char_ptr == '\0')
-        return char_ptr;
-    }
-
-  longword_ptr = (gulong *) char_ptr;
-
-#if GLIB_SIZEOF_LONG == 8
-  magic_bits = 0x7efefefefefefeffL;
-#elif GLIB_SIZEOF_LONG == 4
-  magic_bits = 0x7efefeffL;
-#else
-#error "unknown architecture"
-#endif
-  memset(&charmask, c, sizeof(charmask));
-
-  while (n > sizeof(longword))
-    {
-      longword = *longword_ptr++;
-      if ((((longword + magic_bits) ^ ~longword) & ~magic_bits) != 0 ||
-          ((((longword ^ charmask) + magic_bits) ^ ~(longword ^ charmask)) & ~magic_bits) != 0)
-        {
-          gint i;
+  guint32 pos;
 
-          char_ptr = (const guchar *) (longword_ptr - 1);
-
-          for (i = 0; i < sizeof(longword); i++)
-            {
-              if (*char_ptr == c || *char_ptr == '\0')
-                return char_ptr;
-              char_ptr++;
-            }
-        }
-      n -= sizeof(longword);
-    }
-
-  char_ptr = (const guchar *) longword_ptr;
-
-  while (n-- > 0)
-    {
-      if (*char_ptr == c || *char_ptr == '\0')
-        return char_ptr;
-      ++char_ptr;
-    }
-
-  return NULL;
+  if (find_eol_positions(s, n, FIND_EOL_NL | FIND_EOL_NUL, &pos, 1) == 0)
+    return NULL;
+  return s + pos;
 }
 
 AckTrackerFactory *
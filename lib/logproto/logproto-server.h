@@ -80,6 +80,8 @@ struct _LogProtoServer
   const LogProtoServerOptions *options;
   LogTransport *transport;
   AckTracker *ack_tracker;
+  /* the size of the input buffer currently held by the instance, reported as a metric */
+  gsize buffer_bytes;
 
   LogProtoServerWakeupCallback wakeup_callback;
   /* FIXME: rename to something else */
@@ -157,6 +159,12 @@ log_proto_server_get_fd(LogProtoServer *s)
   return s->transport->fd;
 }
 
+static inline gsize
+log_proto_server_get_buffer_bytes(LogProtoServer *s)
+{
+  return s->buffer_bytes;
+}
+
 static inline void
 log_proto_server_reset_error(LogProtoServer *s)
 {
@@ -25,6 +25,7 @@
 #include "messages.h"
 
 #include <errno.h>
+#include <string.h>
 
 static gboolean
 log_proto_text_client_prepare(LogProtoClient *s, gint *fd, GIOCondition *cond, gint *timeout)
@@ -38,7 +39,7 @@ log_proto_text_client_prepare(LogProtoClient *s, gint *fd, GIOCondition *cond, g
   if (*cond == 0)
     *cond = G_IO_OUT;
 
-  const gboolean pending_write = self->partial != NULL;
+  const gboolean pending_write = self->batch_len > 0 || self->partial;
 
   if (!pending_write && s->options->timeout > 0)
     *timeout = s->options->timeout;
@@ -74,31 +75,48 @@ log_proto_text_client_drop_input(LogProtoClient *s)
 }
 
 static LogProtoStatus
-log_proto_text_client_flush(LogProtoClient *s)
+_handle_write_error(LogProtoTextClient *self)
 {
-  LogProtoTextClient *self = (LogProtoTextClient *) s;
-  gint rc;
+  if (errno == EAGAIN || errno == EINTR)
+    return LPS_SUCCESS;
 
-  if (!self->partial)
-    {
-      return LPS_SUCCESS;
-    }
+  log_proto_client_msg_rewind(&self->super);
+  msg_error("I/O error occurred while writing",
+            evt_tag_int("fd", self->super.transport->fd),
+            evt_tag_error(EVT_TAG_OSERROR));
+  return LPS_ERROR;
+}
+
+static void
+_free_batch_messages(LogProtoTextClient *self, gint from, gint to)
+{
+  for (gint i = from; i < to; i++)
+    g_free(self->batch[i * 2 + 1].iov_base);
+}
+
+static void
+_reset_batch(LogProtoTextClient *self)
+{
+  self->batch_len = 0;
+  self->batch_pos = 0;
+  self->batch_size = 0;
+}
 
+static inline gsize
+_batch_message_len(LogProtoTextClient *self, gint i)
+{
+  return self->batch[i * 2].iov_len + self->batch[i * 2 + 1].iov_len;
+}
+
+static LogProtoStatus
+_flush_partial(LogProtoTextClient *self)
+{
   /* attempt to flush previously buffered data */
-  gint len = self->partial_len - self->partial_pos;
+  gsize len = self->partial_len - self->partial_pos;
+  gssize rc = log_transport_write(self->super.transport, &self->partial[self->partial_pos], len);
 
-  rc = log_transport_write(self->super.transport, &self->partial[self->partial_pos], len);
   if (rc < 0)
-    {
-      if (errno != EAGAIN && errno != EINTR)
-        {
-          msg_error("I/O error occurred while writing",
-                    evt_tag_int("fd", self->super.transport->fd),
-                    evt_tag_error(EVT_TAG_OSERROR));
-          return LPS_ERROR;
-        }
-      return LPS_SUCCESS;
-    }
+    return _handle_write_error(self);
 
   if (rc != len)
     {
@@ -106,88 +124,185 @@ log_proto_text_client_flush(LogProtoClient *s)
       return LPS_PARTIAL;
     }
 
-  if (self->partial_free)
-    self->partial_free(self->partial);
+  log_proto_client_msg_ack(&self->super, self->partial_messages);
+  g_free(self->partial);
   self->partial = NULL;
-  if (self->next_state >= 0)
+  self->partial_messages = 0;
+  return LPS_SUCCESS;
+}
+
+/* copy the part of the batch that was not written by writev() into the
+ * partial buffer, the batch is released by the caller */
+static void
+_process_partial_write(LogProtoTextClient *self, gsize written)
+{
+  gint first_unwritten = 0;
+
+  while (written >= _batch_message_len(self, first_unwritten))
+    written -= _batch_message_len(self, first_unwritten++);
+
+  self->partial_len = self->batch_size;
+  for (gint i = 0; i < first_unwritten; i++)
+    self->partial_len -= _batch_message_len(self, i);
+  self->partial_len -= written;
+  self->partial = g_malloc(self->partial_len);
+  self->partial_pos = 0;
+
+  gsize ofs = 0;
+  for (gint i = first_unwritten * 2; i < self->batch_len * 2; i++)
     {
-      self->state = self->next_state;
-      self->next_state = -1;
+      gsize skip = MIN(written, self->batch[i].iov_len);
+
+      memcpy(self->partial + ofs, (guchar *) self->batch[i].iov_base + skip, self->batch[i].iov_len - skip);
+      ofs += self->batch[i].iov_len - skip;
+      written -= skip;
     }
+  g_assert(ofs == self->partial_len);
+
+  self->partial_messages = self->batch_len - first_unwritten;
+  if (first_unwritten > 0)
+    log_proto_client_msg_ack(&self->super, first_unwritten);
+}
+
+/* stream transports: the whole batch is written with a single writev() */
+static LogProtoStatus
+_flush_batch_to_stream(LogProtoTextClient *self)
+{
+  gssize rc = log_transport_writev(self->super.transport, self->batch, self->batch_len * 2);
+
+  if (rc < 0)
+    return _handle_write_error(self);
+
+  if (rc != self->batch_size)
+    _process_partial_write(self, rc);
+  else
+    log_proto_client_msg_ack(&self->super, self->batch_len);
 
-  log_proto_client_msg_ack(&self->super, 1);
+  /* the unwritten part has been copied to the partial buffer */
+  _free_batch_messages(self, 0, self->batch_len);
+  _reset_batch(self);
 
-  /* NOTE: we return here to give a chance to the framed protocol to send the frame header. */
+  return self->partial ? LPS_PARTIAL : LPS_SUCCESS;
+}
+
+/* datagram transports: each message is sent as a separate datagram, as
+ * many of them with a single call as the transport allows */
+static LogProtoStatus
+_flush_batch_to_datagrams(LogProtoTextClient *self)
+{
+  while (self->batch_pos < self->batch_len)
+    {
+      gint rc = log_transport_write_datagrams(self->super.transport, &self->batch[self->batch_pos * 2], 2,
+                                              self->batch_len - self->batch_pos);
+
+      if (rc < 0)
+        return _handle_write_error(self);
+
+      _free_batch_messages(self, self->batch_pos, self->batch_pos + rc);
+      self->batch_pos += rc;
+      log_proto_client_msg_ack(&self->super, rc);
+    }
+
+  _reset_batch(self);
   return LPS_SUCCESS;
 }
 
-LogProtoStatus
-log_proto_text_client_submit_write(LogProtoClient *s, guchar *msg, gsize msg_len, GDestroyNotify msg_free,
-                                   gint next_state)
+static LogProtoStatus
+log_proto_text_client_flush(LogProtoClient *s)
 {
   LogProtoTextClient *self = (LogProtoTextClient *) s;
 
-  g_assert(self->partial == NULL);
-  self->partial = msg;
-  self->partial_len = msg_len;
-  self->partial_pos = 0;
-  self->partial_free = msg_free;
-  self->next_state = next_state;
-  return log_proto_text_client_flush(s);
-}
+  if (self->partial)
+    {
+      LogProtoStatus status = _flush_partial(self);
+
+      if (status != LPS_SUCCESS || self->partial)
+        return status;
+    }
+
+  /* we might be called from log_writer_deinit() without having a batch at all */
+  if (self->batch_len == 0)
+    return LPS_SUCCESS;
 
+  if (log_transport_is_datagram_based(self->super.transport))
+    return _flush_batch_to_datagrams(self);
+  return _flush_batch_to_stream(self);
+}
 
 /*
- * log_proto_text_client_post:
+ * log_proto_text_client_post_with_header:
+ * @hdr: header to be sent in front of @msg, copied by this function
+ * @hdr_len: length of @hdr
  * @msg: formatted log message to send (this might be consumed by this function)
  * @msg_len: length of @msg
  * @consumed: pointer to a gboolean that gets set if the message was consumed by this function
- * @error: error information, if any
  *
- * This function posts a message to the log transport, performing buffering
- * of partially sent data if needed. The return value indicates whether we
- * successfully sent this message, or if it should be resent by the caller.
+ * This function adds a message to the outgoing batch, which is written to
+ * the transport once it fills up, or when the LogWriter flushes us. The
+ * return value indicates whether we successfully sent this message, or if
+ * it should be resent by the caller.
+ *
+ * Messages are acknowledged only once they were fully written, the header
+ * and the payload of a message are never interleaved with other data.
  **/
-static LogProtoStatus
-log_proto_text_client_post(LogProtoClient *s, LogMessage *logmsg, guchar *msg, gsize msg_len, gboolean *consumed)
+LogProtoStatus
+log_proto_text_client_post_with_header(LogProtoClient *s, const guchar *hdr, gsize hdr_len,
+                                       guchar *msg, gsize msg_len, gboolean *consumed)
 {
   LogProtoTextClient *self = (LogProtoTextClient *) s;
 
-  /* try to flush already buffered data */
+  g_assert(hdr_len <= LOG_PROTO_TEXT_CLIENT_MAX_HEADER_LEN);
+
   *consumed = FALSE;
-  const LogProtoStatus status = log_proto_text_client_flush(s);
-  if (status == LPS_ERROR)
+  if (self->batch_len == LOG_PROTO_TEXT_CLIENT_BATCH_MAX || self->partial)
     {
-      /* log_proto_flush() already logs in the case of an error */
-      return status;
-    }
+      const LogProtoStatus status = log_proto_text_client_flush(s);
 
-  if (self->partial || LPS_PARTIAL == status)
-    {
-      /* NOTE: the partial buffer has not been emptied yet even with the
-       * flush above, we shouldn't attempt to write again.
-       *
-       * Otherwise: with the framed protocol this could case the frame
-       * header to be split, and interleaved with message payload, as in:
-       *
-       *     First bytes of frame header || payload || tail of frame header.
-       *
-       * This obviously would cause the framing to break. Also libssl
-       * returns an error in this case, which is how this was discovered.
-       */
-      return LPS_PARTIAL;
+      if (status == LPS_ERROR)
+        {
+          /* log_proto_flush() already logs in the case of an error */
+          return status;
+        }
+
+      if (self->batch_len == LOG_PROTO_TEXT_CLIENT_BATCH_MAX || self->partial)
+        {
+          /* we couldn't empty the outgoing buffers, don't consume a new
+           * message until they are written */
+          return LPS_PARTIAL;
+        }
     }
 
+  gint i = self->batch_len++;
+
+  if (hdr_len)
+    memcpy(self->batch_headers[i], hdr, hdr_len);
+  self->batch[i * 2].iov_base = self->batch_headers[i];
+  self->batch[i * 2].iov_len = hdr_len;
+  self->batch[i * 2 + 1].iov_base = msg;
+  self->batch[i * 2 + 1].iov_len = msg_len;
+  self->batch_size += hdr_len + msg_len;
   *consumed = TRUE;
-  return log_proto_text_client_submit_write(s, msg, msg_len, (GDestroyNotify) g_free, -1);
+
+  if (self->batch_len == LOG_PROTO_TEXT_CLIENT_BATCH_MAX)
+    return log_proto_text_client_flush(s);
+
+  return LPS_SUCCESS;
+}
+
+static LogProtoStatus
+log_proto_text_client_post(LogProtoClient *s, LogMessage *logmsg, guchar *msg, gsize msg_len, gboolean *consumed)
+{
+  return log_proto_text_client_post_with_header(s, NULL, 0, msg, msg_len, consumed);
 }
 
 void
 log_proto_text_client_free(LogProtoClient *s)
 {
   LogProtoTextClient *self = (LogProtoTextClient *)s;
-  if (self->partial_free)
-    self->partial_free(self->partial);
+
+  _free_batch_messages(self, self->batch_pos, self->batch_len);
+  _reset_batch(self);
+  g_free(self->partial);
   self->partial = NULL;
   log_proto_client_free_method(s);
 };
@@ -203,7 +318,6 @@ log_proto_text_client_init(LogProtoTextClient *self, LogTransport *transport, co
   self->super.post = log_proto_text_client_post;
   self->super.free_fn = log_proto_text_client_free;
   self->super.transport = transport;
-  self->next_state = -1;
 }
 
 LogProtoClient *
@@ -26,17 +26,33 @@
 
 #include "logproto-client.h"
 
+#include <sys/uio.h>
+
+/* maximum number of messages written with a single writev()/sendmmsg() call */
+#define LOG_PROTO_TEXT_CLIENT_BATCH_MAX 64
+#define LOG_PROTO_TEXT_CLIENT_MAX_HEADER_LEN 16
+
 typedef struct _LogProtoTextClient
 {
   LogProtoClient super;
-  gint state, next_state;
+
+  /* messages posted, but not written yet: each of them occupies two
+   * consecutive iovecs, an optional header (e.g. the frame header of the
+   * framed protocol) and the payload. batch_pos is the first message not
+   * written yet (datagram transports only). */
+  struct iovec batch[LOG_PROTO_TEXT_CLIENT_BATCH_MAX * 2];
+  guchar batch_headers[LOG_PROTO_TEXT_CLIENT_BATCH_MAX][LOG_PROTO_TEXT_CLIENT_MAX_HEADER_LEN];
+  gint batch_len, batch_pos;
+  gsize batch_size;
+
+  /* the unwritten tail of a partially written batch (stream transports) */
   guchar *partial;
-  GDestroyNotify partial_free;
   gsize partial_len, partial_pos;
+  gint partial_messages;
 } LogProtoTextClient;
 
-LogProtoStatus log_proto_text_client_submit_write(LogProtoClient *s, guchar *msg, gsize msg_len,
-                                                  GDestroyNotify msg_free, gint next_state);
+LogProtoStatus log_proto_text_client_post_with_header(LogProtoClient *s, const guchar *hdr, gsize hdr_len,
+                                                      guchar *msg, gsize msg_len, gboolean *consumed);
 void log_proto_text_client_init(LogProtoTextClient *self, LogTransport *transport,
                                 const LogProtoClientOptions *options);
 LogProtoClient *log_proto_text_client_new(LogTransport *transport, const LogProtoClientOptions *options);
@@ -23,6 +23,7 @@
  */
 #include "logproto-text-server.h"
 #include "messages.h"
+#include "find-crlf.h"
 
 #include <string.h>
 
@@ -36,7 +37,7 @@ log_proto_text_server_prepare_method(LogProtoServer *s, GIOCondition *cond, gint
   if (action != LPPA_POLL_IO)
     return action;
 
-  avail = (self->cached_eol_pos != 0);
+  avail = (self->eol_cache_index < self->eol_cache_len);
   return avail ? LPPA_FORCE_SCHEDULE_FETCH : LPPA_POLL_IO;
 }
 
@@ -57,28 +58,72 @@ log_proto_text_server_accumulate_line(LogProtoTextServer *self, const guchar *ms
   return MLL_CONSUME_SEGMENT | MLL_EXTRACTED;
 }
 
+/* scans [scan_start, scan_end) of the buffer, appending the line terminators found to the cache */
+static void
+log_proto_text_server_scan_eols(LogProtoTextServer *self, guint32 scan_start, guint32 scan_end)
+{
+  guint32 *positions = &self->eol_cache[self->eol_cache_len];
+  gsize found = find_eol_positions(self->super.buffer + scan_start, scan_end - scan_start, self->eol_chars,
+                                   positions, LOG_PROTO_TEXT_SERVER_EOL_CACHE_SIZE - self->eol_cache_len);
+
+  for (gsize i = 0; i < found; i++)
+    positions[i] += scan_start;
+  self->eol_cache_len += found;
+}
+
+static inline void
+log_proto_text_server_reset_eols(LogProtoTextServer *self)
+{
+  self->eol_cache_index = self->eol_cache_len = 0;
+}
+
+/* the EOL returned by the last log_proto_text_server_locate_next_eol() call is to be returned again */
+static inline void
+log_proto_text_server_push_back_eol(LogProtoTextServer *self)
+{
+  g_assert(self->eol_cache_index > 0);
+  self->eol_cache_index--;
+}
+
+static const guchar *
+log_proto_text_server_locate_next_eol(LogProtoTextServer *self, const guchar *buffer_start, gsize buffer_bytes)
+{
+  guint32 buffer_end = buffer_start + buffer_bytes - self->super.buffer;
+  guint32 eol_pos;
+
+  if (self->eol_cache_index == self->eol_cache_len)
+    {
+      /* all line terminators of the previous scan are processed, the
+       * remaining part of the buffer is scanned in one go */
+
+      log_proto_text_server_reset_eols(self);
+      log_proto_text_server_scan_eols(self, buffer_start + self->consumed_len + 1 - self->super.buffer, buffer_end);
+      if (self->eol_cache_len == 0)
+        return NULL;
+    }
+
+  eol_pos = self->eol_cache[self->eol_cache_index++];
+  if (self->eol_cache_index == LOG_PROTO_TEXT_SERVER_EOL_CACHE_SIZE)
+    {
+      /* the buffer has more lines than the cache can hold, continue the
+       * scan after the last one, keeping it in the cache so that it can
+       * be pushed back */
+
+      self->eol_cache[0] = eol_pos;
+      self->eol_cache_index = self->eol_cache_len = 1;
+      log_proto_text_server_scan_eols(self, eol_pos + 1, buffer_end);
+    }
+  return self->super.buffer + eol_pos;
+}
+
 static gboolean
 log_proto_text_server_try_extract(LogProtoTextServer *self, LogProtoBufferedServerState *state,
                                   const guchar *buffer_start, gsize buffer_bytes, const guchar *eol, const guchar **msg, gsize *msg_len)
 {
   gint verdict;
   guint32 next_line_pos;
-  guint32 next_eol_pos = 0;
 
   next_line_pos = eol + 1 - self->super.buffer;
-  if (state->pending_buffer_end != next_line_pos)
-    {
-      const guchar *eom;
-
-      /* we have some more data in the buffer, check if we have a
-       * subsequent EOL there.  It indicates whether we need to
-       * read further data, or the buffer already contains a
-       * complete line */
-
-      eom = self->find_eom(self->super.buffer + next_line_pos, state->pending_buffer_end - next_line_pos);
-      if (eom)
-        next_eol_pos = eom - self->super.buffer;
-    }
 
   *msg_len = eol - buffer_start;
   *msg = buffer_start;
@@ -91,7 +136,6 @@ log_proto_text_server_try_extract(LogProtoTextServer *self, LogProtoBufferedServ
           gint drop_length = (verdict & MLL_CONSUME_PARTIAL_AMOUNT_MASK) >> MLL_CONSUME_PARTIAL_AMOUNT_SHIFT;
 
           state->pending_buffer_pos = next_line_pos;
-          self->cached_eol_pos = next_eol_pos;
           if (drop_length)
             *msg_len -= drop_length;
         }
@@ -103,7 +147,7 @@ log_proto_text_server_try_extract(LogProtoTextServer *self, LogProtoBufferedServ
             *msg_len = 0;
 
           state->pending_buffer_pos = (buffer_start + self->consumed_len + 1) - self->super.buffer;
-          self->cached_eol_pos = eol - self->super.buffer;
+          log_proto_text_server_push_back_eol(self);
         }
       else
         g_assert_not_reached();
@@ -136,7 +180,6 @@ log_proto_text_server_try_extract(LogProtoTextServer *self, LogProtoBufferedServ
            */
 
           g_assert(drop_length == 0);
-          self->cached_eol_pos = next_eol_pos;
           self->consumed_len = eol - buffer_start;
         }
       else if (verdict & MLL_REWIND_SEGMENT)
@@ -164,9 +207,9 @@ log_proto_text_server_extract(LogProtoTextServer *self, LogProtoBufferedServerSt
     {
       if (log_proto_text_server_try_extract(self, state, buffer_start, buffer_bytes, eol, msg, msg_len))
         return TRUE;
-      eol = self->super.buffer + self->cached_eol_pos;
+      eol = log_proto_text_server_locate_next_eol(self, buffer_start, buffer_bytes);
     }
-  while (self->cached_eol_pos > 0);
+  while (eol);
   return FALSE;
 }
 
@@ -198,27 +241,6 @@ log_proto_text_server_yield_whole_buffer_as_message(LogProtoTextServer *self, Lo
   state->pending_buffer_pos = (*msg) + (*msg_len) - self->super.buffer;
 }
 
-static inline const guchar *
-log_proto_text_server_locate_next_eol(LogProtoTextServer *self, LogProtoBufferedServerState *state,
-                                      const guchar *buffer_start, gsize buffer_bytes)
-{
-  const guchar *eol;
-
-  if (self->cached_eol_pos)
-    {
-      /* previous invocation was nice enough to save a cached EOL
-       * pointer, no need to look it up again */
-
-      eol = self->super.buffer + self->cached_eol_pos;
-      self->cached_eol_pos = 0;
-    }
-  else
-    {
-      eol = self->find_eom(buffer_start + self->consumed_len + 1, buffer_bytes - self->consumed_len - 1);
-    }
-  return eol;
-}
-
 static gboolean
 log_proto_text_server_message_size_too_large(LogProtoTextServer *self, gsize buffer_bytes)
 {
@@ -230,7 +252,7 @@ _fetch_msg_from_buffer(LogProtoTextServer *self, LogProtoBufferedServerState *st
                        const guchar *buffer_start, gsize buffer_bytes,
                        const guchar **msg, gsize *msg_len)
 {
-  const guchar *eol = log_proto_text_server_locate_next_eol(self, state, buffer_start, buffer_bytes);
+  const guchar *eol = log_proto_text_server_locate_next_eol(self, buffer_start, buffer_bytes);
 
   if (!eol)
     {
@@ -278,7 +300,7 @@ log_proto_text_server_flush(LogProtoBufferedServer *s)
 {
   LogProtoTextServer *self = (LogProtoTextServer *) s;
   self->consumed_len = -1;
-  self->cached_eol_pos = 0;
+  log_proto_text_server_reset_eols(self);
 }
 
 void
@@ -308,7 +330,7 @@ log_proto_text_server_init(LogProtoTextServer *self, LogTransport *transport, co
   self->super.super.free_fn = log_proto_text_server_free;
   self->super.fetch_from_buffer = log_proto_text_server_fetch_from_buffer;
   self->super.flush = log_proto_text_server_flush;
-  self->find_eom = find_eom;
+  self->eol_chars = FIND_EOL_NL | FIND_EOL_NUL;
   self->super.stream_based = TRUE;
   self->consumed_len = -1;
 }
@@ -322,18 +344,12 @@ log_proto_text_server_new(LogTransport *transport, const LogProtoServerOptions *
   return &self->super.super;
 }
 
-static const guchar *
-_find_nl_as_eom(const guchar *s, gsize n)
-{
-  return memchr(s, '\n', n);
-}
-
 LogProtoServer *
 log_proto_text_with_nuls_server_new(LogTransport *transport, const LogProtoServerOptions *options)
 {
   LogProtoTextServer *self = g_new0(LogProtoTextServer, 1);
 
   log_proto_text_server_init(self, transport, options);
-  self->find_eom = _find_nl_as_eom;
+  self->eol_chars = FIND_EOL_NL;
   return &self->super.super;
 }
@@ -27,15 +27,23 @@
 #include "logproto-buffered-server.h"
 #include "multi-line/multi-line-logic.h"
 
+#define LOG_PROTO_TEXT_SERVER_EOL_CACHE_SIZE 64
+
 typedef struct _LogProtoTextServer LogProtoTextServer;
 struct _LogProtoTextServer
 {
   LogProtoBufferedServer super;
   MultiLineLogic *multi_line;
 
-  const guchar *(*find_eom)(const guchar *s, gsize n);
+  /* FIND_EOL_* flags */
+  guint eol_chars;
   gint32 consumed_len;
-  gint32 cached_eol_pos;
+
+  /* offsets of the line terminators in super.buffer, located by a single
+   * scan, the ones from eol_cache_index are not yet processed */
+  guint32 eol_cache[LOG_PROTO_TEXT_SERVER_EOL_CACHE_SIZE];
+  gint eol_cache_index;
+  gint eol_cache_len;
 };
 
 void log_proto_text_server_set_multi_line(LogProtoServer *s, MultiLineLogic *multi_line);
@@ -0,0 +1,271 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+#include "libtest/mock-transport.h"
+
+#include "logproto/logproto-text-client.h"
+#include "logproto/logproto-framed-client.h"
+#include "transport/transport-socket.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+static LogProtoClientOptions client_options;
+static gint messages_acked;
+static gint rewinds;
+
+static void
+_ack_callback(gint num_acked, gpointer user_data)
+{
+  messages_acked += num_acked;
+}
+
+static void
+_rewind_callback(gpointer user_data)
+{
+  rewinds++;
+}
+
+static LogProtoClient *
+_construct_client(LogProtoClient *(*constructor)(LogTransport *, const LogProtoClientOptions *),
+                  LogTransport *transport)
+{
+  LogProtoClientFlowControlFuncs flow_control_funcs =
+  {
+    .ack_callback = _ack_callback,
+    .rewind_callback = _rewind_callback,
+  };
+  LogProtoClient *proto = constructor(transport, &client_options);
+
+  log_proto_client_set_client_flow_control(proto, &flow_control_funcs);
+  messages_acked = 0;
+  rewinds = 0;
+  return proto;
+}
+
+static LogProtoStatus
+_post_message(LogProtoClient *proto, const gchar *message)
+{
+  gboolean consumed = FALSE;
+  guchar *msg = (guchar *) g_strdup(message);
+  LogProtoStatus status = log_proto_client_post(proto, NULL, msg, strlen(message), &consumed);
+
+  if (!consumed)
+    g_free(msg);
+  return status;
+}
+
+static void
+_assert_mock_output(LogTransport *transport, const gchar *expected)
+{
+  gchar output[16384] = { 0 };
+
+  gssize len = log_transport_mock_read_from_write_buffer((LogTransportMock *) transport, output, sizeof(output));
+  cr_assert_eq(len, strlen(expected), "unexpected output length: %" G_GSSIZE_FORMAT ", output: %.*s",
+               len, (gint) len, output);
+  cr_assert_str_eq(output, expected);
+}
+
+Test(log_proto, test_text_client_writes_messages_in_batches)
+{
+  LogTransport *transport = log_transport_mock_stream_new(NULL, 0);
+  LogProtoClient *proto = _construct_client(log_proto_text_client_new, transport);
+
+  cr_assert_eq(_post_message(proto, "foo\n"), LPS_SUCCESS);
+  cr_assert_eq(_post_message(proto, "bar\n"), LPS_SUCCESS);
+
+  /* nothing is written until the batch is flushed */
+  _assert_mock_output(transport, "");
+  cr_assert_eq(messages_acked, 0);
+
+  cr_assert_eq(log_proto_client_flush(proto), LPS_SUCCESS);
+  _assert_mock_output(transport, "foo\nbar\n");
+  cr_assert_eq(messages_acked, 2);
+
+  log_proto_client_free(proto);
+}
+
+Test(log_proto, test_text_client_flushes_automatically_when_the_batch_is_full)
+{
+  LogTransport *transport = log_transport_mock_stream_new(NULL, 0);
+  LogProtoClient *proto = _construct_client(log_proto_text_client_new, transport);
+  GString *expected = g_string_new("");
+
+  for (gint i = 0; i < LOG_PROTO_TEXT_CLIENT_BATCH_MAX; i++)
+    {
+      cr_assert_eq(_post_message(proto, "msg\n"), LPS_SUCCESS);
+      g_string_append(expected, "msg\n");
+    }
+
+  _assert_mock_output(transport, expected->str);
+  cr_assert_eq(messages_acked, LOG_PROTO_TEXT_CLIENT_BATCH_MAX);
+
+  g_string_free(expected, TRUE);
+  log_proto_client_free(proto);
+}
+
+Test(log_proto, test_framed_client_sends_frame_headers_with_the_messages)
+{
+  LogTransport *transport = log_transport_mock_stream_new(NULL, 0);
+  LogProtoClient *proto = _construct_client(log_proto_framed_client_new, transport);
+
+  cr_assert_eq(_post_message(proto, "foo"), LPS_SUCCESS);
+  cr_assert_eq(_post_message(proto, "barbaz"), LPS_SUCCESS);
+  cr_assert_eq(log_proto_client_flush(proto), LPS_SUCCESS);
+
+  _assert_mock_output(transport, "3 foo6 barbaz");
+  cr_assert_eq(messages_acked, 2);
+
+  log_proto_client_free(proto);
+}
+
+Test(log_proto, test_framed_client_partial_writes_keep_framing_and_acks_intact)
+{
+  LogTransport *transport = log_transport_mock_stream_new(NULL, 0);
+  LogProtoClient *proto = _construct_client(log_proto_framed_client_new, transport);
+
+  log_transport_mock_set_write_chunk_limit((LogTransportMock *) transport, 4);
+
+  cr_assert_eq(_post_message(proto, "foo"), LPS_SUCCESS);
+  cr_assert_eq(_post_message(proto, "barbaz"), LPS_SUCCESS);
+  cr_assert_eq(_post_message(proto, "x"), LPS_SUCCESS);
+
+  /* "3 fo" is written, nothing is acked yet */
+  cr_assert_eq(log_proto_client_flush(proto), LPS_PARTIAL);
+  cr_assert_eq(messages_acked, 0);
+
+  /* new messages are not accepted while the rest of the batch is pending */
+  gboolean consumed = TRUE;
+  guchar *msg = (guchar *) g_strdup("qux");
+  cr_assert_eq(log_proto_client_post(proto, NULL, msg, 3, &consumed), LPS_PARTIAL);
+  cr_assert_not(consumed);
+  g_free(msg);
+
+  LogProtoStatus status;
+  while ((status = log_proto_client_flush(proto)) == LPS_PARTIAL)
+    cr_assert_lt(messages_acked, 3);
+  cr_assert_eq(status, LPS_SUCCESS);
+
+  _assert_mock_output(transport, "3 foo6 barbaz1 x");
+  cr_assert_eq(messages_acked, 3);
+  cr_assert_eq(rewinds, 0);
+
+  log_proto_client_free(proto);
+}
+
+Test(log_proto, test_text_client_acks_only_fully_written_messages)
+{
+  LogTransport *transport = log_transport_mock_stream_new(NULL, 0);
+  LogProtoClient *proto = _construct_client(log_proto_text_client_new, transport);
+
+  log_transport_mock_set_write_chunk_limit((LogTransportMock *) transport, 6);
+
+  cr_assert_eq(_post_message(proto, "foo\n"), LPS_SUCCESS);
+  cr_assert_eq(_post_message(proto, "bar\n"), LPS_SUCCESS);
+
+  /* "foo\n" and half of "bar\n" is written */
+  cr_assert_eq(log_proto_client_flush(proto), LPS_PARTIAL);
+  cr_assert_eq(messages_acked, 1);
+
+  cr_assert_eq(log_proto_client_flush(proto), LPS_SUCCESS);
+  cr_assert_eq(messages_acked, 2);
+  _assert_mock_output(transport, "foo\nbar\n");
+
+  log_proto_client_free(proto);
+}
+
+Test(log_proto, test_text_client_rewinds_on_write_errors)
+{
+  gint fds[2];
+
+  /* writing the read end of a pipe fails with EBADF */
+  cr_assert_eq(pipe(fds), 0);
+
+  LogTransport *transport = log_transport_stream_socket_new(fds[0]);
+  LogProtoClient *proto = _construct_client(log_proto_text_client_new, transport);
+
+  cr_assert_eq(_post_message(proto, "foo\n"), LPS_SUCCESS);
+  cr_assert_eq(log_proto_client_flush(proto), LPS_ERROR);
+  cr_assert_eq(messages_acked, 0);
+  cr_assert_eq(rewinds, 1);
+
+  log_proto_client_free(proto);
+  close(fds[1]);
+}
+
+Test(log_proto, test_framed_client_on_stream_socket_uses_writev)
+{
+  gint fds[2];
+  gchar buf[1024] = { 0 };
+
+  cr_assert_eq(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+
+  LogTransport *transport = log_transport_stream_socket_new(fds[1]);
+  LogProtoClient *proto = _construct_client(log_proto_framed_client_new, transport);
+
+  cr_assert_eq(_post_message(proto, "foo"), LPS_SUCCESS);
+  cr_assert_eq(_post_message(proto, "bar"), LPS_SUCCESS);
+  cr_assert_eq(log_proto_client_flush(proto), LPS_SUCCESS);
+  cr_assert_eq(messages_acked, 2);
+
+  cr_assert_eq(read(fds[0], buf, sizeof(buf)), 10);
+  cr_assert_str_eq(buf, "3 foo3 bar");
+
+  log_proto_client_free(proto);
+  close(fds[0]);
+}
+
+Test(log_proto, test_text_client_sends_one_datagram_per_message)
+{
+  gint fds[2];
+
+  cr_assert_eq(socketpair(AF_UNIX, SOCK_DGRAM, 0, fds), 0);
+
+  LogTransport *transport = log_transport_dgram_socket_new(fds[1]);
+  LogProtoClient *proto = _construct_client(log_proto_text_client_new, transport);
+
+  for (gint i = 0; i < 10; i++)
+    {
+      gchar message[32];
+
+      g_snprintf(message, sizeof(message), "datagram %d", i);
+      cr_assert_eq(_post_message(proto, message), LPS_SUCCESS);
+    }
+  cr_assert_eq(log_proto_client_flush(proto), LPS_SUCCESS);
+  cr_assert_eq(messages_acked, 10);
+
+  for (gint i = 0; i < 10; i++)
+    {
+      gchar expected[32];
+      gchar buf[1024];
+
+      g_snprintf(expected, sizeof(expected), "datagram %d", i);
+      gssize len = recv(fds[0], buf, sizeof(buf), 0);
+      cr_assert_eq(len, strlen(expected));
+      cr_assert_eq(memcmp(buf, expected, len), 0, "unexpected datagram: %.*s, expected: %s", (gint) len, buf, expected);
+    }
+
+  log_proto_client_free(proto);
+  close(fds[0]);
+}
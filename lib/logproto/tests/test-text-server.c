@@ -29,7 +29,9 @@
 #include "libtest/grab-logging.h"
 
 #include "logproto/logproto-text-server.h"
+#include "logproto/logproto-buffer-pool.h"
 #include "ack-tracker/ack_tracker_factory.h"
+#include "apphook.h"
 
 #include <errno.h>
 
@@ -621,6 +623,53 @@ Test(log_proto, test_log_proto_text_server_rewinding_the_initial_line_results_in
   test_log_proto_text_server_rewinding_the_initial_line_results_in_an_empty_message(log_transport_mock_records_new);
 }
 
+static GString *
+_generate_short_lines(gint num_lines)
+{
+  GString *lines = g_string_new("");
+
+  for (gint i = 0; i < num_lines; i++)
+    g_string_append_printf(lines, "%03d line\n", i);
+  return lines;
+}
+
+static void
+test_log_proto_text_server_splits_buffers_with_more_lines_than_the_eol_cache(MultiLineLogic *multi_line)
+{
+  const gint num_lines = LOG_PROTO_TEXT_SERVER_EOL_CACHE_SIZE * 3 + 5;
+  GString *lines = _generate_short_lines(num_lines);
+  LogProtoServer *proto;
+
+  proto_server_options.max_msg_size = lines->len + 1;
+  proto = log_proto_text_server_new(log_transport_mock_records_new(lines->str, lines->len, LTM_EOF),
+                                    get_inited_proto_server_options());
+  ((LogProtoTextServer *) proto)->multi_line = multi_line;
+
+  for (gint i = 0; i < num_lines; i++)
+    {
+      gchar expected[16];
+
+      g_snprintf(expected, sizeof(expected), "%03d line", i);
+      assert_proto_server_fetch(proto, expected, -1);
+    }
+
+  log_proto_server_free(proto);
+  g_string_free(lines, TRUE);
+}
+
+Test(log_proto, test_log_proto_text_server_splits_buffers_with_more_lines_than_the_eol_cache)
+{
+  MultiLineLogic *multi_line = g_new0(MultiLineLogic, 1);
+
+  test_log_proto_text_server_splits_buffers_with_more_lines_than_the_eol_cache(NULL);
+
+  /* every second line is rewound, which pushes back line terminators at the cache boundaries too */
+  accumulate_seq = 0;
+  multi_line_logic_init_instance(multi_line);
+  multi_line->accumulate_line = accumulator_delay_lines;
+  test_log_proto_text_server_splits_buffers_with_more_lines_than_the_eol_cache(multi_line);
+}
+
 Test(log_proto, test_log_proto_text_server_io_eagain)
 {
   LogProtoServer *proto;
@@ -674,3 +723,92 @@ Test(log_proto, buffer_split_with_encoding_and_position_tracking)
   g_string_free(data_smaller, TRUE);
   g_string_free(data, TRUE);
 }
+
+Test(log_proto, test_log_proto_text_server_grows_its_buffer_for_long_lines)
+{
+  gchar *long_line = g_strnfill(3 * LOG_PROTO_BUFFERED_SERVER_MIN_BUFFER_SIZE, 'x');
+  gchar *payload = g_strconcat(long_line, "\nfoo\n", NULL);
+
+  proto_server_options.max_msg_size = 8 * LOG_PROTO_BUFFERED_SERVER_MIN_BUFFER_SIZE;
+  LogProtoServer *proto = log_proto_text_server_new(log_transport_mock_stream_new(payload, -1, LTM_EOF),
+                                                    get_inited_proto_server_options());
+
+  assert_proto_server_fetch(proto, long_line, -1);
+  cr_assert_gt(log_proto_server_get_buffer_bytes(proto), strlen(long_line));
+  cr_assert_leq(log_proto_server_get_buffer_bytes(proto), proto_server_options.init_buffer_size);
+  assert_proto_server_fetch(proto, "foo", -1);
+  assert_proto_server_fetch_failure(proto, LPS_EOF, NULL);
+
+  log_proto_server_free(proto);
+  g_free(payload);
+  g_free(long_line);
+}
+
+Test(log_proto, test_log_proto_text_server_releases_its_buffer_while_idle)
+{
+  proto_server_options.max_msg_size = 8 * LOG_PROTO_BUFFERED_SERVER_MIN_BUFFER_SIZE;
+  LogProtoServer *proto = log_proto_text_server_new(log_transport_mock_stream_new(
+                                                      "foo\n", -1,
+                                                      LTM_INJECT_ERROR(EAGAIN),
+                                                      "bar", -1,
+                                                      LTM_INJECT_ERROR(EAGAIN),
+                                                      "\n", -1,
+                                                      LTM_EOF),
+                                                    get_inited_proto_server_options());
+
+  Bookmark bookmark;
+  LogTransportAuxData aux;
+  gboolean may_read = TRUE;
+  const guchar *msg = NULL;
+  gsize msg_len;
+
+  log_transport_aux_data_init(&aux);
+  cr_assert_eq(log_proto_server_fetch(proto, &msg, &msg_len, &may_read, &aux, &bookmark), LPS_SUCCESS);
+  cr_assert_eq(msg_len, 3);
+  cr_assert_eq(log_proto_server_get_buffer_bytes(proto), LOG_PROTO_BUFFERED_SERVER_MIN_BUFFER_SIZE);
+
+  /* nothing is buffered, the buffer is returned to the pool */
+  cr_assert_eq(log_proto_server_fetch(proto, &msg, &msg_len, &may_read, &aux, &bookmark), LPS_AGAIN);
+  cr_assert_eq(log_proto_server_get_buffer_bytes(proto), 0);
+  cr_assert_geq(log_proto_buffer_pool_get_pooled_bytes(), LOG_PROTO_BUFFERED_SERVER_MIN_BUFFER_SIZE);
+
+  /* a partial line keeps the buffer */
+  msg = NULL;
+  cr_assert_eq(log_proto_server_fetch(proto, &msg, &msg_len, &may_read, &aux, &bookmark), LPS_AGAIN);
+  cr_assert_null(msg);
+  cr_assert_eq(log_proto_server_get_buffer_bytes(proto), LOG_PROTO_BUFFERED_SERVER_MIN_BUFFER_SIZE);
+
+  cr_assert_eq(log_proto_server_fetch(proto, &msg, &msg_len, &may_read, &aux, &bookmark), LPS_SUCCESS);
+  cr_assert_eq(msg_len, 3);
+  cr_assert_arr_eq(msg, "bar", 3);
+
+  log_proto_server_free(proto);
+}
+
+static gpointer
+_release_buffer_on_a_thread(gpointer user_data)
+{
+  app_thread_start();
+  log_proto_buffer_pool_release(user_data, LOG_PROTO_BUFFER_POOL_MIN_SIZE);
+  app_thread_stop();
+  return NULL;
+}
+
+Test(log_proto, test_log_proto_buffer_pool_caches_released_buffers_per_thread)
+{
+  guchar *buffer = log_proto_buffer_pool_acquire(LOG_PROTO_BUFFER_POOL_MIN_SIZE);
+  gsize pooled_bytes = log_proto_buffer_pool_get_pooled_bytes();
+
+  /* reacquired from the cache of the releasing thread */
+  log_proto_buffer_pool_release(buffer, LOG_PROTO_BUFFER_POOL_MIN_SIZE);
+  cr_assert_eq(log_proto_buffer_pool_get_pooled_bytes(), pooled_bytes + LOG_PROTO_BUFFER_POOL_MIN_SIZE);
+  cr_assert_eq(log_proto_buffer_pool_acquire(LOG_PROTO_BUFFER_POOL_MIN_SIZE), buffer);
+  cr_assert_eq(log_proto_buffer_pool_get_pooled_bytes(), pooled_bytes);
+
+  /* the cache of an exiting thread is moved to the global pool */
+  g_thread_join(g_thread_new("release", _release_buffer_on_a_thread, buffer));
+  cr_assert_eq(log_proto_buffer_pool_get_pooled_bytes(), pooled_bytes + LOG_PROTO_BUFFER_POOL_MIN_SIZE);
+  cr_assert_eq(log_proto_buffer_pool_acquire(LOG_PROTO_BUFFER_POOL_MIN_SIZE), buffer);
+
+  log_proto_buffer_pool_release(buffer, LOG_PROTO_BUFFER_POOL_MIN_SIZE);
+}
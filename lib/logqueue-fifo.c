@@ -45,27 +45,33 @@ QueueType log_queue_fifo_type = "FIFO";
  *
  *   - has a per-thread, unlocked input queue where threads can put their items
  *
- *   - has a locked wait-queue where items go once the per-thread input
- *     would be overflown or if the input thread goes to sleep (e.g.  one
- *     lock acquisition per a longer period)
+ *   - has a lock-free, multi-producer/single-consumer wait-queue where
+ *     items go in batches once the per-thread input would be overflown or
+ *     if the input thread goes to sleep
  *
  *   - has an unlocked output queue where items from the wait queue go, once
  *     it becomes depleted.
  *
  * This means that items flow in this sequence from one list to the next:
  *
- *    input queue (per-thread) -> wait queue (locked) -> output queue (single-threaded)
+ *    input queue (per-thread) -> wait queue (lock-free) -> output queue (single-threaded)
  *
  * Fastpath is:
  *   - input threads putting elements on their per-thread queue (lockless)
  *   - output threads removing elements from the output queue (lockless)
  *
  * Slowpath:
- *   - input queue is overflown (or the input thread goes to sleep), wait
- *     queue mutex is grabbed, all elements are put to the wait queue.
+ *   - input queue is overflown (or the input thread goes to sleep), all
+ *     elements are wrapped into a batch, which is pushed to the wait queue
+ *     using a single compare-and-exchange.
  *
- *   - output queue is depleted, wait queue mutex is grabbed, all elements
- *     on the wait queue is put to the output queue
+ *   - output queue is depleted, the output thread detaches all batches
+ *     from the wait queue using compare-and-exchange and splices them to
+ *     the output queue in their original order.
+ *
+ *   - LogQueue->lock is only taken by input threads when the output thread
+ *     is waiting for items (e.g. parallel_push_notify is set) in order to
+ *     wake it up.
  *
  * Threading assumptions:
  *   - the head of the queue is only manipulated from the output thread
@@ -89,13 +95,44 @@ typedef struct _OverflowQueue
   gint non_flow_controlled_len;
 } OverflowQueue;
 
+typedef struct _WaitQueueBatch WaitQueueBatch;
+struct _WaitQueueBatch
+{
+  WaitQueueBatch *next;
+  struct iv_list_head items;
+  gint len;
+  gint non_flow_controlled_len;
+};
+
+/*
+ * Intrusive lock-free stack of batches, pushed by any number of input
+ * threads and drained (all at once) by the output thread.  Since the
+ * consumer always detaches the complete stack, it is not prone to the ABA
+ * problem.
+ *
+ * Messages pushed one by one (the slow path of log_queue_fifo_push_tail())
+ * don't get a WaitQueueBatch, their LogMessageQueueNode is pushed
+ * directly, tagged with WAIT_QUEUE_NODE_TAG.  While on the stack, the
+ * "next" link of such a node is stored in node->list.next.
+ *
+ * The lengths are updated _before_ a batch is pushed, so that they never
+ * go negative: a racy reader may see a few items which are not yet
+ * available for popping, but never the other way around.
+ */
+typedef struct _WaitQueue
+{
+  gpointer entries;
+  atomic_gssize len;
+  atomic_gssize non_flow_controlled_len;
+} WaitQueue;
+
 typedef struct _LogQueueFifo
 {
   LogQueue super;
 
   /* scalable qoverflow implementation */
   OverflowQueue output_queue;
-  OverflowQueue wait_queue;
+  WaitQueue wait_queue;
   OverflowQueue backlog_queue; /* entries that were sent but not acked yet */
 
   gint log_fifo_size;
@@ -131,18 +168,150 @@ iv_list_update_msg_size(LogQueueFifo *self, struct iv_list_head *head)
   }
 }
 
+#define WAIT_QUEUE_NODE_TAG 0x1
+
+static inline gboolean
+_wait_queue_entry_is_node(gpointer entry)
+{
+  return (GPOINTER_TO_SIZE(entry) & WAIT_QUEUE_NODE_TAG) != 0;
+}
+
+static inline LogMessageQueueNode *
+_wait_queue_entry_get_node(gpointer entry)
+{
+  return (LogMessageQueueNode *) GSIZE_TO_POINTER(GPOINTER_TO_SIZE(entry) & ~WAIT_QUEUE_NODE_TAG);
+}
+
+static inline gpointer *
+_wait_queue_entry_next(gpointer entry)
+{
+  if (_wait_queue_entry_is_node(entry))
+    return (gpointer *) &_wait_queue_entry_get_node(entry)->list.next;
+  return (gpointer *) &((WaitQueueBatch *) entry)->next;
+}
+
+static void
+_wait_queue_push_entry(WaitQueue *self, gpointer entry, gint len, gint non_flow_controlled_len)
+{
+  gpointer *next = _wait_queue_entry_next(entry);
+  gpointer head;
+
+  atomic_gssize_add(&self->len, len);
+  atomic_gssize_add(&self->non_flow_controlled_len, non_flow_controlled_len);
+
+  do
+    {
+      head = g_atomic_pointer_get(&self->entries);
+      *next = head;
+    }
+  while (!g_atomic_pointer_compare_and_exchange(&self->entries, head, entry));
+}
+
+static void
+_wait_queue_push_batch(WaitQueue *self, WaitQueueBatch *batch)
+{
+  _wait_queue_push_entry(self, batch, batch->len, batch->non_flow_controlled_len);
+}
+
+static void
+_wait_queue_push_node(WaitQueue *self, LogMessageQueueNode *node)
+{
+  gpointer entry = GSIZE_TO_POINTER(GPOINTER_TO_SIZE(node) | WAIT_QUEUE_NODE_TAG);
+
+  _wait_queue_push_entry(self, entry, 1, node->flow_control_requested ? 0 : 1);
+}
+
+/* detaches all entries and returns them in the order they were pushed */
+static gpointer
+_wait_queue_steal_entries(WaitQueue *self)
+{
+  gpointer head, fifo = NULL;
+
+  do
+    {
+      head = g_atomic_pointer_get(&self->entries);
+    }
+  while (head && !g_atomic_pointer_compare_and_exchange(&self->entries, head, NULL));
+
+  while (head)
+    {
+      gpointer *next = _wait_queue_entry_next(head);
+      gpointer following = *next;
+
+      *next = fifo;
+      fifo = head;
+      head = following;
+    }
+  return fifo;
+}
+
+/*
+ * Moves the items of a detached entry to @items, returns the next entry.
+ * Batches are freed, nodes are linked into @items.
+ */
+static gpointer
+_wait_queue_entry_splice(gpointer entry, struct iv_list_head *items, gint *len, gint *non_flow_controlled_len)
+{
+  gpointer next = *_wait_queue_entry_next(entry);
+
+  if (_wait_queue_entry_is_node(entry))
+    {
+      LogMessageQueueNode *node = _wait_queue_entry_get_node(entry);
+
+      iv_list_add_tail(&node->list, items);
+      *len = 1;
+      *non_flow_controlled_len = node->flow_control_requested ? 0 : 1;
+    }
+  else
+    {
+      WaitQueueBatch *batch = (WaitQueueBatch *) entry;
+
+      iv_list_splice_tail(&batch->items, items);
+      *len = batch->len;
+      *non_flow_controlled_len = batch->non_flow_controlled_len;
+      g_free(batch);
+    }
+  return next;
+}
+
+static WaitQueueBatch *
+_wait_queue_batch_new(void)
+{
+  WaitQueueBatch *batch = g_new0(WaitQueueBatch, 1);
+
+  INIT_IV_LIST_HEAD(&batch->items);
+  return batch;
+}
+
 static gint64
 log_queue_fifo_get_length(LogQueue *s)
 {
   LogQueueFifo *self = (LogQueueFifo *) s;
 
-  return self->wait_queue.len + self->output_queue.len;
+  return atomic_gssize_get(&self->wait_queue.len) + self->output_queue.len;
 }
 
 static gint64
 log_queue_fifo_get_non_flow_controlled_length(LogQueueFifo *self)
 {
-  return self->wait_queue.non_flow_controlled_len + self->output_queue.non_flow_controlled_len;
+  return atomic_gssize_get(&self->wait_queue.non_flow_controlled_len) + self->output_queue.non_flow_controlled_len;
+}
+
+/*
+ * Wake up the output thread if it is waiting for items.  The output thread
+ * publishes parallel_push_notify and then rechecks the queue length in
+ * log_queue_check_items(), while we have updated the length before getting
+ * here, so at least one of us notices the other one.
+ */
+static void
+_notify_output_thread(LogQueueFifo *self)
+{
+  if (!g_atomic_pointer_get(&self->super.parallel_push_notify))
+    return;
+
+  g_mutex_lock(&self->super.lock);
+  log_queue_push_notify(&self->super);
+  g_mutex_unlock(&self->super.lock);
 }
 
 gboolean
@@ -243,34 +412,40 @@ log_queue_fifo_calculate_num_of_messages_to_drop(LogQueueFifo *self, InputQueue
   return TRUE;
 }
 
-/* move items from the per-thread input queue to the lock-protected "wait" queue */
+/* move items from the per-thread input queue to the lock-free "wait" queue */
 static void
 log_queue_fifo_move_input_unlocked(LogQueueFifo *self, gint thread_index)
 {
+  InputQueue *input_queue = &self->input_queues[thread_index];
   gint num_of_messages_to_drop;
-  gboolean drop_messages = log_queue_fifo_calculate_num_of_messages_to_drop(self, &self->input_queues[thread_index],
+  gboolean drop_messages = log_queue_fifo_calculate_num_of_messages_to_drop(self, input_queue,
                            &num_of_messages_to_drop);
 
   if (drop_messages)
     {
       /* slow path, the input thread's queue would overflow the queue, let's drop some messages */
-      log_queue_fifo_drop_messages_from_input_queue(self, &self->input_queues[thread_index], num_of_messages_to_drop);
+      log_queue_fifo_drop_messages_from_input_queue(self, input_queue, num_of_messages_to_drop);
     }
 
-  log_queue_queued_messages_add(&self->super, self->input_queues[thread_index].len);
-  iv_list_update_msg_size(self, &self->input_queues[thread_index].items);
+  if (input_queue->len == 0)
+    return;
+
+  log_queue_queued_messages_add(&self->super, input_queue->len);
+  iv_list_update_msg_size(self, &input_queue->items);
 
-  iv_list_splice_tail_init(&self->input_queues[thread_index].items, &self->wait_queue.items);
-  self->wait_queue.len += self->input_queues[thread_index].len;
-  self->wait_queue.non_flow_controlled_len += self->input_queues[thread_index].non_flow_controlled_len;
-  self->input_queues[thread_index].len = 0;
-  self->input_queues[thread_index].non_flow_controlled_len = 0;
+  WaitQueueBatch *batch = _wait_queue_batch_new();
+  iv_list_splice_tail_init(&input_queue->items, &batch->items);
+  batch->len = input_queue->len;
+  batch->non_flow_controlled_len = input_queue->non_flow_controlled_len;
+  input_queue->len = 0;
+  input_queue->non_flow_controlled_len = 0;
+
+  _wait_queue_push_batch(&self->wait_queue, batch);
 }
 
-/* move items from the per-thread input queue to the lock-protected
- * "wait" queue, but grabbing locks first. This is registered as a
- * callback to be called when the input worker thread finishes its
- * job.
+/* move items from the per-thread input queue to the "wait" queue and wake
+ * up the output thread if needed. This is registered as a callback to be
+ * called when the input worker thread finishes its job.
  */
 static gpointer
 log_queue_fifo_move_input(gpointer user_data)
@@ -281,16 +456,14 @@ log_queue_fifo_move_input(gpointer user_data)
   thread_index = main_loop_worker_get_thread_index();
   g_assert(thread_index >= 0);
 
-  g_mutex_lock(&self->super.lock);
   log_queue_fifo_move_input_unlocked(self, thread_index);
-  log_queue_push_notify(&self->super);
-  g_mutex_unlock(&self->super.lock);
+  _notify_output_thread(self);
   self->input_queues[thread_index].finish_cb_registered = FALSE;
   log_queue_unref(&self->super);
   return NULL;
 }
 
-/* lock must be held */
+/* racy, see log_queue_fifo_calculate_num_of_messages_to_drop() */
 static inline gboolean
 _message_has_to_be_dropped(LogQueueFifo *self, const LogPathOptions *path_options)
 {
@@ -364,14 +537,11 @@ log_queue_fifo_push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *pat
       return;
     }
 
-  /* slow path, put the pending item and the whole input queue to the wait_queue */
-
-  g_mutex_lock(&self->super.lock);
+  /* slow path, put the pending item to the wait_queue as a batch of its own */
 
   if (_message_has_to_be_dropped(self, path_options))
     {
       log_queue_dropped_messages_inc(&self->super);
-      g_mutex_unlock(&self->super.lock);
 
       log_msg_drop(msg, path_options, AT_PROCESSED);
 
@@ -385,17 +555,12 @@ log_queue_fifo_push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *pat
   log_msg_write_protect(msg);
   node = log_msg_alloc_queue_node(msg, path_options);
 
-  iv_list_add_tail(&node->list, &self->wait_queue.items);
-  self->wait_queue.len++;
-
-  if (!path_options->flow_control_requested)
-    self->wait_queue.non_flow_controlled_len++;
-
-  log_queue_push_notify(&self->super);
   log_queue_queued_messages_inc(&self->super);
-
   log_queue_memory_usage_add(&self->super, log_msg_get_size(msg));
-  g_mutex_unlock(&self->super.lock);
+
+  /* pushed without a WaitQueueBatch, so this path doesn't allocate */
+  _wait_queue_push_node(&self->wait_queue, node);
+  _notify_output_thread(self);
 
   log_msg_unref(msg);
 }
@@ -407,13 +572,20 @@ static inline void
 _move_items_from_wait_queue_to_output_queue(LogQueueFifo *self)
 {
   /* slow path, output queue is empty, get some elements from the wait queue */
-  g_mutex_lock(&self->super.lock);
-  iv_list_splice_tail_init(&self->wait_queue.items, &self->output_queue.items);
-  self->output_queue.len = self->wait_queue.len;
-  self->output_queue.non_flow_controlled_len = self->wait_queue.non_flow_controlled_len;
-  self->wait_queue.len = 0;
-  self->wait_queue.non_flow_controlled_len = 0;
-  g_mutex_unlock(&self->super.lock);
+  gpointer entry = _wait_queue_steal_entries(&self->wait_queue);
+
+  while (entry)
+    {
+      gint len, non_flow_controlled_len;
+
+      entry = _wait_queue_entry_splice(entry, &self->output_queue.items, &len, &non_flow_controlled_len);
+
+      /* increment first, so that racy readers never see fewer items than we have */
+      self->output_queue.len += len;
+      self->output_queue.non_flow_controlled_len += non_flow_controlled_len;
+      atomic_gssize_sub(&self->wait_queue.len, len);
+      atomic_gssize_sub(&self->wait_queue.non_flow_controlled_len, non_flow_controlled_len);
+    }
 }
 
 /*
@@ -653,7 +825,13 @@ log_queue_fifo_free(LogQueue *s)
       log_queue_fifo_free_queue(&self->input_queues[i].items);
     }
 
-  log_queue_fifo_free_queue(&self->wait_queue.items);
+  gpointer entry = _wait_queue_steal_entries(&self->wait_queue);
+  while (entry)
+    {
+      gint len, non_flow_controlled_len;
+
+      entry = _wait_queue_entry_splice(entry, &self->output_queue.items, &len, &non_flow_controlled_len);
+    }
   log_queue_fifo_free_queue(&self->output_queue.items);
   log_queue_fifo_free_queue(&self->backlog_queue.items);
 
@@ -699,7 +877,6 @@ log_queue_fifo_new(gint log_fifo_size, const gchar *persist_name, gint stats_lev
       self->input_queues[i].cb.func = log_queue_fifo_move_input;
       self->input_queues[i].cb.user_data = self;
     }
-  INIT_IV_LIST_HEAD(&self->wait_queue.items);
   INIT_IV_LIST_HEAD(&self->output_queue.items);
   INIT_IV_LIST_HEAD(&self->backlog_queue.items);
 
@@ -163,11 +163,22 @@ log_queue_check_items(LogQueue *self, gint *timeout, LogQueuePushNotifyFunc para
   num_elements = log_queue_get_length(self);
   if (num_elements == 0)
     {
-      self->parallel_push_notify = parallel_push_notify;
       self->parallel_push_data = user_data;
       self->parallel_push_data_destroy = user_data_destroy;
-      g_mutex_unlock(&self->lock);
-      return FALSE;
+
+      /* Some implementations (e.g. LogQueueFifo) push items without
+       * holding self->lock and only check parallel_push_notify
+       * afterwards.  Publish the callback with a full barrier and recheck
+       * the length, so that either they see the callback or we see their
+       * items. */
+      g_atomic_pointer_set(&self->parallel_push_notify, parallel_push_notify);
+      num_elements = log_queue_get_length(self);
+      if (num_elements == 0)
+        {
+          g_mutex_unlock(&self->lock);
+          return FALSE;
+        }
+      self->parallel_push_data_destroy = NULL;
     }
 
   /* consume the user_data reference as we won't use the callback */
@@ -253,12 +264,14 @@ _register_shared_counters(LogQueue *self, gint stats_level, StatsClusterKeyBuild
 
   stats_lock();
   {
-    stats_register_counter(stats_level, self->metrics.shared.output_events_sc_key, SC_TYPE_QUEUED,
-                           &self->metrics.shared.queued_messages);
-    stats_register_counter(stats_level, self->metrics.shared.output_events_sc_key, SC_TYPE_DROPPED,
-                           &self->metrics.shared.dropped_messages);
-    stats_register_counter(stats_level, self->metrics.shared.memory_usage_sc_key, SC_TYPE_SINGLE_VALUE,
-                           &self->metrics.shared.memory_usage);
+    /* shared counters are updated by the queues of all destinations
+     * using the same key, e.g. by every connection of a network destination */
+    stats_register_sharded_counter(stats_level, self->metrics.shared.output_events_sc_key, SC_TYPE_QUEUED,
+                                   &self->metrics.shared.queued_messages);
+    stats_register_sharded_counter(stats_level, self->metrics.shared.output_events_sc_key, SC_TYPE_DROPPED,
+                                   &self->metrics.shared.dropped_messages);
+    stats_register_sharded_counter(stats_level, self->metrics.shared.memory_usage_sc_key, SC_TYPE_SINGLE_VALUE,
+                                   &self->metrics.shared.memory_usage);
   }
   stats_unlock();
 }
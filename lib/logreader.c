@@ -178,6 +178,20 @@ log_reader_force_check_in_next_poll(LogReader *self)
     }
 }
 
+static inline gboolean
+log_reader_is_owner_thread(LogReader *self)
+{
+  return threads_equal(self->owner_thread, get_thread_id());
+}
+
+static inline void
+log_reader_assert_owner_thread(LogReader *self)
+{
+#if SYSLOG_NG_ENABLE_DEBUG
+  g_assert(log_reader_is_owner_thread(self));
+#endif
+}
+
 static void
 log_reader_wakeup_triggered(gpointer s)
 {
@@ -188,7 +202,7 @@ log_reader_wakeup_triggered(gpointer s)
       /* NOTE: by the time working is set to FALSE we're over an
        * update_watches call.  So it is called either here (when
        * work_finished has done its work) or from work_finished above. The
-       * two are not racing as both run in the main thread
+       * two are not racing as both run in the owner thread
        */
       log_reader_update_watches(self);
     }
@@ -207,7 +221,7 @@ log_reader_wakeup(LogSource *s)
    *
    * This happens when log_writer_deinit() flushes its output queue
    * after the reader which produced the message has already been
-   * deinited. Since init/deinit calls are made in the main thread, no
+   * deinited. Since init/deinit calls are made in the owner thread, no
    * locking is needed.
    *
    */
@@ -237,9 +251,9 @@ log_reader_apply_proto_and_poll_events(LogReader *self, LogProtoServer *proto, P
 }
 
 
-/* run in the main thread in reaction to a log_reader_reopen to change
- * the source LogProtoServer instance. It needs to be ran in the main
- * thread as it reregisters the watches associated with the main
+/* run in the owner thread in reaction to a log_reader_reopen to change
+ * the source LogProtoServer instance. It needs to be ran in the owner
+ * thread as it reregisters the watches associated with the owner
  * thread. */
 void
 log_reader_close_proto_deferred(gpointer s)
@@ -257,21 +271,39 @@ log_reader_close_proto_deferred(gpointer s)
   log_reader_start_watches(self);
 }
 
+/* the watches belong to the event loop of the owner thread, which is not
+ * necessarily the main thread (e.g. with accept-threads()) */
+static void
+log_reader_close_proto_request_triggered(gpointer s)
+{
+  LogReader *self = (LogReader *) s;
+
+  g_mutex_lock(&self->pending_close_lock);
+  log_reader_close_proto_deferred(self);
+  self->pending_close_request = FALSE;
+  g_cond_signal(&self->pending_close_cond);
+  g_mutex_unlock(&self->pending_close_lock);
+}
+
 void
 log_reader_close_proto(LogReader *self)
 {
   g_assert(self->watches_running);
-  main_loop_call((MainLoopTaskFunc) log_reader_close_proto_deferred, self, TRUE);
 
-  if (!main_loop_is_main_thread())
+  if (log_reader_is_owner_thread(self))
     {
-      g_mutex_lock(&self->pending_close_lock);
-      while (self->pending_close)
-        {
-          g_cond_wait(&self->pending_close_cond, &self->pending_close_lock);
-        }
-      g_mutex_unlock(&self->pending_close_lock);
+      log_reader_close_proto_deferred(self);
+      return;
     }
+
+  g_mutex_lock(&self->pending_close_lock);
+  self->pending_close_request = TRUE;
+  iv_event_post(&self->close_proto_requested);
+  while (self->pending_close_request || self->pending_close)
+    {
+      g_cond_wait(&self->pending_close_cond, &self->pending_close_lock);
+    }
+  g_mutex_unlock(&self->pending_close_lock);
 }
 
 void
@@ -299,7 +331,7 @@ log_reader_update_watches(LogReader *self)
   GIOCondition cond;
   gint idle_timeout = -1;
 
-  main_loop_assert_main_thread();
+  log_reader_assert_owner_thread(self);
   g_assert(self->watches_running);
 
   log_reader_disable_watches(self);
@@ -353,7 +385,7 @@ log_reader_update_watches(LogReader *self)
 static inline gboolean
 log_reader_work_in_progress(LogReader *self)
 {
-  main_loop_assert_main_thread();
+  log_reader_assert_owner_thread(self);
 
   return self->io_job.working;
 }
@@ -363,7 +395,7 @@ log_reader_set_work_in_progress(LogReader *self, gboolean state)
 {
   if ((self->options->flags & LR_THREADED) == 0)
     {
-      main_loop_assert_main_thread();
+      log_reader_assert_owner_thread(self);
       self->io_job.working = state;
     }
 }
@@ -399,7 +431,7 @@ log_reader_work_finished(void *s, gpointer arg)
 
   if (self->pending_close)
     {
-      /* pending proto is only set in the main thread, so no need to
+      /* pending proto is only set in the owner thread, so no need to
        * lock it before coming here. After we're syncing with the
        * log_writer_reopen() call, quite possibly coming from a
        * non-main thread. */
@@ -477,7 +509,8 @@ _log_reader_insert_msg_length_stats(LogReader *self, gsize len)
 }
 
 static gboolean
-log_reader_handle_line(LogReader *self, const guchar *line, gint length, LogTransportAuxData *aux)
+log_reader_handle_line(LogReader *self, const guchar *line, gint length, LogTransportAuxData *aux,
+                       LogMessage **batch, gint *batch_len)
 {
   LogMessage *m;
 
@@ -505,15 +538,27 @@ log_reader_handle_line(LogReader *self, const guchar *line, gint length, LogTran
         }
       m->proto = aux->proto;
     }
-  log_msg_refcache_start_producer(m);
 
   log_transport_aux_data_foreach(aux, _add_aux_nvpair, m);
 
-  log_source_post(&self->super, m);
-  log_msg_refcache_stop();
+  /* NOTE: the message is tracked right away, as it belongs to the bookmark
+   * requested for this fetch, but it is only sent once the batch is
+   * complete */
+  log_source_track_msg(&self->super, m);
+  batch[(*batch_len)++] = m;
   return log_source_free_to_send(&self->super);
 }
 
+static void
+log_reader_flush_batch(LogReader *self, LogMessage **batch, gint *batch_len)
+{
+  if (*batch_len == 0)
+    return;
+
+  log_source_post_batch(&self->super, batch, *batch_len);
+  *batch_len = 0;
+}
+
 /* returns: notify_code (NC_XXXX) or 0 for success */
 static gint
 log_reader_fetch_log(LogReader *self)
@@ -521,6 +566,9 @@ log_reader_fetch_log(LogReader *self)
   gint msg_count = 0;
   gboolean may_read = TRUE;
   LogTransportAuxData aux_storage, *aux = &aux_storage;
+  LogMessage *batch[LOG_PIPE_BATCH_MAX];
+  gint batch_len = 0;
+  gint notify_code = 0;
 
   if ((self->options->flags & LR_IGNORE_AUX_DATA))
     aux = NULL;
@@ -533,7 +581,8 @@ log_reader_fetch_log(LogReader *self)
 
   /* NOTE: this loop is here to decrease the load on the main loop, we try
    * to fetch a couple of messages in a single run (but only up to
-   * fetch_limit).
+   * fetch_limit).  The messages fetched are sent along the pipeline in
+   * batches of up to LOG_PIPE_BATCH_MAX messages.
    */
   while (msg_count < self->options->fetch_limit && !main_loop_worker_job_quit())
     {
@@ -556,11 +605,11 @@ log_reader_fetch_log(LogReader *self)
       switch (status)
         {
         case LPS_EOF:
-          log_transport_aux_data_destroy(aux);
-          return NC_CLOSE;
+          notify_code = NC_CLOSE;
+          break;
         case LPS_ERROR:
-          log_transport_aux_data_destroy(aux);
-          return NC_READ_ERROR;
+          notify_code = NC_READ_ERROR;
+          break;
         case LPS_SUCCESS:
           break;
         case LPS_AGAIN:
@@ -570,7 +619,7 @@ log_reader_fetch_log(LogReader *self)
           break;
         }
 
-      if (!msg)
+      if (notify_code || !msg)
         {
           /* no more messages for now */
           break;
@@ -579,14 +628,23 @@ log_reader_fetch_log(LogReader *self)
         {
           msg_count++;
 
-          if (!log_reader_handle_line(self, msg, msg_len, aux))
+          gboolean free_to_send = log_reader_handle_line(self, msg, msg_len, aux, batch, &batch_len);
+          if (batch_len == LOG_PIPE_BATCH_MAX)
+            log_reader_flush_batch(self, batch, &batch_len);
+
+          if (!free_to_send)
             {
               /* window is full, don't generate further messages */
               break;
             }
         }
     }
+  log_reader_flush_batch(self, batch, &batch_len);
   log_transport_aux_data_destroy(aux);
+  stats_counter_set(self->buffer_bytes, log_proto_server_get_buffer_bytes(self->proto));
+
+  if (notify_code)
+    return notify_code;
 
   if (msg_count == self->options->fetch_limit)
     self->immediate_check = TRUE;
@@ -620,6 +678,13 @@ log_reader_io_handle_in(gpointer s)
           log_reader_work_perform(s, NULL);
           log_reader_work_finished(s, NULL);
           log_pipe_unref(&self->super.super);
+
+          /* readers run by a worker thread take the place of an I/O job */
+          if (main_loop_worker_is_worker_thread())
+            {
+              main_loop_worker_invoke_batch_callbacks();
+              main_loop_worker_run_gc();
+            }
         }
     }
 }
@@ -672,6 +737,41 @@ _unregister_aggregated_stats(LogReader *self)
   stats_aggregator_unlock();
 }
 
+/* the memory held by the input buffer of this connection */
+static void
+_register_buffer_stats(LogReader *self)
+{
+  if (!stats_check_level(4))
+    return;
+
+  gchar stats_instance[1024];
+  const gchar *instance_name = self->super.name;
+  if (!instance_name)
+    instance_name = stats_cluster_key_builder_format_legacy_stats_instance(self->super.metrics.stats_kb,
+                    stats_instance, sizeof(stats_instance));
+
+  StatsClusterKey sc_key;
+  stats_cluster_single_key_legacy_set_with_name(&sc_key, self->super.options->stats_source | SCS_SOURCE,
+                                                self->super.stats_id, instance_name, "buffer_bytes");
+
+  stats_lock();
+  self->buffer_bytes_cluster = stats_register_dynamic_counter(4, &sc_key, SC_TYPE_SINGLE_VALUE, &self->buffer_bytes);
+  stats_counter_set(self->buffer_bytes, log_proto_server_get_buffer_bytes(self->proto));
+  stats_unlock();
+}
+
+static void
+_unregister_buffer_stats(LogReader *self)
+{
+  if (!self->buffer_bytes_cluster)
+    return;
+
+  stats_lock();
+  stats_unregister_dynamic_counter(self->buffer_bytes_cluster, SC_TYPE_SINGLE_VALUE, &self->buffer_bytes);
+  stats_unlock();
+  self->buffer_bytes_cluster = NULL;
+}
+
 /*****************************************************************************
  * LogReader->LogPipe interface implementation
  *****************************************************************************/
@@ -697,11 +797,16 @@ log_reader_init(LogPipe *s)
       return FALSE;
     }
 
+  /* the watches are registered in the event loop of the initializing
+   * thread, which is usually the main thread */
+  self->owner_thread = get_thread_id();
   iv_event_register(&self->schedule_wakeup);
+  iv_event_register(&self->close_proto_requested);
 
   log_reader_start_watches(self);
 
   _register_aggregated_stats(self);
+  _register_buffer_stats(self);
 
   return TRUE;
 }
@@ -711,15 +816,17 @@ log_reader_deinit(LogPipe *s)
 {
   LogReader *self = (LogReader *) s;
 
-  main_loop_assert_main_thread();
+  log_reader_assert_owner_thread(self);
 
   iv_event_unregister(&self->schedule_wakeup);
+  iv_event_unregister(&self->close_proto_requested);
   if (iv_task_registered(&self->restart_task))
     iv_task_unregister(&self->restart_task);
 
   log_reader_stop_watches(self);
 
   _unregister_aggregated_stats(self);
+  _unregister_buffer_stats(self);
   if (!log_source_deinit(s))
     return FALSE;
 
@@ -738,6 +845,10 @@ log_reader_init_watches(LogReader *self)
   self->schedule_wakeup.cookie = self;
   self->schedule_wakeup.handler = log_reader_wakeup_triggered;
 
+  IV_EVENT_INIT(&self->close_proto_requested);
+  self->close_proto_requested.cookie = self;
+  self->close_proto_requested.handler = log_reader_close_proto_request_triggered;
+
   IV_TIMER_INIT(&self->idle_timer);
   self->idle_timer.cookie = self;
   self->idle_timer.handler = log_reader_idle_timeout;
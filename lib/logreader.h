@@ -69,6 +69,8 @@ struct _LogReader
   StatsAggregator *max_message_size;
   StatsAggregator *average_messages_size;
   StatsAggregator *CPS;
+  StatsCluster *buffer_bytes_cluster;
+  StatsCounterItem *buffer_bytes;
 
   /* NOTE: these used to be LogReaderWatch members, which were merged into
    * LogReader with the multi-thread refactorization */
@@ -86,8 +88,14 @@ struct _LogReader
   gboolean pending_close;
   GCond pending_close_cond;
   GMutex pending_close_lock;
+  /* posted by log_reader_close_proto() from threads other than the owner */
+  struct iv_event close_proto_requested;
+  gboolean pending_close_request;
 
   struct iv_timer idle_timer;
+
+  /* the thread running the watches, see log_reader_init() */
+  ThreadId owner_thread;
 };
 
 void log_reader_set_options(LogReader *s, LogPipe *control, LogReaderOptions *options, const gchar *stats_id,
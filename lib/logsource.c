@@ -552,8 +552,14 @@ log_source_deinit(LogPipe *s)
   return TRUE;
 }
 
+/*
+ * Account for a new message in the flow-control window and the ack
+ * tracker.  This needs to happen right after the message was fetched, as
+ * the ack tracker associates the message with the bookmark requested last.
+ * Tracked messages are to be sent using log_source_post_batch().
+ */
 void
-log_source_post(LogSource *self, LogMessage *msg)
+log_source_track_msg(LogSource *self, LogMessage *msg)
 {
   LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
   gint old_window_size;
@@ -585,6 +591,14 @@ log_source_post(LogSource *self, LogMessage *msg)
    */
 
   g_assert(old_window_size > 0);
+}
+
+void
+log_source_post(LogSource *self, LogMessage *msg)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+
+  log_source_track_msg(self, msg);
 
   ScratchBuffersMarker mark;
   scratch_buffers_mark(&mark);
@@ -592,6 +606,23 @@ log_source_post(LogSource *self, LogMessage *msg)
   scratch_buffers_reclaim_marked(mark);
 }
 
+/* send messages already tracked by log_source_track_msg() */
+void
+log_source_post_batch(LogSource *self, LogMessage **msgs, gint count)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  const LogPathOptions *batch_path_options[LOG_PIPE_BATCH_MAX];
+
+  g_assert(count <= LOG_PIPE_BATCH_MAX);
+  for (gint i = 0; i < count; i++)
+    batch_path_options[i] = &path_options;
+
+  ScratchBuffersMarker mark;
+  scratch_buffers_mark(&mark);
+  log_pipe_queue_batch(&self->super, msgs, batch_path_options, count);
+  scratch_buffers_reclaim_marked(mark);
+}
+
 static gboolean
 _invoke_mangle_callbacks(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
 {
@@ -648,14 +679,13 @@ _get_pid_string(void)
   return pid_string;
 }
 
-static void
-log_source_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
+/* returns FALSE if the message was dropped */
+static gboolean
+_process_message(LogSource *self, LogMessage *msg, const LogPathOptions *path_options)
 {
-  LogSource *self = (LogSource *) s;
+  LogPipe *s = &self->super;
   gint i;
 
-  msg_set_context(msg);
-
   msg_diagnostics(">>>>>> Source side message processing begin",
                   log_pipe_location_tag(s),
                   evt_tag_msg_reference(msg));
@@ -679,7 +709,7 @@ log_source_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options
 
 
   if (!_invoke_mangle_callbacks(s, msg, path_options))
-    return;
+    return FALSE;
 
   if (self->options->host_override)
     log_source_override_host(self, msg);
@@ -694,8 +724,12 @@ log_source_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options
   stats_counter_inc(self->metrics.recvd_messages);
   stats_counter_set_time(self->metrics.last_message_seen, msg->timestamps[LM_TS_RECVD].ut_sec);
   stats_byte_counter_add(&self->metrics.recvd_bytes, msg->recvd_rawmsg_size);
-  log_pipe_forward_msg(s, msg, path_options);
+  return TRUE;
+}
 
+static void
+_throttle_on_full_window(LogSource *self)
+{
   if (accurate_nanosleep && self->threaded && self->window_full_sleep_nsec > 0 && !log_source_free_to_send(self))
     {
       struct timespec ts;
@@ -705,6 +739,24 @@ log_source_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options
       ts.tv_nsec = self->window_full_sleep_nsec;
       nanosleep(&ts, NULL);
     }
+}
+
+static void
+log_source_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
+{
+  LogSource *self = (LogSource *) s;
+
+  msg_set_context(msg);
+
+  if (!_process_message(self, msg, path_options))
+    {
+      msg_set_context(NULL);
+      return;
+    }
+
+  log_pipe_forward_msg(s, msg, path_options);
+
+  _throttle_on_full_window(self);
   msg_diagnostics("<<<<<< Source side message processing finish",
                   log_pipe_location_tag(s),
                   evt_tag_msg_reference(msg));
@@ -712,6 +764,36 @@ log_source_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options
   msg_set_context(NULL);
 }
 
+static void
+log_source_queue_batch(LogPipe *s, LogMessage **msgs, const LogPathOptions **path_options, gint count)
+{
+  LogSource *self = (LogSource *) s;
+  gint n = 0;
+
+  for (gint i = 0; i < count; i++)
+    {
+      msg_set_context(msgs[i]);
+      gboolean accepted = _process_message(self, msgs[i], path_options[i]);
+      msg_set_context(NULL);
+
+      if (!accepted)
+        continue;
+      msgs[n] = msgs[i];
+      path_options[n] = path_options[i];
+      n++;
+    }
+
+  if (n == 0)
+    return;
+
+  log_pipe_forward_batch(s, msgs, path_options, n);
+
+  _throttle_on_full_window(self);
+  msg_diagnostics("<<<<<< Source side batch processing finish",
+                  log_pipe_location_tag(s),
+                  evt_tag_int("count", n));
+}
+
 static void
 _initialize_window(LogSource *self, gint init_window_size)
 {
@@ -808,6 +890,7 @@ log_source_init_instance(LogSource *self, GlobalConfig *cfg)
 {
   log_pipe_init_instance(&self->super, cfg);
   self->super.queue = log_source_queue;
+  log_pipe_set_queue_batch(&self->super, log_source_queue_batch);
   self->super.free_fn = log_source_free;
   self->super.init = log_source_init;
   self->super.deinit = log_source_deinit;
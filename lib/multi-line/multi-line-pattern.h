@@ -36,6 +36,7 @@ struct _MultiLinePattern
   pcre2_code *pattern;
 };
 
+gint multi_line_pattern_eval(MultiLinePattern *re, const guchar *str, gsize len, pcre2_match_data *match_data);
 gboolean multi_line_pattern_find(MultiLinePattern *re, const guchar *str, gsize len, gint *start, gint *end);
 gboolean multi_line_pattern_match(MultiLinePattern *re, const guchar *str, gsize len);
 MultiLinePattern *multi_line_pattern_compile(const gchar *regexp, GError **error);
@@ -46,6 +46,7 @@ typedef struct _SmartMultiLine
 {
   MultiLineLogic super;
   GMutex lock;
+  pcre2_match_data *match_data;
   gint current_state;
   gboolean last_segment_rewound;
   gboolean rewound_segment_is_trace;
@@ -57,6 +58,110 @@ gint last_state_id = SMLS_START_STATE;
 GArray *rules;
 GPtrArray *rules_by_from_state[64];
 
+/* all rules of a from_state combined into a single regexp, see _compile_combined_rules() */
+MultiLinePattern *combined_rules_by_from_state[64];
+
+/* returns TRUE if all top-level alternatives of @regexp start with '^' */
+static gboolean
+_regexp_is_anchored(const gchar *regexp)
+{
+  gint depth = 0;
+  gboolean in_class = FALSE;
+  gboolean branch_start = TRUE;
+
+  for (const gchar *p = regexp; *p; p++)
+    {
+      if (branch_start)
+        {
+          if (*p != '^')
+            return FALSE;
+          branch_start = FALSE;
+          continue;
+        }
+
+      switch (*p)
+        {
+        case '\\':
+          if (*(p + 1))
+            p++;
+          break;
+        case '[':
+          if (in_class)
+            break;
+          in_class = TRUE;
+          /* a ']' right after the opening bracket is a literal */
+          if (*(p + 1) == '^')
+            p++;
+          if (*(p + 1) == ']')
+            p++;
+          break;
+        case ']':
+          in_class = FALSE;
+          break;
+        case '(':
+          if (!in_class)
+            depth++;
+          break;
+        case ')':
+          if (!in_class)
+            depth--;
+          break;
+        case '|':
+          if (!in_class && depth == 0)
+            branch_start = TRUE;
+          break;
+        default:
+          break;
+        }
+    }
+  return !branch_start;
+}
+
+/*
+ * The rules of a state are tried in order and the first matching one
+ * determines the transition.  Instead of running them one-by-one, they are
+ * combined into a single, anchored alternation, where each alternative is a
+ * lookahead that searches for the rule anywhere in the line, and records
+ * the index of the rule with a MARK:
+ *
+ *   \A(?|(?=[\s\S]*?(?:rule0))(*MARK:0)|(?=(?:^rule1))(*MARK:1)|...)
+ *
+ * The alternatives are attempted in order at the start of the line, so the
+ * result is the same as that of the sequential evaluation, but the line is
+ * classified with a single pcre2_match() call.  Anchored rules are not
+ * prefixed with the skipping part, so they fail right at the start of the
+ * line instead of being retried at each position.  The branch reset group
+ * keeps the capture group numbering of the individual rules intact.
+ */
+static MultiLinePattern *
+_compile_combined_rules(GPtrArray *applicable_rules)
+{
+  GString *combined = g_string_new("\\A(?|");
+
+  for (gint i = 0; i < applicable_rules->len; i++)
+    {
+      SmartMultiLineRule *rule = g_ptr_array_index(applicable_rules, i);
+
+      if (i > 0)
+        g_string_append_c(combined, '|');
+      g_string_append_printf(combined, "(?=%s(?:%s))(*MARK:%d)",
+                             _regexp_is_anchored(rule->regexp) ? "" : "[\\s\\S]*?",
+                             rule->regexp, i);
+    }
+  g_string_append_c(combined, ')');
+
+  GError *error = NULL;
+  MultiLinePattern *compiled = multi_line_pattern_compile(combined->str, &error);
+  if (!compiled)
+    {
+      msg_debug("smart-multi-line: error compiling combined rules, evaluating rules one-by-one",
+                evt_tag_str("error", error->message));
+      g_clear_error(&error);
+    }
+  g_string_free(combined, TRUE);
+  return compiled;
+}
+
 static void
 _reshuffle_rules_by_from_state(void)
 {
@@ -79,6 +184,12 @@ _reshuffle_rules_by_from_state(void)
           g_ptr_array_add(rules_by_from_state[from_state], rule);
         }
     }
+
+  for (gint state_ndx = 0; state_ndx < G_N_ELEMENTS(rules_by_from_state); state_ndx++)
+    {
+      if (rules_by_from_state[state_ndx])
+        combined_rules_by_from_state[state_ndx] = _compile_combined_rules(rules_by_from_state[state_ndx]);
+    }
 }
 
 static gint
@@ -227,6 +338,8 @@ _free_rules(void)
           g_ptr_array_free(rules_by_from_state[state_ndx], TRUE);
           rules_by_from_state[state_ndx] = NULL;
         }
+      multi_line_pattern_unref(combined_rules_by_from_state[state_ndx]);
+      combined_rules_by_from_state[state_ndx] = NULL;
     }
 
   for (gint rule_ndx = 0; rule_ndx < rules->len; rule_ndx++)
@@ -240,12 +353,29 @@ _free_rules(void)
   rules = NULL;
 }
 
-gboolean
-_fsm_transition(SmartMultiLine *self, const gchar *segment, gsize segment_len)
+static SmartMultiLineRule *
+_find_matching_rule_combined(SmartMultiLine *self, MultiLinePattern *combined_rules, GPtrArray *applicable_rules,
+                             const gchar *segment, gsize segment_len)
 {
-  GPtrArray *applicable_rules = rules_by_from_state[self->current_state];
+  gint rc = multi_line_pattern_eval(combined_rules, (const guchar *) segment, segment_len, self->match_data);
+
+  /* the ovector is not used, so rc == 0 (ovector too small) is a match too */
+  if (rc < 0)
+    return NULL;
+
+  PCRE2_SPTR mark = pcre2_get_mark(self->match_data);
+  g_assert(mark);
+
+  gint rule_ndx = atoi((const gchar *) mark);
+  g_assert(rule_ndx >= 0 && rule_ndx < applicable_rules->len);
+  return g_ptr_array_index(applicable_rules, rule_ndx);
+}
 
-  for (gint i = 0; applicable_rules && i < applicable_rules->len; i++)
+static SmartMultiLineRule *
+_find_matching_rule_sequentially(SmartMultiLine *self, GPtrArray *applicable_rules,
+                                 const gchar *segment, gsize segment_len)
+{
+  for (gint i = 0; i < applicable_rules->len; i++)
     {
       SmartMultiLineRule *rule = g_ptr_array_index(applicable_rules, i);
       gboolean match = multi_line_pattern_match(rule->compiled_regexp, (const guchar *) segment, segment_len);
@@ -253,11 +383,29 @@ _fsm_transition(SmartMultiLine *self, const gchar *segment, gsize segment_len)
       msg_trace_printf("smart-multi-line: Matching against pattern: %s in state %d, matched %d", rule->regexp,
                        self->current_state, match);
       if (match)
-        {
-          self->current_state = rule->to_state;
-          /* the current segment is part of a sequence */
-          return TRUE;
-        }
+        return rule;
+    }
+  return NULL;
+}
+
+gboolean
+_fsm_transition(SmartMultiLine *self, const gchar *segment, gsize segment_len)
+{
+  GPtrArray *applicable_rules = rules_by_from_state[self->current_state];
+  MultiLinePattern *combined_rules = combined_rules_by_from_state[self->current_state];
+  SmartMultiLineRule *rule = NULL;
+
+  if (applicable_rules && combined_rules)
+    rule = _find_matching_rule_combined(self, combined_rules, applicable_rules, segment, segment_len);
+  else if (applicable_rules)
+    rule = _find_matching_rule_sequentially(self, applicable_rules, segment, segment_len);
+
+  if (rule)
+    {
+      msg_trace_printf("smart-multi-line: Matched pattern: %s in state %d", rule->regexp, self->current_state);
+      self->current_state = rule->to_state;
+      /* the current segment is part of a sequence */
+      return TRUE;
     }
   self->current_state = SMLS_START_STATE;
   return FALSE;
@@ -421,6 +569,7 @@ static void
 _free(MultiLineLogic *s)
 {
   SmartMultiLine *self = (SmartMultiLine *) s;
+  pcre2_match_data_free(self->match_data);
   g_mutex_clear(&self->lock);
   multi_line_logic_free_method(s);
 }
@@ -435,6 +584,8 @@ smart_multi_line_new(void)
   self->super.accumulate_line = _accumulate_line;
   self->last_segment_rewound = FALSE;
   self->current_state = SMLS_START_STATE;
+  /* MARKs are used to identify the matching rule, the ovector is not needed */
+  self->match_data = pcre2_match_data_create(1, NULL);
   g_mutex_init(&self->lock);
 
   return &self->super;
@@ -20,6 +20,7 @@
  * COPYING for details.
  */
 #include <criterion/criterion.h>
+#include "libtest/stopwatch.h"
 
 #include "multi-line/smart-multi-line.h"
 #include "scratch-buffers.h"
@@ -668,6 +669,59 @@ Test(smart_multi_line, test_dart_backtrace)
 }
 
 
+/* a mix of regular log lines and stack traces, as seen in application logs */
+static const gchar *perf_corpus[] =
+{
+  "2024-03-01 12:00:00.123 INFO  [main] c.e.app.Server - Request processed in 12ms, status=200",
+  "2024-03-01 12:00:00.125 DEBUG [worker-3] c.e.app.Cache - cache hit for key user:1234",
+  "java.lang.IllegalStateException: Connection pool exhausted",
+  "\tat com.example.app.db.Pool.acquire(Pool.java:118)",
+  "\tat com.example.app.db.Repository.findUser(Repository.java:42)",
+  "\tat com.example.app.web.UserController.get(UserController.java:77)",
+  "\tat java.base/java.lang.Thread.run(Thread.java:829)",
+  "Caused by: java.net.SocketTimeoutException: connect timed out",
+  "\tat java.base/java.net.PlainSocketImpl.socketConnect(Native Method)",
+  "\t... 4 more",
+  "2024-03-01 12:00:01.001 WARN  [worker-1] c.e.app.Server - slow request, elapsed=1503ms",
+  "Traceback (most recent call last):",
+  "  File \"/srv/app/handlers.py\", line 51, in handle",
+  "    return self.process(request)",
+  "  File \"/srv/app/handlers.py\", line 87, in process",
+  "    raise ValueError(\"invalid payload\")",
+  "ValueError: invalid payload",
+  "2024-03-01 12:00:02.310 INFO  [main] c.e.app.Server - Request processed in 3ms, status=200",
+  "panic: runtime error: index out of range",
+  "",
+  "goroutine 1 [running]:",
+  "main.main()",
+  "\t/srv/app/main.go:12 +0x1d",
+  "2024-03-01 12:00:03.000 INFO  [main] c.e.app.Server - shutting down",
+  NULL
+};
+
+#define PERF_ITERATIONS 10000
+
+Test(smart_multi_line, test_smart_multi_line_performance)
+{
+  MultiLineLogic *mll = smart_multi_line_new();
+  gint num_lines = 0;
+
+  start_stopwatch();
+  for (gint i = 0; i < PERF_ITERATIONS; i++)
+    {
+      for (gint line = 0; perf_corpus[line]; line++)
+        {
+          _feed_line(mll, perf_corpus[line], -1);
+          num_lines++;
+        }
+      g_ptr_array_foreach(output_messages, (GFunc) g_free, NULL);
+      g_ptr_array_set_size(output_messages, 0);
+    }
+  stop_stopwatch_and_display_result(num_lines, "smart-multi-line, classifying lines of stack traces and regular logs");
+
+  multi_line_logic_free(mll);
+}
+
 void
 setup(void)
 {
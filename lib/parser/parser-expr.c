@@ -85,35 +85,61 @@ log_parser_process_message(LogParser *self, LogMessage **pmsg, const LogPathOpti
   return success;
 }
 
-void
-log_parser_queue_method(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
+/* returns TRUE if the message is to be forwarded, otherwise it is dropped */
+static gboolean
+_parse_message(LogParser *self, LogMessage **pmsg, const LogPathOptions *path_options)
 {
-  LogParser *self = (LogParser *) s;
+  LogPipe *s = &self->super;
   gboolean success;
 
   msg_trace(">>>>>> parser rule evaluation begin",
             evt_tag_str("rule", self->name),
             log_pipe_location_tag(s),
-            evt_tag_msg_reference(msg));
+            evt_tag_msg_reference(*pmsg));
 
-  success = log_parser_process_message(self, &msg, path_options);
+  success = log_parser_process_message(self, pmsg, path_options);
 
   msg_trace("<<<<<< parser rule evaluation result",
             evt_tag_str("result", success ? "accepted" : "rejected"),
             evt_tag_str("rule", self->name),
             log_pipe_location_tag(s),
-            evt_tag_msg_reference(msg));
+            evt_tag_msg_reference(*pmsg));
 
-  if (success)
-    {
-      log_pipe_forward_msg(s, msg, path_options);
-    }
-  else
+  if (!success)
     {
       if (path_options->matched)
         (*path_options->matched) = FALSE;
-      log_msg_drop(msg, path_options, AT_PROCESSED);
+      log_msg_drop(*pmsg, path_options, AT_PROCESSED);
+    }
+  return success;
+}
+
+void
+log_parser_queue_method(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
+{
+  LogParser *self = (LogParser *) s;
+
+  if (_parse_message(self, &msg, path_options))
+    log_pipe_forward_msg(s, msg, path_options);
+}
+
+static void
+log_parser_queue_batch_method(LogPipe *s, LogMessage **msgs, const LogPathOptions **path_options, gint count)
+{
+  LogParser *self = (LogParser *) s;
+  gint n = 0;
+
+  for (gint i = 0; i < count; i++)
+    {
+      if (!_parse_message(self, &msgs[i], path_options[i]))
+        continue;
+      msgs[n] = msgs[i];
+      path_options[n] = path_options[i];
+      n++;
     }
+
+  if (n > 0)
+    log_pipe_forward_batch(s, msgs, path_options, n);
 }
 
 static void
@@ -187,4 +213,5 @@ log_parser_init_instance(LogParser *self, GlobalConfig *cfg)
   self->super.deinit = log_parser_deinit_method;
   self->super.free_fn = log_parser_free_method;
   self->super.queue = log_parser_queue_method;
+  log_pipe_set_queue_batch(&self->super, log_parser_queue_batch_method);
 }
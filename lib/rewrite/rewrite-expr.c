@@ -33,33 +33,51 @@ log_rewrite_set_condition(LogRewrite *self, FilterExprNode *condition)
 }
 
 static void
-log_rewrite_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
+_rewrite_message(LogRewrite *self, LogMessage **pmsg, const LogPathOptions *path_options)
 {
-  LogRewrite *self = (LogRewrite *) s;
+  LogPipe *s = &self->super;
 
   msg_trace(">>>>>> rewrite rule evaluation begin",
             evt_tag_str("rule", self->name),
             log_pipe_location_tag(s),
-            evt_tag_msg_reference(msg));
-  if (self->condition && !filter_expr_eval_root(self->condition, &msg, path_options))
+            evt_tag_msg_reference(*pmsg));
+  if (self->condition && !filter_expr_eval_root(self->condition, pmsg, path_options))
     {
       msg_trace("Rewrite condition unmatched, skipping rewrite",
                 evt_tag_str("value", log_msg_get_value_name(self->value_handle, NULL)),
                 evt_tag_str("rule", self->name),
                 log_pipe_location_tag(s),
-                evt_tag_msg_reference(msg));
+                evt_tag_msg_reference(*pmsg));
     }
   else
     {
-      self->process(self, &msg, path_options);
+      self->process(self, pmsg, path_options);
     }
   msg_trace("<<<<<< rewrite rule evaluation finished",
             evt_tag_str("rule", self->name),
             log_pipe_location_tag(s),
-            evt_tag_msg_reference(msg));
+            evt_tag_msg_reference(*pmsg));
+}
+
+static void
+log_rewrite_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
+{
+  LogRewrite *self = (LogRewrite *) s;
+
+  _rewrite_message(self, &msg, path_options);
   log_pipe_forward_msg(s, msg, path_options);
 }
 
+static void
+log_rewrite_queue_batch(LogPipe *s, LogMessage **msgs, const LogPathOptions **path_options, gint count)
+{
+  LogRewrite *self = (LogRewrite *) s;
+
+  for (gint i = 0; i < count; i++)
+    _rewrite_message(self, &msgs[i], path_options[i]);
+  log_pipe_forward_batch(s, msgs, path_options, count);
+}
+
 void
 log_rewrite_clone_method(LogRewrite *dst, const LogRewrite *src)
 {
@@ -101,6 +119,7 @@ log_rewrite_init_instance(LogRewrite *self, GlobalConfig *cfg)
   self->super.flags |= PIF_CONFIG_RELATED + PIF_SYNC_FILTERX;
   self->super.free_fn = log_rewrite_free_method;
   self->super.queue = log_rewrite_queue;
+  log_pipe_set_queue_batch(&self->super, log_rewrite_queue_batch);
   self->super.init = log_rewrite_init_method;
   self->value_handle = LM_V_MESSAGE;
 }
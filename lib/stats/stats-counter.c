@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#include "stats/stats-counter.h"
+#include "tls-support.h"
+
+TLS_BLOCK_START
+{
+  /* shifted by one, to make 0 the unassigned state */
+  gint stats_counter_shard_index;
+}
+TLS_BLOCK_END;
+
+#define stats_counter_shard_index __tls_deref(stats_counter_shard_index)
+
+static gint stats_counter_num_shards;
+static gint stats_counter_next_shard;
+
+/* the number of shards is the number of CPUs rounded up to a power of two */
+gint
+stats_counter_get_num_shards(void)
+{
+  static gsize initialized = 0;
+
+  if (g_once_init_enter(&initialized))
+    {
+      gint num_cpus = g_get_num_processors();
+      gint num_shards = 1;
+
+      while (num_shards < num_cpus && num_shards < STATS_COUNTER_MAX_SHARDS)
+        num_shards <<= 1;
+      stats_counter_num_shards = num_shards;
+      g_once_init_leave(&initialized, 1);
+    }
+  return stats_counter_num_shards;
+}
+
+/* threads are assigned to shards in a round-robin fashion, when they first
+ * update a sharded counter */
+gint
+stats_counter_get_shard_index(void)
+{
+  if (G_UNLIKELY(stats_counter_shard_index == 0))
+    {
+      gint shard = g_atomic_int_add(&stats_counter_next_shard, 1) & (stats_counter_get_num_shards() - 1);
+
+      stats_counter_shard_index = shard + 1;
+    }
+  return stats_counter_shard_index - 1;
+}
+
+void
+stats_counter_enable_sharding(StatsCounterItem *counter)
+{
+  if (!counter || counter->shards)
+    return;
+
+  g_assert(!counter->external);
+
+  StatsCounterShard *shards = g_new0(StatsCounterShard, stats_counter_get_num_shards());
+  if (!g_atomic_pointer_compare_and_exchange(&counter->shards, NULL, shards))
+    g_free(shards);
+}
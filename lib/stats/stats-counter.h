@@ -29,6 +29,29 @@
 
 #define STATS_COUNTER_MAX_VALUE G_MAXSIZE
 
+/*
+ * Sharded counters
+ *
+ * Counters updated by all worker threads (e.g. the global received/queued
+ * counters) suffer from cache line contention if they are stored in a
+ * single atomic variable.  A sharded counter spreads its updates among a
+ * set of per-thread shards (each on its own cache line), which are summed
+ * up when the counter is read.  Readers (stats-query, prometheus,
+ * syslog-ng-ctl stats) use stats_counter_get() and are not affected.
+ *
+ * The base value of a sharded counter is kept in "value", the shards
+ * only hold deltas on top of it, so a counter can be switched to sharded
+ * mode while other threads are already updating it.
+ */
+#define STATS_COUNTER_SHARD_SIZE 64
+#define STATS_COUNTER_MAX_SHARDS 64
+
+typedef struct _StatsCounterShard
+{
+  atomic_gssize value;
+  gchar __padding[STATS_COUNTER_SHARD_SIZE - sizeof(atomic_gssize)];
+} StatsCounterShard;
+
 typedef struct _StatsCounterItem
 {
   union
@@ -36,11 +59,15 @@ typedef struct _StatsCounterItem
     atomic_gssize value;
     atomic_gssize *value_ref;
   };
+  StatsCounterShard *shards;
   gchar *name;
   gint type;
   gboolean external;
 } StatsCounterItem;
 
+gint stats_counter_get_shard_index(void);
+gint stats_counter_get_num_shards(void);
+void stats_counter_enable_sharding(StatsCounterItem *counter);
 
 static gboolean
 stats_counter_read_only(StatsCounterItem *counter)
@@ -48,13 +75,23 @@ stats_counter_read_only(StatsCounterItem *counter)
   return counter->external;
 }
 
+static inline atomic_gssize *
+_stats_counter_get_writable_value(StatsCounterItem *counter)
+{
+  StatsCounterShard *shards = (StatsCounterShard *) g_atomic_pointer_get(&counter->shards);
+
+  if (shards)
+    return &shards[stats_counter_get_shard_index()].value;
+  return &counter->value;
+}
+
 static inline void
 stats_counter_add(StatsCounterItem *counter, gssize add)
 {
   if (counter)
     {
       g_assert(!stats_counter_read_only(counter));
-      atomic_gssize_add(&counter->value, add);
+      atomic_gssize_add(_stats_counter_get_writable_value(counter), add);
     }
 }
 
@@ -64,7 +101,7 @@ stats_counter_sub(StatsCounterItem *counter, gssize sub)
   if (counter)
     {
       g_assert(!stats_counter_read_only(counter));
-      atomic_gssize_sub(&counter->value, sub);
+      atomic_gssize_sub(_stats_counter_get_writable_value(counter), sub);
     }
 }
 
@@ -74,7 +111,7 @@ stats_counter_inc(StatsCounterItem *counter)
   if (counter)
     {
       g_assert(!stats_counter_read_only(counter));
-      atomic_gssize_inc(&counter->value);
+      atomic_gssize_inc(_stats_counter_get_writable_value(counter));
     }
 }
 
@@ -84,7 +121,7 @@ stats_counter_dec(StatsCounterItem *counter)
   if (counter)
     {
       g_assert(!stats_counter_read_only(counter));
-      atomic_gssize_dec(&counter->value);
+      atomic_gssize_dec(_stats_counter_get_writable_value(counter));
     }
 }
 
@@ -93,6 +130,15 @@ stats_counter_set(StatsCounterItem *counter, gsize value)
 {
   if (counter && !stats_counter_read_only(counter))
     {
+      StatsCounterShard *shards = (StatsCounterShard *) g_atomic_pointer_get(&counter->shards);
+
+      /* NOTE: updates racing with set() may get lost, just like they
+       * would with a single atomic value */
+      if (shards)
+        {
+          for (gint i = 0; i < stats_counter_get_num_shards(); i++)
+            atomic_gssize_set(&shards[i].value, 0);
+        }
       atomic_gssize_set(&counter->value, value);
     }
 }
@@ -105,7 +151,16 @@ stats_counter_get(StatsCounterItem *counter)
   if (counter)
     {
       if (!counter->external)
-        result = atomic_gssize_get_unsigned(&counter->value);
+        {
+          StatsCounterShard *shards = (StatsCounterShard *) g_atomic_pointer_get(&counter->shards);
+
+          result = atomic_gssize_get_unsigned(&counter->value);
+          if (shards)
+            {
+              for (gint i = 0; i < stats_counter_get_num_shards(); i++)
+                result += atomic_gssize_get_unsigned(&shards[i].value);
+            }
+        }
       else
         result = atomic_gssize_get_unsigned(counter->value_ref);
     }
@@ -130,6 +185,7 @@ stats_counter_get_name(StatsCounterItem *counter)
 static inline void
 stats_counter_clear(StatsCounterItem *counter)
 {
+  g_free(counter->shards);
   g_free(counter->name);
   memset(counter, 0, sizeof(*counter));
 }
@@ -228,6 +228,23 @@ stats_register_counter(gint stats_level, const StatsClusterKey *sc_key, gint typ
   return _register_counter(stats_level, sc_key, type, FALSE, counter);
 }
 
+/*
+ * Same as stats_register_counter(), but the counter is switched to sharded
+ * mode (see stats-counter.h).  Use it for counters that are updated by
+ * many threads concurrently, e.g. global or per-destination counters on the
+ * message path.
+ */
+StatsCluster *
+stats_register_sharded_counter(gint stats_level, const StatsClusterKey *sc_key, gint type,
+                               StatsCounterItem **counter)
+{
+  StatsCluster *sc = _register_counter(stats_level, sc_key, type, FALSE, counter);
+
+  if (*counter && !(*counter)->external)
+    stats_counter_enable_sharding(*counter);
+  return sc;
+}
+
 StatsCluster *
 stats_register_external_counter(gint stats_level, const StatsClusterKey *sc_key, gint type,
                                 atomic_gssize *external_counter)
@@ -238,6 +255,8 @@ stats_register_external_counter(gint stats_level, const StatsClusterKey *sc_key,
 StatsCluster *
 stats_register_alias_counter(gint level, const StatsClusterKey *sc_key, gint type, StatsCounterItem *aliased_counter)
 {
+  /* an alias only sees the base value, not the shards */
+  g_assert(!aliased_counter->shards);
   return stats_register_external_counter(level, sc_key, type, &aliased_counter->value);
 }
 
@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#include <criterion/criterion.h>
+#include "libtest/stopwatch.h"
+
+#include "stats/stats-registry.h"
+#include "stats/stats-cluster-single.h"
+#include "apphook.h"
+
+#define INCREMENTS_PER_THREAD 100000
+#define PERF_INCREMENTS 10000000
+#define PERF_MAX_THREADS 64
+
+typedef struct _IncrementerArgs
+{
+  StatsCounterItem *counter;
+  gint increments;
+} IncrementerArgs;
+
+static gpointer
+_increment_counter(gpointer user_data)
+{
+  IncrementerArgs *args = (IncrementerArgs *) user_data;
+
+  for (gint i = 0; i < args->increments; i++)
+    stats_counter_inc(args->counter);
+  return NULL;
+}
+
+static void
+_increment_from_threads(StatsCounterItem *counter, gint num_threads, gint increments)
+{
+  GThread *threads[PERF_MAX_THREADS];
+  IncrementerArgs args = { .counter = counter, .increments = increments };
+
+  g_assert(num_threads <= PERF_MAX_THREADS);
+  for (gint i = 0; i < num_threads; i++)
+    threads[i] = g_thread_new(NULL, _increment_counter, &args);
+  for (gint i = 0; i < num_threads; i++)
+    g_thread_join(threads[i]);
+}
+
+Test(stats_counter, test_sharded_counter_sums_up_shards)
+{
+  StatsCounterItem counter = { 0 };
+
+  stats_counter_add(&counter, 10);
+  stats_counter_enable_sharding(&counter);
+  cr_assert_not_null(counter.shards);
+  cr_assert_eq(stats_counter_get(&counter), 10, "value before sharding was lost");
+
+  stats_counter_inc(&counter);
+  stats_counter_add(&counter, 5);
+  stats_counter_dec(&counter);
+  stats_counter_sub(&counter, 2);
+  cr_assert_eq(stats_counter_get(&counter), 13);
+
+  _increment_from_threads(&counter, 8, INCREMENTS_PER_THREAD);
+  cr_assert_eq(stats_counter_get(&counter), 13 + 8 * INCREMENTS_PER_THREAD);
+
+  stats_counter_set(&counter, 42);
+  cr_assert_eq(stats_counter_get(&counter), 42);
+
+  stats_counter_clear(&counter);
+}
+
+Test(stats_counter, test_gauge_updated_from_different_threads)
+{
+  StatsCounterItem counter = { 0 };
+
+  stats_counter_enable_sharding(&counter);
+
+  /* increments and decrements may land in different shards, the sum is
+   * still correct */
+  _increment_from_threads(&counter, 4, INCREMENTS_PER_THREAD);
+  stats_counter_sub(&counter, 4 * INCREMENTS_PER_THREAD - 1);
+  cr_assert_eq(stats_counter_get(&counter), 1);
+
+  stats_counter_clear(&counter);
+}
+
+Test(stats_counter, test_register_sharded_counter)
+{
+  StatsClusterKey sc_key;
+  StatsCounterItem *counter, *same_counter;
+
+  stats_cluster_single_key_set(&sc_key, "sharded_counter", NULL, 0);
+  stats_lock();
+  stats_register_sharded_counter(0, &sc_key, SC_TYPE_SINGLE_VALUE, &counter);
+  stats_register_counter(0, &sc_key, SC_TYPE_SINGLE_VALUE, &same_counter);
+  stats_unlock();
+
+  cr_assert_eq(counter, same_counter);
+  cr_assert_not_null(counter->shards);
+
+  stats_counter_inc(same_counter);
+  _increment_from_threads(counter, 4, INCREMENTS_PER_THREAD);
+  cr_assert_eq(stats_counter_get(stats_get_counter(&sc_key, SC_TYPE_SINGLE_VALUE)), 4 * INCREMENTS_PER_THREAD + 1);
+
+  stats_lock();
+  stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, &counter);
+  stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, &same_counter);
+  stats_unlock();
+}
+
+static void
+_measure_scaling(StatsCounterItem *counter, const gchar *name)
+{
+  for (gint num_threads = 1; num_threads <= PERF_MAX_THREADS; num_threads *= 2)
+    {
+      start_stopwatch();
+      _increment_from_threads(counter, num_threads, PERF_INCREMENTS / num_threads);
+      stop_stopwatch_and_display_result(PERF_INCREMENTS, "%s counter, %d threads", name, num_threads);
+    }
+}
+
+Test(stats_counter, test_counter_scaling_performance)
+{
+  StatsCounterItem counter = { 0 };
+
+  _measure_scaling(&counter, "single atomic");
+  stats_counter_enable_sharding(&counter);
+  _measure_scaling(&counter, "sharded");
+
+  stats_counter_clear(&counter);
+}
+
+TestSuite(stats_counter, .init = app_startup, .fini = app_shutdown);
@@ -29,6 +29,7 @@
 #include "cfg.h"
 #include "scratch-buffers.h"
 #include "templates.h"
+#include "program.h"
 #include "globals.h"
 
 static LogMessageValueType
@@ -55,29 +56,62 @@ _should_render(const gchar *value, LogMessageValueType value_type, LogMessageVal
   return !!value[0];
 }
 
-static void
-log_template_append_elem_value(LogTemplate *self, LogTemplateElem *e, LogTemplateEvalOptions *options,
-                               LogMessage *msg, LogMessageValueType *type, GString *result)
+static const gchar *
+_lookup_value(LogTemplate *self, NVHandle handle, const gchar *default_value, gssize default_value_len,
+              LogMessage *msg, gssize *value_len, LogMessageValueType *type)
 {
   const gchar *value = NULL;
-  gssize value_len = -1;
   LogMessageValueType value_type = LM_VT_NONE;
 
-  value = log_msg_get_value_with_type(msg, e->value_handle, &value_len, &value_type);
-  if (value && _should_render(value, value_type, self->type_hint))
+  value = log_msg_get_value_with_type(msg, handle, value_len, &value_type);
+  if (!value || !_should_render(value, value_type, self->type_hint))
     {
-      g_string_append_len(result, value, value_len);
-    }
-  else if (e->default_value)
-    {
-      g_string_append_len(result, e->default_value, -1);
-      value_type = LM_VT_STRING;
+      if (default_value)
+        {
+          value = default_value;
+          *value_len = default_value_len;
+          value_type = LM_VT_STRING;
+        }
+      else
+        {
+          if (value_type == LM_VT_BYTES || value_type == LM_VT_PROTOBUF)
+            value_type = LM_VT_NULL;
+          value = "";
+          *value_len = 0;
+        }
     }
-  else if (value_type == LM_VT_BYTES || value_type == LM_VT_PROTOBUF)
+  *type = _propagate_type(*type, value_type);
+  return value;
+}
+
+/* same as the M_MESSAGE macro: the value is rendered as is, the default
+ * value is used if it is empty */
+static const gchar *
+_lookup_raw_value(NVHandle handle, const gchar *default_value, gssize default_value_len,
+                  LogMessage *msg, gssize *value_len, LogMessageValueType *type)
+{
+  LogMessageValueType value_type = LM_VT_NONE;
+  const gchar *value = log_msg_get_value_with_type(msg, handle, value_len, &value_type);
+
+  if (*value_len == 0 && default_value)
     {
-      value_type = LM_VT_NULL;
+      value = default_value;
+      *value_len = default_value_len;
     }
   *type = _propagate_type(*type, value_type);
+  return value;
+}
+
+static void
+log_template_append_elem_value(LogTemplate *self, LogTemplateElem *e, LogTemplateEvalOptions *options,
+                               LogMessage *msg, LogMessageValueType *type, GString *result)
+{
+  gssize value_len = -1;
+  const gchar *value = _lookup_value(self, e->value_handle,
+                                     e->default_value, e->default_value ? strlen(e->default_value) : 0,
+                                     msg, &value_len, type);
+
+  g_string_append_len(result, value, value_len);
 }
 
 static void
@@ -122,33 +156,56 @@ log_template_append_elem_func(LogTemplate *self, LogTemplateElem *e, LogTemplate
   *type = _propagate_type(*type, value_type);
 }
 
-void
-log_template_append_format_value_and_type_with_context(LogTemplate *self, LogMessage **messages, gint num_messages,
-                                                       LogTemplateEvalOptions *options,
-                                                       GString *result, LogMessageValueType *type)
+/* returns FALSE if the element references a message outside of the context */
+static gboolean
+_append_elem(LogTemplate *self, LogTemplateElem *e, LogTemplateEvalOptions *options,
+             LogMessage **messages, gint num_messages, LogMessageValueType *type, GString *result)
 {
-  LogTemplateElem *e;
-  LogMessageValueType t = LM_VT_NONE;
-  gboolean first_elem = TRUE;
-  GString *target_buffer = result;
-
-  if (!options->opts)
+  gint msg_ndx;
+
+  /* NOTE: msg_ref is 1 larger than the index specified by the user in
+   * order to make it distinguishable from the zero value.  Therefore
+   * the '>' instead of '>='
+   *
+   * msg_ref == 0 means that the user didn't specify msg_ref
+   * msg_ref >= 1 means that the user supplied the given msg_ref, 1 is equal to @0 */
+  if (e->msg_ref > num_messages)
+    return FALSE;
+  msg_ndx = num_messages - e->msg_ref;
+
+  /* value and macro can't understand a context, assume that no msg_ref means @0 */
+  if (e->msg_ref == 0)
+    msg_ndx--;
+
+  switch (e->type)
     {
-      /* try the configuration first */
-
-      if (self->cfg)
-        options->opts = &self->cfg->template_options;
-      else
-        options->opts = log_template_get_global_template_options();
+    case LTE_VALUE:
+      log_template_append_elem_value(self, e, options, messages[msg_ndx], type, result);
+      break;
+    case LTE_MACRO:
+      log_template_append_elem_macro(self, e, options, messages[msg_ndx], type, result);
+      break;
+    case LTE_FUNC:
+      log_template_append_elem_func(self, e, options, messages, num_messages, msg_ndx, type, result);
+      break;
+    default:
+      g_assert_not_reached();
+      break;
     }
+  return TRUE;
+}
 
-  gboolean escape = (self->escape || (self->top_level && options->opts->escape));
-  if (escape)
-    target_buffer = scratch_buffers_alloc();
+static void
+_append_escaped_elems(LogTemplate *self, LogMessage **messages, gint num_messages,
+                      LogTemplateEvalOptions *options, GString *result, LogMessageValueType *type)
+{
+  GString *target_buffer = scratch_buffers_alloc();
+  LogMessageValueType t = LM_VT_NONE;
+  gboolean first_elem = TRUE;
 
   for (GList *p = self->compiled_template; p; p = g_list_next(p), first_elem = FALSE)
     {
-      gint msg_ndx;
+      LogTemplateElem *e = (LogTemplateElem *) p->data;
 
       if (!first_elem)
         {
@@ -158,7 +215,6 @@ log_template_append_format_value_and_type_with_context(LogTemplate *self, LogMes
           t = LM_VT_STRING;
         }
 
-      e = (LogTemplateElem *) p->data;
       if (e->text)
         {
           g_string_append_len(result, e->text, e->text_len);
@@ -167,55 +223,149 @@ log_template_append_format_value_and_type_with_context(LogTemplate *self, LogMes
             t = LM_VT_STRING;
         }
 
-      /* NOTE: msg_ref is 1 larger than the index specified by the user in
-       * order to make it distinguishable from the zero value.  Therefore
-       * the '>' instead of '>='
-       *
-       * msg_ref == 0 means that the user didn't specify msg_ref
-       * msg_ref >= 1 means that the user supplied the given msg_ref, 1 is equal to @0 */
-      if (e->msg_ref > num_messages)
+      g_string_truncate(target_buffer, 0);
+      if (!_append_elem(self, e, options, messages, num_messages, &t, target_buffer))
         {
           /* msg_ref out of range, we expand to empty string without evaluating the element */
           t = LM_VT_STRING;
           continue;
         }
-      msg_ndx = num_messages - e->msg_ref;
 
-      /* value and macro can't understand a context, assume that no msg_ref means @0 */
-      if (e->msg_ref == 0)
-        msg_ndx--;
+      if (options->escape)
+        options->escape(result, target_buffer->str, target_buffer->len);
+      else
+        log_template_default_escape_method(result, target_buffer->str, target_buffer->len);
+      t = LM_VT_STRING;
+    }
+  *type = t;
+}
 
-      if (escape)
-        g_string_truncate(target_buffer, 0);
+/* fused programs: look up all values first, then size the result once and
+ * copy the pieces into it */
+static void
+_append_fused_program(LogTemplate *self, LogMessage *msg, GString *result, LogMessageValueType *type)
+{
+  const LogTemplateProgram *program = self->program;
+  const gchar *pieces[LOG_TEMPLATE_PROGRAM_MAX_FUSED];
+  gssize piece_lens[LOG_TEMPLATE_PROGRAM_MAX_FUSED];
+  gsize total_len = 0;
+
+  for (gint i = 0; i < program->num_instrs; i++)
+    {
+      const LogTemplateInstr *instr = &program->instrs[i];
 
-      switch (e->type)
+      switch (instr->op)
         {
-        case LTE_VALUE:
-          log_template_append_elem_value(self, e, options, messages[msg_ndx], &t, target_buffer);
+        case LTI_LITERAL:
+          pieces[i] = instr->literal.text;
+          piece_lens[i] = instr->literal.text_len;
           break;
-        case LTE_MACRO:
-          log_template_append_elem_macro(self, e, options, messages[msg_ndx], &t, target_buffer);
+        case LTI_VALUE:
+          pieces[i] = _lookup_value(self, instr->value.handle,
+                                    instr->value.default_value, instr->value.default_value_len,
+                                    msg, &piece_lens[i], type);
           break;
-        case LTE_FUNC:
-          log_template_append_elem_func(self, e, options, messages, num_messages, msg_ndx, &t, target_buffer);
+        case LTI_RAW_VALUE:
+          pieces[i] = _lookup_raw_value(instr->value.handle,
+                                        instr->value.default_value, instr->value.default_value_len,
+                                        msg, &piece_lens[i], type);
           break;
         default:
           g_assert_not_reached();
           break;
         }
+      total_len += piece_lens[i];
+    }
+
+  gsize pos = result->len;
+  g_string_set_size(result, pos + total_len);
+  for (gint i = 0; i < program->num_instrs; i++)
+    {
+      memcpy(result->str + pos, pieces[i], piece_lens[i]);
+      pos += piece_lens[i];
+    }
+}
+
+static void
+_append_program(LogTemplate *self, LogMessage *msg, LogMessage **messages, gint num_messages,
+                LogTemplateEvalOptions *options, GString *result, LogMessageValueType *type)
+{
+  const LogTemplateProgram *program = self->program;
+  const gchar *value;
+  gssize value_len;
+
+  for (gint i = 0; i < program->num_instrs; i++)
+    {
+      const LogTemplateInstr *instr = &program->instrs[i];
 
-      if (escape)
+      switch (instr->op)
         {
-          if (options->escape)
-            options->escape(result, target_buffer->str, target_buffer->len);
-          else
-            log_template_default_escape_method(result, target_buffer->str, target_buffer->len);
-          t = LM_VT_STRING;
+        case LTI_LITERAL:
+          g_string_append_len(result, instr->literal.text, instr->literal.text_len);
+          break;
+        case LTI_VALUE:
+          value = _lookup_value(self, instr->value.handle,
+                                instr->value.default_value, instr->value.default_value_len,
+                                msg, &value_len, type);
+          g_string_append_len(result, value, value_len);
+          break;
+        case LTI_RAW_VALUE:
+          value = _lookup_raw_value(instr->value.handle,
+                                    instr->value.default_value, instr->value.default_value_len,
+                                    msg, &value_len, type);
+          g_string_append_len(result, value, value_len);
+          break;
+        case LTI_ELEM:
+          if (!_append_elem(self, instr->elem, options, messages, num_messages, type, result))
+            *type = LM_VT_STRING;
+          break;
+        default:
+          g_assert_not_reached();
+          break;
         }
     }
+}
+
+void
+log_template_append_format_value_and_type_with_context(LogTemplate *self, LogMessage **messages, gint num_messages,
+                                                       LogTemplateEvalOptions *options,
+                                                       GString *result, LogMessageValueType *type)
+{
+  LogMessageValueType t = LM_VT_NONE;
+
+  if (!options->opts)
+    {
+      /* try the configuration first */
+
+      if (self->cfg)
+        options->opts = &self->cfg->template_options;
+      else
+        options->opts = log_template_get_global_template_options();
+    }
+
+  gboolean escape = (self->escape || (self->top_level && options->opts->escape));
+  if (escape)
+    {
+      _append_escaped_elems(self, messages, num_messages, options, result, &t);
+    }
+  else if (self->program)
+    {
+      /* value and macro can't understand a context, they use the last message */
+      LogMessage *msg = num_messages > 0 ? messages[num_messages - 1] : NULL;
+
+      if (self->program->fused)
+        _append_fused_program(self, msg, result, &t);
+      else
+        _append_program(self, msg, messages, num_messages, options, result, &t);
+
+      /* concatenating multiple elements or literal text, convert the value to string */
+      if (self->program->concatenated)
+        t = LM_VT_STRING;
+    }
+
   if (type)
     {
-      if (first_elem && t == LM_VT_NONE)
+      if (t == LM_VT_NONE)
         {
           /* empty template string, use LM_VT_STRING before applying the type-cast */
           t = LM_VT_STRING;
@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "template/program.h"
+
+static gsize
+_calculate_literals_len(GList *compiled_template)
+{
+  gsize len = 0;
+
+  for (GList *p = compiled_template; p; p = g_list_next(p))
+    len += ((LogTemplateElem *) p->data)->text_len;
+  return len;
+}
+
+static void
+_emit_literal(LogTemplateProgram *self, GArray *instrs, const gchar *text, gsize text_len)
+{
+  gchar *dest = self->literals + self->literals_len;
+
+  memcpy(dest, text, text_len);
+  self->literals_len += text_len;
+
+  if (instrs->len > 0)
+    {
+      LogTemplateInstr *last = &g_array_index(instrs, LogTemplateInstr, instrs->len - 1);
+
+      if (last->op == LTI_LITERAL)
+        {
+          /* literal runs are stored contiguously, extend the previous one */
+          last->literal.text_len += text_len;
+          return;
+        }
+    }
+
+  LogTemplateInstr instr = { .op = LTI_LITERAL, .literal = { .text = dest, .text_len = text_len } };
+  g_array_append_val(instrs, instr);
+}
+
+static void
+_emit_value(GArray *instrs, guint8 op, NVHandle handle, const gchar *default_value)
+{
+  LogTemplateInstr instr =
+  {
+    .op = op,
+    .value =
+    {
+      .handle = handle,
+      .default_value = default_value,
+      .default_value_len = default_value ? strlen(default_value) : 0,
+    },
+  };
+  g_array_append_val(instrs, instr);
+}
+
+static void
+_emit_elem(GArray *instrs, LogTemplateElem *e)
+{
+  LogTemplateInstr instr = { .op = LTI_ELEM, .elem = e };
+  g_array_append_val(instrs, instr);
+}
+
+static void
+_compile_elem(LogTemplateProgram *self, GArray *instrs, LogTemplateElem *e)
+{
+  if (e->text_len)
+    _emit_literal(self, instrs, e->text, e->text_len);
+
+  /* elements referencing a specific message of the context need the
+   * msg_ref logic of the generic evaluator */
+  if (e->msg_ref)
+    {
+      _emit_elem(instrs, e);
+      return;
+    }
+
+  switch (e->type)
+    {
+    case LTE_VALUE:
+      /* macro values are rendered into a per-thread buffer, which would be
+       * overwritten by the next lookup in a fused program */
+      if (log_msg_is_handle_macro(e->value_handle))
+        _emit_elem(instrs, e);
+      else
+        _emit_value(instrs, LTI_VALUE, e->value_handle, e->default_value);
+      break;
+    case LTE_MACRO:
+      if (e->macro == M_NONE)
+        break;
+      if (e->macro == M_MESSAGE)
+        _emit_value(instrs, LTI_RAW_VALUE, LM_V_MESSAGE, e->default_value);
+      else
+        _emit_elem(instrs, e);
+      break;
+    case LTE_FUNC:
+      _emit_elem(instrs, e);
+      break;
+    default:
+      g_assert_not_reached();
+    }
+}
+
+static gboolean
+_calculate_if_fused(LogTemplateProgram *self)
+{
+  if (self->num_instrs > LOG_TEMPLATE_PROGRAM_MAX_FUSED)
+    return FALSE;
+
+  for (gint i = 0; i < self->num_instrs; i++)
+    {
+      if (self->instrs[i].op == LTI_ELEM)
+        return FALSE;
+    }
+  return TRUE;
+}
+
+LogTemplateProgram *
+log_template_program_new(GList *compiled_template)
+{
+  LogTemplateProgram *self = g_new0(LogTemplateProgram, 1);
+  GArray *instrs = g_array_new(FALSE, FALSE, sizeof(LogTemplateInstr));
+
+  self->literals = g_malloc(_calculate_literals_len(compiled_template) + 1);
+  self->literals_len = 0;
+  for (GList *p = compiled_template; p; p = g_list_next(p))
+    _compile_elem(self, instrs, (LogTemplateElem *) p->data);
+  self->literals[self->literals_len] = 0;
+
+  self->num_instrs = instrs->len;
+  self->instrs = (LogTemplateInstr *) g_array_free(instrs, FALSE);
+
+  self->concatenated = self->literals_len > 0 || (compiled_template && compiled_template->next);
+  self->fused = _calculate_if_fused(self);
+  return self;
+}
+
+void
+log_template_program_free(LogTemplateProgram *self)
+{
+  g_free(self->instrs);
+  g_free(self->literals);
+  g_free(self);
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef TEMPLATE_PROGRAM_H_INCLUDED
+#define TEMPLATE_PROGRAM_H_INCLUDED
+
+#include "template/repr.h"
+
+/*
+ * LogTemplateProgram is a flat, array based representation of the
+ * compiled template, derived from the list of LogTemplateElem instances.
+ * It is used to render templates when no escaping is needed:
+ *
+ *   - literal text of adjacent elements is merged into a single instruction
+ *   - name-value pairs (and the $MSG macro) are resolved to NVHandles at
+ *     compile time
+ *   - everything else (macros, template functions and elements with a
+ *     message reference) is evaluated through the original element
+ *
+ * A program that consists of literals and value lookups only is "fused":
+ * the values are looked up first, and the result is sized once, before the
+ * pieces are copied into it.
+ */
+
+#define LOG_TEMPLATE_PROGRAM_MAX_FUSED 32
+
+enum
+{
+  LTI_LITERAL,
+  /* name-value pair, rendered with value() semantics */
+  LTI_VALUE,
+  /* name-value pair, rendered with macro semantics (e.g. $MSG) */
+  LTI_RAW_VALUE,
+  /* anything else, evaluated via the LogTemplateElem */
+  LTI_ELEM,
+};
+
+typedef struct _LogTemplateInstr
+{
+  guint8 op;
+  union
+  {
+    struct
+    {
+      const gchar *text;
+      gsize text_len;
+    } literal;
+    struct
+    {
+      NVHandle handle;
+      const gchar *default_value;
+      gssize default_value_len;
+    } value;
+    LogTemplateElem *elem;
+  };
+} LogTemplateInstr;
+
+struct _LogTemplateProgram
+{
+  LogTemplateInstr *instrs;
+  gint num_instrs;
+
+  /* storage for the merged literal runs */
+  gchar *literals;
+  gsize literals_len;
+
+  /* the result is a concatenation of multiple elements (or contains
+   * literal text), which makes it a string */
+  guint concatenated:1;
+  /* only LTI_LITERAL, LTI_VALUE and LTI_RAW_VALUE instructions */
+  guint fused:1;
+};
+
+LogTemplateProgram *log_template_program_new(GList *compiled_template);
+void log_template_program_free(LogTemplateProgram *self);
+
+#endif
@@ -24,6 +24,7 @@
 #include "template/templates.h"
 #include "template/repr.h"
 #include "template/compiler.h"
+#include "template/program.h"
 #include "template/macros.h"
 #include "template/escaping.h"
 #include "template/repr.h"
@@ -186,6 +187,9 @@ log_template_reset_compiled(LogTemplate *self)
 {
   log_template_elem_free_list(self->compiled_template);
   self->compiled_template = NULL;
+  if (self->program)
+    log_template_program_free(self->program);
+  self->program = NULL;
   self->trivial = FALSE;
 }
 
@@ -206,6 +210,7 @@ log_template_compile(LogTemplate *self, const gchar *template, GError **error)
   result = log_template_compiler_compile(&compiler, &self->compiled_template, error);
   log_template_compiler_clear(&compiler);
 
+  self->program = log_template_program_new(self->compiled_template);
   self->literal = _calculate_if_literal(self);
   self->trivial = _calculate_if_trivial(self);
   return result;
@@ -284,6 +289,7 @@ log_template_compile_literal_string(LogTemplate *self, const gchar *literal)
   self->template_str = g_strdup(literal);
   self->compiled_template = g_list_append(self->compiled_template,
                                           log_template_elem_new_macro(literal, M_NONE, NULL, 0));
+  self->program = log_template_program_new(self->compiled_template);
 
   /* double check that the representation here is actually considered trivial. It should be. */
   g_assert(_calculate_if_trivial(self));
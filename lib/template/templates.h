@@ -51,6 +51,8 @@ struct _LogTemplate
   gchar *name;
   gchar *template_str;
   GList *compiled_template;
+  /* flat representation of compiled_template, used for evaluation */
+  LogTemplateProgram *program;
   GlobalConfig *cfg;
   guint top_level:1, escape:1, def_inline:1, trivial:1, literal:1;
 
@@ -27,6 +27,7 @@
 
 #include "logmsg/logmsg.h"
 #include "template/templates.h"
+#include "template/program.h"
 #include "template/user-function.h"
 #include "apphook.h"
 #include "cfg.h"
@@ -628,6 +629,36 @@ Test(template, test_compile_literal_string)
   log_template_unref(template);
 }
 
+Test(template, test_compiled_programs_append_to_the_existing_result)
+{
+  LogMessage *msg = create_sample_message();
+  GString *result = g_string_new("prefix:");
+  LogTemplate *template = compile_template("${PROGRAM}[${PID}]: $MSG ${APP.VALUE99:-ures}");
+
+  cr_assert(template->program->fused);
+  log_template_append_format(template, msg, &DEFAULT_TEMPLATE_EVAL_OPTIONS, result);
+  cr_assert_str_eq(result->str, "prefix:syslog-ng[23323]: árvíztűrőtükörfúrógép ures");
+  log_template_unref(template);
+
+  template = compile_template("$FACILITY ${APP.VALUE} $(echo $HOST)");
+  cr_assert_not(template->program->fused);
+  log_template_append_format(template, msg, &DEFAULT_TEMPLATE_EVAL_OPTIONS, result);
+  cr_assert_str_eq(result->str, "prefix:syslog-ng[23323]: árvíztűrőtükörfúrógép ureslocal3 value bzorp");
+  log_template_unref(template);
+
+  g_string_free(result, TRUE);
+  log_msg_unref(msg);
+}
+
+Test(template, test_message_macro_with_default_value)
+{
+  LogMessage *msg = create_sample_message();
+
+  log_msg_set_value(msg, LM_V_MESSAGE, "", 0);
+  assert_template_format_msg("${MSG:-empty} ${MESSAGE}", "empty ", msg);
+  log_msg_unref(msg);
+}
+
 Test(template, test_result_of_concatenation_in_templates_are_typed_as_strings)
 {
   assert_template_format_value_and_type("$HOST$PROGRAM", "bzorpsyslog-ng", LM_VT_STRING);
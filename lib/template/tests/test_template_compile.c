@@ -377,6 +377,85 @@ Test(template_compile, test_unknown_function)
                            type = LTE_MACRO, msg_ref = 0);
 }
 
+static void
+assert_program_instr(gint index, guint8 op)
+{
+  cr_assert_lt(index, template->program->num_instrs, "Missing template instruction %d", index);
+  cr_assert_eq(template->program->instrs[index].op, op, "Bad template instruction at %d", index);
+}
+
+static void
+assert_program_literal(gint index, const gchar *text)
+{
+  const LogTemplateInstr *instr = &template->program->instrs[index];
+
+  assert_program_instr(index, LTI_LITERAL);
+  cr_assert_eq(instr->literal.text_len, strlen(text));
+  cr_assert_eq(memcmp(instr->literal.text, text, instr->literal.text_len), 0, "Bad literal in instruction %d", index);
+}
+
+Test(template_compile, test_program_resolves_values_and_message)
+{
+  assert_template_compile("${APP.VALUE:-default}: $MSG literal");
+
+  cr_assert_eq(template->program->num_instrs, 4);
+  assert_program_instr(0, LTI_VALUE);
+  cr_assert_eq(template->program->instrs[0].value.handle, log_msg_get_value_handle("APP.VALUE"));
+  cr_assert_str_eq(template->program->instrs[0].value.default_value, "default");
+  cr_assert_eq(template->program->instrs[0].value.default_value_len, 7);
+  assert_program_literal(1, ": ");
+  assert_program_instr(2, LTI_RAW_VALUE);
+  cr_assert_eq(template->program->instrs[2].value.handle, LM_V_MESSAGE);
+  assert_program_literal(3, " literal");
+
+  cr_assert(template->program->fused);
+  cr_assert(template->program->concatenated);
+}
+
+Test(template_compile, test_program_falls_back_to_elements_for_macros_functions_and_msg_refs)
+{
+  assert_template_compile("$FACILITY $(hello) ${HOST}@1");
+
+  cr_assert_eq(template->program->num_instrs, 5);
+  assert_program_instr(0, LTI_ELEM);
+  cr_assert_eq(template->program->instrs[0].elem, template->compiled_template->data);
+  assert_program_literal(1, " ");
+  assert_program_instr(2, LTI_ELEM);
+  assert_program_literal(3, " ");
+  assert_program_instr(4, LTI_ELEM);
+
+  cr_assert_not(template->program->fused);
+}
+
+Test(template_compile, test_program_merges_adjacent_literals)
+{
+  GList *elems = NULL;
+
+  elems = g_list_append(elems, log_template_elem_new_macro("foo", M_NONE, NULL, 0));
+  elems = g_list_append(elems, log_template_elem_new_macro("bar", M_NONE, NULL, 0));
+  elems = g_list_append(elems, log_template_elem_new_value("baz", (gchar *) "APP.VALUE", NULL, 0));
+
+  LogTemplateProgram *program = log_template_program_new(elems);
+  cr_assert_eq(program->num_instrs, 2);
+  cr_assert_eq(program->instrs[0].op, LTI_LITERAL);
+  cr_assert_eq(program->instrs[0].literal.text_len, 9);
+  cr_assert_eq(memcmp(program->instrs[0].literal.text, "foobarbaz", 9), 0);
+  cr_assert_eq(program->instrs[1].op, LTI_VALUE);
+  cr_assert_str_eq(program->literals, "foobarbaz");
+
+  log_template_program_free(program);
+  log_template_elem_free_list(elems);
+}
+
+Test(template_compile, test_program_of_a_single_value_is_not_concatenated)
+{
+  assert_template_compile("${APP.VALUE}");
+
+  cr_assert_eq(template->program->num_instrs, 1);
+  assert_program_instr(0, LTI_VALUE);
+  cr_assert_not(template->program->concatenated);
+}
+
 static void
 setup(void)
 {
@@ -165,3 +165,71 @@ ParameterizedTest(struct findcrlf_params *params, findcrlf, test)
                 "EOM is at wrong location. msg=%s, eom_ofs=%d, eom=%s\n",
                 params->msg, (gint) params->eom_ofs, eom);
 }
+
+static gsize
+_find_eol_positions_reference(const guchar *s, gsize n, guint eol_chars, guint32 *positions, gsize max_positions)
+{
+  gsize found = 0;
+
+  for (gsize i = 0; i < n && found < max_positions; i++)
+    {
+      if (((eol_chars & FIND_EOL_NL) && s[i] == '\n') ||
+          ((eol_chars & FIND_EOL_CR) && s[i] == '\r') ||
+          ((eol_chars & FIND_EOL_NUL) && s[i] == '\0'))
+        positions[found++] = i;
+    }
+  return found;
+}
+
+static void
+_fill_random_lines(guchar *buffer, gsize len)
+{
+  for (gsize i = 0; i < len; i++)
+    {
+      gint r = g_random_int_range(0, 24);
+
+      buffer[i] = r == 0 ? '\n' : r == 1 ? '\r' : r == 2 ? '\0' : 'a' + r;
+    }
+}
+
+ParameterizedTestParameters(findcrlf, test_find_eol_positions)
+{
+  static FindEOLImplementation implementations[] =
+  {
+    FIND_EOL_IMPL_SCALAR,
+    FIND_EOL_IMPL_SSE2,
+    FIND_EOL_IMPL_AVX2,
+  };
+
+  return cr_make_param_array(FindEOLImplementation, implementations, G_N_ELEMENTS(implementations));
+}
+
+ParameterizedTest(FindEOLImplementation *impl, findcrlf, test_find_eol_positions)
+{
+  guchar buffer[512 + 64];
+  guint32 expected[512], positions[512];
+
+  /* not supported by the CPU */
+  if (!find_eol_set_implementation(*impl))
+    return;
+
+  g_random_set_seed(*impl);
+  for (gint i = 0; i < 10000; i++)
+    {
+      /* unaligned buffers of any length, all combinations of terminators
+       * and a limited number of positions to return */
+      gsize offset = g_random_int_range(0, 64);
+      gsize len = g_random_int_range(0, 512);
+      guint eol_chars = g_random_int_range(1, 8);
+      gsize max_positions = g_random_int_range(1, 512);
+
+      _fill_random_lines(buffer + offset, len);
+      gsize expected_found = _find_eol_positions_reference(buffer + offset, len, eol_chars, expected, max_positions);
+      gsize found = find_eol_positions(buffer + offset, len, eol_chars, positions, max_positions);
+
+      cr_assert_eq(found, expected_found, "len=%" G_GSIZE_FORMAT ", eol_chars=%x", len, eol_chars);
+      cr_assert_arr_eq(positions, expected, found * sizeof(positions[0]));
+    }
+
+  find_eol_set_implementation(FIND_EOL_IMPL_AUTO);
+}
@@ -0,0 +1,236 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#include <criterion/criterion.h>
+
+#include "logpipe.h"
+#include "logmpx.h"
+#include "apphook.h"
+#include "cfg.h"
+
+typedef struct TestPipe
+{
+  LogPipe super;
+  gboolean reject_marked;
+  gint queue_calls;
+  gint queue_batch_calls;
+  gint messages_count;
+} TestPipe;
+
+static gboolean
+_is_marked(LogMessage *msg)
+{
+  return strcmp(log_msg_get_value(msg, LM_V_MESSAGE, NULL), "reject") == 0;
+}
+
+static void
+_consume_message(TestPipe *self, LogMessage *msg, const LogPathOptions *path_options)
+{
+  if (self->reject_marked && _is_marked(msg))
+    {
+      if (path_options->matched)
+        *path_options->matched = FALSE;
+    }
+  else
+    {
+      self->messages_count++;
+    }
+  log_msg_drop(msg, path_options, AT_PROCESSED);
+}
+
+static void
+test_pipe_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
+{
+  TestPipe *self = (TestPipe *) s;
+
+  self->queue_calls++;
+  _consume_message(self, msg, path_options);
+}
+
+static void
+test_pipe_queue_batch(LogPipe *s, LogMessage **msgs, const LogPathOptions **path_options, gint count)
+{
+  TestPipe *self = (TestPipe *) s;
+
+  self->queue_batch_calls++;
+  for (gint i = 0; i < count; i++)
+    _consume_message(self, msgs[i], path_options[i]);
+}
+
+static TestPipe *
+test_pipe_new(gboolean batch_aware)
+{
+  TestPipe *self = g_new0(TestPipe, 1);
+
+  log_pipe_init_instance(&self->super, configuration);
+  self->super.queue = test_pipe_queue;
+  if (batch_aware)
+    log_pipe_set_queue_batch(&self->super, test_pipe_queue_batch);
+  cr_assert(log_pipe_init(&self->super));
+  return self;
+}
+
+static void
+_free_pipe(LogPipe *pipe)
+{
+  log_pipe_deinit(pipe);
+  log_pipe_unref(pipe);
+}
+
+static gint
+_fill_batch(LogMessage **msgs, const LogPathOptions **batch_path_options, const LogPathOptions *path_options,
+            gint count)
+{
+  for (gint i = 0; i < count; i++)
+    {
+      msgs[i] = log_msg_new_empty();
+      log_msg_set_value(msgs[i], LM_V_MESSAGE, (i % 2) ? "reject" : "accept", -1);
+      batch_path_options[i] = path_options;
+    }
+  return count;
+}
+
+Test(logpipe_batch, test_batch_is_unrolled_for_pipes_without_batch_support)
+{
+  TestPipe *pipe = test_pipe_new(FALSE);
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT_NOACK;
+  LogMessage *msgs[LOG_PIPE_BATCH_MAX];
+  const LogPathOptions *batch_path_options[LOG_PIPE_BATCH_MAX];
+  gint count = _fill_batch(msgs, batch_path_options, &path_options, 10);
+
+  log_pipe_queue_batch(&pipe->super, msgs, batch_path_options, count);
+  cr_assert_eq(pipe->queue_calls, 10);
+  cr_assert_eq(pipe->queue_batch_calls, 0);
+  cr_assert_eq(pipe->messages_count, 10);
+
+  _free_pipe(&pipe->super);
+}
+
+Test(logpipe_batch, test_batch_is_passed_in_one_call_to_batch_aware_pipes)
+{
+  TestPipe *pipe = test_pipe_new(TRUE);
+  LogPipe *forwarder = log_pipe_new(configuration);
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT_NOACK;
+  LogMessage *msgs[LOG_PIPE_BATCH_MAX];
+  const LogPathOptions *batch_path_options[LOG_PIPE_BATCH_MAX];
+  gint count = _fill_batch(msgs, batch_path_options, &path_options, LOG_PIPE_BATCH_MAX);
+
+  /* a pipe without a queue method forwards the batch as is */
+  log_pipe_append(forwarder, &pipe->super);
+  cr_assert(log_pipe_init(forwarder));
+
+  log_pipe_queue_batch(forwarder, msgs, batch_path_options, count);
+  cr_assert_eq(pipe->queue_calls, 0);
+  cr_assert_eq(pipe->queue_batch_calls, 1);
+  cr_assert_eq(pipe->messages_count, LOG_PIPE_BATCH_MAX);
+
+  _free_pipe(forwarder);
+  _free_pipe(&pipe->super);
+}
+
+static gint overriding_queue_calls;
+
+static void
+_overriding_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
+{
+  overriding_queue_calls++;
+  log_msg_drop(msg, path_options, AT_PROCESSED);
+}
+
+Test(logpipe_batch, test_overridden_queue_method_is_not_bypassed)
+{
+  TestPipe *pipe = test_pipe_new(TRUE);
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT_NOACK;
+  LogMessage *msgs[LOG_PIPE_BATCH_MAX];
+  const LogPathOptions *batch_path_options[LOG_PIPE_BATCH_MAX];
+  gint count = _fill_batch(msgs, batch_path_options, &path_options, 5);
+
+  /* a subclass taking over queue() without providing a batch variant */
+  pipe->super.queue = _overriding_queue;
+
+  log_pipe_queue_batch(&pipe->super, msgs, batch_path_options, count);
+  cr_assert_eq(overriding_queue_calls, 5);
+  cr_assert_eq(pipe->queue_batch_calls, 0);
+
+  _free_pipe(&pipe->super);
+}
+
+Test(logpipe_batch, test_multiplexer_delivers_batch_to_each_branch_and_propagates_matched)
+{
+  LogMultiplexer *mpx = log_multiplexer_new(configuration);
+  TestPipe *filtering = test_pipe_new(TRUE);
+  TestPipe *unrolled = test_pipe_new(FALSE);
+  LogPathOptions path_options[LOG_PIPE_BATCH_MAX];
+  const LogPathOptions *batch_path_options[LOG_PIPE_BATCH_MAX];
+  gboolean matched[LOG_PIPE_BATCH_MAX];
+  LogMessage *msgs[LOG_PIPE_BATCH_MAX];
+  gint count = 8;
+
+  filtering->reject_marked = TRUE;
+  unrolled->reject_marked = TRUE;
+  log_multiplexer_add_next_hop(mpx, &filtering->super);
+  log_multiplexer_add_next_hop(mpx, &unrolled->super);
+  cr_assert(log_pipe_init(&mpx->super));
+
+  _fill_batch(msgs, batch_path_options, NULL, count);
+  for (gint i = 0; i < count; i++)
+    {
+      LogPathOptions lpo = LOG_PATH_OPTIONS_INIT_NOACK;
+
+      matched[i] = TRUE;
+      path_options[i] = lpo;
+      path_options[i].matched = &matched[i];
+      batch_path_options[i] = &path_options[i];
+    }
+
+  log_pipe_queue_batch(&mpx->super, msgs, batch_path_options, count);
+
+  cr_assert_eq(filtering->queue_batch_calls, 1);
+  cr_assert_eq(filtering->messages_count, count / 2);
+  cr_assert_eq(unrolled->queue_calls, count);
+  cr_assert_eq(unrolled->messages_count, count / 2);
+
+  /* messages rejected by every branch are reported as unmatched */
+  for (gint i = 0; i < count; i++)
+    cr_assert_eq(matched[i], (i % 2) == 0, "unexpected matched state for message %d", i);
+
+  _free_pipe(&mpx->super);
+  _free_pipe(&filtering->super);
+  _free_pipe(&unrolled->super);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  configuration = cfg_new_snippet();
+  cr_assert(cfg_init(configuration));
+}
+
+static void
+teardown(void)
+{
+  cfg_free(configuration);
+  app_shutdown();
+}
+
+TestSuite(logpipe_batch, .init = setup, .fini = teardown);
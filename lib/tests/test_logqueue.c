@@ -25,6 +25,7 @@
 #include <criterion/criterion.h>
 #include "libtest/msg_parse_lib.h"
 #include "libtest/queue_utils_lib.h"
+#include "libtest/stopwatch.h"
 
 #include "logqueue.h"
 #include "logqueue-fifo.h"
@@ -262,6 +263,150 @@ Test(logqueue, test_with_threads)
   fprintf(stderr, "Feed speed: %.2lf\n", (double) TEST_RUNS * MESSAGES_SUM * 1000000 / sum_time);
 }
 
+#define CONTENTION_MESSAGES_PER_PRODUCER 100000
+#define CONTENTION_BATCH_SIZE 64
+
+static gpointer
+_contention_producer(gpointer args)
+{
+  LogQueue *q = args;
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+
+  path_options.ack_needed = TRUE;
+  path_options.flow_control_requested = TRUE;
+  feed_messages_as_worker(q, &path_options, CONTENTION_MESSAGES_PER_PRODUCER, CONTENTION_BATCH_SIZE);
+  return NULL;
+}
+
+Test(logqueue, log_queue_fifo_contention_performance)
+{
+  gint producer_counts[] = { 1, 2, 4, 8, 16 };
+
+  for (gint i = 0; i < G_N_ELEMENTS(producer_counts); i++)
+    {
+      gint num_producers = producer_counts[i];
+      gint num_messages = num_producers * CONTENTION_MESSAGES_PER_PRODUCER;
+      GThread *producers[num_producers];
+
+      main_loop_worker_allocate_thread_space(num_producers);
+      main_loop_worker_finalize_thread_space();
+
+      StatsClusterKeyBuilder *driver_sck_builder = stats_cluster_key_builder_new();
+      StatsClusterKeyBuilder *queue_sck_builder = stats_cluster_key_builder_new();
+      LogQueue *q = log_queue_fifo_new(num_messages, NULL, STATS_LEVEL0, driver_sck_builder, queue_sck_builder);
+      stats_cluster_key_builder_free(driver_sck_builder);
+      stats_cluster_key_builder_free(queue_sck_builder);
+
+      acked_messages = 0;
+      start_stopwatch();
+      for (gint j = 0; j < num_producers; j++)
+        producers[j] = g_thread_new(NULL, _contention_producer, q);
+
+      gint consumed = consume_messages(q, num_messages);
+
+      for (gint j = 0; j < num_producers; j++)
+        g_thread_join(producers[j]);
+      stop_stopwatch_and_display_result(num_messages, "LogQueueFifo, %d producers, 1 consumer", num_producers);
+
+      cr_assert_eq(consumed, num_messages);
+      cr_assert_eq(acked_messages, num_messages);
+      cr_assert_eq(stats_counter_get(q->metrics.shared.queued_messages), 0);
+      cr_assert_eq(stats_counter_get(q->metrics.shared.memory_usage), 0);
+      cr_assert_eq(stats_counter_get(q->metrics.shared.dropped_messages), 0);
+
+      log_queue_unref(q);
+    }
+}
+
+#define MIXED_WORKER_MESSAGES 100
+
+static gpointer
+_mixed_worker_producer(gpointer args)
+{
+  LogQueue *q = args;
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+
+  path_options.ack_needed = TRUE;
+  feed_messages_as_worker(q, &path_options, MIXED_WORKER_MESSAGES, 16);
+  return NULL;
+}
+
+static void
+_feed_single_messages_with_seq(LogQueue *q, const LogPathOptions *path_options, gint first, gint n)
+{
+  for (gint i = first; i < first + n; i++)
+    {
+      LogMessage *msg = log_msg_new_empty();
+      gchar seq[16];
+
+      g_snprintf(seq, sizeof(seq), "%d", i);
+      log_msg_set_value(msg, LM_V_MESSAGE, seq, -1);
+      log_msg_add_ack(msg, path_options);
+      msg->ack_func = test_ack;
+      log_queue_push_tail(q, msg, path_options);
+    }
+}
+
+Test(logqueue, log_queue_fifo_single_pushes_and_worker_batches_keep_order)
+{
+  LogPathOptions flow_controlled_path = LOG_PATH_OPTIONS_INIT;
+  flow_controlled_path.ack_needed = TRUE;
+  flow_controlled_path.flow_control_requested = TRUE;
+
+  LogPathOptions non_flow_controlled_path = LOG_PATH_OPTIONS_INIT;
+  non_flow_controlled_path.ack_needed = TRUE;
+
+  main_loop_worker_allocate_thread_space(1);
+  main_loop_worker_finalize_thread_space();
+
+  StatsClusterKeyBuilder *driver_sck_builder = stats_cluster_key_builder_new();
+  StatsClusterKeyBuilder *queue_sck_builder = stats_cluster_key_builder_new();
+  LogQueue *q = log_queue_fifo_new(OVERFLOW_SIZE, NULL, STATS_LEVEL0, driver_sck_builder, queue_sck_builder);
+  stats_cluster_key_builder_free(driver_sck_builder);
+  stats_cluster_key_builder_free(queue_sck_builder);
+
+  acked_messages = 0;
+
+  /* the main thread has no input queue, these go to the wait queue one by one */
+  _feed_single_messages_with_seq(q, &flow_controlled_path, 0, 10);
+  GThread *thread = g_thread_new(NULL, _mixed_worker_producer, q);
+  g_thread_join(thread);
+  _feed_single_messages_with_seq(q, &non_flow_controlled_path, 10, 10);
+
+  gint total = 20 + MIXED_WORKER_MESSAGES;
+  cr_assert_eq(log_queue_get_length(q), total);
+  cr_assert_eq(stats_counter_get(q->metrics.shared.queued_messages), total);
+
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  gint next_seq = 0;
+  for (gint i = 0; i < total; i++)
+    {
+      LogMessage *msg = log_queue_pop_head(q, &path_options);
+      cr_assert_not_null(msg);
+
+      const gchar *seq = log_msg_get_value(msg, LM_V_MESSAGE, NULL);
+      if (seq[0])
+        {
+          cr_assert_eq(atoi(seq), next_seq, "single messages reordered, expected=%d, got=%s", next_seq, seq);
+          next_seq++;
+        }
+
+      log_msg_ack(msg, &path_options, AT_PROCESSED);
+      log_queue_ack_backlog(q, 1);
+      log_msg_unref(msg);
+    }
+
+  cr_assert_eq(next_seq, 20);
+  cr_assert_eq(acked_messages, total);
+  cr_assert_eq(log_queue_get_length(q), 0);
+  cr_assert_eq(stats_counter_get(q->metrics.shared.memory_usage), 0);
+
+  /* entries left on the wait queue are released by the free method */
+  _feed_single_messages_with_seq(q, &flow_controlled_path, 0, 3);
+  log_queue_unref(q);
+  cr_assert_eq(acked_messages, total + 3);
+}
+
 Test(logqueue, log_queue_fifo_rewind_all_and_memory_usage)
 {
   StatsClusterKeyBuilder *driver_sck_builder = stats_cluster_key_builder_new();
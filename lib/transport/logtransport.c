@@ -26,6 +26,7 @@
 #include "messages.h"
 
 #include <unistd.h>
+#include <sys/uio.h>
 
 void
 log_transport_free_method(LogTransport *s)
@@ -38,11 +39,26 @@ log_transport_free_method(LogTransport *s)
     }
 }
 
+/* generic writev() for transports without scatter-gather support: it
+ * writes the first non-empty buffer only, which is a valid (short) writev
+ * result, callers write the rest in subsequent calls */
+gssize
+log_transport_writev_method(LogTransport *s, struct iovec *iov, gint iov_count)
+{
+  for (gint i = 0; i < iov_count; i++)
+    {
+      if (iov[i].iov_len > 0)
+        return log_transport_write(s, iov[i].iov_base, iov[i].iov_len);
+    }
+  return 0;
+}
+
 void
 log_transport_init_instance(LogTransport *self, gint fd)
 {
   self->fd = fd;
   self->cond = 0;
+  self->writev = log_transport_writev_method;
   self->free_fn = log_transport_free_method;
 }
 
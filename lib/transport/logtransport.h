@@ -38,6 +38,12 @@ struct _LogTransport
   gssize (*read)(LogTransport *self, gpointer buf, gsize count, LogTransportAuxData *aux);
   gssize (*write)(LogTransport *self, const gpointer buf, gsize count);
   gssize (*writev)(LogTransport *self, struct iovec *iov, gint iov_count);
+  /* DGRAM transports only: sends @count datagrams, each consisting of
+   * @iov_per_datagram consecutive elements of @iov, returns the number of
+   * datagrams sent */
+  gint (*write_datagrams)(LogTransport *self, struct iovec *iov, gint iov_per_datagram, gint count);
+  /* input that was already read from the fd, but not yet returned by read() */
+  gboolean (*has_pending_input)(LogTransport *self);
   void (*free_fn)(LogTransport *self);
 };
 
@@ -53,13 +59,34 @@ log_transport_writev(LogTransport *self, struct iovec *iov, gint iov_count)
   return self->writev(self, iov, iov_count);
 }
 
+static inline gint
+log_transport_write_datagrams(LogTransport *self, struct iovec *iov, gint iov_per_datagram, gint count)
+{
+  return self->write_datagrams(self, iov, iov_per_datagram, count);
+}
+
+static inline gboolean
+log_transport_is_datagram_based(LogTransport *self)
+{
+  return self->write_datagrams != NULL;
+}
+
 static inline gssize
 log_transport_read(LogTransport *self, gpointer buf, gsize count, LogTransportAuxData *aux)
 {
   return self->read(self, buf, count, aux);
 }
 
+static inline gboolean
+log_transport_has_pending_input(LogTransport *self)
+{
+  if (!self->has_pending_input)
+    return FALSE;
+  return self->has_pending_input(self);
+}
+
 void log_transport_init_instance(LogTransport *s, gint fd);
+gssize log_transport_writev_method(LogTransport *s, struct iovec *iov, gint iov_count);
 void log_transport_free_method(LogTransport *s);
 void log_transport_free(LogTransport *s);
 gint log_transport_release_fd(LogTransport *s);
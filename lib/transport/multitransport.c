@@ -31,6 +31,15 @@ void multitransport_add_factory(MultiTransport *self, TransportFactory *transpor
   transport_factory_registry_add(self->registry, transport_factory);
 }
 
+static gint _multitransport_write_datagrams(LogTransport *s, struct iovec *iov, gint iov_per_datagram, gint count);
+
+/* datagram batching is only advertised if the active transport supports it */
+static void
+_inherit_write_datagrams(MultiTransport *self)
+{
+  self->super.write_datagrams = self->active_transport->write_datagrams ? _multitransport_write_datagrams : NULL;
+}
+
 static void
 _do_transport_switch(MultiTransport *self, LogTransport *new_transport, const TransportFactory *new_transport_factory)
 {
@@ -43,6 +52,7 @@ _do_transport_switch(MultiTransport *self, LogTransport *new_transport, const Tr
   log_transport_free(self->active_transport);
   self->active_transport = new_transport;
   self->active_transport_factory = new_transport_factory;
+  _inherit_write_datagrams(self);
 }
 
 static const TransportFactory *
@@ -116,6 +126,26 @@ _multitransport_write(LogTransport *s, gpointer buf, gsize count)
   return r;
 }
 
+static gssize
+_multitransport_writev(LogTransport *s, struct iovec *iov, gint iov_count)
+{
+  MultiTransport *self = (MultiTransport *)s;
+  gssize r = log_transport_writev(self->active_transport, iov, iov_count);
+  self->super.cond = self->active_transport->cond;
+
+  return r;
+}
+
+static gint
+_multitransport_write_datagrams(LogTransport *s, struct iovec *iov, gint iov_per_datagram, gint count)
+{
+  MultiTransport *self = (MultiTransport *)s;
+  gint r = log_transport_write_datagrams(self->active_transport, iov, iov_per_datagram, count);
+  self->super.cond = self->active_transport->cond;
+
+  return r;
+}
+
 static gssize
 _multitransport_read(LogTransport *s, gpointer buf, gsize count, LogTransportAuxData *aux)
 {
@@ -126,6 +156,14 @@ _multitransport_read(LogTransport *s, gpointer buf, gsize count, LogTransportAux
   return r;
 }
 
+static gboolean
+_multitransport_has_pending_input(LogTransport *s)
+{
+  MultiTransport *self = (MultiTransport *)s;
+
+  return log_transport_has_pending_input(self->active_transport);
+}
+
 static void
 _multitransport_free(LogTransport *s)
 {
@@ -146,9 +184,12 @@ multitransport_new(TransportFactory *default_transport_factory, gint fd)
   log_transport_init_instance(&self->super, fd);
   self->super.read = _multitransport_read;
   self->super.write = _multitransport_write;
+  self->super.writev = _multitransport_writev;
+  self->super.has_pending_input = _multitransport_has_pending_input;
   self->super.free_fn = _multitransport_free;
   self->active_transport = transport_factory_construct_transport(default_transport_factory, fd);
   self->active_transport_factory = default_transport_factory;
+  _inherit_write_datagrams(self);
 
   return &self->super;
 }
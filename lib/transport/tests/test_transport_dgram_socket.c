@@ -0,0 +1,215 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#include <criterion/criterion.h>
+
+#include "transport/transport-socket.h"
+#include "apphook.h"
+
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+
+#define NUM_DATAGRAMS 32
+
+typedef struct _DGramSocketPair
+{
+  gint sender;
+  LogTransport *transport;
+} DGramSocketPair;
+
+static void
+_open_socket_pair(DGramSocketPair *pair, gint recv_batch_size)
+{
+  gint fds[2];
+
+  cr_assert_eq(socketpair(AF_UNIX, SOCK_DGRAM, 0, fds), 0);
+  cr_assert_eq(fcntl(fds[1], F_SETFL, O_NONBLOCK), 0);
+
+  pair->sender = fds[0];
+  pair->transport = log_transport_dgram_socket_new(fds[1]);
+  log_transport_dgram_socket_set_recv_batch_size((LogTransportSocket *) pair->transport, recv_batch_size);
+}
+
+static void
+_close_socket_pair(DGramSocketPair *pair)
+{
+  close(pair->sender);
+  log_transport_free(pair->transport);
+}
+
+static void
+_send_datagram(DGramSocketPair *pair, const gchar *datagram)
+{
+  cr_assert_eq(send(pair->sender, datagram, strlen(datagram), 0), strlen(datagram));
+}
+
+static void
+_send_datagrams(DGramSocketPair *pair, gint count)
+{
+  for (gint i = 0; i < count; i++)
+    {
+      gchar datagram[32];
+
+      g_snprintf(datagram, sizeof(datagram), "datagram %d", i);
+      _send_datagram(pair, datagram);
+    }
+}
+
+static void
+_assert_read_datagram(DGramSocketPair *pair, gsize buflen, const gchar *expected)
+{
+  gchar buf[1024] = { 0 };
+  LogTransportAuxData aux;
+
+  log_transport_aux_data_init(&aux);
+  gssize rc = log_transport_read(pair->transport, buf, MIN(buflen, sizeof(buf)), &aux);
+  cr_assert_eq(rc, strlen(expected), "unexpected datagram length: %" G_GSSIZE_FORMAT ", expected: %s", rc, expected);
+  cr_assert_eq(memcmp(buf, expected, rc), 0, "unexpected datagram: %.*s, expected: %s", (gint) rc, buf, expected);
+#if defined(__linux__) && defined(SO_TIMESTAMPNS)
+  cr_assert_neq(aux.timestamp.tv_sec, 0, "datagram timestamp was not preserved");
+#endif
+  log_transport_aux_data_destroy(&aux);
+}
+
+static void
+_assert_read_datagrams(DGramSocketPair *pair, gint count)
+{
+  for (gint i = 0; i < count; i++)
+    {
+      gchar expected[32];
+
+      g_snprintf(expected, sizeof(expected), "datagram %d", i);
+      _assert_read_datagram(pair, 1024, expected);
+    }
+}
+
+static void
+_assert_no_more_datagrams(DGramSocketPair *pair)
+{
+  gchar buf[1024];
+
+  cr_assert_not(log_transport_has_pending_input(pair->transport));
+  cr_assert_eq(log_transport_read(pair->transport, buf, sizeof(buf), NULL), -1);
+  cr_assert_eq(errno, EAGAIN);
+}
+
+Test(transport_dgram_socket, test_datagrams_are_returned_one_by_one)
+{
+  DGramSocketPair pair;
+
+  _open_socket_pair(&pair, LOG_TRANSPORT_DGRAM_RECV_BATCH_MAX);
+
+  _send_datagrams(&pair, NUM_DATAGRAMS);
+  _assert_read_datagram(&pair, 1024, "datagram 0");
+#ifdef SYSLOG_NG_HAVE_RECVMMSG
+  /* the rest was received by the same syscall */
+  cr_assert(log_transport_has_pending_input(pair.transport));
+#endif
+  for (gint i = 1; i < NUM_DATAGRAMS; i++)
+    {
+      gchar expected[32];
+
+      g_snprintf(expected, sizeof(expected), "datagram %d", i);
+      _assert_read_datagram(&pair, 1024, expected);
+    }
+  _assert_no_more_datagrams(&pair);
+
+  /* the buffers are reused for the next batch */
+  _send_datagrams(&pair, NUM_DATAGRAMS);
+  _assert_read_datagrams(&pair, NUM_DATAGRAMS);
+  _assert_no_more_datagrams(&pair);
+
+  _close_socket_pair(&pair);
+}
+
+Test(transport_dgram_socket, test_batch_smaller_than_the_number_of_pending_datagrams)
+{
+  DGramSocketPair pair;
+
+  _open_socket_pair(&pair, 4);
+
+  _send_datagrams(&pair, NUM_DATAGRAMS);
+  _assert_read_datagrams(&pair, NUM_DATAGRAMS);
+  _assert_no_more_datagrams(&pair);
+
+  _close_socket_pair(&pair);
+}
+
+Test(transport_dgram_socket, test_unbatched_reads)
+{
+  DGramSocketPair pair;
+
+  _open_socket_pair(&pair, 1);
+
+  _send_datagrams(&pair, NUM_DATAGRAMS);
+  _assert_read_datagram(&pair, 1024, "datagram 0");
+  cr_assert_not(log_transport_has_pending_input(pair.transport));
+  _close_socket_pair(&pair);
+}
+
+Test(transport_dgram_socket, test_empty_datagrams_are_skipped)
+{
+  DGramSocketPair pair;
+
+  _open_socket_pair(&pair, LOG_TRANSPORT_DGRAM_RECV_BATCH_MAX);
+
+  cr_assert_eq(send(pair.sender, "", 0, 0), 0);
+  _send_datagram(&pair, "foo");
+  cr_assert_eq(send(pair.sender, "", 0, 0), 0);
+  _send_datagram(&pair, "bar");
+
+  _assert_read_datagram(&pair, 1024, "foo");
+  _assert_read_datagram(&pair, 1024, "bar");
+  _assert_no_more_datagrams(&pair);
+
+  _close_socket_pair(&pair);
+}
+
+#ifdef SYSLOG_NG_HAVE_RECVMMSG
+Test(transport_dgram_socket, test_datagrams_are_truncated_to_the_read_buffer)
+{
+  DGramSocketPair pair;
+
+  _open_socket_pair(&pair, LOG_TRANSPORT_DGRAM_RECV_BATCH_MAX);
+
+  _send_datagram(&pair, "0123456789");
+  _send_datagram(&pair, "abcdefghij");
+  _send_datagram(&pair, "ABCDEFGHIJ");
+
+  /* datagrams received together are truncated to the buffer size of the
+   * read() that received them, just like a single recvmsg() would do */
+  _assert_read_datagram(&pair, 4, "0123");
+  _assert_read_datagram(&pair, 4, "abcd");
+  _assert_read_datagram(&pair, 1024, "ABCD");
+
+  /* larger buffers are honoured once the received datagrams are consumed */
+  _send_datagram(&pair, "0123456789");
+  _assert_read_datagram(&pair, 1024, "0123456789");
+  _assert_no_more_datagrams(&pair);
+
+  _close_socket_pair(&pair);
+}
+#endif
+
+TestSuite(transport_dgram_socket, .init = app_startup, .fini = app_shutdown);
@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#include <criterion/criterion.h>
+
+#include "transport/transport-tls.h"
+#include "transport/tls-context.h"
+#include "apphook.h"
+
+#include <openssl/ssl.h>
+#include <openssl/evp.h>
+#include <openssl/rsa.h>
+#include <openssl/x509.h>
+#include <sys/socket.h>
+#include <string.h>
+#include <unistd.h>
+
+/* a TLS server on the other end of a socketpair, it collects everything
+ * it reads until the peer closes the connection */
+typedef struct _TestTLSServer
+{
+  gint fd;
+  SSL_CTX *ssl_ctx;
+  GString *received;
+  GThread *thread;
+} TestTLSServer;
+
+static EVP_PKEY *
+_generate_key(void)
+{
+  EVP_PKEY *pkey = NULL;
+  EVP_PKEY_CTX *pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_RSA, NULL);
+
+  cr_assert(pctx);
+  cr_assert_eq(EVP_PKEY_keygen_init(pctx), 1);
+  cr_assert_eq(EVP_PKEY_CTX_set_rsa_keygen_bits(pctx, 2048), 1);
+  cr_assert_eq(EVP_PKEY_keygen(pctx, &pkey), 1);
+  EVP_PKEY_CTX_free(pctx);
+
+  return pkey;
+}
+
+static X509 *
+_generate_self_signed_cert(EVP_PKEY *pkey)
+{
+  X509 *cert = X509_new();
+
+  X509_set_version(cert, 2);
+  ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+  X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+  X509_gmtime_adj(X509_getm_notAfter(cert), 3600);
+  X509_set_pubkey(cert, pkey);
+
+  X509_NAME *name = X509_get_subject_name(cert);
+  X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const guchar *) "localhost", -1, -1, 0);
+  X509_set_issuer_name(cert, name);
+  cr_assert(X509_sign(cert, pkey, EVP_sha256()));
+
+  return cert;
+}
+
+static gpointer
+_tls_server_thread(gpointer user_data)
+{
+  TestTLSServer *server = user_data;
+  SSL *ssl = SSL_new(server->ssl_ctx);
+  gchar buf[4096];
+  gint rc;
+
+  SSL_set_fd(ssl, server->fd);
+  if (SSL_accept(ssl) == 1)
+    {
+      while ((rc = SSL_read(ssl, buf, sizeof(buf))) > 0)
+        g_string_append_len(server->received, buf, rc);
+    }
+
+  SSL_free(ssl);
+  return NULL;
+}
+
+static void
+_tls_server_start(TestTLSServer *server, gint fd)
+{
+  EVP_PKEY *pkey = _generate_key();
+  X509 *cert = _generate_self_signed_cert(pkey);
+
+  server->fd = fd;
+  server->received = g_string_new(NULL);
+  server->ssl_ctx = SSL_CTX_new(SSLv23_server_method());
+  cr_assert_eq(SSL_CTX_use_certificate(server->ssl_ctx, cert), 1);
+  cr_assert_eq(SSL_CTX_use_PrivateKey(server->ssl_ctx, pkey), 1);
+  X509_free(cert);
+  EVP_PKEY_free(pkey);
+
+  server->thread = g_thread_new("tls-server", _tls_server_thread, server);
+}
+
+static const gchar *
+_tls_server_join(TestTLSServer *server)
+{
+  g_thread_join(server->thread);
+  return server->received->str;
+}
+
+static void
+_tls_server_free(TestTLSServer *server)
+{
+  SSL_CTX_free(server->ssl_ctx);
+  g_string_free(server->received, TRUE);
+  close(server->fd);
+}
+
+static LogTransport *
+_create_tls_client_transport(gint fd)
+{
+  TLSContext *ctx = tls_context_new(TM_CLIENT, "test");
+
+  cr_assert(tls_context_set_verify_mode_by_name(ctx, "optional-untrusted"));
+  cr_assert_eq(tls_context_setup_context(ctx), TLS_CONTEXT_SETUP_OK);
+
+  TLSSession *session = tls_context_setup_session(ctx);
+  cr_assert(session);
+  tls_context_unref(ctx);
+
+  return log_transport_tls_new(session, fd);
+}
+
+Test(transport_tls, writev_sends_all_buffers_with_a_single_write)
+{
+  gint fds[2];
+  cr_assert_eq(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+
+  TestTLSServer server;
+  _tls_server_start(&server, fds[1]);
+  LogTransport *transport = _create_tls_client_transport(fds[0]);
+
+  gchar header[] = "17 ";
+  gchar payload[] = "<13>first message";
+  gchar header2[] = "18 ";
+  gchar payload2[] = "<13>second message";
+  struct iovec iov[] =
+  {
+    { .iov_base = header, .iov_len = strlen(header) },
+    { .iov_base = payload, .iov_len = strlen(payload) },
+    { .iov_base = NULL, .iov_len = 0 },
+    { .iov_base = header2, .iov_len = strlen(header2) },
+    { .iov_base = payload2, .iov_len = strlen(payload2) },
+  };
+  const gchar *batch = "17 <13>first message18 <13>second message";
+
+  /* the socket is blocking, so the handshake completes within the first write */
+  gssize rc = log_transport_writev(transport, iov, G_N_ELEMENTS(iov));
+  cr_assert_eq(rc, strlen(batch), "the batch was not written as a whole, rc=%zd", rc);
+
+  /* a single non-empty buffer is written as is */
+  rc = log_transport_writev(transport, &iov[1], 2);
+  cr_assert_eq(rc, strlen(payload));
+
+  rc = log_transport_writev(transport, &iov[2], 1);
+  cr_assert_eq(rc, 0);
+
+  /* shuts the socket down, which ends the read loop of the server */
+  log_transport_free(transport);
+
+  gchar *expected = g_strconcat(batch, payload, NULL);
+  cr_assert_str_eq(_tls_server_join(&server), expected);
+  g_free(expected);
+
+  _tls_server_free(&server);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+}
+
+static void
+teardown(void)
+{
+  app_shutdown();
+}
+
+TestSuite(transport_tls, .init = setup, .fini = teardown);
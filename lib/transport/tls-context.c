@@ -26,8 +26,11 @@
 #include "compat/openssl_support.h"
 #include "secret-storage/secret-storage.h"
 #include "string-list.h"
+#include "stats/stats-registry.h"
+#include "stats/stats-cluster-single.h"
 
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <stdio.h>
@@ -155,6 +158,435 @@ tls_context_setup_session_tickets(TLSContext *self)
   openssl_ctx_setup_session_tickets(self->ssl_ctx);
 }
 
+/*
+ * Session cache
+ *
+ * Client contexts remember the session of the last handshake and offer it
+ * when a connection is (re)opened.  Server contexts use a session-ID cache
+ * of their own instead of the internal one of the SSL_CTX.  Both are
+ * owned by the TLSContext, so that the sessions (and the session ticket
+ * keys) can be handed over to the TLSContext of the new configuration on
+ * reload.
+ */
+
+typedef struct _TLSCachedSession
+{
+  GBytes *id;
+  SSL_SESSION *session;
+  GList link;
+} TLSCachedSession;
+
+struct _TLSSessionCacheState
+{
+  gchar *config_digest;
+  SSL_SESSION *client_session;
+  /* oldest first */
+  GList *server_sessions;
+  guchar ticket_keys[128];
+  glong ticket_keys_len;
+};
+
+static gboolean
+_session_is_resumable(SSL_SESSION *session)
+{
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+  return SSL_SESSION_is_resumable(session);
+#else
+  return TRUE;
+#endif
+}
+
+/* takes over the reference of @session */
+static TLSCachedSession *
+_cached_session_new(SSL_SESSION *session)
+{
+  TLSCachedSession *self = g_new0(TLSCachedSession, 1);
+  guint id_len;
+  const guchar *id = SSL_SESSION_get_id(session, &id_len);
+
+  self->id = g_bytes_new(id, id_len);
+  self->session = session;
+  self->link.data = self;
+  return self;
+}
+
+static void
+_cached_session_free(TLSCachedSession *self)
+{
+  SSL_SESSION_free(self->session);
+  g_bytes_unref(self->id);
+  g_free(self);
+}
+
+static TLSCachedSession *
+_server_cache_lookup(TLSContext *self, const guchar *id, gsize id_len)
+{
+  GBytes *key = g_bytes_new_static(id, id_len);
+  TLSCachedSession *entry = g_hash_table_lookup(self->session_cache.server_sessions, key);
+
+  g_bytes_unref(key);
+  return entry;
+}
+
+static void
+_server_cache_remove(TLSContext *self, TLSCachedSession *entry)
+{
+  g_queue_unlink(&self->session_cache.server_sessions_order, &entry->link);
+  g_hash_table_remove(self->session_cache.server_sessions, entry->id);
+}
+
+/* takes over the reference of @session, must be called with the lock held */
+static void
+_server_cache_add(TLSContext *self, SSL_SESSION *session)
+{
+  TLSCachedSession *entry = _cached_session_new(session);
+  TLSCachedSession *old_entry = g_hash_table_lookup(self->session_cache.server_sessions, entry->id);
+
+  if (old_entry)
+    _server_cache_remove(self, old_entry);
+
+  while (g_hash_table_size(self->session_cache.server_sessions) >= TLS_CONTEXT_SESSION_CACHE_SIZE)
+    _server_cache_remove(self, g_queue_peek_head(&self->session_cache.server_sessions_order));
+
+  g_hash_table_insert(self->session_cache.server_sessions, entry->id, entry);
+  g_queue_push_tail_link(&self->session_cache.server_sessions_order, &entry->link);
+}
+
+/* takes over the reference of @session, must be called with the lock held */
+static void
+_client_cache_set(TLSContext *self, SSL_SESSION *session)
+{
+  if (self->session_cache.client_session)
+    SSL_SESSION_free(self->session_cache.client_session);
+  self->session_cache.client_session = session;
+}
+
+static int
+_new_session_cb(SSL *ssl, SSL_SESSION *session)
+{
+  TLSContext *self = SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl));
+
+  g_mutex_lock(&self->session_cache.lock);
+  if (self->mode == TM_CLIENT)
+    _client_cache_set(self, session);
+  else
+    _server_cache_add(self, session);
+  g_mutex_unlock(&self->session_cache.lock);
+
+  /* we keep the reference passed to us */
+  return 1;
+}
+
+static SSL_SESSION *
+_get_session_cb(SSL *ssl, const unsigned char *id, int id_len, int *copy)
+{
+  TLSContext *self = SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl));
+  SSL_SESSION *session = NULL;
+
+  g_mutex_lock(&self->session_cache.lock);
+  TLSCachedSession *entry = _server_cache_lookup(self, id, id_len);
+  if (entry)
+    {
+      session = entry->session;
+      SSL_SESSION_up_ref(session);
+    }
+  g_mutex_unlock(&self->session_cache.lock);
+
+  /* the reference is taken above, as the entry may be evicted once we release the lock */
+  *copy = 0;
+  return session;
+}
+
+static void
+_remove_session_cb(SSL_CTX *ssl_ctx, SSL_SESSION *session)
+{
+  TLSContext *self = SSL_CTX_get_app_data(ssl_ctx);
+
+  g_mutex_lock(&self->session_cache.lock);
+  if (self->mode == TM_CLIENT)
+    {
+      if (self->session_cache.client_session == session)
+        _client_cache_set(self, NULL);
+    }
+  else
+    {
+      guint id_len;
+      const guchar *id = SSL_SESSION_get_id(session, &id_len);
+      TLSCachedSession *entry = _server_cache_lookup(self, id, id_len);
+
+      if (entry && entry->session == session)
+        _server_cache_remove(self, entry);
+    }
+  g_mutex_unlock(&self->session_cache.lock);
+}
+
+static void
+tls_context_setup_session_cache(TLSContext *self)
+{
+  g_mutex_init(&self->session_cache.lock);
+  self->session_cache.server_sessions = g_hash_table_new_full(g_bytes_hash, g_bytes_equal, NULL,
+                                                              (GDestroyNotify) _cached_session_free);
+  g_queue_init(&self->session_cache.server_sessions_order);
+
+  if (self->mode == TM_CLIENT)
+    {
+      SSL_CTX_set_session_cache_mode(self->ssl_ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    }
+  else
+    {
+      SSL_CTX_set_session_cache_mode(self->ssl_ctx, SSL_SESS_CACHE_SERVER | SSL_SESS_CACHE_NO_INTERNAL);
+      SSL_CTX_sess_set_get_cb(self->ssl_ctx, _get_session_cb);
+    }
+  SSL_CTX_sess_set_new_cb(self->ssl_ctx, _new_session_cb);
+  SSL_CTX_sess_set_remove_cb(self->ssl_ctx, _remove_session_cb);
+}
+
+static void
+tls_context_free_session_cache(TLSContext *self)
+{
+  if (self->session_cache.client_session)
+    SSL_SESSION_free(self->session_cache.client_session);
+  /* the links are embedded in the entries, they are freed by the hash table */
+  g_queue_init(&self->session_cache.server_sessions_order);
+  g_hash_table_destroy(self->session_cache.server_sessions);
+  g_mutex_clear(&self->session_cache.lock);
+  g_free(self->session_cache.config_digest);
+}
+
+static void
+_offer_cached_session(TLSContext *self, SSL *ssl)
+{
+  g_mutex_lock(&self->session_cache.lock);
+  SSL_SESSION *session = self->session_cache.client_session;
+  if (session && _session_is_resumable(session))
+    SSL_set_session(ssl, session);
+  g_mutex_unlock(&self->session_cache.lock);
+}
+
+static void
+_update_digest_with_string(GChecksum *digest, const gchar *value)
+{
+  /* unset values differ from empty strings, as the latter include the terminating NUL */
+  if (value)
+    g_checksum_update(digest, (const guchar *) value, strlen(value) + 1);
+  g_checksum_update(digest, (const guchar *) "\n", 1);
+}
+
+static void
+_update_digest_with_int(GChecksum *digest, gint value)
+{
+  g_checksum_update(digest, (const guchar *) &value, sizeof(value));
+}
+
+static void
+_update_digest_with_string_list(GChecksum *digest, GList *list)
+{
+  for (GList *l = list; l; l = l->next)
+    _update_digest_with_string(digest, (const gchar *) l->data);
+  _update_digest_with_int(digest, g_list_length(list));
+}
+
+static void
+_update_digest_with_file_stat(GChecksum *digest, const gchar *filename)
+{
+  struct stat st;
+
+  if (stat(filename, &st) < 0)
+    {
+      _update_digest_with_int(digest, -1);
+      return;
+    }
+
+  gint64 fingerprint[] =
+  {
+    st.st_dev, st.st_ino, st.st_size, st.st_mtim.tv_sec, st.st_mtim.tv_nsec, st.st_ctim.tv_sec, st.st_ctim.tv_nsec
+  };
+  g_checksum_update(digest, (const guchar *) fingerprint, sizeof(fingerprint));
+}
+
+static gint
+_compare_filenames(gconstpointer a, gconstpointer b)
+{
+  return strcmp(*(const gchar **) a, *(const gchar **) b);
+}
+
+/* certificates and CRLs in a directory may be replaced in place, which does
+ * not change the directory itself, so each entry is checked */
+static void
+_update_digest_with_dir_stat(GChecksum *digest, const gchar *dirname)
+{
+  _update_digest_with_file_stat(digest, dirname);
+
+  GDir *dir = g_dir_open(dirname, 0, NULL);
+  if (!dir)
+    return;
+
+  GPtrArray *entries = g_ptr_array_new_with_free_func(g_free);
+  const gchar *entry;
+  while ((entry = g_dir_read_name(dir)))
+    g_ptr_array_add(entries, g_build_filename(dirname, entry, NULL));
+  g_dir_close(dir);
+
+  g_ptr_array_sort(entries, _compare_filenames);
+  for (guint i = 0; i < entries->len; i++)
+    {
+      _update_digest_with_string(digest, g_ptr_array_index(entries, i));
+      _update_digest_with_file_stat(digest, g_ptr_array_index(entries, i));
+    }
+  g_ptr_array_free(entries, TRUE);
+}
+
+static void
+_update_digest_with_file(GChecksum *digest, const gchar *filename)
+{
+  _update_digest_with_string(digest, filename);
+  if (filename)
+    _update_digest_with_file_stat(digest, filename);
+}
+
+static void
+_update_digest_with_dir(GChecksum *digest, const gchar *dirname)
+{
+  _update_digest_with_string(digest, dirname);
+  if (dirname)
+    _update_digest_with_dir_stat(digest, dirname);
+}
+
+/*
+ * Resumed sessions skip certificate verification, so cached sessions are
+ * only handed over if the new configuration of the context is identical,
+ * including the keys, certificates and CRLs it has loaded.  Files are
+ * identified by their inode, size and modification times.
+ */
+static gchar *
+_calculate_config_digest(TLSContext *self)
+{
+  GChecksum *digest = g_checksum_new(G_CHECKSUM_SHA256);
+
+  _update_digest_with_int(digest, self->mode);
+  _update_digest_with_int(digest, self->verify_mode);
+  _update_digest_with_int(digest, self->ssl_options);
+  _update_digest_with_int(digest, self->ssl_version);
+  _update_digest_with_int(digest, self->ocsp_stapling_verify);
+  _update_digest_with_file(digest, self->key_file);
+  _update_digest_with_file(digest, self->cert_file);
+  _update_digest_with_file(digest, self->pkcs12_file);
+  _update_digest_with_file(digest, self->dhparam_file);
+  _update_digest_with_dir(digest, self->ca_dir);
+  _update_digest_with_dir(digest, self->crl_dir);
+  _update_digest_with_file(digest, self->ca_file);
+  _update_digest_with_string(digest, self->cipher_suite);
+  _update_digest_with_string(digest, self->tls13_cipher_suite);
+  _update_digest_with_string(digest, self->sigalgs);
+  _update_digest_with_string(digest, self->client_sigalgs);
+  _update_digest_with_string(digest, self->ecdh_curve_list);
+  _update_digest_with_string(digest, self->sni);
+  _update_digest_with_string_list(digest, self->conf_cmds_list);
+  _update_digest_with_string_list(digest, self->trusted_fingerprint_list);
+  _update_digest_with_string_list(digest, self->trusted_dn_list);
+
+  gchar *result = g_strdup(g_checksum_get_string(digest));
+  g_checksum_free(digest);
+  return result;
+}
+
+/* the files may change after they were loaded, so the digest is taken
+ * right after tls_context_setup_context() has loaded them */
+static void
+_store_config_digest(TLSContext *self)
+{
+  g_free(self->session_cache.config_digest);
+  self->session_cache.config_digest = _calculate_config_digest(self);
+}
+
+static void
+_save_ticket_keys(TLSContext *self, TLSSessionCacheState *state)
+{
+  glong keys_len = SSL_CTX_get_tlsext_ticket_keys(self->ssl_ctx, NULL, 0);
+
+  if (keys_len <= 0 || keys_len > (glong) sizeof(state->ticket_keys))
+    return;
+
+  if (SSL_CTX_get_tlsext_ticket_keys(self->ssl_ctx, state->ticket_keys, keys_len))
+    state->ticket_keys_len = keys_len;
+}
+
+TLSSessionCacheState *
+tls_context_save_session_cache(TLSContext *self)
+{
+  if (!self->ssl_ctx || !self->session_cache.config_digest)
+    return NULL;
+
+  TLSSessionCacheState *state = g_new0(TLSSessionCacheState, 1);
+  state->config_digest = g_strdup(self->session_cache.config_digest);
+
+  g_mutex_lock(&self->session_cache.lock);
+  if (self->session_cache.client_session)
+    {
+      state->client_session = self->session_cache.client_session;
+      SSL_SESSION_up_ref(state->client_session);
+    }
+  for (GList *l = self->session_cache.server_sessions_order.tail; l; l = l->prev)
+    {
+      TLSCachedSession *entry = l->data;
+
+      SSL_SESSION_up_ref(entry->session);
+      state->server_sessions = g_list_prepend(state->server_sessions, entry->session);
+    }
+  g_mutex_unlock(&self->session_cache.lock);
+
+  if (self->mode == TM_SERVER)
+    _save_ticket_keys(self, state);
+
+  return state;
+}
+
+void
+tls_context_restore_session_cache(TLSContext *self, TLSSessionCacheState *state)
+{
+  if (!self->ssl_ctx || !self->session_cache.config_digest)
+    return;
+
+  if (strcmp(self->session_cache.config_digest, state->config_digest) != 0)
+    {
+      msg_debug("TLS configuration changed, cached TLS sessions are not resumed",
+                tls_context_format_location_tag(self));
+      return;
+    }
+
+  if (state->ticket_keys_len)
+    SSL_CTX_set_tlsext_ticket_keys(self->ssl_ctx, state->ticket_keys, state->ticket_keys_len);
+
+  g_mutex_lock(&self->session_cache.lock);
+  if (state->client_session)
+    {
+      _client_cache_set(self, state->client_session);
+      state->client_session = NULL;
+    }
+  for (GList *l = state->server_sessions; l; l = l->next)
+    _server_cache_add(self, (SSL_SESSION *) l->data);
+  g_list_free(state->server_sessions);
+  state->server_sessions = NULL;
+  gint num_sessions = g_hash_table_size(self->session_cache.server_sessions)
+                      + (self->session_cache.client_session ? 1 : 0);
+  g_mutex_unlock(&self->session_cache.lock);
+
+  msg_debug("Cached TLS sessions restored",
+            evt_tag_int("sessions", num_sessions),
+            tls_context_format_location_tag(self));
+}
+
+void
+tls_session_cache_state_free(TLSSessionCacheState *state)
+{
+  if (state->client_session)
+    SSL_SESSION_free(state->client_session);
+  g_list_free_full(state->server_sessions, (GDestroyNotify) SSL_SESSION_free);
+  OPENSSL_cleanse(state->ticket_keys, sizeof(state->ticket_keys));
+  g_free(state->config_digest);
+  g_free(state);
+}
+
 static void
 tls_context_setup_verify_mode(TLSContext *self)
 {
@@ -236,6 +668,13 @@ tls_context_setup_ssl_options(TLSContext *self)
         ssl_options |= SSL_OP_IGNORE_UNEXPECTED_EOF;
 #endif
 
+#ifdef SSL_OP_ENABLE_KTLS
+      /* OpenSSL only uses kTLS if the kernel supports the negotiated
+       * cipher, otherwise it silently falls back to userspace encryption */
+      if (self->ssl_options & TSO_ENABLE_KTLS)
+        ssl_options |= SSL_OP_ENABLE_KTLS;
+#endif
+
 
 #ifdef SSL_OP_CIPHER_SERVER_PREFERENCE
       if (self->mode == TM_SERVER)
@@ -615,6 +1054,7 @@ tls_context_setup_context(TLSContext *self)
   if (!tls_context_setup_cmd_context(self))
     goto error;
 
+  _store_config_digest(self);
   return TLS_CONTEXT_SETUP_OK;
 
 error:
@@ -650,6 +1090,9 @@ tls_context_setup_session(TLSContext *self)
       g_assert(ocsp_enabled);
     }
 
+  if (self->mode == TM_CLIENT)
+    _offer_cached_session(self, ssl);
+
   TLSSession *session = tls_session_new(ssl, self);
   if (!session)
     {
@@ -661,6 +1104,12 @@ tls_context_setup_session(TLSContext *self)
   return session;
 }
 
+void
+tls_context_count_handshake(TLSContext *self, gboolean resumed)
+{
+  stats_counter_inc(resumed ? self->metrics.resumed_handshakes : self->metrics.full_handshakes);
+}
+
 gboolean
 tls_context_set_verify_mode_by_name(TLSContext *self, const gchar *mode_str)
 {
@@ -729,6 +1178,10 @@ tls_context_set_ssl_options_by_name(TLSContext *self, GList *options)
 #ifdef SSL_OP_IGNORE_UNEXPECTED_EOF
       else if (strcasecmp(l->data, "ignore-unexpected-eof") == 0 || strcasecmp(l->data, "ignore_unexpected_eof") == 0)
         self->ssl_options |= TSO_IGNORE_UNEXPECTED_EOF;
+#endif
+#ifdef SSL_OP_ENABLE_KTLS
+      else if (strcasecmp(l->data, "enable-ktls") == 0 || strcasecmp(l->data, "enable_ktls") == 0)
+        self->ssl_options |= TSO_ENABLE_KTLS;
 #endif
       else if (strcasecmp(l->data, "ignore-hostname-mismatch") == 0 || strcasecmp(l->data, "ignore_hostname_mismatch") == 0)
         self->ssl_options |= TSO_IGNORE_HOSTNAME_MISMATCH;
@@ -753,6 +1206,12 @@ tls_context_set_verify_mode(TLSContext *self, gint verify_mode)
   self->verify_mode = verify_mode;
 }
 
+gboolean
+tls_context_ktls_enabled(TLSContext *self)
+{
+  return self->ssl_options & TSO_ENABLE_KTLS;
+}
+
 gboolean
 tls_context_ignore_hostname_mismatch(TLSContext *self)
 {
@@ -940,6 +1399,65 @@ tls_context_set_ocsp_stapling_verify(TLSContext *self, gboolean ocsp_stapling_ve
 }
 
 /* NOTE: location is a string description where this tls context was defined, e.g. the location in the config */
+static void
+_format_ktls_stats_key(TLSContext *self, StatsClusterKey *sc_key, StatsClusterLabel *labels, const gchar *direction)
+{
+  labels[0] = stats_cluster_label("mode", self->mode == TM_CLIENT ? "client" : "server");
+  labels[1] = stats_cluster_label("direction", direction);
+  stats_cluster_single_key_set(sc_key, "tls_ktls_connections", labels, 2);
+}
+
+static void
+_format_handshake_stats_key(TLSContext *self, StatsClusterKey *sc_key, StatsClusterLabel *labels,
+                            const gchar *handshake)
+{
+  labels[0] = stats_cluster_label("mode", self->mode == TM_CLIENT ? "client" : "server");
+  labels[1] = stats_cluster_label("handshake", handshake);
+  stats_cluster_single_key_set(sc_key, "tls_handshakes_total", labels, 2);
+}
+
+static void
+_register_stats(TLSContext *self)
+{
+  StatsClusterLabel labels[2];
+  StatsClusterKey sc_key;
+
+  stats_lock();
+  _format_ktls_stats_key(self, &sc_key, labels, "send");
+  stats_register_counter(1, &sc_key, SC_TYPE_SINGLE_VALUE, &self->metrics.ktls_send_connections);
+
+  _format_ktls_stats_key(self, &sc_key, labels, "receive");
+  stats_register_counter(1, &sc_key, SC_TYPE_SINGLE_VALUE, &self->metrics.ktls_recv_connections);
+
+  _format_handshake_stats_key(self, &sc_key, labels, "full");
+  stats_register_counter(1, &sc_key, SC_TYPE_SINGLE_VALUE, &self->metrics.full_handshakes);
+
+  _format_handshake_stats_key(self, &sc_key, labels, "resumed");
+  stats_register_counter(1, &sc_key, SC_TYPE_SINGLE_VALUE, &self->metrics.resumed_handshakes);
+  stats_unlock();
+}
+
+static void
+_unregister_stats(TLSContext *self)
+{
+  StatsClusterLabel labels[2];
+  StatsClusterKey sc_key;
+
+  stats_lock();
+  _format_ktls_stats_key(self, &sc_key, labels, "send");
+  stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, &self->metrics.ktls_send_connections);
+
+  _format_ktls_stats_key(self, &sc_key, labels, "receive");
+  stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, &self->metrics.ktls_recv_connections);
+
+  _format_handshake_stats_key(self, &sc_key, labels, "full");
+  stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, &self->metrics.full_handshakes);
+
+  _format_handshake_stats_key(self, &sc_key, labels, "resumed");
+  stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, &self->metrics.resumed_handshakes);
+  stats_unlock();
+}
+
 TLSContext *
 tls_context_new(TLSMode mode, const gchar *location)
 {
@@ -959,6 +1477,8 @@ tls_context_new(TLSMode mode, const gchar *location)
       SSL_CTX_set_session_id_context(self->ssl_ctx, (const unsigned char *) "syslog", 6);
     }
   SSL_CTX_set_app_data(self->ssl_ctx, self);
+  tls_context_setup_session_cache(self);
+  _register_stats(self);
 
   return self;
 }
@@ -966,8 +1486,10 @@ tls_context_new(TLSMode mode, const gchar *location)
 static void
 _tls_context_free(TLSContext *self)
 {
+  _unregister_stats(self);
   g_free(self->location);
   SSL_CTX_free(self->ssl_ctx);
+  tls_context_free_session_cache(self);
   string_list_free(self->conf_cmds_list);
   string_list_free(self->trusted_fingerprint_list);
   string_list_free(self->trusted_dn_list);
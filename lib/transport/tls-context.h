@@ -26,6 +26,7 @@
 
 #include "transport/tls-verifier.h"
 #include "transport/tls-session.h"
+#include "stats/stats-counter.h"
 #include "messages.h"
 
 typedef enum
@@ -56,6 +57,7 @@ typedef enum
   TSO_IGNORE_UNEXPECTED_EOF=0x0040,
   TSO_IGNORE_HOSTNAME_MISMATCH=0x0080,
   TSO_IGNORE_VALIDITY_PERIOD=0x0100,
+  TSO_ENABLE_KTLS=0x0200,
 } TLSSslOptions;
 
 typedef enum
@@ -65,6 +67,12 @@ typedef enum
   TLS_CONTEXT_SETUP_BAD_PASSWORD
 } TLSContextSetupResult;
 
+/* maximum number of sessions in the session-ID cache of server contexts */
+#define TLS_CONTEXT_SESSION_CACHE_SIZE 1024
+
+/* cached sessions handed over to the TLSContext of the next configuration */
+typedef struct _TLSSessionCacheState TLSSessionCacheState;
+
 struct _TLSContext
 {
   GAtomicCounter ref_cnt;
@@ -98,6 +106,27 @@ struct _TLSContext
   gint ssl_options;
   gint ssl_version;
   gchar *location;
+
+  struct
+  {
+    GMutex lock;
+    /* client mode: the session of the last handshake, offered when reconnecting */
+    SSL_SESSION *client_session;
+    /* server mode: session-ID cache, keyed by the session ID, oldest first in the queue */
+    GHashTable *server_sessions;
+    GQueue server_sessions_order;
+    /* configuration and loaded files, cached sessions are only handed over if it matches */
+    gchar *config_digest;
+  } session_cache;
+
+  struct
+  {
+    /* number of connections where the kernel encrypts/decrypts the records */
+    StatsCounterItem *ktls_send_connections;
+    StatsCounterItem *ktls_recv_connections;
+    StatsCounterItem *full_handshakes;
+    StatsCounterItem *resumed_handshakes;
+  } metrics;
 };
 
 
@@ -122,6 +151,7 @@ gint tls_context_get_verify_mode(const TLSContext *self);
 void tls_context_set_verify_mode(TLSContext *self, gint verify_mode);
 gboolean tls_context_ignore_hostname_mismatch(TLSContext *self);
 gboolean tls_context_ignore_validity_period(TLSContext *self);
+gboolean tls_context_ktls_enabled(TLSContext *self);
 void tls_context_set_key_file(TLSContext *self, const gchar *key_file);
 void tls_context_set_cert_file(TLSContext *self, const gchar *cert_file);
 gboolean tls_context_set_keylog_file(TLSContext *self, gchar *keylog_file_path, GError **error);
@@ -144,6 +174,10 @@ EVTTAG *tls_context_format_location_tag(TLSContext *self);
 gboolean tls_context_verify_peer(TLSContext *self, X509 *peer_cert, const gchar *peer_name);
 TLSContextSetupResult tls_context_setup_context(TLSContext *self);
 TLSSession *tls_context_setup_session(TLSContext *self);
+void tls_context_count_handshake(TLSContext *self, gboolean resumed);
+TLSSessionCacheState *tls_context_save_session_cache(TLSContext *self);
+void tls_context_restore_session_cache(TLSContext *self, TLSSessionCacheState *state);
+void tls_session_cache_state_free(TLSSessionCacheState *state);
 TLSContext *tls_context_new(TLSMode mode, const gchar *config_location);
 TLSContext *tls_context_ref(TLSContext *self);
 void tls_context_unref(TLSContext *self);
@@ -541,6 +541,13 @@ tls_session_info_callback(const SSL *ssl, int where, int ret)
           X509_free(cert);
         }
     }
+
+  /* renegotiations are not counted, only the initial handshake */
+  if ((where & SSL_CB_HANDSHAKE_DONE) && !self->handshake_done)
+    {
+      self->handshake_done = TRUE;
+      tls_context_count_handshake(self->ctx, SSL_session_reused((SSL *) ssl));
+    }
 }
 
 static gboolean
@@ -36,6 +36,7 @@ typedef struct _TLSSession
   SSL *ssl;
   TLSContext *ctx;
   TLSVerifier *verifier;
+  gboolean handshake_done;
   struct
   {
     int found;
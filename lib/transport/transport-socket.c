@@ -28,6 +28,7 @@
 #include <errno.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/uio.h>
 
 static gint
 _determine_address_family(gint fd)
@@ -193,7 +194,7 @@ log_transport_socket_read_method(LogTransport *s, gpointer buf, gsize buflen, Lo
   return rc;
 }
 
-static gssize
+gssize
 log_transport_socket_write_method(LogTransport *s, const gpointer buf, gsize buflen)
 {
   LogTransportSocket *self = (LogTransportSocket *) s;
@@ -234,9 +235,158 @@ log_transport_socket_free_method(LogTransport *s)
   log_transport_free_method(s);
 }
 
+#ifdef SYSLOG_NG_HAVE_RECVMMSG
+
+/* upper limit for the buffers of the received datagrams */
+#define LOG_TRANSPORT_DGRAM_RECV_BATCH_MEMORY (1024 * 1024)
+
+typedef struct _LogTransportDGramRecvSlot
+{
+  struct sockaddr_storage ss;
+  gchar ctlbuf[256];
+} LogTransportDGramRecvSlot;
+
+/*
+ * Datagrams received by a single recvmmsg() call, returned one-by-one by
+ * subsequent read() calls.  Each datagram keeps its own msghdr, so the
+ * peer address and the control messages are extracted at the time the
+ * datagram is returned.
+ */
+struct _LogTransportDGramRecvBatch
+{
+  gint size;
+  gsize slot_size;
+  /* next datagram to return and the number of datagrams received */
+  gint pos;
+  gint count;
+  struct mmsghdr *msgs;
+  struct iovec *iov;
+  LogTransportDGramRecvSlot *slots;
+  gchar *buffers;
+};
+
+static LogTransportDGramRecvBatch *
+_recv_batch_new(gint size, gsize slot_size)
+{
+  LogTransportDGramRecvBatch *self = g_new0(LogTransportDGramRecvBatch, 1);
+
+  self->size = size;
+  self->slot_size = slot_size;
+  self->msgs = g_new0(struct mmsghdr, size);
+  self->iov = g_new0(struct iovec, size);
+  self->slots = g_new0(LogTransportDGramRecvSlot, size);
+  self->buffers = g_malloc(size * slot_size);
+  return self;
+}
+
+static void
+_recv_batch_free(LogTransportDGramRecvBatch *self)
+{
+  g_free(self->msgs);
+  g_free(self->iov);
+  g_free(self->slots);
+  g_free(self->buffers);
+  g_free(self);
+}
+
+static gint
+_recv_batch_calculate_size(LogTransportSocket *self, gsize slot_size)
+{
+  gint size = LOG_TRANSPORT_DGRAM_RECV_BATCH_MEMORY / MAX(slot_size, 1);
+
+  return CLAMP(size, 1, self->recv_batch_size);
+}
+
+static gint
+_recv_batch_receive(LogTransportSocket *self, LogTransportDGramRecvBatch *batch)
+{
+  gint rc;
+
+  /* the kernel updates the lengths, they need to be reset before each call */
+  for (gint i = 0; i < batch->size; i++)
+    {
+      struct msghdr *msg = &batch->msgs[i].msg_hdr;
+
+      batch->iov[i].iov_base = batch->buffers + i * batch->slot_size;
+      batch->iov[i].iov_len = batch->slot_size;
+      msg->msg_iov = &batch->iov[i];
+      msg->msg_iovlen = 1;
+      msg->msg_name = (struct sockaddr *) &batch->slots[i].ss;
+      msg->msg_namelen = sizeof(batch->slots[i].ss);
+#if defined(SYSLOG_NG_HAVE_CTRLBUF_IN_MSGHDR)
+      msg->msg_control = batch->slots[i].ctlbuf;
+      msg->msg_controllen = sizeof(batch->slots[i].ctlbuf);
+#endif
+      msg->msg_flags = 0;
+      batch->msgs[i].msg_len = 0;
+    }
+
+  do
+    {
+      rc = recvmmsg(self->super.fd, batch->msgs, batch->size, 0, NULL);
+    }
+  while (rc == -1 && errno == EINTR);
+
+  batch->pos = 0;
+  batch->count = MAX(rc, 0);
+  return rc;
+}
+
+static gssize
+_read_from_recv_batch(LogTransportSocket *self, gpointer buf, gsize buflen, LogTransportAuxData *aux)
+{
+  LogTransportDGramRecvBatch *batch = self->recv_batch;
+
+  while (1)
+    {
+      if (!batch || batch->pos >= batch->count)
+        {
+          /* the buffers are sized for the reader's buffer, reallocate if it grew */
+          if (batch && batch->slot_size < buflen)
+            {
+              _recv_batch_free(batch);
+              batch = self->recv_batch = NULL;
+            }
+          if (!batch)
+            batch = self->recv_batch = _recv_batch_new(_recv_batch_calculate_size(self, buflen), buflen);
+
+          if (_recv_batch_receive(self, batch) < 0)
+            return -1;
+        }
+
+      struct mmsghdr *mmsg = &batch->msgs[batch->pos++];
+
+      /* DGRAM sockets should never return EOF, skip empty datagrams */
+      if (mmsg->msg_len == 0)
+        continue;
+
+      gsize len = MIN(mmsg->msg_len, buflen);
+      memcpy(buf, batch->iov[batch->pos - 1].iov_base, len);
+      _extract_from_msghdr_method(self, &mmsg->msg_hdr, aux);
+      return len;
+    }
+}
+
+static gboolean
+log_transport_dgram_socket_has_pending_input(LogTransport *s)
+{
+  LogTransportSocket *self = (LogTransportSocket *) s;
+
+  return self->recv_batch && self->recv_batch->pos < self->recv_batch->count;
+}
+
+#endif
+
 static gssize
 log_transport_dgram_socket_read_method(LogTransport *s, gpointer buf, gsize buflen, LogTransportAuxData *aux)
 {
+#ifdef SYSLOG_NG_HAVE_RECVMMSG
+  LogTransportSocket *self = (LogTransportSocket *) s;
+
+  if (self->recv_batch_size > 1)
+    return _read_from_recv_batch(self, buf, buflen, aux);
+#endif
+
   gssize rc = log_transport_socket_read_method(s, buf, buflen, aux);
   if (rc == 0)
     {
@@ -268,6 +418,48 @@ log_transport_dgram_socket_write_method(LogTransport *s, const gpointer buf, gsi
   return rc;
 }
 
+static gint
+log_transport_dgram_socket_write_datagrams_method(LogTransport *s, struct iovec *iov, gint iov_per_datagram,
+                                                  gint count)
+{
+  gint rc;
+
+#ifdef SYSLOG_NG_HAVE_SENDMMSG
+  struct mmsghdr msgs[LOG_TRANSPORT_DGRAM_SEND_BATCH_MAX];
+
+  count = MIN(count, LOG_TRANSPORT_DGRAM_SEND_BATCH_MAX);
+  memset(msgs, 0, sizeof(msgs[0]) * count);
+  for (gint i = 0; i < count; i++)
+    {
+      msgs[i].msg_hdr.msg_iov = &iov[i * iov_per_datagram];
+      msgs[i].msg_hdr.msg_iovlen = iov_per_datagram;
+    }
+
+  do
+    {
+      rc = sendmmsg(s->fd, msgs, count, 0);
+    }
+  while (rc == -1 && errno == EINTR);
+#else
+  struct msghdr msg = { .msg_iov = iov, .msg_iovlen = iov_per_datagram };
+
+  do
+    {
+      rc = sendmsg(s->fd, &msg, 0);
+    }
+  while (rc == -1 && errno == EINTR);
+
+  if (rc >= 0)
+    rc = 1;
+#endif
+
+  /* sendmmsg() only fails if the first datagram could not be sent, drop
+   * it on ENOBUFS, see log_transport_dgram_socket_write_method() */
+  if (rc < 0 && errno == ENOBUFS)
+    return 1;
+  return rc;
+}
+
 void
 log_transport_socket_set_proxied(LogTransportSocket *self, LogTransportSocketProxy *proxy)
 {
@@ -277,12 +469,41 @@ log_transport_socket_set_proxied(LogTransportSocket *self, LogTransportSocketPro
   self->proxy = proxy;
 }
 
+void
+log_transport_dgram_socket_set_recv_batch_size(LogTransportSocket *self, gint batch_size)
+{
+#ifdef SYSLOG_NG_HAVE_RECVMMSG
+  self->recv_batch_size = CLAMP(batch_size, 1, LOG_TRANSPORT_DGRAM_RECV_BATCH_MAX);
+#else
+  self->recv_batch_size = 1;
+#endif
+}
+
+void
+log_transport_dgram_socket_free_method(LogTransport *s)
+{
+#ifdef SYSLOG_NG_HAVE_RECVMMSG
+  LogTransportSocket *self = (LogTransportSocket *) s;
+
+  if (self->recv_batch)
+    _recv_batch_free(self->recv_batch);
+  self->recv_batch = NULL;
+#endif
+  log_transport_socket_free_method(s);
+}
+
 void
 log_transport_dgram_socket_init_instance(LogTransportSocket *self, gint fd)
 {
   log_transport_socket_init_instance(self, fd);
   self->super.read = log_transport_dgram_socket_read_method;
   self->super.write = log_transport_dgram_socket_write_method;
+  self->super.write_datagrams = log_transport_dgram_socket_write_datagrams_method;
+  self->super.free_fn = log_transport_dgram_socket_free_method;
+#ifdef SYSLOG_NG_HAVE_RECVMMSG
+  self->super.has_pending_input = log_transport_dgram_socket_has_pending_input;
+#endif
+  log_transport_dgram_socket_set_recv_batch_size(self, LOG_TRANSPORT_DGRAM_RECV_BATCH_MAX);
 }
 
 LogTransport *
@@ -294,6 +515,19 @@ log_transport_dgram_socket_new(gint fd)
   return &self->super;
 }
 
+gssize
+log_transport_stream_socket_writev_method(LogTransport *s, struct iovec *iov, gint iov_count)
+{
+  gint rc;
+
+  do
+    {
+      rc = writev(s->fd, iov, iov_count);
+    }
+  while (rc == -1 && errno == EINTR);
+  return rc;
+}
+
 void
 log_transport_stream_socket_free_method(LogTransport *s)
 {
@@ -309,6 +543,7 @@ log_transport_stream_socket_init_instance(LogTransportSocket *self, gint fd)
            && "log_transport_stream_socket_init_instance must be called before log_transport_socket_set_proxied ");
 
   log_transport_socket_init_instance(self, fd);
+  self->super.writev = log_transport_stream_socket_writev_method;
   self->super.free_fn = log_transport_stream_socket_free_method;
 }
 
@@ -29,6 +29,13 @@
 #include "logtransport.h"
 #include "transport-socket-proxy.h"
 
+/* maximum number of datagrams received with a single recvmmsg() call */
+#define LOG_TRANSPORT_DGRAM_RECV_BATCH_MAX 64
+/* maximum number of datagrams sent with a single sendmmsg() call */
+#define LOG_TRANSPORT_DGRAM_SEND_BATCH_MAX 64
+
+typedef struct _LogTransportDGramRecvBatch LogTransportDGramRecvBatch;
+
 typedef struct _LogTransportSocket LogTransportSocket;
 struct _LogTransportSocket
 {
@@ -37,15 +44,24 @@ struct _LogTransportSocket
   gint proto;
   void (*parse_cmsg)(LogTransportSocket *self, struct cmsghdr *cmsg, LogTransportAuxData *aux);
   LogTransportSocketProxy *proxy;
+
+  /* DGRAM sockets: datagrams received in advance, see
+   * log_transport_dgram_socket_set_recv_batch_size() */
+  gint recv_batch_size;
+  LogTransportDGramRecvBatch *recv_batch;
 };
 
 void log_transport_socket_parse_cmsg_method(LogTransportSocket *s, struct cmsghdr *cmsg, LogTransportAuxData *aux);
+gssize log_transport_socket_write_method(LogTransport *s, const gpointer buf, gsize buflen);
 
 void log_transport_dgram_socket_init_instance(LogTransportSocket *self, gint fd);
+void log_transport_dgram_socket_free_method(LogTransport *s);
+void log_transport_dgram_socket_set_recv_batch_size(LogTransportSocket *self, gint batch_size);
 LogTransport *log_transport_dgram_socket_new(gint fd);
 
 void log_transport_stream_socket_init_instance(LogTransportSocket *self, gint fd);
 void log_transport_stream_socket_free_method(LogTransport *s);
+gssize log_transport_stream_socket_writev_method(LogTransport *s, struct iovec *iov, gint iov_count);
 LogTransport *log_transport_stream_socket_new(gint fd);
 
 void log_transport_socket_set_proxied(LogTransportSocket *self, LogTransportSocketProxy *proxy);
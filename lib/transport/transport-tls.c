@@ -35,8 +35,89 @@ typedef struct _LogTransportTLS
   LogTransportSocket super;
   TLSSession *tls_session;
   gboolean sending_shutdown;
+
+  /* kTLS state, detected after the handshake */
+  gboolean ktls_detected;
+  gboolean ktls_send;
+  gboolean ktls_recv;
+
+  /* the buffers of a writev() are coalesced here, see log_transport_tls_writev_method() */
+  GString *writev_buffer;
 } LogTransportTLS;
 
+/* don't keep a coalescing buffer larger than this around between writes */
+#define LOG_TRANSPORT_TLS_WRITEV_BUFFER_KEEP (256 * 1024)
+
+#ifdef SSL_OP_ENABLE_KTLS
+
+static void
+log_transport_tls_detect_ktls(LogTransportTLS *self)
+{
+  SSL *ssl = self->tls_session->ssl;
+  TLSContext *ctx = self->tls_session->ctx;
+
+  self->ktls_detected = TRUE;
+  if (!tls_context_ktls_enabled(ctx))
+    return;
+
+  self->ktls_send = BIO_get_ktls_send(SSL_get_wbio(ssl));
+  self->ktls_recv = BIO_get_ktls_recv(SSL_get_rbio(ssl));
+
+  if (self->ktls_send)
+    stats_counter_inc(ctx->metrics.ktls_send_connections);
+  if (self->ktls_recv)
+    stats_counter_inc(ctx->metrics.ktls_recv_connections);
+
+  msg_debug("TLS connection established, kernel TLS offload status",
+            evt_tag_str("cipher", SSL_get_cipher_name(ssl)),
+            evt_tag_str("ktls_send", self->ktls_send ? "enabled" : "unavailable"),
+            evt_tag_str("ktls_receive", self->ktls_recv ? "enabled" : "unavailable"),
+            evt_tag_int("fd", self->super.super.fd),
+            tls_context_format_location_tag(ctx));
+}
+
+/*
+ * When the kernel encrypts the records, application data can be written
+ * to the socket directly, which also makes scatter-gather writes
+ * possible.  Reading continues via SSL_read(): with kTLS it is a thin
+ * wrapper around recvmsg(), which also takes care of the non-application
+ * records (alerts, session tickets, key updates) that a plain read()
+ * would fail on.
+ */
+static inline void
+log_transport_tls_check_ktls(LogTransportTLS *self, gboolean write_completed)
+{
+  if (G_UNLIKELY(!self->ktls_detected) && SSL_is_init_finished(self->tls_session->ssl))
+    log_transport_tls_detect_ktls(self);
+
+  /* an SSL_write() returning WANT_READ/WANT_WRITE has to be retried with
+   * SSL_write(), so the write methods are only switched once a write
+   * completed */
+  if (G_UNLIKELY(self->ktls_send && write_completed && self->super.super.write != log_transport_socket_write_method))
+    {
+      self->super.super.write = log_transport_socket_write_method;
+      self->super.super.writev = log_transport_stream_socket_writev_method;
+    }
+}
+
+static void
+log_transport_tls_release_ktls(LogTransportTLS *self)
+{
+  TLSContext *ctx = self->tls_session->ctx;
+
+  if (self->ktls_send)
+    stats_counter_dec(ctx->metrics.ktls_send_connections);
+  if (self->ktls_recv)
+    stats_counter_dec(ctx->metrics.ktls_recv_connections);
+}
+
+#else
+
+#define log_transport_tls_check_ktls(self, write_completed)
+#define log_transport_tls_release_ktls(self)
+
+#endif
+
 static inline gboolean
 _is_shutdown_sent(gint shutdown_rc)
 {
@@ -159,7 +240,10 @@ log_transport_tls_read_method(LogTransport *s, gpointer buf, gsize buflen, LogTr
   while (rc == -1 && errno == EINTR);
 
   if (rc > 0)
-    self->super.super.cond = 0;
+    {
+      self->super.super.cond = 0;
+      log_transport_tls_check_ktls(self, FALSE);
+    }
 
   return rc;
 tls_error:
@@ -222,6 +306,7 @@ log_transport_tls_write_method(LogTransport *s, const gpointer buf, gsize buflen
   else
     {
       self->super.super.cond = 0;
+      log_transport_tls_check_ktls(self, TRUE);
     }
 
   return rc;
@@ -237,6 +322,57 @@ tls_error:
   return -1;
 }
 
+/*
+ * SSL_write() has no scatter-gather variant, writing the buffers one by one
+ * would turn every framed batch into a short write of its first buffer
+ * (usually the frame header), so they are copied into one buffer and
+ * written with a single SSL_write().
+ *
+ * A write that returned WANT_READ/WANT_WRITE is retried by the caller with
+ * the same (or an extended) list of buffers, which is coalesced again, the
+ * address of the buffer may change in between, see
+ * SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER in log_transport_tls_new().
+ */
+static gssize
+log_transport_tls_writev_method(LogTransport *s, struct iovec *iov, gint iov_count)
+{
+  LogTransportTLS *self = (LogTransportTLS *) s;
+  gint first = -1, non_empty = 0;
+
+  for (gint i = 0; i < iov_count; i++)
+    {
+      if (iov[i].iov_len == 0)
+        continue;
+
+      if (first < 0)
+        first = i;
+      non_empty++;
+    }
+
+  if (non_empty == 0)
+    return 0;
+
+  if (non_empty == 1)
+    return log_transport_tls_write_method(s, iov[first].iov_base, iov[first].iov_len);
+
+  if (!self->writev_buffer)
+    self->writev_buffer = g_string_sized_new(4096);
+
+  g_string_truncate(self->writev_buffer, 0);
+  for (gint i = first; i < iov_count; i++)
+    g_string_append_len(self->writev_buffer, iov[i].iov_base, iov[i].iov_len);
+
+  gssize rc = log_transport_tls_write_method(s, self->writev_buffer->str, self->writev_buffer->len);
+
+  /* libssl keeps its own copy of the records it could not send yet */
+  if (self->writev_buffer->allocated_len > LOG_TRANSPORT_TLS_WRITEV_BUFFER_KEEP)
+    {
+      g_string_free(self->writev_buffer, TRUE);
+      self->writev_buffer = NULL;
+    }
+
+  return rc;
+}
 
 static void log_transport_tls_free_method(LogTransport *s);
 
@@ -249,10 +385,14 @@ log_transport_tls_new(TLSSession *tls_session, gint fd)
   self->super.super.cond = 0;
   self->super.super.read = log_transport_tls_read_method;
   self->super.super.write = log_transport_tls_write_method;
+  /* replaced by the socket writev once the kernel takes over encryption,
+   * see log_transport_tls_check_ktls() */
+  self->super.super.writev = log_transport_tls_writev_method;
   self->super.super.free_fn = log_transport_tls_free_method;
   self->tls_session = tls_session;
 
   SSL_set_fd(self->tls_session->ssl, fd);
+  SSL_set_mode(self->tls_session->ssl, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
   return &self->super.super;
 }
 
@@ -261,6 +401,9 @@ log_transport_tls_free_method(LogTransport *s)
 {
   LogTransportTLS *self = (LogTransportTLS *) s;
 
+  log_transport_tls_release_ktls(self);
+  if (self->writev_buffer)
+    g_string_free(self->writev_buffer, TRUE);
   tls_session_free(self->tls_session);
   log_transport_stream_socket_free_method(s);
 }
@@ -24,6 +24,7 @@
 
 #include "queue_utils_lib.h"
 #include "logmsg/logmsg-serialize.h"
+#include "mainloop-worker.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -101,3 +102,62 @@ send_some_messages(LogQueue *q, gint n, gboolean remove_from_backlog)
       log_msg_unref(msg);
     }
 }
+
+/* Emulates an input worker thread: messages are put on the per-thread
+ * input queue of @q and are flushed to the queue every @batch_size
+ * messages, just like a LogReader would do at the end of a fetch loop.
+ *
+ * Must be called from a thread that has no worker identity yet. */
+void
+feed_messages_as_worker(LogQueue *q, const LogPathOptions *path_options, gint n, gint batch_size)
+{
+  iv_init();
+  main_loop_worker_thread_start(MLW_ASYNC_WORKER);
+
+  for (gint i = 0; i < n; i++)
+    {
+      LogMessage *msg = log_msg_new_empty();
+
+      log_msg_add_ack(msg, path_options);
+      msg->ack_func = test_ack;
+      log_queue_push_tail(q, msg, path_options);
+
+      if ((i + 1) % batch_size == 0)
+        main_loop_worker_invoke_batch_callbacks();
+    }
+  main_loop_worker_invoke_batch_callbacks();
+
+  main_loop_worker_thread_stop();
+  iv_deinit();
+}
+
+/* pops, acks and frees @n messages, waiting for the producers if the queue
+ * is temporarily empty, returns the number of messages consumed */
+gint
+consume_messages(LogQueue *q, gint n)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  gint consumed = 0;
+  gint idle_loops = 0;
+
+  while (consumed < n)
+    {
+      LogMessage *msg = log_queue_pop_head(q, &path_options);
+
+      if (!msg)
+        {
+          /* 10 seconds without progress, give up */
+          if (++idle_loops > 100000)
+            break;
+          g_usleep(100);
+          continue;
+        }
+
+      idle_loops = 0;
+      log_msg_ack(msg, &path_options, AT_PROCESSED);
+      log_queue_ack_backlog(q, 1);
+      log_msg_unref(msg);
+      consumed++;
+    }
+  return consumed;
+}
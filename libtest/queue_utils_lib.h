@@ -37,5 +37,8 @@ void feed_some_messages(LogQueue *q, int n);
 
 void send_some_messages(LogQueue *q, gint n, gboolean remove_from_backlog);
 
+void feed_messages_as_worker(LogQueue *q, const LogPathOptions *path_options, gint n, gint batch_size);
+gint consume_messages(LogQueue *q, gint n);
+
 gsize get_one_message_serialized_size(void);
 #endif
@@ -0,0 +1,271 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "file-content-watch.h"
+#include "messages.h"
+
+#if SYSLOG_NG_HAVE_INOTIFY
+
+#include <iv_inotify.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+
+#define FILE_CONTENT_WATCH_MASK (IN_MODIFY | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF)
+
+/* inotify reports changes done through the local kernel only, files on
+ * these filesystems can be modified by other hosts as well */
+static const guint32 network_filesystem_magics[] =
+{
+  0x00006969, /* NFS */
+  0x0000517b, /* SMB */
+  0xff534d42, /* CIFS */
+  0xfe534d42, /* SMB2 */
+  0x00c36400, /* Ceph */
+  0x01021997, /* 9P */
+  0x5346414f, /* AFS */
+  0x6b414653, /* kAFS */
+  0x47504653, /* GPFS */
+  0x0bd00bd0, /* Lustre */
+  0x19830326, /* BeeGFS */
+  0x65735546, /* FUSE, e.g. sshfs */
+};
+
+/* inotify watches are per inode, a file followed by multiple readers is
+ * watched only once, and the event is dispatched to all of them */
+typedef struct _WatchedInode
+{
+  dev_t dev;
+  ino_t ino;
+  gchar *pathname;
+  struct iv_inotify_watch watch;
+  gboolean watch_removed;
+  GList *watches;
+} WatchedInode;
+
+struct _FileContentWatch
+{
+  WatchedInode *inode;
+  FileContentWatchCallback callback;
+  gpointer user_data;
+};
+
+static struct iv_inotify content_inotify;
+static GHashTable *watched_inodes;
+
+static gboolean
+_is_on_network_filesystem(gint fd)
+{
+  struct statfs st;
+
+  if (fstatfs(fd, &st) < 0)
+    return TRUE;
+
+  for (gint i = 0; i < G_N_ELEMENTS(network_filesystem_magics); i++)
+    {
+      if ((guint32) st.f_type == network_filesystem_magics[i])
+        return TRUE;
+    }
+  return FALSE;
+}
+
+static guint
+_inode_hash(gconstpointer k)
+{
+  const WatchedInode *inode = (const WatchedInode *) k;
+  guint64 ino = inode->ino;
+
+  return (guint) (ino ^ (ino >> 32) ^ inode->dev);
+}
+
+static gboolean
+_inode_equal(gconstpointer a, gconstpointer b)
+{
+  const WatchedInode *inode_a = (const WatchedInode *) a;
+  const WatchedInode *inode_b = (const WatchedInode *) b;
+
+  return inode_a->ino == inode_b->ino && inode_a->dev == inode_b->dev;
+}
+
+static gboolean
+_ensure_inotify(void)
+{
+  if (watched_inodes)
+    return TRUE;
+
+  IV_INOTIFY_INIT(&content_inotify);
+  if (iv_inotify_register(&content_inotify) < 0)
+    {
+      msg_warning_once("WARNING: could not create inotify object for following files, falling back to polling, "
+                       "you may need to increase /proc/sys/fs/inotify/max_user_instances",
+                       evt_tag_error("error"));
+      return FALSE;
+    }
+  watched_inodes = g_hash_table_new(_inode_hash, _inode_equal);
+  return TRUE;
+}
+
+static void
+_release_inotify_if_unused(void)
+{
+  if (g_hash_table_size(watched_inodes) > 0)
+    return;
+
+  g_hash_table_destroy(watched_inodes);
+  watched_inodes = NULL;
+  iv_inotify_unregister(&content_inotify);
+}
+
+static void
+_handle_event(gpointer s, struct inotify_event *event)
+{
+  WatchedInode *inode = (WatchedInode *) s;
+
+  /* the watch is already dropped by the kernel (e.g. the filesystem was unmounted) */
+  if (event->mask & IN_IGNORED)
+    inode->watch_removed = TRUE;
+
+  for (GList *l = inode->watches; l; l = l->next)
+    {
+      FileContentWatch *watch = (FileContentWatch *) l->data;
+      watch->callback(watch->user_data);
+    }
+}
+
+static WatchedInode *
+_watched_inode_new(gint fd, struct stat *st)
+{
+  WatchedInode *inode = g_new0(WatchedInode, 1);
+
+  inode->dev = st->st_dev;
+  inode->ino = st->st_ino;
+
+  /* the magic link resolves to the open file, even if it was renamed or
+   * deleted in the meantime */
+  inode->pathname = g_strdup_printf("/proc/self/fd/%d", fd);
+
+  IV_INOTIFY_WATCH_INIT(&inode->watch);
+  inode->watch.inotify = &content_inotify;
+  inode->watch.pathname = inode->pathname;
+  inode->watch.mask = FILE_CONTENT_WATCH_MASK;
+  inode->watch.cookie = inode;
+  inode->watch.handler = _handle_event;
+  if (iv_inotify_watch_register(&inode->watch) < 0)
+    {
+      msg_warning_once("WARNING: could not add inotify watch for a followed file, falling back to polling, "
+                       "you may need to increase /proc/sys/fs/inotify/max_user_watches",
+                       evt_tag_error("error"));
+      g_free(inode->pathname);
+      g_free(inode);
+      return NULL;
+    }
+
+  g_hash_table_add(watched_inodes, inode);
+  return inode;
+}
+
+static void
+_watched_inode_free(WatchedInode *inode)
+{
+  g_hash_table_remove(watched_inodes, inode);
+  if (!inode->watch_removed)
+    iv_inotify_watch_unregister(&inode->watch);
+  g_free(inode->pathname);
+  g_free(inode);
+}
+
+static WatchedInode *
+_lookup_or_watch_inode(gint fd)
+{
+  struct stat st;
+
+  if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode))
+    return NULL;
+
+  if (_is_on_network_filesystem(fd))
+    {
+      msg_debug("Followed file is on a network filesystem, polling it for changes",
+                evt_tag_int("fd", fd));
+      return NULL;
+    }
+
+  if (!_ensure_inotify())
+    return NULL;
+
+  WatchedInode lookup_key = { .dev = st.st_dev, .ino = st.st_ino };
+  WatchedInode *inode = g_hash_table_lookup(watched_inodes, &lookup_key);
+
+  if (!inode)
+    inode = _watched_inode_new(fd, &st);
+  else if (inode->watch_removed)
+    inode = NULL;
+
+  if (!inode)
+    _release_inotify_if_unused();
+  return inode;
+}
+
+FileContentWatch *
+file_content_watch_new(gint fd, FileContentWatchCallback callback, gpointer user_data)
+{
+  WatchedInode *inode = _lookup_or_watch_inode(fd);
+
+  if (!inode)
+    return NULL;
+
+  FileContentWatch *self = g_new0(FileContentWatch, 1);
+  self->inode = inode;
+  self->callback = callback;
+  self->user_data = user_data;
+  inode->watches = g_list_prepend(inode->watches, self);
+  return self;
+}
+
+void
+file_content_watch_free(FileContentWatch *self)
+{
+  WatchedInode *inode = self->inode;
+
+  inode->watches = g_list_remove(inode->watches, self);
+  if (!inode->watches)
+    {
+      _watched_inode_free(inode);
+      _release_inotify_if_unused();
+    }
+  g_free(self);
+}
+
+#else
+
+FileContentWatch *
+file_content_watch_new(gint fd, FileContentWatchCallback callback, gpointer user_data)
+{
+  return NULL;
+}
+
+void
+file_content_watch_free(FileContentWatch *self)
+{
+}
+
+#endif
@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef FILE_CONTENT_WATCH_H_INCLUDED
+#define FILE_CONTENT_WATCH_H_INCLUDED
+
+#include "syslog-ng.h"
+
+/*
+ * Notifies about changes of an open regular file (new content, truncation,
+ * rename or deletion) using inotify, so that followed files don't need to
+ * be polled with fstat() every follow-freq() milliseconds.
+ *
+ * All watches share a single inotify instance, files opened multiple
+ * times share the same inotify watch.  The callback is invoked from the
+ * main loop and must not free the watch.
+ *
+ * file_content_watch_new() returns NULL if the file can't be watched:
+ * syslog-ng was compiled without inotify, the inotify limits are reached,
+ * or the file is on a network filesystem, where changes done by other
+ * hosts are not reported by inotify.  The caller is expected to fall back
+ * to polling in that case.
+ */
+typedef struct _FileContentWatch FileContentWatch;
+typedef void (*FileContentWatchCallback)(gpointer user_data);
+
+FileContentWatch *file_content_watch_new(gint fd, FileContentWatchCallback callback, gpointer user_data);
+void file_content_watch_free(FileContentWatch *self);
+
+#endif
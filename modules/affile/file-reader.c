@@ -260,6 +260,9 @@ _construct_poll_events(FileReader *self, gint fd)
       else
         poll_events = poll_multiline_file_changes_new(fd, self->filename->str, self->options->follow_freq,
                                                       self->options->multi_line_timeout, self);
+
+      if (self->watch_content_changes)
+        poll_file_changes_watch_content((PollFileChanges *) poll_events);
       msg_trace("File follow-mode is syslog-ng poll");
     }
   else if (fd >= 0 && _is_fd_pollable(fd))
@@ -503,6 +506,16 @@ file_reader_queue_method(LogPipe *s, LogMessage *msg, const LogPathOptions *path
   log_pipe_forward_msg(s, msg, path_options);
 }
 
+void
+file_reader_queue_batch_method(LogPipe *s, LogMessage **msgs, const LogPathOptions **path_options, gint count)
+{
+  FileReader *self = (FileReader *)s;
+
+  for (gint i = 0; i < count; i++)
+    log_msg_set_value(msgs[i], LM_V_FILE_NAME, self->filename->str, self->filename->len);
+  log_pipe_forward_batch(s, msgs, path_options, count);
+}
+
 gboolean
 file_reader_init_method(LogPipe *s)
 {
@@ -566,6 +579,7 @@ file_reader_init_instance (FileReader *self, const gchar *filename,
   log_pipe_init_instance (&self->super, cfg);
   self->super.init = file_reader_init_method;
   self->super.queue = file_reader_queue_method;
+  log_pipe_set_queue_batch(&self->super, file_reader_queue_batch_method);
   self->super.deinit = file_reader_deinit_method;
   self->super.notify = file_reader_notify_method;
   self->super.free_fn = file_reader_free_method;
@@ -46,6 +46,9 @@ struct _FileReader
   LogReader *reader;
   const gchar *persist_name;
   const gchar *persist_name_prefix;
+  /* new files created with the same name are noticed by the owner, the
+   * followed file only needs to be checked when inotify reports a change */
+  gboolean watch_content_changes;
 
   void (*on_file_moved)(FileReader *);
 };
@@ -66,6 +69,7 @@ gboolean file_reader_init_method(LogPipe *s);
 gboolean file_reader_deinit_method(LogPipe *s);
 void file_reader_free_method(LogPipe *s);
 void file_reader_queue_method(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options);
+void file_reader_queue_batch_method(LogPipe *s, LogMessage **msgs, const LogPathOptions **path_options, gint count);
 gint file_reader_notify_method(LogPipe *s, gint notify_code, gpointer user_data);
 
 void file_reader_remove_persist_state(FileReader *self);
@@ -82,6 +82,10 @@ poll_file_changes_check_file(gpointer s)
   off_t pos = -1;
   gint fd = self->fd;
 
+  /* the checks below cover every change reported so far */
+  self->waiting_for_changes = FALSE;
+  self->content_changed = FALSE;
+
   msg_trace("Checking if the followed file has new lines",
             evt_tag_str("follow_filename", self->follow_filename));
   if (fd >= 0)
@@ -166,19 +170,58 @@ poll_file_changes_stop_watches(PollEvents *s)
 {
   PollFileChanges *self = (PollFileChanges *) s;
 
+  self->waiting_for_changes = FALSE;
   if (iv_timer_registered(&self->follow_timer))
     iv_timer_unregister(&self->follow_timer);
 }
 
 static void
-poll_file_changes_rearm_timer(PollFileChanges *self)
+poll_file_changes_arm_timer(PollFileChanges *self, gint msec)
 {
   iv_validate_now();
   self->follow_timer.expires = iv_now;
-  timespec_add_msec(&self->follow_timer.expires, self->follow_freq);
+  timespec_add_msec(&self->follow_timer.expires, msec);
   iv_timer_register(&self->follow_timer);
 }
 
+static gboolean
+poll_file_changes_needs_timer(PollFileChanges *self)
+{
+  if (!self->content_watch)
+    return TRUE;
+  return self->needs_timer && self->needs_timer(self);
+}
+
+static void
+poll_file_changes_wait_for_changes(PollFileChanges *self)
+{
+  self->waiting_for_changes = TRUE;
+
+  /* changes reported while the file was being read might not have been
+   * consumed by that read, check them right away */
+  if (self->content_changed)
+    poll_file_changes_arm_timer(self, 0);
+  else if (poll_file_changes_needs_timer(self))
+    poll_file_changes_arm_timer(self, self->follow_freq);
+}
+
+/* inotify callback, all events queued up until the file is checked are
+ * coalesced into a single check, which then reads everything up to EOF */
+static void
+poll_file_changes_on_content_changed(gpointer s)
+{
+  PollFileChanges *self = (PollFileChanges *) s;
+
+  self->content_changed = TRUE;
+  if (!self->waiting_for_changes)
+    return;
+
+  self->waiting_for_changes = FALSE;
+  if (iv_timer_registered(&self->follow_timer))
+    iv_timer_unregister(&self->follow_timer);
+  poll_file_changes_arm_timer(self, 0);
+}
+
 void
 poll_file_changes_update_watches(PollEvents *s, GIOCondition cond)
 {
@@ -189,7 +232,24 @@ poll_file_changes_update_watches(PollEvents *s, GIOCondition cond)
   poll_file_changes_stop_watches(s);
 
   if (poll_file_changes_check_watches(self))
-    poll_file_changes_rearm_timer(self);
+    poll_file_changes_wait_for_changes(self);
+}
+
+/* Follow the file based on inotify events instead of checking it every
+ * follow_freq milliseconds. This doesn't notice a new file created with
+ * the same name, so it can only be used if that is detected by other means
+ * (e.g. a directory monitor). Falls back to polling if the file can't be
+ * watched. */
+void
+poll_file_changes_watch_content(PollFileChanges *self)
+{
+  if (self->fd < 0 || self->content_watch)
+    return;
+
+  self->content_watch = file_content_watch_new(self->fd, poll_file_changes_on_content_changed, self);
+  msg_trace("poll-file-changes: following file",
+            evt_tag_str("follow_filename", self->follow_filename),
+            evt_tag_str("method", self->content_watch ? "inotify" : "poll"));
 }
 
 void
@@ -197,6 +257,8 @@ poll_file_changes_free(PollEvents *s)
 {
   PollFileChanges *self = (PollFileChanges *) s;
 
+  if (self->content_watch)
+    file_content_watch_free(self->content_watch);
   log_pipe_unref(self->control);
   g_free(self->follow_filename);
 }
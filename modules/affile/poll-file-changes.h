@@ -25,6 +25,7 @@
 
 #include "poll-events.h"
 #include "logpipe.h"
+#include "file-content-watch.h"
 
 #include <iv.h>
 
@@ -39,15 +40,23 @@ struct _PollFileChanges
   struct iv_timer follow_timer;
   LogPipe *control;
 
+  /* when set, the file is only checked when inotify reports a change */
+  FileContentWatch *content_watch;
+  gboolean waiting_for_changes;
+  gboolean content_changed;
+
   void (*on_read)(PollFileChanges *);
   gboolean (*on_eof)(PollFileChanges *);
   void (*on_file_moved)(PollFileChanges *);
+  /* keep polling at follow_freq even if content changes are watched */
+  gboolean (*needs_timer)(PollFileChanges *);
 };
 
 PollEvents *poll_file_changes_new(gint fd, const gchar *follow_filename, gint follow_freq, LogPipe *control);
 
 void poll_file_changes_init_instance(PollFileChanges *self, gint fd, const gchar *follow_filename, gint follow_freq,
                                      LogPipe *control);
+void poll_file_changes_watch_content(PollFileChanges *self);
 void poll_file_changes_update_watches(PollEvents *s, GIOCondition cond);
 void poll_file_changes_stop_watches(PollEvents *s);
 void poll_file_changes_free(PollEvents *s);
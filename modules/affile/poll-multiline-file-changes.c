@@ -113,6 +113,15 @@ poll_multiline_file_changes_on_eof(PollFileChanges *s)
   return TRUE;
 }
 
+/* the multi-line timeout is detected by the follow timer */
+static gboolean
+poll_multiline_file_changes_needs_timer(PollFileChanges *s)
+{
+  PollMultilineFileChanges *self = (PollMultilineFileChanges *) s;
+
+  return _is_multi_line_timeout_pending(self);
+}
+
 static void
 poll_multiline_file_changes_on_file_moved(PollFileChanges *s)
 {
@@ -155,6 +164,7 @@ poll_multiline_file_changes_new(gint fd, const gchar *follow_filename, gint foll
   self->super.on_read = poll_multiline_file_changes_on_read;
   self->super.on_eof = poll_multiline_file_changes_on_eof;
   self->super.on_file_moved = poll_multiline_file_changes_on_file_moved;
+  self->super.needs_timer = poll_multiline_file_changes_needs_timer;
 
   self->super.super.update_watches = poll_file_changes_update_watches;
   self->super.super.stop_watches = poll_multiline_file_changes_stop_watches;
@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "file-content-watch.h"
+#include "apphook.h"
+#include "timeutils/misc.h"
+
+#include <iv.h>
+#include <glib/gstdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+typedef struct _WatchTestFile
+{
+  gchar *filename;
+  gint read_fd;
+  gint write_fd;
+} WatchTestFile;
+
+static gint changes_reported;
+
+static void
+_on_changed(gpointer user_data)
+{
+  changes_reported++;
+  iv_quit();
+}
+
+static void
+_on_timeout(gpointer user_data)
+{
+  iv_quit();
+}
+
+/* runs the main loop until a change is reported or the timeout expires */
+static void
+_run_main_loop_until_change(void)
+{
+  struct iv_timer timeout;
+
+  IV_TIMER_INIT(&timeout);
+  timeout.handler = _on_timeout;
+  iv_validate_now();
+  timeout.expires = iv_now;
+  timespec_add_msec(&timeout.expires, 200);
+  iv_timer_register(&timeout);
+
+  iv_main();
+
+  if (iv_timer_registered(&timeout))
+    iv_timer_unregister(&timeout);
+}
+
+static void
+_create_test_file(WatchTestFile *file)
+{
+  file->filename = g_strdup("test_file_content_watch_XXXXXX");
+  file->write_fd = g_mkstemp(file->filename);
+  cr_assert_geq(file->write_fd, 0);
+  file->read_fd = open(file->filename, O_RDONLY);
+  cr_assert_geq(file->read_fd, 0);
+}
+
+static void
+_destroy_test_file(WatchTestFile *file)
+{
+  close(file->read_fd);
+  close(file->write_fd);
+  g_unlink(file->filename);
+  g_free(file->filename);
+}
+
+static void
+_append(WatchTestFile *file, const gchar *data)
+{
+  cr_assert_eq(write(file->write_fd, data, strlen(data)), strlen(data));
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  changes_reported = 0;
+}
+
+TestSuite(file_content_watch, .init = setup, .fini = app_shutdown);
+
+#if SYSLOG_NG_HAVE_INOTIFY
+
+Test(file_content_watch, test_appending_to_the_file_is_reported)
+{
+  WatchTestFile file;
+
+  _create_test_file(&file);
+  FileContentWatch *watch = file_content_watch_new(file.read_fd, _on_changed, NULL);
+  if (!watch)
+    cr_skip_test("the test directory can't be watched with inotify");
+
+  _run_main_loop_until_change();
+  cr_assert_eq(changes_reported, 0, "idle file reported as changed");
+
+  _append(&file, "foo\n");
+  _run_main_loop_until_change();
+  cr_assert_gt(changes_reported, 0);
+
+  file_content_watch_free(watch);
+  _destroy_test_file(&file);
+}
+
+Test(file_content_watch, test_deleting_the_file_is_reported)
+{
+  WatchTestFile file;
+
+  _create_test_file(&file);
+  FileContentWatch *watch = file_content_watch_new(file.read_fd, _on_changed, NULL);
+  if (!watch)
+    cr_skip_test("the test directory can't be watched with inotify");
+
+  cr_assert_eq(g_unlink(file.filename), 0);
+  _run_main_loop_until_change();
+  cr_assert_gt(changes_reported, 0);
+
+  file_content_watch_free(watch);
+  _destroy_test_file(&file);
+}
+
+Test(file_content_watch, test_the_same_file_can_be_watched_multiple_times)
+{
+  WatchTestFile file;
+
+  _create_test_file(&file);
+  FileContentWatch *watch = file_content_watch_new(file.read_fd, _on_changed, NULL);
+  if (!watch)
+    cr_skip_test("the test directory can't be watched with inotify");
+
+  gint second_fd = open(file.filename, O_RDONLY);
+  FileContentWatch *second_watch = file_content_watch_new(second_fd, _on_changed, NULL);
+  cr_assert_not_null(second_watch);
+
+  /* dropping one of them keeps the other one working */
+  file_content_watch_free(watch);
+
+  _append(&file, "foo\n");
+  _run_main_loop_until_change();
+  cr_assert_gt(changes_reported, 0);
+
+  file_content_watch_free(second_watch);
+  close(second_fd);
+  _destroy_test_file(&file);
+}
+
+#endif
+
+Test(file_content_watch, test_non_regular_files_are_not_watched)
+{
+  gint fds[2];
+
+  cr_assert_eq(pipe(fds), 0);
+  cr_assert_null(file_content_watch_new(fds[0], _on_changed, NULL));
+  close(fds[0]);
+  close(fds[1]);
+}
@@ -167,6 +167,7 @@ wildcard_file_reader_new(const gchar *filename, FileReaderOptions *options, File
   self->super.super.notify = _notify;
   self->super.super.deinit = _deinit;
   self->super.on_file_moved = _on_file_moved;
+  self->super.watch_content_changes = TRUE;
   IV_TASK_INIT(&self->file_state_event_handler);
   self->file_state_event_handler.cookie = self;
   self->file_state_event_handler.handler = _handle_file_state_event;
@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+
+#include "afsocket-accept-thread.h"
+
+static void
+_accept(gpointer s)
+{
+  AFSocketAcceptThread *self = (AFSocketAcceptThread *) s;
+
+  self->accept(self, self->listen_fd.fd);
+}
+
+static void
+_wakeup_requested(gpointer s)
+{
+  AFSocketAcceptThread *self = (AFSocketAcceptThread *) s;
+
+  if (self->wakeup)
+    self->wakeup(self);
+}
+
+static void
+_exit_requested(gpointer s)
+{
+  iv_quit();
+}
+
+static void
+_set_running(AFSocketAcceptThread *self, gboolean running)
+{
+  g_mutex_lock(&self->lock);
+  self->running = running;
+  g_mutex_unlock(&self->lock);
+}
+
+static gboolean
+_thread_init(MainLoopThreadedWorker *s)
+{
+  AFSocketAcceptThread *self = (AFSocketAcceptThread *) s->data;
+
+  iv_event_register(&self->exit_requested);
+  iv_event_register(&self->wakeup_requested);
+  _set_running(self, TRUE);
+
+  if (self->thread_init)
+    self->thread_init(self);
+
+  iv_fd_register(&self->listen_fd);
+  return TRUE;
+}
+
+static void
+_thread_deinit(MainLoopThreadedWorker *s)
+{
+  AFSocketAcceptThread *self = (AFSocketAcceptThread *) s->data;
+
+  iv_fd_unregister(&self->listen_fd);
+
+  if (self->thread_deinit)
+    self->thread_deinit(self);
+
+  _set_running(self, FALSE);
+  iv_event_unregister(&self->wakeup_requested);
+  iv_event_unregister(&self->exit_requested);
+}
+
+static void
+_run(MainLoopThreadedWorker *s)
+{
+  iv_main();
+}
+
+static void
+_request_exit(MainLoopThreadedWorker *s)
+{
+  AFSocketAcceptThread *self = (AFSocketAcceptThread *) s->data;
+
+  iv_event_post(&self->exit_requested);
+}
+
+gboolean
+afsocket_accept_thread_start(AFSocketAcceptThread *self)
+{
+  return main_loop_threaded_worker_start(&self->thread);
+}
+
+/* calls the wakeup() callback on the thread, unless it has already exited */
+void
+afsocket_accept_thread_wakeup(AFSocketAcceptThread *self)
+{
+  g_mutex_lock(&self->lock);
+  if (self->running)
+    iv_event_post(&self->wakeup_requested);
+  g_mutex_unlock(&self->lock);
+}
+
+AFSocketAcceptThread *
+afsocket_accept_thread_new(gint listen_fd, gpointer user_data)
+{
+  AFSocketAcceptThread *self = g_new0(AFSocketAcceptThread, 1);
+
+  main_loop_threaded_worker_init(&self->thread, MLW_THREADED_INPUT_WORKER, self);
+  self->thread.thread_init = _thread_init;
+  self->thread.thread_deinit = _thread_deinit;
+  self->thread.run = _run;
+  self->thread.request_exit = _request_exit;
+  self->user_data = user_data;
+
+  IV_FD_INIT(&self->listen_fd);
+  self->listen_fd.fd = listen_fd;
+  self->listen_fd.cookie = self;
+  self->listen_fd.handler_in = _accept;
+
+  IV_EVENT_INIT(&self->exit_requested);
+  self->exit_requested.cookie = self;
+  self->exit_requested.handler = _exit_requested;
+
+  IV_EVENT_INIT(&self->wakeup_requested);
+  self->wakeup_requested.cookie = self;
+  self->wakeup_requested.handler = _wakeup_requested;
+
+  g_mutex_init(&self->lock);
+  return self;
+}
+
+void
+afsocket_accept_thread_free(AFSocketAcceptThread *self)
+{
+  main_loop_threaded_worker_clear(&self->thread);
+  g_mutex_clear(&self->lock);
+  g_free(self);
+}
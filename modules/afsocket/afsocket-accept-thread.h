@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+
+#ifndef AFSOCKET_ACCEPT_THREAD_H_INCLUDED
+#define AFSOCKET_ACCEPT_THREAD_H_INCLUDED
+
+#include "syslog-ng.h"
+#include "mainloop-threaded-worker.h"
+
+#include <iv.h>
+#include <iv_event.h>
+
+/*
+ * A worker thread with its own event loop, that calls accept() whenever
+ * its listening socket becomes readable.  The thread owns the connections
+ * it accepts: they are set up, read and closed in its event loop, without
+ * involving the main thread.
+ *
+ * The callbacks run on the thread.  Like other threaded workers, the
+ * thread is stopped by the main loop before the configuration is
+ * deinitialized, afsocket_accept_thread_free() only joins it.
+ */
+typedef struct _AFSocketAcceptThread AFSocketAcceptThread;
+struct _AFSocketAcceptThread
+{
+  MainLoopThreadedWorker thread;
+  gpointer user_data;
+
+  struct iv_fd listen_fd;
+  struct iv_event exit_requested;
+  struct iv_event wakeup_requested;
+
+  GMutex lock;
+  gboolean running;
+
+  void (*thread_init)(AFSocketAcceptThread *self);
+  void (*thread_deinit)(AFSocketAcceptThread *self);
+  void (*accept)(AFSocketAcceptThread *self, gint listen_fd);
+  void (*wakeup)(AFSocketAcceptThread *self);
+};
+
+gboolean afsocket_accept_thread_start(AFSocketAcceptThread *self);
+void afsocket_accept_thread_wakeup(AFSocketAcceptThread *self);
+
+AFSocketAcceptThread *afsocket_accept_thread_new(gint listen_fd, gpointer user_data);
+void afsocket_accept_thread_free(AFSocketAcceptThread *self);
+
+#endif
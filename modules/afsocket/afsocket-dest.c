@@ -158,6 +158,16 @@ afsocket_dd_format_connections_name(const AFSocketDestDriver *self)
   return persist_name;
 }
 
+static const gchar *
+afsocket_dd_format_transport_state_name(const AFSocketDestDriver *self)
+{
+  static gchar persist_name[1024];
+  g_snprintf(persist_name, sizeof(persist_name), "%s_transport_state(%s)", _module_name,
+             _get_module_identifier(self));
+
+  return persist_name;
+}
+
 static const gchar *
 afsocket_dd_format_legacy_connection_name(const AFSocketDestDriver *self)
 {
@@ -701,6 +711,8 @@ afsocket_dd_init(LogPipe *s)
     return FALSE;
 
   afsocket_dd_register_stats(self);
+  transport_mapper_restore_state(self->transport_mapper, log_pipe_get_config(s),
+                                 afsocket_dd_format_transport_state_name(self));
 
   if (!_dd_init_socket(self))
     {
@@ -745,6 +757,8 @@ afsocket_dd_deinit(LogPipe *s)
     {
       afsocket_dd_save_connection(self);
     }
+  transport_mapper_save_state(self->transport_mapper, log_pipe_get_config(s),
+                              afsocket_dd_format_transport_state_name(self));
 
   afsocket_dd_unregister_stats(self);
   return log_dest_driver_deinit_method(s);
@@ -96,6 +96,7 @@ static CfgLexerKeyword afsocket_keywords[] =
   { "ip_protocol",        KW_IP_PROTOCOL },
   { "max_connections",    KW_MAX_CONNECTIONS },
   { "listen_backlog",     KW_LISTEN_BACKLOG },
+  { "accept_threads",     KW_ACCEPT_THREADS },
   { "keep_alive",         KW_KEEP_ALIVE },
   { "close_on_input",     KW_CLOSE_ON_INPUT },
   { "systemd_syslog",     KW_SYSTEMD_SYSLOG  },
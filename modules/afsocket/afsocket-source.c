@@ -29,9 +29,11 @@
 #include "stats/stats-cluster-single.h"
 #include "stats/stats-cluster-key-builder.h"
 #include "mainloop.h"
+#include "mainloop-worker.h"
 #include "poll-fd-events.h"
 #include "timeutils/misc.h"
 #include "afsocket-signals.h"
+#include "afsocket-accept-thread.h"
 
 #include <string.h>
 #include <sys/types.h>
@@ -58,6 +60,8 @@ typedef struct _AFSocketSourceConnection
 {
   LogPipe super;
   struct _AFSocketSourceDriver *owner;
+  /* the accept thread running the reader, NULL for the main thread */
+  AFSocketAcceptThread *thread;
   LogReader *reader;
   int sock;
   GSockAddr *peer_addr;
@@ -212,6 +216,7 @@ afsocket_sc_deinit(LogPipe *s)
 
   log_pipe_unref(&self->owner->super.super.super);
   self->owner = NULL;
+  self->thread = NULL;
 
   log_pipe_deinit((LogPipe *) self->reader);
   return TRUE;
@@ -289,7 +294,17 @@ afsocket_sc_new(GSockAddr *peer_addr, GSockAddr *local_addr, int fd, GlobalConfi
 void
 afsocket_sd_add_connection(AFSocketSourceDriver *self, AFSocketSourceConnection *connection)
 {
+  g_mutex_lock(&self->connections_lock);
   self->connections = g_list_prepend(self->connections, connection);
+  g_mutex_unlock(&self->connections_lock);
+}
+
+static void
+afsocket_sd_remove_connection(AFSocketSourceDriver *self, AFSocketSourceConnection *connection)
+{
+  g_mutex_lock(&self->connections_lock);
+  self->connections = g_list_remove(self->connections, connection);
+  g_mutex_unlock(&self->connections_lock);
 }
 
 static void
@@ -310,23 +325,12 @@ afsocket_sd_kill_connection(AFSocketSourceConnection *connection)
 static void
 afsocket_sd_kill_connection_list(GList *list)
 {
-  GList *l, *next;
-
   /* NOTE: the list may contain a list of
    *   - deinitialized AFSocketSourceConnection instances (in case the persist-config list is
    *     freed), or
    *    - initialized AFSocketSourceConnection instances (in case keep-alive is turned off)
    */
-  for (l = list; l; l = next)
-    {
-      AFSocketSourceConnection *connection = (AFSocketSourceConnection *) l->data;
-
-      next = l->next;
-
-      if (connection->owner)
-        connection->owner->connections = g_list_remove(connection->owner->connections, connection);
-      afsocket_sd_kill_connection(connection);
-    }
+  g_list_free_full(list, (GDestroyNotify) afsocket_sd_kill_connection);
 }
 
 void
@@ -353,6 +357,14 @@ afsocket_sd_set_listen_backlog(LogDriver *s, gint listen_backlog)
   self->listen_backlog = listen_backlog;
 }
 
+void
+afsocket_sd_set_accept_threads(LogDriver *s, gint accept_threads)
+{
+  AFSocketSourceDriver *self = (AFSocketSourceDriver *) s;
+
+  self->num_accept_threads = accept_threads;
+}
+
 void
 afsocket_sd_set_dynamic_window_size(LogDriver *s, gint dynamic_window_size)
 {
@@ -411,6 +423,17 @@ afsocket_sd_format_listener_name(const AFSocketSourceDriver *self)
   return persist_name;
 }
 
+static const gchar *
+afsocket_sd_format_accept_listeners_name(const AFSocketSourceDriver *self)
+{
+  static gchar persist_name[1024];
+
+  g_snprintf(persist_name, sizeof(persist_name), "%s.accept_listen_fds",
+             afsocket_sd_format_name((const LogPipe *)self));
+
+  return persist_name;
+}
+
 static const gchar *
 afsocket_sd_format_connections_name(const AFSocketSourceDriver *self)
 {
@@ -422,6 +445,17 @@ afsocket_sd_format_connections_name(const AFSocketSourceDriver *self)
   return persist_name;
 }
 
+static const gchar *
+afsocket_sd_format_transport_state_name(const AFSocketSourceDriver *self)
+{
+  static gchar persist_name[1024];
+
+  g_snprintf(persist_name, sizeof(persist_name), "%s.transport_state",
+             afsocket_sd_format_name((const LogPipe *)self));
+
+  return persist_name;
+}
+
 static const gchar *
 afsocket_sd_format_dynamic_window_pool_name(const AFSocketSourceDriver *self)
 {
@@ -434,7 +468,31 @@ afsocket_sd_format_dynamic_window_pool_name(const AFSocketSourceDriver *self)
 }
 
 static gboolean
-afsocket_sd_process_connection(AFSocketSourceDriver *self, GSockAddr *client_addr, GSockAddr *local_addr, gint fd)
+_connections_count_reserve(AFSocketSourceDriver *self)
+{
+  gboolean reserved = FALSE;
+
+  /* connections may be accepted on multiple threads at the same time */
+  g_mutex_lock(&self->connections_lock);
+  if (_connections_count_get(self) < atomic_gssize_get(&self->max_connections))
+    {
+      _connections_count_inc(self);
+      reserved = TRUE;
+    }
+  g_mutex_unlock(&self->connections_lock);
+  return reserved;
+}
+
+#if SYSLOG_NG_ENABLE_TCP_WRAPPER
+/* libwrap keeps its state in static variables, while connections may be
+ * accepted on multiple threads */
+static GMutex tcp_wrapper_lock;
+#endif
+
+/* runs on the thread that accepted the connection, which also runs its reader */
+static gboolean
+afsocket_sd_process_connection(AFSocketSourceDriver *self, GSockAddr *client_addr, GSockAddr *local_addr, gint fd,
+                               AFSocketAcceptThread *thread)
 {
   gchar buf[MAX_SOCKADDR_STRING], buf2[MAX_SOCKADDR_STRING];
 #if SYSLOG_NG_ENABLE_TCP_WRAPPER
@@ -445,10 +503,15 @@ afsocket_sd_process_connection(AFSocketSourceDriver *self, GSockAddr *client_add
                      ))
     {
       struct request_info req;
+      gboolean allowed;
 
+      g_mutex_lock(&tcp_wrapper_lock);
       request_init(&req, RQ_DAEMON, "syslog-ng", RQ_FILE, fd, 0);
       fromhost(&req);
-      if (hosts_access(&req) == 0)
+      allowed = hosts_access(&req) != 0;
+      g_mutex_unlock(&tcp_wrapper_lock);
+
+      if (!allowed)
         {
 
           msg_error("Syslog connection rejected by tcpd",
@@ -461,7 +524,7 @@ afsocket_sd_process_connection(AFSocketSourceDriver *self, GSockAddr *client_add
 
 #endif
 
-  if (_connections_count_get(self) >= atomic_gssize_get(&self->max_connections))
+  if (!_connections_count_reserve(self))
     {
       msg_error("Number of allowed concurrent connections reached, rejecting connection",
                 evt_tag_str("client", g_sockaddr_format(client_addr, buf, sizeof(buf), GSA_FULL)),
@@ -477,15 +540,16 @@ afsocket_sd_process_connection(AFSocketSourceDriver *self, GSockAddr *client_add
       AFSocketSourceConnection *conn;
 
       conn = afsocket_sc_new(client_addr, local_addr, fd, self->super.super.super.cfg);
+      conn->thread = thread;
       afsocket_sc_set_owner(conn, self);
       if (log_pipe_init(&conn->super))
         {
           afsocket_sd_add_connection(self, conn);
-          _connections_count_inc(self);
           log_pipe_append(&conn->super, &self->super.super.super);
         }
       else
         {
+          _connections_count_dec(self);
           log_pipe_unref(&conn->super);
           return FALSE;
         }
@@ -495,10 +559,10 @@ afsocket_sd_process_connection(AFSocketSourceDriver *self, GSockAddr *client_add
 
 #define MAX_ACCEPTS_AT_A_TIME 30
 
+/* runs on the main thread, or on the accept thread listening on listen_fd */
 static void
-afsocket_sd_accept(gpointer s)
+afsocket_sd_accept_connections(AFSocketSourceDriver *self, gint listen_fd, AFSocketAcceptThread *thread)
 {
-  AFSocketSourceDriver *self = (AFSocketSourceDriver *) s;
   GSockAddr *peer_addr;
   GSockAddr *local_addr;
   gchar buf1[256], buf2[256];
@@ -510,7 +574,7 @@ afsocket_sd_accept(gpointer s)
     {
       GIOStatus status;
 
-      status = g_accept(self->fd, &new_fd, &peer_addr);
+      status = g_accept(listen_fd, &new_fd, &peer_addr);
       if (status == G_IO_STATUS_AGAIN)
         {
           /* no more connections to accept */
@@ -527,7 +591,7 @@ afsocket_sd_accept(gpointer s)
       g_fd_set_cloexec(new_fd, TRUE);
 
       local_addr = g_socket_get_local_name(new_fd);
-      res = afsocket_sd_process_connection(self, peer_addr, local_addr, new_fd);
+      res = afsocket_sd_process_connection(self, peer_addr, local_addr, new_fd, thread);
       g_sockaddr_unref(local_addr);
 
       if (res)
@@ -556,6 +620,284 @@ afsocket_sd_accept(gpointer s)
   return;
 }
 
+static void
+afsocket_sd_accept(gpointer s)
+{
+  AFSocketSourceDriver *self = (AFSocketSourceDriver *) s;
+
+  afsocket_sd_accept_connections(self, self->fd, NULL);
+}
+
+/*
+ * accept-threads()
+ *
+ * Connections are accepted on dedicated threads, each with its own
+ * SO_REUSEPORT listener, so the kernel distributes incoming connections
+ * between them.  A connection stays on the thread that accepted it: its
+ * LogReader is constructed, polled and deinitialized there, without
+ * involving the main thread.  Connections kept alive across a reload are
+ * distributed between the new threads.
+ */
+
+static void
+afsocket_sd_accept_on_thread(AFSocketAcceptThread *thread, gint listen_fd)
+{
+  AFSocketSourceDriver *self = (AFSocketSourceDriver *) thread->user_data;
+
+  afsocket_sd_accept_connections(self, listen_fd, thread);
+}
+
+/*
+ * Only the thread that owns a connection removes it from the list, so its
+ * connections can be processed without holding connections_lock, which
+ * would block the accept path of every other thread, and could not be
+ * taken again by afsocket_sd_remove_connection().
+ */
+static GList *
+afsocket_sd_get_thread_connections(AFSocketSourceDriver *self, AFSocketAcceptThread *thread)
+{
+  GList *thread_connections = NULL;
+
+  g_mutex_lock(&self->connections_lock);
+  for (GList *l = self->connections; l; l = l->next)
+    {
+      AFSocketSourceConnection *sc = (AFSocketSourceConnection *) l->data;
+
+      if (sc->thread == thread)
+        thread_connections = g_list_prepend(thread_connections, sc);
+    }
+  g_mutex_unlock(&self->connections_lock);
+
+  return thread_connections;
+}
+
+static void
+afsocket_sd_init_thread_connections(AFSocketAcceptThread *thread)
+{
+  AFSocketSourceDriver *self = (AFSocketSourceDriver *) thread->user_data;
+  GList *thread_connections = afsocket_sd_get_thread_connections(self, thread);
+
+  for (GList *l = thread_connections; l; l = l->next)
+    {
+      AFSocketSourceConnection *sc = (AFSocketSourceConnection *) l->data;
+
+      afsocket_sc_set_owner(sc, self);
+      if (log_pipe_init(&sc->super))
+        {
+          _connections_count_inc(self);
+        }
+      else
+        {
+          afsocket_sd_remove_connection(self, sc);
+          afsocket_sd_kill_connection(sc);
+        }
+    }
+  g_list_free(thread_connections);
+}
+
+static void
+afsocket_sd_deinit_thread_connections(AFSocketAcceptThread *thread)
+{
+  AFSocketSourceDriver *self = (AFSocketSourceDriver *) thread->user_data;
+  GList *thread_connections = afsocket_sd_get_thread_connections(self, thread);
+
+  for (GList *l = thread_connections; l; l = l->next)
+    log_pipe_deinit(&((AFSocketSourceConnection *) l->data)->super);
+  g_list_free(thread_connections);
+}
+
+static void
+afsocket_sd_realloc_thread_dynamic_windows(AFSocketAcceptThread *thread)
+{
+  AFSocketSourceDriver *self = (AFSocketSourceDriver *) thread->user_data;
+
+  g_mutex_lock(&self->connections_lock);
+  for (GList *l = self->connections; l; l = l->next)
+    {
+      AFSocketSourceConnection *sc = (AFSocketSourceConnection *) l->data;
+
+      if (sc->thread == thread)
+        log_source_schedule_dynamic_window_realloc(&sc->reader->super);
+    }
+  g_mutex_unlock(&self->connections_lock);
+}
+
+static gboolean afsocket_sd_open_socket(AFSocketSourceDriver *self, gint *sock);
+
+/* the listeners of the accept threads share the port using SO_REUSEPORT,
+ * regardless of the so-reuseport() setting of the driver */
+static gboolean
+afsocket_sd_open_reuseport_socket(AFSocketSourceDriver *self, gint *sock)
+{
+  gboolean so_reuseport = self->socket_options->so_reuseport;
+  gboolean result;
+
+  self->socket_options->so_reuseport = TRUE;
+  result = afsocket_sd_open_socket(self, sock);
+  self->socket_options->so_reuseport = so_reuseport;
+  return result;
+}
+
+static gint
+_open_accept_thread_listener(AFSocketSourceDriver *self)
+{
+  gint sock = -1;
+
+  if (!afsocket_sd_open_reuseport_socket(self, &sock))
+    return -1;
+
+  if (listen(sock, self->listen_backlog) < 0)
+    {
+      msg_error("Error during listen()",
+                evt_tag_error(EVT_TAG_OSERROR));
+      close(sock);
+      return -1;
+    }
+  return sock;
+}
+
+static void
+_close_accept_thread_listeners(GArray *listen_fds)
+{
+  for (gint i = 0; i < listen_fds->len; i++)
+    close(g_array_index(listen_fds, gint, i));
+  g_array_free(listen_fds, TRUE);
+}
+
+/* the first thread uses the listener of the driver, the rest opens their own */
+static void
+_acquire_accept_thread_listeners(AFSocketSourceDriver *self)
+{
+  GlobalConfig *cfg = log_pipe_get_config(&self->super.super.super);
+  gint num_extra_listeners = self->num_accept_threads - 1;
+
+  g_assert(!self->accept_listen_fds);
+  if (self->connections_kept_alive_across_reloads)
+    self->accept_listen_fds = cfg_persist_config_fetch(cfg, afsocket_sd_format_accept_listeners_name(self));
+  if (!self->accept_listen_fds)
+    self->accept_listen_fds = g_array_new(FALSE, FALSE, sizeof(gint));
+
+  while (self->accept_listen_fds->len > num_extra_listeners)
+    {
+      close(g_array_index(self->accept_listen_fds, gint, self->accept_listen_fds->len - 1));
+      g_array_set_size(self->accept_listen_fds, self->accept_listen_fds->len - 1);
+    }
+
+  while (self->accept_listen_fds->len < num_extra_listeners)
+    {
+      gint sock = _open_accept_thread_listener(self);
+
+      if (sock == -1)
+        {
+          msg_warning("WARNING: error opening an SO_REUSEPORT listener for accept-threads(), "
+                      "using less accept threads",
+                      evt_tag_int("accept_threads", self->accept_listen_fds->len + 1),
+                      log_pipe_location_tag(&self->super.super.super));
+          break;
+        }
+      g_array_append_val(self->accept_listen_fds, sock);
+    }
+}
+
+static void
+_release_accept_thread_listeners(AFSocketSourceDriver *self)
+{
+  GlobalConfig *cfg = log_pipe_get_config(&self->super.super.super);
+
+  if (!self->accept_listen_fds)
+    return;
+
+  if (self->connections_kept_alive_across_reloads)
+    cfg_persist_config_add(cfg, afsocket_sd_format_accept_listeners_name(self), self->accept_listen_fds,
+                           (GDestroyNotify) _close_accept_thread_listeners);
+  else
+    _close_accept_thread_listeners(self->accept_listen_fds);
+  self->accept_listen_fds = NULL;
+}
+
+static AFSocketAcceptThread *
+_accept_thread_new(AFSocketSourceDriver *self, gint listen_fd)
+{
+  AFSocketAcceptThread *thread = afsocket_accept_thread_new(listen_fd, self);
+
+  thread->thread_init = afsocket_sd_init_thread_connections;
+  thread->thread_deinit = afsocket_sd_deinit_thread_connections;
+  thread->accept = afsocket_sd_accept_on_thread;
+  thread->wakeup = afsocket_sd_realloc_thread_dynamic_windows;
+  return thread;
+}
+
+/* kept-alive connections are restarted on the accept threads, round-robin */
+static void
+_assign_kept_alive_connections(AFSocketSourceDriver *self)
+{
+  gint i = 0;
+
+  for (GList *l = self->connections; l; l = l->next, i++)
+    {
+      AFSocketSourceConnection *sc = (AFSocketSourceConnection *) l->data;
+
+      sc->thread = g_ptr_array_index(self->accept_threads, i % self->accept_threads->len);
+    }
+}
+
+/* runs on the main thread, once the configuration has been initialized */
+static void
+_accept_threads_start(AFSocketSourceDriver *self)
+{
+  _acquire_accept_thread_listeners(self);
+
+  self->accept_threads = g_ptr_array_new_with_free_func((GDestroyNotify) afsocket_accept_thread_free);
+  g_ptr_array_add(self->accept_threads, _accept_thread_new(self, self->fd));
+  for (gint i = 0; i < self->accept_listen_fds->len; i++)
+    g_ptr_array_add(self->accept_threads, _accept_thread_new(self, g_array_index(self->accept_listen_fds, gint, i)));
+
+  _assign_kept_alive_connections(self);
+
+  for (gint i = 0; i < self->accept_threads->len; i++)
+    g_assert(afsocket_accept_thread_start(g_ptr_array_index(self->accept_threads, i)));
+
+  msg_verbose("Accepting connections on dedicated threads",
+              evt_tag_int("accept_threads", self->accept_threads->len),
+              log_pipe_location_tag(&self->super.super.super));
+}
+
+static void
+_accept_threads_stop(AFSocketSourceDriver *self)
+{
+  if (!self->accept_threads)
+    return;
+
+  /* the threads have already deinitialized their connections, this joins them */
+  g_ptr_array_free(self->accept_threads, TRUE);
+  self->accept_threads = NULL;
+}
+
+static gboolean
+_accept_threads_supported(AFSocketSourceDriver *self)
+{
+  return self->transport_mapper->sock_type == SOCK_STREAM
+         && self->bind_addr && self->bind_addr->sa.sa_family != AF_UNIX;
+}
+
+static void
+afsocket_sd_setup_accept_threads(AFSocketSourceDriver *self)
+{
+  if (self->num_accept_threads == 0)
+    return;
+
+  if (!_accept_threads_supported(self))
+    {
+      msg_warning("WARNING: accept-threads() is only supported by TCP based sources, accepting connections on the main thread",
+                  log_pipe_location_tag(&self->super.super.super));
+      self->num_accept_threads = 0;
+      return;
+    }
+
+  /* readers are run by their accept thread, not by the I/O worker pool */
+  self->reader_options.flags &= ~LR_THREADED;
+}
+
 static void
 afsocket_sd_close_connection(AFSocketSourceDriver *self, AFSocketSourceConnection *sc)
 {
@@ -574,7 +916,7 @@ afsocket_sd_close_connection(AFSocketSourceDriver *self, AFSocketSourceConnectio
 
   log_reader_close_proto(sc->reader);
   log_pipe_deinit(&sc->super);
-  self->connections = g_list_remove(self->connections, sc);
+  afsocket_sd_remove_connection(self, sc);
   afsocket_sd_kill_connection(sc);
   _connections_count_dec(self);
 }
@@ -593,13 +935,20 @@ _listen_fd_init(AFSocketSourceDriver *self)
 static void
 _listen_fd_start(AFSocketSourceDriver *self)
 {
-  if (self->listen_fd.fd != -1)
+  if (self->listen_fd.fd == -1)
+    return;
+
+  if (self->num_accept_threads == 0)
     iv_fd_register(&self->listen_fd);
+  else if (self->post_config_inited)
+    _accept_threads_start(self);
 }
 
 static void
 _listen_fd_stop(AFSocketSourceDriver *self)
 {
+  _accept_threads_stop(self);
+
   if (iv_fd_registered (&self->listen_fd))
     iv_fd_unregister(&self->listen_fd);
 }
@@ -622,7 +971,9 @@ _dynamic_window_update_statistics_cb(AFSocketSourceConnection *conn)
 static void
 _dynamic_window_update_stats(AFSocketSourceDriver *self)
 {
+  g_mutex_lock(&self->connections_lock);
   g_list_foreach(self->connections, (GFunc) _dynamic_window_update_statistics_cb, NULL);
+  g_mutex_unlock(&self->connections_lock);
 }
 
 static void
@@ -634,6 +985,14 @@ _dynamic_window_realloc_cb(AFSocketSourceConnection *conn)
 static void
 _dynamic_window_realloc(AFSocketSourceDriver *self)
 {
+  if (self->num_accept_threads > 0)
+    {
+      /* the windows are reallocated by the threads running the readers */
+      if (self->accept_threads)
+        g_ptr_array_foreach(self->accept_threads, (GFunc) afsocket_accept_thread_wakeup, NULL);
+      return;
+    }
+
   g_list_foreach(self->connections, (GFunc) _dynamic_window_realloc_cb, NULL);
 }
 
@@ -1016,6 +1375,11 @@ afsocket_sd_restore_kept_alive_connections(AFSocketSourceDriver *self)
       self->connections = cfg_persist_config_fetch(cfg, afsocket_sd_format_connections_name(self));
 
       _connections_count_set(self, 0);
+
+      /* these are initialized by the accept threads, once they are started */
+      if (self->num_accept_threads > 0)
+        return;
+
       for (p = self->connections; p; p = p->next)
         {
           afsocket_sc_set_owner((AFSocketSourceConnection *) p->data, self);
@@ -1096,6 +1460,14 @@ afsocket_sd_open_socket(AFSocketSourceDriver *self, gint *sock)
   return !signal_data.failure;
 }
 
+static gboolean
+_open_listener_socket(AFSocketSourceDriver *self, gint *sock)
+{
+  if (self->num_accept_threads > 0)
+    return afsocket_sd_open_reuseport_socket(self, sock);
+  return afsocket_sd_open_socket(self, sock);
+}
+
 static gboolean
 _sd_open_stream(AFSocketSourceDriver *self)
 {
@@ -1114,7 +1486,7 @@ _sd_open_stream(AFSocketSourceDriver *self)
     {
       if (!afsocket_sd_acquire_socket(self, &sock))
         return self->super.super.optional;
-      if (sock == -1 && !afsocket_sd_open_socket(self, &sock))
+      if (sock == -1 && !_open_listener_socket(self, &sock))
         return self->super.super.optional;
     }
   self->fd = sock;
@@ -1135,7 +1507,7 @@ _sd_open_dgram(AFSocketSourceDriver *self)
   self->fd = -1;
 
   /* we either have self->connections != NULL, or sock contains a new fd */
-  if (!(self->connections || afsocket_sd_process_connection(self, NULL, self->bind_addr, sock)))
+  if (!(self->connections || afsocket_sd_process_connection(self, NULL, self->bind_addr, sock, NULL)))
     return FALSE;
 
   if (!transport_mapper_init(self->transport_mapper))
@@ -1198,6 +1570,7 @@ afsocket_sd_save_listener(AFSocketSourceDriver *self)
           cfg_persist_config_add(cfg, afsocket_sd_format_listener_name(self),
                                  GUINT_TO_POINTER(self->fd + 1), afsocket_sd_close_fd);
         }
+      _release_accept_thread_listeners(self);
     }
 }
 
@@ -1322,9 +1695,13 @@ afsocket_sd_init_method(LogPipe *s)
   if (!afsocket_sd_setup_transport(self) || !afsocket_sd_setup_addresses(self))
     return FALSE;
 
+  afsocket_sd_setup_accept_threads(self);
+
   afsocket_sd_register_stats(self);
   afsocket_sd_dynamic_window_init(self);
   afsocket_sd_restore_kept_alive_connections(self);
+  transport_mapper_restore_state(self->transport_mapper, log_pipe_get_config(s),
+                                 afsocket_sd_format_transport_state_name(self));
 
   if (!afsocket_sd_open_listener(self))
     {
@@ -1337,6 +1714,28 @@ afsocket_sd_init_method(LogPipe *s)
   return TRUE;
 }
 
+gboolean
+afsocket_sd_pre_config_init_method(LogPipe *s)
+{
+  AFSocketSourceDriver *self = (AFSocketSourceDriver *) s;
+
+  main_loop_worker_allocate_thread_space(self->num_accept_threads);
+  return TRUE;
+}
+
+/* accept threads start after the configuration has been initialized, as
+ * their readers register themselves in the config tree */
+gboolean
+afsocket_sd_post_config_init_method(LogPipe *s)
+{
+  AFSocketSourceDriver *self = (AFSocketSourceDriver *) s;
+
+  self->post_config_inited = TRUE;
+  if (self->num_accept_threads > 0)
+    _listen_fd_start(self);
+  return TRUE;
+}
+
 gboolean
 afsocket_sd_deinit_method(LogPipe *s)
 {
@@ -1344,7 +1743,10 @@ afsocket_sd_deinit_method(LogPipe *s)
 
   afsocket_sd_save_listener(self);
   afsocket_sd_save_connections(self);
+  self->post_config_inited = FALSE;
   afsocket_sd_dynamic_window_deinit(self);
+  transport_mapper_save_state(self->transport_mapper, log_pipe_get_config(s),
+                              afsocket_sd_format_transport_state_name(self));
   afsocket_sd_unregister_stats(self);
 
   return log_src_driver_deinit_method(s);
@@ -1387,6 +1789,7 @@ afsocket_sd_free_method(LogPipe *s)
 {
   AFSocketSourceDriver *self = (AFSocketSourceDriver *) s;
 
+  g_mutex_clear(&self->connections_lock);
   log_reader_options_destroy(&self->reader_options);
   transport_mapper_free(self->transport_mapper);
   socket_options_free(self->socket_options);
@@ -1402,9 +1805,12 @@ afsocket_sd_init_instance(AFSocketSourceDriver *self,
                           GlobalConfig *cfg)
 {
   log_src_driver_init_instance(&self->super, cfg);
+  g_mutex_init(&self->connections_lock);
 
   self->super.super.super.queue = afsocket_sd_queue;
+  self->super.super.super.pre_config_init = afsocket_sd_pre_config_init_method;
   self->super.super.super.init = afsocket_sd_init_method;
+  self->super.super.super.post_config_init = afsocket_sd_post_config_init_method;
   self->super.super.super.deinit = afsocket_sd_deinit_method;
   self->super.super.super.free_fn = afsocket_sd_free_method;
   self->super.super.super.notify = afsocket_sd_notify;
@@ -42,7 +42,8 @@ struct _AFSocketSourceDriver
   LogSrcDriver super;
   guint32 connections_kept_alive_across_reloads:1,
           window_size_initialized:1,
-          activate_listener:1;
+          activate_listener:1,
+          post_config_inited:1;
   struct iv_fd listen_fd;
   struct iv_timer dynamic_window_timer;
   gsize dynamic_window_size;
@@ -67,7 +68,16 @@ struct _AFSocketSourceDriver
   atomic_gssize max_connections;
   atomic_gssize num_connections;
   gint listen_backlog;
+  /* connections are added and removed by the accept threads as well */
+  GMutex connections_lock;
   GList *connections;
+
+  /* accept-threads(), 0 means accepting on the main thread */
+  gint num_accept_threads;
+  GPtrArray *accept_threads;
+  /* listeners of the accept threads, except the first one, which uses fd */
+  GArray *accept_listen_fds;
+
   SocketOptions *socket_options;
   TransportMapper *transport_mapper;
 
@@ -90,6 +100,7 @@ struct _AFSocketSourceDriver
 void afsocket_sd_set_keep_alive(LogDriver *self, gint enable);
 void afsocket_sd_set_max_connections(LogDriver *self, gint max_connections);
 void afsocket_sd_set_listen_backlog(LogDriver *self, gint listen_backlog);
+void afsocket_sd_set_accept_threads(LogDriver *self, gint accept_threads);
 void afsocket_sd_set_dynamic_window_size(LogDriver *self, gint dynamic_window_size);
 void afsocket_sd_set_dynamic_window_stats_freq(LogDriver *self, gdouble stats_freq);
 void afsocket_sd_set_dynamic_window_realloc_ticks(LogDriver *self, gint realloc_ticks);
@@ -111,7 +122,9 @@ afsocket_sd_setup_addresses(AFSocketSourceDriver *s)
 
 gboolean afsocket_sd_setup_addresses_method(AFSocketSourceDriver *self);
 
+gboolean afsocket_sd_pre_config_init_method(LogPipe *s);
 gboolean afsocket_sd_init_method(LogPipe *s);
+gboolean afsocket_sd_post_config_init_method(LogPipe *s);
 gboolean afsocket_sd_deinit_method(LogPipe *s);
 void afsocket_sd_free_method(LogPipe *self);
 
@@ -0,0 +1,290 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "afinet-source.h"
+#include "apphook.h"
+#include "mainloop.h"
+#include "mainloop-worker.h"
+#include "cfg.h"
+#include "gsockaddr.h"
+#include "logmsg/logmsg.h"
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <string.h>
+#include <unistd.h>
+
+#define NUM_CLIENTS 32
+#define NUM_MESSAGES_PER_CLIENT 10
+
+MainLoopOptions main_loop_options = {0};
+MainLoop *main_loop;
+
+/* collects the threads the messages of each connection were processed on */
+typedef struct _TestCapture
+{
+  LogPipe super;
+  GMutex lock;
+  GHashTable *threads_by_peer_port;
+  gint num_messages;
+  gboolean processed_on_main_thread;
+  gboolean connection_moved_between_threads;
+} TestCapture;
+
+static GThread *main_thread;
+
+static void
+_capture_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
+{
+  TestCapture *self = (TestCapture *) s;
+  gpointer peer_port = GUINT_TO_POINTER(g_sockaddr_get_port(msg->saddr));
+  GThread *thread = g_thread_self();
+
+  g_mutex_lock(&self->lock);
+  GThread *previous_thread = g_hash_table_lookup(self->threads_by_peer_port, peer_port);
+  if (previous_thread && previous_thread != thread)
+    self->connection_moved_between_threads = TRUE;
+  g_hash_table_insert(self->threads_by_peer_port, peer_port, thread);
+
+  if (thread == main_thread)
+    self->processed_on_main_thread = TRUE;
+  self->num_messages++;
+  g_mutex_unlock(&self->lock);
+
+  log_msg_drop(msg, path_options, AT_PROCESSED);
+}
+
+static void
+_capture_free(LogPipe *s)
+{
+  TestCapture *self = (TestCapture *) s;
+
+  g_hash_table_unref(self->threads_by_peer_port);
+  g_mutex_clear(&self->lock);
+  log_pipe_free_method(s);
+}
+
+static TestCapture *
+_capture_new(GlobalConfig *cfg)
+{
+  TestCapture *self = g_new0(TestCapture, 1);
+
+  log_pipe_init_instance(&self->super, cfg);
+  self->super.queue = _capture_queue;
+  self->super.free_fn = _capture_free;
+  g_mutex_init(&self->lock);
+  self->threads_by_peer_port = g_hash_table_new(g_direct_hash, g_direct_equal);
+  return self;
+}
+
+static gint
+_capture_get_num_messages(TestCapture *self)
+{
+  g_mutex_lock(&self->lock);
+  gint num_messages = self->num_messages;
+  g_mutex_unlock(&self->lock);
+  return num_messages;
+}
+
+static gint
+_find_free_port(void)
+{
+  struct sockaddr_in sin = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+  socklen_t sin_len = sizeof(sin);
+  gint sock = socket(AF_INET, SOCK_STREAM, 0);
+
+  cr_assert(sock >= 0);
+  cr_assert_eq(bind(sock, (struct sockaddr *) &sin, sizeof(sin)), 0);
+  cr_assert_eq(getsockname(sock, (struct sockaddr *) &sin, &sin_len), 0);
+  close(sock);
+
+  return ntohs(sin.sin_port);
+}
+
+static gint
+_connect_client(gint port)
+{
+  struct sockaddr_in sin = { .sin_family = AF_INET, .sin_port = htons(port), .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+  gint sock = socket(AF_INET, SOCK_STREAM, 0);
+
+  cr_assert(sock >= 0);
+  cr_assert_eq(connect(sock, (struct sockaddr *) &sin, sizeof(sin)), 0);
+  return sock;
+}
+
+static void
+_send_messages(gint sock)
+{
+  for (gint i = 0; i < NUM_MESSAGES_PER_CLIENT; i++)
+    {
+      gchar *line = g_strdup_printf("<13>Oct 18 00:00:00 localhost prog: message %d\n", i);
+      gssize len = strlen(line);
+
+      cr_assert_eq(write(sock, line, len), len);
+      g_free(line);
+    }
+}
+
+static gboolean
+_wait_for(gboolean (*condition)(gpointer), gpointer user_data)
+{
+  for (gint i = 0; i < 500; i++)
+    {
+      if (condition(user_data))
+        return TRUE;
+      g_usleep(10000);
+    }
+  return FALSE;
+}
+
+static gboolean
+_all_messages_arrived(gpointer user_data)
+{
+  return _capture_get_num_messages((TestCapture *) user_data) == NUM_CLIENTS * NUM_MESSAGES_PER_CLIENT;
+}
+
+static gboolean
+_all_connections_closed(gpointer user_data)
+{
+  AFSocketSourceDriver *driver = (AFSocketSourceDriver *) user_data;
+
+  return atomic_gssize_get(&driver->num_connections) == 0;
+}
+
+static AFSocketSourceDriver *
+_create_source(GlobalConfig *cfg, gint port)
+{
+  AFInetSourceDriver *driver = afinet_sd_new_tcp(cfg);
+  LogDriver *d = &driver->super.super.super;
+  gchar *port_str = g_strdup_printf("%d", port);
+
+  afinet_sd_set_localip(d, "127.0.0.1");
+  afinet_sd_set_localport(d, port_str);
+  afsocket_sd_set_keep_alive(d, FALSE);
+  afsocket_sd_set_max_connections(d, NUM_CLIENTS);
+  afsocket_sd_set_accept_threads(d, 2);
+  driver->super.reader_options.super.host_resolve_options.use_dns = FALSE;
+  g_free(port_str);
+
+  return &driver->super;
+}
+
+Test(accept_threads, connections_are_handled_by_the_thread_that_accepted_them)
+{
+  GlobalConfig *cfg = main_loop_get_current_config(main_loop);
+  AFSocketSourceDriver *driver = _create_source(cfg, _find_free_port());
+  TestCapture *capture = _capture_new(cfg);
+  gint clients[NUM_CLIENTS];
+
+  log_pipe_append(&driver->super.super.super, &capture->super);
+  cr_assert(log_pipe_init(&driver->super.super.super));
+  cr_assert(log_pipe_post_config_init(&driver->super.super.super));
+  cr_assert_eq(driver->accept_threads->len, 2);
+
+  for (gint i = 0; i < NUM_CLIENTS; i++)
+    {
+      clients[i] = _connect_client(g_sockaddr_get_port(driver->bind_addr));
+      _send_messages(clients[i]);
+    }
+
+  cr_assert(_wait_for(_all_messages_arrived, capture), "messages did not arrive, received: %d",
+            _capture_get_num_messages(capture));
+  cr_assert_not(capture->processed_on_main_thread);
+  cr_assert_not(capture->connection_moved_between_threads);
+  cr_assert_eq(g_hash_table_size(capture->threads_by_peer_port), NUM_CLIENTS);
+
+  /* the threads close their connections on EOF */
+  for (gint i = 0; i < NUM_CLIENTS; i++)
+    close(clients[i]);
+  cr_assert(_wait_for(_all_connections_closed, driver));
+
+  /* the listeners are set up with SO_REUSEPORT, without changing the option of the driver */
+  cr_assert_not(driver->socket_options->so_reuseport);
+
+  main_loop_sync_worker_startup_and_teardown();
+  cr_assert(log_pipe_deinit(&driver->super.super.super));
+  log_pipe_unref(&driver->super.super.super);
+  log_pipe_unref(&capture->super);
+}
+
+Test(accept_threads, connections_of_all_accept_threads_are_deinitialized_on_stop)
+{
+  GlobalConfig *cfg = main_loop_get_current_config(main_loop);
+  AFSocketSourceDriver *driver = _create_source(cfg, _find_free_port());
+  TestCapture *capture = _capture_new(cfg);
+  gint clients[NUM_CLIENTS];
+
+  log_pipe_append(&driver->super.super.super, &capture->super);
+  cr_assert(log_pipe_init(&driver->super.super.super));
+  cr_assert(log_pipe_post_config_init(&driver->super.super.super));
+
+  for (gint i = 0; i < NUM_CLIENTS; i++)
+    {
+      clients[i] = _connect_client(g_sockaddr_get_port(driver->bind_addr));
+      _send_messages(clients[i]);
+    }
+  cr_assert(_wait_for(_all_messages_arrived, capture));
+
+  /* distinct threads picked up the connections */
+  GHashTable *threads = g_hash_table_new(g_direct_hash, g_direct_equal);
+  GHashTableIter iter;
+  gpointer thread;
+
+  g_hash_table_iter_init(&iter, capture->threads_by_peer_port);
+  while (g_hash_table_iter_next(&iter, NULL, &thread))
+    g_hash_table_add(threads, thread);
+  cr_assert_eq(g_hash_table_size(threads), 2);
+  g_hash_table_unref(threads);
+
+  /* the open connections are deinitialized by the exiting threads */
+  main_loop_sync_worker_startup_and_teardown();
+  cr_assert(log_pipe_deinit(&driver->super.super.super));
+  cr_assert_null(driver->connections);
+
+  for (gint i = 0; i < NUM_CLIENTS; i++)
+    close(clients[i]);
+
+  log_pipe_unref(&driver->super.super.super);
+  log_pipe_unref(&capture->super);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  main_thread = g_thread_self();
+  main_loop = main_loop_get_instance();
+  main_loop_init(main_loop, &main_loop_options);
+  cfg_load_module(main_loop_get_current_config(main_loop), "syslogformat");
+}
+
+static void
+teardown(void)
+{
+  main_loop_deinit(main_loop);
+  app_shutdown();
+}
+
+TestSuite(accept_threads, .init = setup, .fini = teardown, .timeout = 20);
@@ -28,6 +28,7 @@
 #include "transport-mapper-inet.h"
 #include "socket-options-inet.h"
 #include "transport-mapper-lib.h"
+#include "cfg.h"
 
 #include <unistd.h>
 
@@ -135,6 +136,36 @@ create_dummy_tls_context(void)
   return tls_context;
 }
 
+static void
+assert_ticket_keys_equal(TLSContext *a, TLSContext *b, gboolean expected)
+{
+  guchar keys_a[128], keys_b[128];
+  glong keys_len = SSL_CTX_get_tlsext_ticket_keys(a->ssl_ctx, NULL, 0);
+
+  cr_assert(keys_len > 0 && keys_len <= (glong) sizeof(keys_a));
+  cr_assert(SSL_CTX_get_tlsext_ticket_keys(a->ssl_ctx, keys_a, keys_len));
+  cr_assert(SSL_CTX_get_tlsext_ticket_keys(b->ssl_ctx, keys_b, keys_len));
+  cr_assert_eq(memcmp(keys_a, keys_b, keys_len) == 0, expected, "unexpected session ticket keys after reload");
+}
+
+static void
+reload_transport_mapper_state(TransportMapper *old_mapper, TransportMapper *new_mapper)
+{
+  GlobalConfig *cfg = cfg_new_snippet();
+
+  cfg->persist = persist_config_new();
+  transport_mapper_save_state(old_mapper, cfg, "tls_sessions");
+  transport_mapper_restore_state(new_mapper, cfg, "tls_sessions");
+  cr_assert_null(cfg_persist_config_fetch(cfg, "tls_sessions"));
+
+  persist_config_free(cfg->persist);
+  cfg->persist = NULL;
+  cfg_free(cfg);
+
+  /* the sessions are handed over when the new TLS context is set up */
+  cr_assert(transport_mapper_init(new_mapper));
+}
+
 /******************************************************************************
  * Tests start here
  ******************************************************************************/
@@ -353,6 +384,79 @@ Test(transport_mapper_inet, test_open_socket_fails_properly_on_bind_failure)
   g_sockaddr_unref(addr);
 }
 
+Test(transport_mapper_inet, test_tls_session_cache_is_handed_over_on_reload)
+{
+  TLSContext *old_context = create_dummy_tls_context();
+  TLSContext *new_context = create_dummy_tls_context();
+
+  transport_mapper = transport_mapper_network_new();
+  transport_mapper_inet_set_tls_context((TransportMapperInet *) transport_mapper, old_context);
+  cr_assert(transport_mapper_init(transport_mapper));
+  TransportMapper *new_transport_mapper = transport_mapper_network_new();
+  transport_mapper_inet_set_tls_context((TransportMapperInet *) new_transport_mapper, new_context);
+
+  assert_ticket_keys_equal(old_context, new_context, FALSE);
+  reload_transport_mapper_state(transport_mapper, new_transport_mapper);
+  assert_ticket_keys_equal(old_context, new_context, TRUE);
+
+  transport_mapper_free(new_transport_mapper);
+}
+
+Test(transport_mapper_inet, test_tls_session_cache_is_dropped_when_the_tls_config_changes)
+{
+  TLSContext *old_context = create_dummy_tls_context();
+  TLSContext *new_context = create_dummy_tls_context();
+
+  tls_context_set_ca_dir(new_context, "/etc/ssl/other-ca");
+
+  transport_mapper = transport_mapper_network_new();
+  transport_mapper_inet_set_tls_context((TransportMapperInet *) transport_mapper, old_context);
+  cr_assert(transport_mapper_init(transport_mapper));
+  TransportMapper *new_transport_mapper = transport_mapper_network_new();
+  transport_mapper_inet_set_tls_context((TransportMapperInet *) new_transport_mapper, new_context);
+
+  reload_transport_mapper_state(transport_mapper, new_transport_mapper);
+  assert_ticket_keys_equal(old_context, new_context, FALSE);
+
+  transport_mapper_free(new_transport_mapper);
+}
+
+static void
+_write_file(const gchar *filename, const gchar *content)
+{
+  cr_assert(g_file_set_contents(filename, content, -1, NULL));
+}
+
+Test(transport_mapper_inet, test_tls_session_cache_is_dropped_when_a_loaded_file_changes)
+{
+  gchar *crl_dir = g_dir_make_tmp("test-tls-crl-XXXXXX", NULL);
+  gchar *crl_file = g_build_filename(crl_dir, "revoked.pem", NULL);
+  cr_assert(crl_dir);
+
+  _write_file(crl_file, "original");
+  TLSContext *old_context = create_dummy_tls_context();
+  tls_context_set_crl_dir(old_context, crl_dir);
+  transport_mapper = transport_mapper_network_new();
+  transport_mapper_inet_set_tls_context((TransportMapperInet *) transport_mapper, old_context);
+  cr_assert(transport_mapper_init(transport_mapper));
+
+  /* the option values don't change, only the contents of the directory */
+  _write_file(crl_file, "a new revocation list");
+  TLSContext *new_context = create_dummy_tls_context();
+  tls_context_set_crl_dir(new_context, crl_dir);
+  TransportMapper *new_transport_mapper = transport_mapper_network_new();
+  transport_mapper_inet_set_tls_context((TransportMapperInet *) new_transport_mapper, new_context);
+
+  reload_transport_mapper_state(transport_mapper, new_transport_mapper);
+  assert_ticket_keys_equal(old_context, new_context, FALSE);
+
+  transport_mapper_free(new_transport_mapper);
+  unlink(crl_file);
+  rmdir(crl_dir);
+  g_free(crl_file);
+  g_free(crl_dir);
+}
+
 static void
 setup(void)
 {
@@ -166,14 +166,31 @@ transport_mapper_inet_construct_log_transport(TransportMapper *s, gint fd)
   return transport;
 }
 
+/* the handed over sessions are checked against the configuration digest
+ * that tls_context_setup_context() takes, so this can only run after it */
+static void
+_restore_session_cache(TransportMapperInet *self)
+{
+  if (!self->restored_session_cache)
+    return;
+
+  tls_context_restore_session_cache(self->tls_context, self->restored_session_cache);
+  tls_session_cache_state_free(self->restored_session_cache);
+  self->restored_session_cache = NULL;
+}
+
 static gboolean
 transport_mapper_inet_init(TransportMapper *s)
 {
   TransportMapperInet *self = (TransportMapperInet *) s;
 
-  if (self->tls_context && (tls_context_setup_context(self->tls_context) != TLS_CONTEXT_SETUP_OK))
+  if (!self->tls_context)
+    return TRUE;
+
+  if (tls_context_setup_context(self->tls_context) != TLS_CONTEXT_SETUP_OK)
     return FALSE;
 
+  _restore_session_cache(self);
   return TRUE;
 }
 
@@ -223,6 +240,7 @@ _call_finalize_init(Secret *secret, gpointer user_data)
     }
     default:
       secret_storage_update_status(key, SECRET_STORAGE_SUCCESS);
+      _restore_session_cache(self);
       if (!args->func(args->func_args))
         {
           msg_error("Error finalize initialization",
@@ -247,6 +265,7 @@ transport_mapper_inet_async_init(TransportMapper *s, TransportMapperAsyncInitCB
     {
       if (key && secret_storage_contains_key(key))
         secret_storage_update_status(key, SECRET_STORAGE_SUCCESS);
+      _restore_session_cache(self);
       return func(func_args);
     }
 
@@ -272,6 +291,38 @@ transport_mapper_inet_async_init(TransportMapper *s, TransportMapperAsyncInitCB
   return FALSE;
 }
 
+static void
+transport_mapper_inet_save_state(TransportMapper *s, GlobalConfig *cfg, const gchar *persist_name)
+{
+  TransportMapperInet *self = (TransportMapperInet *) s;
+
+  if (!self->tls_context)
+    return;
+
+  TLSSessionCacheState *state = tls_context_save_session_cache(self->tls_context);
+  if (!state)
+    return;
+
+  cfg_persist_config_add(cfg, persist_name, state, (GDestroyNotify) tls_session_cache_state_free);
+}
+
+static void
+transport_mapper_inet_restore_state(TransportMapper *s, GlobalConfig *cfg, const gchar *persist_name)
+{
+  TransportMapperInet *self = (TransportMapperInet *) s;
+
+  if (!self->tls_context)
+    return;
+
+  TLSSessionCacheState *state = cfg_persist_config_fetch(cfg, persist_name);
+  if (!state)
+    return;
+
+  if (self->restored_session_cache)
+    tls_session_cache_state_free(self->restored_session_cache);
+  self->restored_session_cache = state;
+}
+
 void
 transport_mapper_inet_free_method(TransportMapper *s)
 {
@@ -284,6 +335,8 @@ transport_mapper_inet_free_method(TransportMapper *s)
       g_free(self->secret_store_cb_data);
     }
 
+  if (self->restored_session_cache)
+    tls_session_cache_state_free(self->restored_session_cache);
   if (self->tls_verifier)
     tls_verifier_unref(self->tls_verifier);
   if (self->tls_context)
@@ -300,6 +353,8 @@ transport_mapper_inet_init_instance(TransportMapperInet *self, const gchar *tran
   self->super.construct_log_transport = transport_mapper_inet_construct_log_transport;
   self->super.init = transport_mapper_inet_init;
   self->super.async_init = transport_mapper_inet_async_init;
+  self->super.save_state = transport_mapper_inet_save_state;
+  self->super.restore_state = transport_mapper_inet_restore_state;
   self->super.free_fn = transport_mapper_inet_free_method;
   self->super.address_family = AF_INET;
 }
@@ -40,6 +40,8 @@ typedef struct _TransportMapperInet
   TLSContext *tls_context;
   TLSVerifier *tls_verifier;
   gpointer secret_store_cb_data;
+  /* cached TLS sessions of the previous config, applied once tls_context is set up */
+  TLSSessionCacheState *restored_session_cache;
 } TransportMapperInet;
 
 static inline void
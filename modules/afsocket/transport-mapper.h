@@ -55,6 +55,9 @@ struct _TransportMapper
   LogTransport *(*construct_log_transport)(TransportMapper *self, gint fd);
   gboolean (*init)(TransportMapper *self);
   gboolean (*async_init)(TransportMapper *self, TransportMapperAsyncInitCB func, gpointer arg);
+  /* state kept across reloads, e.g. cached TLS sessions */
+  void (*save_state)(TransportMapper *self, GlobalConfig *cfg, const gchar *persist_name);
+  void (*restore_state)(TransportMapper *self, GlobalConfig *cfg, const gchar *persist_name);
   void (*free_fn)(TransportMapper *self);
 };
 
@@ -111,6 +114,20 @@ transport_mapper_init(TransportMapper *self)
   return TRUE;
 }
 
+static inline void
+transport_mapper_save_state(TransportMapper *self, GlobalConfig *cfg, const gchar *persist_name)
+{
+  if (self->save_state)
+    self->save_state(self, cfg, persist_name);
+}
+
+static inline void
+transport_mapper_restore_state(TransportMapper *self, GlobalConfig *cfg, const gchar *persist_name)
+{
+  if (self->restore_state)
+    self->restore_state(self, cfg, persist_name);
+}
+
 static inline gboolean
 transport_mapper_async_init(TransportMapper *self, TransportMapperAsyncInitCB func, gpointer arg)
 {
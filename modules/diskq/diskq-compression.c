@@ -0,0 +1,239 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "diskq-compression.h"
+#include "messages.h"
+
+#include <string.h>
+
+#ifdef SYSLOG_NG_HAVE_LZ4
+#include <lz4.h>
+#endif
+
+#ifdef SYSLOG_NG_HAVE_ZSTD
+#include <zstd.h>
+
+/* favour speed, the disk-buffer is on the hot path of the destination */
+#define DISKQ_ZSTD_COMPRESSION_LEVEL 1
+#endif
+
+struct _DiskQueueCodec
+{
+  DiskQueueCompression compression;
+#ifdef SYSLOG_NG_HAVE_ZSTD
+  ZSTD_CCtx *zstd_cctx;
+  ZSTD_DCtx *zstd_dctx;
+#endif
+};
+
+gboolean
+disk_queue_compression_parse(const gchar *name, DiskQueueCompression *compression)
+{
+  if (strcmp(name, "none") == 0)
+    *compression = DISKQ_COMPRESSION_NONE;
+  else if (strcmp(name, "lz4") == 0)
+    *compression = DISKQ_COMPRESSION_LZ4;
+  else if (strcmp(name, "zstd") == 0)
+    *compression = DISKQ_COMPRESSION_ZSTD;
+  else
+    return FALSE;
+
+  return TRUE;
+}
+
+const gchar *
+disk_queue_compression_format(DiskQueueCompression compression)
+{
+  switch (compression)
+    {
+    case DISKQ_COMPRESSION_NONE:
+      return "none";
+    case DISKQ_COMPRESSION_LZ4:
+      return "lz4";
+    case DISKQ_COMPRESSION_ZSTD:
+      return "zstd";
+    default:
+      return "unknown";
+    }
+}
+
+gboolean
+disk_queue_compression_is_available(DiskQueueCompression compression)
+{
+  switch (compression)
+    {
+    case DISKQ_COMPRESSION_NONE:
+      return TRUE;
+#ifdef SYSLOG_NG_HAVE_LZ4
+    case DISKQ_COMPRESSION_LZ4:
+      return TRUE;
+#endif
+#ifdef SYSLOG_NG_HAVE_ZSTD
+    case DISKQ_COMPRESSION_ZSTD:
+      return TRUE;
+#endif
+    default:
+      return FALSE;
+    }
+}
+
+#ifdef SYSLOG_NG_HAVE_LZ4
+
+static gboolean
+_lz4_compress(DiskQueueCodec *self, const gchar *src, gsize src_len, GString *dst)
+{
+  gsize orig_len = dst->len;
+  gint bound = LZ4_compressBound(src_len);
+
+  g_string_set_size(dst, orig_len + bound);
+  gint compressed_len = LZ4_compress_default(src, dst->str + orig_len, src_len, bound);
+  if (compressed_len <= 0)
+    {
+      g_string_set_size(dst, orig_len);
+      return FALSE;
+    }
+
+  g_string_set_size(dst, orig_len + compressed_len);
+  return TRUE;
+}
+
+static gboolean
+_lz4_decompress(DiskQueueCodec *self, const gchar *src, gsize src_len, gchar *dst, gsize dst_len)
+{
+  gint decompressed_len = LZ4_decompress_safe(src, dst, src_len, dst_len);
+  return decompressed_len >= 0 && decompressed_len == dst_len;
+}
+
+#endif
+
+#ifdef SYSLOG_NG_HAVE_ZSTD
+
+static gboolean
+_zstd_compress(DiskQueueCodec *self, const gchar *src, gsize src_len, GString *dst)
+{
+  gsize orig_len = dst->len;
+  gsize bound = ZSTD_compressBound(src_len);
+
+  g_string_set_size(dst, orig_len + bound);
+  gsize compressed_len = ZSTD_compressCCtx(self->zstd_cctx, dst->str + orig_len, bound, src, src_len,
+                                           DISKQ_ZSTD_COMPRESSION_LEVEL);
+  if (ZSTD_isError(compressed_len))
+    {
+      msg_debug("Error compressing disk-queue record",
+                evt_tag_str("error", ZSTD_getErrorName(compressed_len)));
+      g_string_set_size(dst, orig_len);
+      return FALSE;
+    }
+
+  g_string_set_size(dst, orig_len + compressed_len);
+  return TRUE;
+}
+
+static gboolean
+_zstd_decompress(DiskQueueCodec *self, const gchar *src, gsize src_len, gchar *dst, gsize dst_len)
+{
+  gsize decompressed_len = ZSTD_decompressDCtx(self->zstd_dctx, dst, dst_len, src, src_len);
+  if (ZSTD_isError(decompressed_len))
+    {
+      msg_error("Error decompressing disk-queue record",
+                evt_tag_str("error", ZSTD_getErrorName(decompressed_len)));
+      return FALSE;
+    }
+
+  return decompressed_len == dst_len;
+}
+
+#endif
+
+/* appends the compressed form of src to dst */
+gboolean
+disk_queue_codec_compress(DiskQueueCodec *self, const gchar *src, gsize src_len, GString *dst)
+{
+  switch (self->compression)
+    {
+#ifdef SYSLOG_NG_HAVE_LZ4
+    case DISKQ_COMPRESSION_LZ4:
+      return _lz4_compress(self, src, src_len, dst);
+#endif
+#ifdef SYSLOG_NG_HAVE_ZSTD
+    case DISKQ_COMPRESSION_ZSTD:
+      return _zstd_compress(self, src, src_len, dst);
+#endif
+    default:
+      g_assert_not_reached();
+    }
+}
+
+/* dst_len is the exact length of the original data */
+gboolean
+disk_queue_codec_decompress(DiskQueueCodec *self, const gchar *src, gsize src_len, gchar *dst, gsize dst_len)
+{
+  switch (self->compression)
+    {
+#ifdef SYSLOG_NG_HAVE_LZ4
+    case DISKQ_COMPRESSION_LZ4:
+      return _lz4_decompress(self, src, src_len, dst, dst_len);
+#endif
+#ifdef SYSLOG_NG_HAVE_ZSTD
+    case DISKQ_COMPRESSION_ZSTD:
+      return _zstd_decompress(self, src, src_len, dst, dst_len);
+#endif
+    default:
+      g_assert_not_reached();
+    }
+}
+
+DiskQueueCodec *
+disk_queue_codec_new(DiskQueueCompression compression)
+{
+  g_assert(compression != DISKQ_COMPRESSION_NONE);
+
+  if (!disk_queue_compression_is_available(compression))
+    return NULL;
+
+  DiskQueueCodec *self = g_new0(DiskQueueCodec, 1);
+  self->compression = compression;
+
+#ifdef SYSLOG_NG_HAVE_ZSTD
+  if (compression == DISKQ_COMPRESSION_ZSTD)
+    {
+      self->zstd_cctx = ZSTD_createCCtx();
+      self->zstd_dctx = ZSTD_createDCtx();
+    }
+#endif
+
+  return self;
+}
+
+void
+disk_queue_codec_free(DiskQueueCodec *self)
+{
+  if (!self)
+    return;
+
+#ifdef SYSLOG_NG_HAVE_ZSTD
+  ZSTD_freeCCtx(self->zstd_cctx);
+  ZSTD_freeDCtx(self->zstd_dctx);
+#endif
+
+  g_free(self);
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2024 Axoflow
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef DISKQ_COMPRESSION_H_
+#define DISKQ_COMPRESSION_H_
+
+#include "syslog-ng.h"
+
+/* stored in the disk-queue file header, do not renumber */
+typedef enum
+{
+  DISKQ_COMPRESSION_NONE = 0,
+  DISKQ_COMPRESSION_LZ4 = 1,
+  DISKQ_COMPRESSION_ZSTD = 2,
+} DiskQueueCompression;
+
+typedef struct _DiskQueueCodec DiskQueueCodec;
+
+gboolean disk_queue_compression_parse(const gchar *name, DiskQueueCompression *compression);
+const gchar *disk_queue_compression_format(DiskQueueCompression compression);
+gboolean disk_queue_compression_is_available(DiskQueueCompression compression);
+
+DiskQueueCodec *disk_queue_codec_new(DiskQueueCompression compression);
+gboolean disk_queue_codec_compress(DiskQueueCodec *self, const gchar *src, gsize src_len, GString *dst);
+gboolean disk_queue_codec_decompress(DiskQueueCodec *self, const gchar *src, gsize src_len,
+                                     gchar *dst, gsize dst_len);
+void disk_queue_codec_free(DiskQueueCodec *self);
+
+#endif /* DISKQ_COMPRESSION_H_ */
@@ -82,6 +82,55 @@ disk_queue_options_set_prealloc(DiskQueueOptions *self, gboolean prealloc)
   self->prealloc = prealloc;
 }
 
+void
+disk_queue_options_set_write_batch_messages(DiskQueueOptions *self, gint write_batch_messages)
+{
+  self->write_batch_messages = MAX(write_batch_messages, 1);
+}
+
+void
+disk_queue_options_set_write_batch_bytes(DiskQueueOptions *self, gint write_batch_bytes)
+{
+  self->write_batch_bytes = write_batch_bytes;
+}
+
+void
+disk_queue_options_set_write_batch_timeout(DiskQueueOptions *self, gint write_batch_timeout)
+{
+  self->write_batch_timeout = write_batch_timeout;
+}
+
+void
+disk_queue_options_set_sync_interval(DiskQueueOptions *self, gint sync_interval)
+{
+  self->sync_interval = sync_interval;
+}
+
+void
+disk_queue_options_set_sync_bytes(DiskQueueOptions *self, gint64 sync_bytes)
+{
+  self->sync_bytes = sync_bytes;
+}
+
+gboolean
+disk_queue_options_set_compression(DiskQueueOptions *self, const gchar *compression)
+{
+  DiskQueueCompression parsed_compression;
+
+  if (!disk_queue_compression_parse(compression, &parsed_compression))
+    return FALSE;
+
+  if (!disk_queue_compression_is_available(parsed_compression))
+    {
+      msg_error("The requested disk-buffer compression is not available in this build of syslog-ng",
+                evt_tag_str("compression", compression));
+      return FALSE;
+    }
+
+  self->compression = parsed_compression;
+  return TRUE;
+}
+
 void
 disk_queue_options_check_plugin_settings(DiskQueueOptions *self)
 {
@@ -134,6 +183,12 @@ disk_queue_options_set_default_options(DiskQueueOptions *self)
   self->dir = g_strdup(get_installation_path_for(SYSLOG_NG_PATH_LOCALSTATEDIR));
   self->truncate_size_ratio = -1;
   self->prealloc = -1;
+  self->write_batch_messages = 1;
+  self->write_batch_bytes = 64 * 1024;
+  self->write_batch_timeout = 100;
+  self->sync_interval = 0;
+  self->sync_bytes = 0;
+  self->compression = DISKQ_COMPRESSION_NONE;
 }
 
 void
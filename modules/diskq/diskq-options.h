@@ -26,6 +26,7 @@
 
 #include "syslog-ng.h"
 #include "logmsg/logmsg-serialize.h"
+#include "diskq-compression.h"
 
 #define MIN_CAPACITY_BYTES 1024*1024
 
@@ -41,6 +42,12 @@ typedef struct _DiskQueueOptions
   gchar *dir;
   gdouble truncate_size_ratio;
   gboolean prealloc;
+  gint write_batch_messages;
+  gint write_batch_bytes;
+  gint write_batch_timeout;
+  gint sync_interval;
+  gint64 sync_bytes;
+  DiskQueueCompression compression;
 } DiskQueueOptions;
 
 void disk_queue_options_front_cache_size_set(DiskQueueOptions *self, gint front_cache_size);
@@ -53,6 +60,12 @@ void disk_queue_options_check_plugin_settings(DiskQueueOptions *self);
 void disk_queue_options_set_dir(DiskQueueOptions *self, const gchar *dir);
 void disk_queue_options_set_truncate_size_ratio(DiskQueueOptions *self, gdouble truncate_size_ratio);
 void disk_queue_options_set_prealloc(DiskQueueOptions *self, gboolean prealloc);
+void disk_queue_options_set_write_batch_messages(DiskQueueOptions *self, gint write_batch_messages);
+void disk_queue_options_set_write_batch_bytes(DiskQueueOptions *self, gint write_batch_bytes);
+void disk_queue_options_set_write_batch_timeout(DiskQueueOptions *self, gint write_batch_timeout);
+void disk_queue_options_set_sync_interval(DiskQueueOptions *self, gint sync_interval);
+void disk_queue_options_set_sync_bytes(DiskQueueOptions *self, gint64 sync_bytes);
+gboolean disk_queue_options_set_compression(DiskQueueOptions *self, const gchar *compression);
 void disk_queue_options_set_default_options(DiskQueueOptions *self);
 void disk_queue_options_destroy(DiskQueueOptions *self);
 
@@ -44,6 +44,12 @@ static CfgLexerKeyword diskq_keywords[] =
   { "dir",               KW_DIR },
   { "truncate_size_ratio", KW_TRUNCATE_SIZE_RATIO },
   { "prealloc",          KW_PREALLOC },
+  { "write_batch_messages", KW_WRITE_BATCH_MESSAGES },
+  { "write_batch_bytes", KW_WRITE_BATCH_BYTES },
+  { "write_batch_timeout", KW_WRITE_BATCH_TIMEOUT },
+  { "sync_interval",     KW_SYNC_INTERVAL },
+  { "sync_bytes",        KW_SYNC_BYTES },
+  { "compression",       KW_COMPRESSION },
   { "stats",             KW_STATS },
   { "freq",              KW_FREQ },
   { NULL }
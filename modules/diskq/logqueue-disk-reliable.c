@@ -208,6 +208,77 @@ _rewind_backlog_all(LogQueue *s)
   _rewind_backlog(s, G_MAXUINT);
 }
 
+static inline gboolean
+_is_reserved_buffer_size_reached(LogQueueDiskReliable *self)
+{
+  return qdisk_get_empty_space(self->super.qdisk) < qdisk_get_flow_control_window_bytes(self->super.qdisk);
+}
+
+static inline gboolean
+_is_space_available_in_front_cache(LogQueueDiskReliable *self)
+{
+  gint num_of_messages_in_front_cache = g_queue_get_length(self->front_cache) / ENTRIES_PER_MSG_IN_MEM_Q;
+  return num_of_messages_in_front_cache < self->front_cache_size;
+}
+
+static void
+_push_to_front_cache_acked(LogQueueDiskReliable *self, gint64 position, LogMessage *msg,
+                           const LogPathOptions *path_options)
+{
+  /*
+   * Keep the message in memory for fast-path.
+   * Set its ack_needed to FALSE, because we have already acked it.
+   */
+  LogPathOptions local_path_options;
+  log_path_options_chain(&local_path_options, path_options);
+  local_path_options.ack_needed = FALSE;
+  _push_to_memory_queue_tail(self->front_cache, position, msg, &local_path_options);
+  log_queue_memory_usage_add(&self->super.super, log_msg_get_size(msg));
+}
+
+/*
+ * A message can only be acked once its record is written to the file,
+ * otherwise it would be lost if we crashed before the qdisk write batch is
+ * flushed.  Those messages wait in write_batch_window, and are acked here
+ * once the batch is written, by whichever push, read or timer flushed it.
+ *
+ * The records of write_batch_window are pushed after the records of the
+ * front cache, and are written and read in order, so counting is enough to
+ * tell which of them are written and which are read already.  Flushed
+ * messages are only put into the front cache while the flow control window
+ * is empty, as its records may be interleaved with theirs.
+ */
+static void
+_ack_written_messages(LogQueueDiskReliable *self)
+{
+  gint num_waiting = self->write_batch_window->length / ENTRIES_PER_MSG_IN_MEM_Q;
+  gint num_unwritten = qdisk_get_write_batch_length(self->super.qdisk);
+  gint64 num_unread = qdisk_get_length(self->super.qdisk);
+
+  for (gint i = num_waiting; i > num_unwritten; i--)
+    {
+      gint64 position;
+      LogMessage *msg;
+      LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+
+      _pop_from_memory_queue_head(self->write_batch_window, &position, &msg, &path_options);
+      log_queue_memory_usage_sub(&self->super.super, log_msg_get_size(msg));
+      log_msg_ack(msg, &path_options, AT_PROCESSED);
+
+      gboolean unread = i <= num_unread && g_queue_is_empty(self->flow_control_window);
+      if (unread && _is_space_available_in_front_cache(self))
+        _push_to_front_cache_acked(self, position, msg, &path_options);
+      else
+        log_msg_unref(msg);
+    }
+}
+
+static void
+_write_batch_flushed(LogQueueDisk *s)
+{
+  _ack_written_messages((LogQueueDiskReliable *) s);
+}
+
 static inline gboolean
 _is_next_message_in_flow_control_window(LogQueueDiskReliable *self)
 {
@@ -297,6 +368,9 @@ _pop_head(LogQueue *s, LogPathOptions *path_options)
   msg = log_queue_disk_read_message(&self->super, path_options);
 
 exit:
+  /* reading up to the write head flushes the write batch */
+  _ack_written_messages(self);
+
   if (!msg)
     {
       g_mutex_unlock(&s->lock);
@@ -313,19 +387,6 @@ exit:
   return msg;
 }
 
-static inline gboolean
-_is_reserved_buffer_size_reached(LogQueueDiskReliable *self)
-{
-  return qdisk_get_empty_space(self->super.qdisk) < qdisk_get_flow_control_window_bytes(self->super.qdisk);
-}
-
-static inline gboolean
-_is_space_available_in_front_cache(LogQueueDiskReliable *self)
-{
-  gint num_of_messages_in_front_cache = g_queue_get_length(self->front_cache) / ENTRIES_PER_MSG_IN_MEM_Q;
-  return num_of_messages_in_front_cache < self->front_cache_size;
-}
-
 static void
 _push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *path_options)
 {
@@ -384,19 +445,19 @@ _push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *path_options)
       goto exit;
     }
 
+  if (qdisk_get_write_batch_length(self->super.qdisk) > 0 || !g_queue_is_empty(self->write_batch_window))
+    {
+      _push_to_memory_queue_tail(self->write_batch_window, message_position, msg, path_options);
+      log_queue_memory_usage_add(s, log_msg_get_size(msg));
+      _ack_written_messages(self);
+      goto exit;
+    }
+
   log_msg_ack(msg, path_options, AT_PROCESSED);
 
   if (_is_space_available_in_front_cache(self))
     {
-      /*
-       * Keep the message in memory for fast-path.
-       * Set its ack_needed to FALSE, because we have already acked it.
-       */
-      LogPathOptions local_path_options;
-      log_path_options_chain(&local_path_options, path_options);
-      local_path_options.ack_needed = FALSE;
-      _push_to_memory_queue_tail(self->front_cache, message_position, msg, &local_path_options);
-      log_queue_memory_usage_add(s, log_msg_get_size(msg));
+      _push_to_front_cache_acked(self, message_position, msg, path_options);
       goto exit;
     }
 
@@ -425,6 +486,13 @@ _free(LogQueue *s)
       self->flow_control_window = NULL;
     }
 
+  if (self->write_batch_window)
+    {
+      g_assert(g_queue_is_empty(self->write_batch_window));
+      g_queue_free(self->write_batch_window);
+      self->write_batch_window = NULL;
+    }
+
   if (self->backlog)
     {
       g_assert(g_queue_is_empty(self->backlog));
@@ -456,6 +524,7 @@ _stop(LogQueueDisk *s, gboolean *persistent)
     }
 
   _empty_queue(self, self->flow_control_window);
+  _empty_queue(self, self->write_batch_window);
   _empty_queue(self, self->front_cache);
   _empty_queue(self, self->backlog);
 
@@ -480,6 +549,7 @@ _set_logqueue_disk_virtual_functions(LogQueueDisk *s)
 {
   s->start = _start;
   s->stop = _stop;
+  s->write_batch_flushed = _write_batch_flushed;
 }
 
 static inline void
@@ -503,6 +573,7 @@ log_queue_disk_reliable_new(DiskQueueOptions *options, const gchar *filename, co
       options->flow_control_window_bytes = PESSIMISTIC_FLOW_CONTROL_WINDOW_BYTES;
     }
   self->flow_control_window = g_queue_new();
+  self->write_batch_window = g_queue_new();
   self->backlog = g_queue_new();
   self->front_cache = g_queue_new();
   self->front_cache_size = options->front_cache_size;
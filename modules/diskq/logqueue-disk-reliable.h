@@ -30,6 +30,8 @@ typedef struct _LogQueueDiskReliable
 {
   LogQueueDisk super;
   GQueue *flow_control_window;
+  /* messages whose records are still in the write batch of the qdisk, not acked yet */
+  GQueue *write_batch_window;
   GQueue *backlog;
   GQueue *front_cache;
   gint front_cache_size;
@@ -31,6 +31,7 @@
 #include "reloc.h"
 #include "qdisk.h"
 #include "scratch-buffers.h"
+#include "timeutils/misc.h"
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -46,12 +47,60 @@
 
 QueueType log_queue_disk_type = "DISK";
 
+static void
+_flush_timer_stop(LogQueueDisk *self)
+{
+  if (iv_timer_registered(&self->flush_timer))
+    iv_timer_unregister(&self->flush_timer);
+}
+
+static void
+_flush_timer_start(LogQueueDisk *self)
+{
+  gint flush_interval = qdisk_get_flush_interval(self->qdisk);
+
+  if (flush_interval <= 0)
+    return;
+
+  _flush_timer_stop(self);
+
+  iv_validate_now();
+  self->flush_timer.expires = iv_now;
+  timespec_add_msec(&self->flush_timer.expires, flush_interval);
+  iv_timer_register(&self->flush_timer);
+}
+
+/*
+ * Producers only check write-batch-timeout() and sync-interval() when they
+ * push the next record, so a partial batch would be held back, and the
+ * last writes would stay unsynced indefinitely once the input goes idle.
+ * The timer flushes and syncs whatever is pending.
+ */
+static void
+_flush_timer_expired(gpointer s)
+{
+  LogQueueDisk *self = (LogQueueDisk *) s;
+
+  g_mutex_lock(&self->super.lock);
+  if (qdisk_started(self->qdisk))
+    {
+      qdisk_flush(self->qdisk);
+      if (self->write_batch_flushed)
+        self->write_batch_flushed(self);
+    }
+  g_mutex_unlock(&self->super.lock);
+
+  _flush_timer_start(self);
+}
+
 gboolean
 log_queue_disk_stop(LogQueue *s, gboolean *persistent)
 {
   LogQueueDisk *self = (LogQueueDisk *) s;
   g_assert(self->stop);
 
+  _flush_timer_stop(self);
+
   if (!qdisk_started(self->qdisk))
     {
       *persistent = FALSE;
@@ -76,6 +125,7 @@ log_queue_disk_start(LogQueue *s)
       log_queue_queued_messages_add(s, log_queue_get_length(s));
       log_queue_disk_update_disk_related_counters(self);
       stats_counter_set(self->metrics.capacity, B_TO_KiB(qdisk_get_max_useful_space(self->qdisk)));
+      _flush_timer_start(self);
       return TRUE;
     }
 
@@ -94,6 +144,8 @@ _unregister_counters(LogQueueDisk *self)
 {
   stats_lock();
   {
+    qdisk_unregister_stats(self->qdisk);
+
     if (self->metrics.capacity_sc_key)
       {
         stats_unregister_counter(self->metrics.capacity_sc_key, SC_TYPE_SINGLE_VALUE,
@@ -125,9 +177,10 @@ void
 log_queue_disk_free_method(LogQueueDisk *self)
 {
   g_assert(!qdisk_started(self->qdisk));
-  qdisk_free(self->qdisk);
+  g_assert(!iv_timer_registered(&self->flush_timer));
 
   _unregister_counters(self);
+  qdisk_free(self->qdisk);
 
   log_queue_free_method(&self->super);
 }
@@ -382,6 +435,8 @@ _register_counters(LogQueueDisk *self, gint stats_level, StatsClusterKeyBuilder
                            &self->metrics.disk_usage);
     stats_register_counter(stats_level, self->metrics.disk_allocated_sc_key, SC_TYPE_SINGLE_VALUE,
                            &self->metrics.disk_allocated);
+
+    qdisk_register_stats(self->qdisk, stats_level, builder);
   }
   stats_unlock();
 }
@@ -406,6 +461,10 @@ log_queue_disk_init_instance(LogQueueDisk *self, DiskQueueOptions *options, cons
 
   self->compaction = options->compaction;
 
+  IV_TIMER_INIT(&self->flush_timer);
+  self->flush_timer.cookie = self;
+  self->flush_timer.handler = _flush_timer_expired;
+
   self->qdisk = qdisk_new(options, qdisk_file_id, filename);
   _register_counters(self, stats_level, queue_sck_builder);
 
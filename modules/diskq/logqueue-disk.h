@@ -29,6 +29,8 @@
 #include "qdisk.h"
 #include "logmsg/logmsg-serialize.h"
 
+#include <iv.h>
+
 typedef struct _LogQueueDisk LogQueueDisk;
 
 struct _LogQueueDisk
@@ -53,9 +55,14 @@ struct _LogQueueDisk
   } metrics;
 
   gboolean compaction;
+
+  /* periodically flushes the pending qdisk write batch and syncs idle writes */
+  struct iv_timer flush_timer;
   gboolean (*start)(LogQueueDisk *s);
   gboolean (*stop)(LogQueueDisk *s, gboolean *persistent);
   gboolean (*stop_corrupted)(LogQueueDisk *s);
+  /* optional, called under the queue lock after the flush timer flushed the write batch */
+  void (*write_batch_flushed)(LogQueueDisk *s);
 };
 
 extern QueueType log_queue_disk_type;
@@ -27,6 +27,8 @@
 #include "serialize.h"
 #include "logmsg/logmsg-serialize.h"
 #include "stats/stats-registry.h"
+#include "stats/stats-cluster-single.h"
+#include "stats/stats-cluster-key-builder.h"
 #include "reloc.h"
 #include "compat/lfs.h"
 #include "scratch-buffers.h"
@@ -51,7 +53,7 @@
 
 #define PATH_QDISK              PATH_LOCALSTATEDIR
 
-#define QDISK_HDR_VERSION_CURRENT 3
+#define QDISK_HDR_VERSION_CURRENT 4
 
 #define QDISK_FILENAME_PREFIX "syslog-ng-"
 #define QDISK_FILENAME_IDX_FMT "%05d"
@@ -90,10 +92,78 @@ typedef union _QDiskFileHeader
 
     guint8 use_v1_wrap_condition;
     gint64 capacity_bytes;
+
+    /* DiskQueueCompression of the records, see _compress_record() */
+    guint8 compression;
   };
   gchar _pad2[QDISK_RESERVED_SPACE];
 } QDiskFileHeader;
 
+#define QDISK_HISTOGRAM_MAX_BUCKETS 16
+
+/* Cumulative histogram, exported as one counter per bucket with an "le" label */
+typedef struct _QDiskHistogram
+{
+  const gint64 *bounds;
+  const gchar *const *bound_labels;
+  gint num_bounds;
+  StatsClusterKey *sc_keys[QDISK_HISTOGRAM_MAX_BUCKETS];
+  StatsCounterItem *buckets[QDISK_HISTOGRAM_MAX_BUCKETS];
+} QDiskHistogram;
+
+/* number of records flushed together */
+static const gint64 write_batch_size_bounds[] = { 1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024 };
+static const gchar *const write_batch_size_labels[] =
+{
+  "1", "2", "4", "8", "16", "32", "64", "128", "256", "512", "1024"
+};
+
+/* fdatasync() latency in microseconds, labelled in seconds */
+static const gint64 sync_latency_bounds[] = { 100, 500, 1000, 5000, 10000, 50000, 100000, 500000, 1000000 };
+static const gchar *const sync_latency_labels[] =
+{
+  "0.0001", "0.0005", "0.001", "0.005", "0.01", "0.05", "0.1", "0.5", "1"
+};
+
+/*
+ * Records collected by qdisk_push_tail() that are not yet written to the
+ * file. The batch occupies the contiguous range [ofs, ofs + buffer->len),
+ * where ofs equals hdr->write_head: the header only advances once the batch
+ * has been written, so the on-disk state is consistent at all times.
+ */
+typedef struct _QDiskWriteBatch
+{
+  GString *buffer;
+  gint64 ofs;
+  guint32 count;
+  gint64 start_time;
+} QDiskWriteBatch;
+
+/*
+ * A window of the file cached in memory, so that walking the queue costs
+ * a single pread() per window instead of two per record. The file is not
+ * mmap()-ed, as the writer truncates it, which would make accesses through
+ * a stale mapping fault with SIGBUS.
+ *
+ * Only written data is ever cached (see _get_readable_end()): the writer
+ * never overwrites the part of the file between the backlog head and the
+ * write head, and readers move backwards (a wrap, a rewind or a reset)
+ * only to positions that are either outside of the window or still intact.
+ * Resetting the heads of an empty queue is the exception, that invalidates
+ * the windows.
+ */
+typedef struct _QDiskReadAhead
+{
+  GString *buffer;
+  gint64 ofs;
+  gsize size;
+} QDiskReadAhead;
+
+#define QDISK_READ_AHEAD_SIZE (128 * 1024)
+#define QDISK_BACKLOG_READ_AHEAD_SIZE (16 * 1024)
+/* ms, used when write batching is enabled with write-batch-timeout(0) */
+#define QDISK_IDLE_WRITE_BATCH_FLUSH_INTERVAL 100
+
 struct _QDisk
 {
   gchar *filename;
@@ -102,6 +172,20 @@ struct _QDisk
   gint64 cached_file_size;
   QDiskFileHeader *hdr;
   DiskQueueOptions *options;
+
+  QDiskWriteBatch write_batch;
+  QDiskReadAhead read_ahead;
+  QDiskReadAhead backlog_read_ahead;
+  DiskQueueCodec *codec;
+  GString *compressed_record;
+  gint64 unsynced_bytes;
+  gint64 last_sync_time;
+
+  struct
+  {
+    QDiskHistogram write_batch_size;
+    QDiskHistogram sync_latency;
+  } metrics;
 };
 
 #define QDISK_ERROR qdisk_error_quark()
@@ -138,6 +222,66 @@ pwrite_strict(gint fd, const void *buf, size_t count, off_t offset)
   return result;
 }
 
+static inline gint
+_sync_data(gint fd)
+{
+#ifdef __APPLE__
+  return fsync(fd);
+#else
+  return fdatasync(fd);
+#endif
+}
+
+static void
+_histogram_init(QDiskHistogram *self, const gint64 *bounds, const gchar *const *bound_labels, gint num_bounds)
+{
+  g_assert(num_bounds < QDISK_HISTOGRAM_MAX_BUCKETS);
+
+  self->bounds = bounds;
+  self->bound_labels = bound_labels;
+  self->num_bounds = num_bounds;
+}
+
+static void
+_histogram_register(QDiskHistogram *self, gint stats_level, StatsClusterKeyBuilder *builder, const gchar *name)
+{
+  for (gint i = 0; i <= self->num_bounds; i++)
+    {
+      stats_cluster_key_builder_push(builder);
+      stats_cluster_key_builder_set_name(builder, name);
+      stats_cluster_key_builder_add_label(builder,
+                                          stats_cluster_label("le", i < self->num_bounds ? self->bound_labels[i] : "+Inf"));
+      self->sc_keys[i] = stats_cluster_key_builder_build_single(builder);
+      stats_cluster_key_builder_pop(builder);
+
+      stats_register_counter(stats_level, self->sc_keys[i], SC_TYPE_SINGLE_VALUE, &self->buckets[i]);
+    }
+}
+
+static void
+_histogram_unregister(QDiskHistogram *self)
+{
+  for (gint i = 0; i <= self->num_bounds; i++)
+    {
+      if (!self->sc_keys[i])
+        continue;
+
+      stats_unregister_counter(self->sc_keys[i], SC_TYPE_SINGLE_VALUE, &self->buckets[i]);
+      stats_cluster_key_free(self->sc_keys[i]);
+      self->sc_keys[i] = NULL;
+    }
+}
+
+static void
+_histogram_observe(QDiskHistogram *self, gint64 value)
+{
+  for (gint i = 0; i < self->num_bounds; i++)
+    {
+      if (value <= self->bounds[i])
+        stats_counter_inc(self->buckets[i]);
+    }
+  stats_counter_inc(self->buckets[self->num_bounds]);
+}
 
 static inline gboolean
 _has_position_reached_max_size(QDisk *self, gint64 position)
@@ -349,15 +493,15 @@ qdisk_started(QDisk *self)
 }
 
 static inline gboolean
-_does_backlog_head_precede_write_head(QDisk *self)
+_does_backlog_head_precede_write_position(QDisk *self, gint64 write_position)
 {
-  return self->hdr->backlog_head <= self->hdr->write_head;
+  return self->hdr->backlog_head <= write_position;
 }
 
 static inline gboolean
-_is_write_head_less_than_max_size(QDisk *self)
+_is_write_position_less_than_max_size(QDisk *self, gint64 write_position)
 {
-  return self->hdr->write_head < self->hdr->capacity_bytes;
+  return write_position < self->hdr->capacity_bytes;
 }
 
 static inline gboolean
@@ -367,10 +511,10 @@ _is_able_to_reset_write_head_to_beginning_of_qdisk(QDisk *self)
 }
 
 static inline gboolean
-_is_free_space_between_write_head_and_backlog_head(QDisk *self, gint msg_len)
+_is_free_space_between_write_position_and_backlog_head(QDisk *self, gint64 write_position, gint msg_len)
 {
   /* this forces 1 byte of empty space between backlog and write */
-  return self->hdr->write_head + msg_len < self->hdr->backlog_head;
+  return write_position + msg_len < self->hdr->backlog_head;
 }
 
 static inline gboolean
@@ -380,21 +524,27 @@ _is_free_space_at_the_beginning_of_qdisk(QDisk *self, gint msg_len)
   return QDISK_RESERVED_SPACE + msg_len < self->hdr->backlog_head;
 }
 
+static inline gint64
+_get_write_batch_tail(QDisk *self)
+{
+  return self->write_batch.ofs + self->write_batch.buffer->len;
+}
+
 gboolean
 qdisk_is_file_empty(QDisk *self)
 {
-  return self->hdr->length == 0 && self->hdr->backlog_len == 0;
+  return self->hdr->length == 0 && self->hdr->backlog_len == 0 && self->write_batch.count == 0;
 }
 
-gboolean
-qdisk_is_space_avail(QDisk *self, gint at_least)
+static gboolean
+_is_space_avail_at(QDisk *self, gint64 write_position, gint at_least)
 {
-  if (_does_backlog_head_precede_write_head(self))
+  if (_does_backlog_head_precede_write_position(self, write_position))
     {
       /* no exact size-check is needed in this case, because writing after
        * capacity_bytes is allowed when the last message does not fit in
        */
-      if (_is_write_head_less_than_max_size(self))
+      if (_is_write_position_less_than_max_size(self, write_position))
         return TRUE;
 
       /* exact size-check is needed as we have unread/unacked data after the write head
@@ -404,7 +554,16 @@ qdisk_is_space_avail(QDisk *self, gint at_least)
              && _is_free_space_at_the_beginning_of_qdisk(self, at_least);
     }
 
-  return _is_free_space_between_write_head_and_backlog_head(self, at_least);
+  return _is_free_space_between_write_position_and_backlog_head(self, write_position, at_least);
+}
+
+gboolean
+qdisk_is_space_avail(QDisk *self, gint at_least)
+{
+  if (self->write_batch.count > 0)
+    return _is_space_avail_at(self, _get_write_batch_tail(self), at_least);
+
+  return _is_space_avail_at(self, self->hdr->write_head, at_least);
 }
 
 static inline gboolean
@@ -551,6 +710,12 @@ qdisk_get_max_useful_space(QDisk *self)
   return qdisk_get_maximum_size(self) - QDISK_RESERVED_SPACE;
 }
 
+static inline gint64
+_get_pending_write_batch_bytes(QDisk *self)
+{
+  return self->write_batch.count > 0 ? self->write_batch.buffer->len : 0;
+}
+
 gint64
 qdisk_get_empty_space(QDisk *self)
 {
@@ -558,6 +723,9 @@ qdisk_get_empty_space(QDisk *self)
   gint64 bpos = qdisk_get_backlog_head(self);
   gint64 capacity_bytes = qdisk_get_maximum_size(self);
 
+  /* the pending write batch starts at the write head and never wraps */
+  gint64 pending_bytes = _get_pending_write_batch_bytes(self);
+
   if (wpos < capacity_bytes && bpos < capacity_bytes)
     {
       if (wpos < bpos)
@@ -565,14 +733,14 @@ qdisk_get_empty_space(QDisk *self)
           // 0   RESERVED    W   B         DBS   FS
           // |---|-----------|---|---------|-----|
           //                  ^^^
-          return bpos - wpos;
+          return bpos - wpos - pending_bytes;
         }
       else if (bpos < wpos)
         {
           // 0   RESERVED    B   W         DBS   FS
           // |---|--- ... ---|---|---------|-----|
           //      ^^^^^^^^^^^     ^^^^^^^^^
-          return (bpos - QDISK_RESERVED_SPACE) + (capacity_bytes - wpos);
+          return (bpos - QDISK_RESERVED_SPACE) + MAX(capacity_bytes - wpos - pending_bytes, 0);
         }
       else
         {
@@ -681,40 +849,68 @@ _could_not_wrap_write_head_last_push_but_now_can(QDisk *self)
 gint64
 qdisk_get_next_tail_position(QDisk *self)
 {
+  if (self->write_batch.count > 0)
+    {
+      /* the position the record would get after the pending batch is flushed */
+      gint64 write_batch_tail = _get_write_batch_tail(self);
+      if (_has_position_reached_max_size(self, write_batch_tail)
+          && _is_able_to_reset_write_head_to_beginning_of_qdisk(self))
+        return QDISK_RESERVED_SPACE;
+
+      return write_batch_tail;
+    }
+
   if (_could_not_wrap_write_head_last_push_but_now_can(self))
     return QDISK_RESERVED_SPACE;
 
   return self->hdr->write_head;
 }
 
-gboolean
-qdisk_push_tail(QDisk *self, GString *record)
+static void
+_sync(QDisk *self)
 {
-  if (!qdisk_started(self))
-    return FALSE;
+  gint64 start_time = g_get_monotonic_time();
 
-  if (_could_not_wrap_write_head_last_push_but_now_can(self))
+  if (_sync_data(self->fd) < 0)
     {
-      /*
-       * We can safely move the write_head to the beginning, but still
-       * not sure, if this message will have space. We move the write_head
-       * then check the available space compared to the new position.
-       */
-      self->hdr->write_head = QDISK_RESERVED_SPACE;
+      msg_error("Error syncing disk-queue file",
+                evt_tag_str("filename", self->filename),
+                evt_tag_error("error"));
+      return;
     }
 
-  if (!qdisk_is_space_avail(self, record->len))
-    return FALSE;
+  self->last_sync_time = g_get_monotonic_time();
+  self->unsynced_bytes = 0;
+  _histogram_observe(&self->metrics.sync_latency, self->last_sync_time - start_time);
+}
 
-  if (!pwrite_strict(self->fd, record->str, record->len, self->hdr->write_head))
-    {
-      msg_error("Error writing disk-queue file",
-                evt_tag_error("error"));
-      return FALSE;
-    }
+static inline gboolean
+_is_sync_interval_elapsed(QDisk *self)
+{
+  return self->options->sync_interval > 0
+         && g_get_monotonic_time() - self->last_sync_time >= self->options->sync_interval * G_TIME_SPAN_MILLISECOND;
+}
+
+static void
+_maybe_sync(QDisk *self, gsize written_bytes)
+{
+  if (self->options->sync_interval <= 0 && self->options->sync_bytes <= 0)
+    return;
 
-  self->hdr->write_head = self->hdr->write_head + record->len;
+  self->unsynced_bytes += written_bytes;
 
+  gboolean sync_bytes_reached = self->options->sync_bytes > 0
+                                && self->unsynced_bytes >= self->options->sync_bytes;
+
+  if (sync_bytes_reached || _is_sync_interval_elapsed(self))
+    _sync(self);
+}
+
+/* moves the write head past data that has already been written to the file */
+static void
+_advance_write_head(QDisk *self, gint64 new_write_head, guint32 record_count)
+{
+  self->hdr->write_head = new_write_head;
 
   /* NOTE: we only wrap around if the read head is before the write,
    * otherwise we'd truncate the data the read head is still processing, e.g.
@@ -758,20 +954,344 @@ qdisk_push_tail(QDisk *self, GString *record)
            *
            * Otherwise try to wrap again in the beginning of the next push.
            *
-           * This way we guarantee, that only a part of 1 message is written after
-           * capacity_bytes.
+           * This way we guarantee, that only a part of 1 message (or 1 write
+           * batch) is written after capacity_bytes.
            */
           self->hdr->write_head = QDISK_RESERVED_SPACE;
         }
     }
-  self->hdr->length++;
+  self->hdr->length += record_count;
+}
+
+static gboolean
+_prepare_write_head(QDisk *self, gint record_len)
+{
+  if (_could_not_wrap_write_head_last_push_but_now_can(self))
+    {
+      /*
+       * We can safely move the write_head to the beginning, but still
+       * not sure, if this message will have space. We move the write_head
+       * then check the available space compared to the new position.
+       */
+      self->hdr->write_head = QDISK_RESERVED_SPACE;
+    }
+
+  return _is_space_avail_at(self, self->hdr->write_head, record_len);
+}
+
+static gboolean
+_push_record(QDisk *self, GString *record)
+{
+  if (!_prepare_write_head(self, record->len))
+    return FALSE;
+
+  if (!pwrite_strict(self->fd, record->str, record->len, self->hdr->write_head))
+    {
+      msg_error("Error writing disk-queue file",
+                evt_tag_error("error"));
+      return FALSE;
+    }
+
+  _advance_write_head(self, self->hdr->write_head + record->len, 1);
+  _maybe_sync(self, record->len);
+  return TRUE;
+}
+
+static inline gboolean
+_is_write_batching_enabled(QDisk *self)
+{
+  return self->options->write_batch_messages > 1;
+}
+
+static gboolean
+_is_write_batch_full(QDisk *self)
+{
+  QDiskWriteBatch *batch = &self->write_batch;
+
+  if (batch->count == 0)
+    return FALSE;
+
+  if (batch->count >= self->options->write_batch_messages)
+    return TRUE;
+
+  if (self->options->write_batch_bytes > 0 && batch->buffer->len >= self->options->write_batch_bytes)
+    return TRUE;
+
+  return self->options->write_batch_timeout > 0
+         && g_get_monotonic_time() - batch->start_time >= self->options->write_batch_timeout * G_TIME_SPAN_MILLISECOND;
+}
+
+static void
+_reset_write_batch(QDisk *self)
+{
+  self->write_batch.count = 0;
+  self->write_batch.ofs = 0;
+  if (self->write_batch.buffer)
+    g_string_truncate(self->write_batch.buffer, 0);
+}
+
+gboolean
+qdisk_flush_write_batch(QDisk *self)
+{
+  QDiskWriteBatch *batch = &self->write_batch;
+
+  if (batch->count == 0)
+    return TRUE;
+
+  g_assert(batch->ofs == self->hdr->write_head);
+
+  if (!pwrite_strict(self->fd, batch->buffer->str, batch->buffer->len, batch->ofs))
+    {
+      msg_error("Error writing disk-queue file",
+                evt_tag_str("filename", self->filename),
+                evt_tag_int("write_batch_messages", batch->count),
+                evt_tag_error("error"));
+      return FALSE;
+    }
+
+  gsize written_bytes = batch->buffer->len;
+  _histogram_observe(&self->metrics.write_batch_size, batch->count);
+  _advance_write_head(self, batch->ofs + written_bytes, batch->count);
+  _reset_write_batch(self);
+
+  _maybe_sync(self, written_bytes);
+  return TRUE;
+}
+
+/*
+ * Writes are only synced as part of a later write, so once the input goes
+ * idle, this is what keeps the sync-interval() promise.  It has to be
+ * called periodically, see qdisk_get_flush_interval().
+ */
+gboolean
+qdisk_flush(QDisk *self)
+{
+  gboolean result = qdisk_flush_write_batch(self);
+
+  if (self->unsynced_bytes > 0 && _is_sync_interval_elapsed(self))
+    _sync(self);
+
+  return result;
+}
+
+static inline gboolean
+_can_append_to_write_batch(QDisk *self, gint record_len)
+{
+  gint64 write_batch_tail = _get_write_batch_tail(self);
+
+  /* a batch never wraps, records past capacity_bytes need the usual wrap logic */
+  return self->write_batch.count > 0
+         && !_has_position_reached_max_size(self, write_batch_tail)
+         && _is_space_avail_at(self, write_batch_tail, record_len);
+}
+
+static gboolean
+_start_write_batch(QDisk *self, gint record_len)
+{
+  if (!_prepare_write_head(self, record_len))
+    return FALSE;
+
+  if (!self->write_batch.buffer)
+    self->write_batch.buffer = g_string_sized_new(self->options->write_batch_bytes);
+
+  self->write_batch.ofs = self->hdr->write_head;
+  self->write_batch.start_time = g_get_monotonic_time();
+  return TRUE;
+}
+
+static gboolean
+_push_record_to_write_batch(QDisk *self, GString *record)
+{
+  /* a full batch here means that the last flush failed, do not grow it any further */
+  if (_is_write_batch_full(self) && !qdisk_flush_write_batch(self))
+    return FALSE;
+
+  if (!_can_append_to_write_batch(self, record->len))
+    {
+      if (!qdisk_flush_write_batch(self))
+        return FALSE;
+
+      if (!_start_write_batch(self, record->len))
+        return FALSE;
+    }
+
+  g_string_append_len(self->write_batch.buffer, record->str, record->len);
+  self->write_batch.count++;
+
+  if (_is_write_batch_full(self) && !qdisk_flush_write_batch(self))
+    {
+      /* the earlier records stay pending and are retried by the next flush,
+       * this one is handed back to the caller as not stored */
+      g_string_truncate(self->write_batch.buffer, self->write_batch.buffer->len - record->len);
+      self->write_batch.count--;
+      if (self->write_batch.count == 0)
+        _reset_write_batch(self);
+      return FALSE;
+    }
+
   return TRUE;
 }
 
+/*
+ * A compressed record keeps the usual length frame, which is followed by
+ * the length of the uncompressed payload and the compressed payload
+ * itself. An uncompressed length of 0 marks a payload stored as is, as
+ * compression would not have made it any smaller.
+ */
+static GString *
+_compress_record(QDisk *self, GString *record)
+{
+  GString *compressed = self->compressed_record;
+  const gchar *payload = record->str + sizeof(guint32);
+  guint32 payload_length = record->len - sizeof(guint32);
+  guint32 uncompressed_length = payload_length;
+  const gsize frame_length = 2 * sizeof(guint32);
+
+  g_string_set_size(compressed, frame_length);
+  if (!disk_queue_codec_compress(self->codec, payload, payload_length, compressed)
+      || compressed->len - frame_length >= payload_length)
+    {
+      g_string_set_size(compressed, frame_length);
+      g_string_append_len(compressed, payload, payload_length);
+      uncompressed_length = 0;
+    }
+
+  guint32 frame[2] =
+  {
+    GUINT32_TO_BE(compressed->len - sizeof(guint32)),
+    GUINT32_TO_BE(uncompressed_length)
+  };
+  memcpy(compressed->str, frame, sizeof(frame));
+
+  return compressed;
+}
+
+gboolean
+qdisk_push_tail(QDisk *self, GString *record)
+{
+  if (!qdisk_started(self))
+    return FALSE;
+
+  if (self->codec)
+    record = _compress_record(self, record);
+
+  if (_is_write_batching_enabled(self))
+    return _push_record_to_write_batch(self, record);
+
+  return _push_record(self, record);
+}
+
+/*
+ * Records in the write batch are not visible to readers until they are
+ * written, so a reader reaching the write head flushes them first.
+ */
+static gboolean
+_is_position_at_write_head(QDisk *self, gint64 position)
+{
+  if (position != self->hdr->write_head)
+    return FALSE;
+
+  if (self->write_batch.count == 0 || !qdisk_flush_write_batch(self))
+    return TRUE;
+
+  return position == self->hdr->write_head;
+}
+
+static void
+_read_ahead_invalidate(QDiskReadAhead *self)
+{
+  self->ofs = 0;
+  if (self->buffer)
+    g_string_truncate(self->buffer, 0);
+}
+
+static void
+_read_ahead_free(QDiskReadAhead *self)
+{
+  if (self->buffer)
+    g_string_free(self->buffer, TRUE);
+  self->buffer = NULL;
+}
+
+static inline gboolean
+_read_ahead_contains(QDiskReadAhead *self, gint64 position, gsize count)
+{
+  return self->buffer
+         && position >= self->ofs
+         && position + count <= self->ofs + self->buffer->len;
+}
+
+/* the end of the written data that follows position, without wrapping */
+static inline gint64
+_get_readable_end(QDisk *self, gint64 position)
+{
+  if (position < self->hdr->write_head)
+    return self->hdr->write_head;
+
+  return self->cached_file_size;
+}
+
+static gssize
+_read_ahead_fill(QDisk *self, QDiskReadAhead *read_ahead, gint64 position, gsize count)
+{
+  gint64 readable_bytes = _get_readable_end(self, position) - position;
+  gsize window_size = CLAMP(readable_bytes, (gint64) count, (gint64) read_ahead->size);
+
+  if (!read_ahead->buffer)
+    read_ahead->buffer = g_string_sized_new(read_ahead->size);
+
+  g_string_set_size(read_ahead->buffer, window_size);
+  gssize bytes_read = pread(self->fd, read_ahead->buffer->str, window_size, position);
+  if (bytes_read < 0)
+    {
+      _read_ahead_invalidate(read_ahead);
+      return bytes_read;
+    }
+
+  g_string_set_size(read_ahead->buffer, bytes_read);
+  read_ahead->ofs = position;
+  return bytes_read;
+}
+
+/* count must fit in the window, bytes_available is set with pread() semantics */
+static const gchar *
+_read_ahead_get(QDisk *self, QDiskReadAhead *read_ahead, gsize count, gint64 position, gssize *bytes_available)
+{
+  if (!_read_ahead_contains(read_ahead, position, count))
+    {
+      gssize bytes_read = _read_ahead_fill(self, read_ahead, position, count);
+      if (bytes_read < 0)
+        {
+          *bytes_available = bytes_read;
+          return NULL;
+        }
+
+      count = MIN(count, bytes_read);
+    }
+
+  *bytes_available = count;
+  return read_ahead->buffer->str + (position - read_ahead->ofs);
+}
+
+/* pread() semantics, served from the read-ahead window where possible */
+static gssize
+_pread_with_read_ahead(QDisk *self, QDiskReadAhead *read_ahead, gchar *buf, gsize count, gint64 position)
+{
+  if (count > read_ahead->size)
+    return pread(self->fd, buf, count, position);
+
+  gssize bytes_read;
+  const gchar *data = _read_ahead_get(self, read_ahead, count, position, &bytes_read);
+  if (data)
+    memcpy(buf, data, bytes_read);
+
+  return bytes_read;
+}
+
 static inline gssize
-_read_record_length_from_disk(QDisk *self, gint64 position, guint32 *record_length)
+_read_record_length_from_disk(QDisk *self, QDiskReadAhead *read_ahead, gint64 position, guint32 *record_length)
 {
-  gssize bytes_read = pread(self->fd, (gchar *)record_length, sizeof(guint32), position);
+  gssize bytes_read = _pread_with_read_ahead(self, read_ahead, (gchar *) record_length, sizeof(guint32), position);
 
   *record_length = GUINT32_FROM_BE(*record_length);
 
@@ -818,10 +1338,10 @@ _is_record_length_valid(QDisk *self, gssize bytes_read, guint32 record_length, g
 }
 
 static inline gboolean
-_try_reading_record_length(QDisk *self, gint64 position, guint32 *record_length)
+_try_reading_record_length(QDisk *self, QDiskReadAhead *read_ahead, gint64 position, guint32 *record_length)
 {
   guint32 read_record_length;
-  gssize bytes_read = _read_record_length_from_disk(self, position, &read_record_length);
+  gssize bytes_read = _read_record_length_from_disk(self, read_ahead, position, &read_record_length);
 
   if (!_is_record_length_valid(self, bytes_read, read_record_length, position))
     return FALSE;
@@ -830,12 +1350,85 @@ _try_reading_record_length(QDisk *self, gint64 position, guint32 *record_length)
   return TRUE;
 }
 
+static gboolean
+_decompress_record(QDisk *self, const gchar *data, guint32 data_length, GString *record)
+{
+  guint32 uncompressed_length;
+
+  if (data_length < sizeof(uncompressed_length))
+    goto error;
+
+  memcpy(&uncompressed_length, data, sizeof(uncompressed_length));
+  uncompressed_length = GUINT32_FROM_BE(uncompressed_length);
+  data += sizeof(uncompressed_length);
+  data_length -= sizeof(uncompressed_length);
+
+  if (uncompressed_length == 0)
+    {
+      g_string_truncate(record, 0);
+      g_string_append_len(record, data, data_length);
+      return TRUE;
+    }
+
+  if (_is_record_length_reached_hard_limit(uncompressed_length))
+    goto error;
+
+  g_string_set_size(record, uncompressed_length);
+  if (!disk_queue_codec_decompress(self->codec, data, data_length, record->str, uncompressed_length))
+    goto error;
+
+  return TRUE;
+
+error:
+  msg_error("Error decompressing disk-queue record",
+            evt_tag_str("filename", self->filename),
+            evt_tag_str("compression", disk_queue_compression_format(self->hdr->compression)),
+            evt_tag_long("offset", self->hdr->read_head));
+  return FALSE;
+}
+
+static gboolean
+_read_compressed_record_from_disk(QDisk *self, GString *record, guint32 record_length)
+{
+  gint64 position = self->hdr->read_head + sizeof(record_length);
+  const gchar *data;
+  gssize bytes_read;
+
+  if (record_length <= self->read_ahead.size)
+    {
+      /* decompress right from the read-ahead window */
+      data = _read_ahead_get(self, &self->read_ahead, record_length, position, &bytes_read);
+    }
+  else
+    {
+      g_string_set_size(self->compressed_record, record_length);
+      bytes_read = pread(self->fd, self->compressed_record->str, record_length, position);
+      data = self->compressed_record->str;
+    }
+
+  if (bytes_read != record_length)
+    {
+      msg_error("Error reading disk-queue file",
+                evt_tag_str("filename", self->filename),
+                evt_tag_str("error", bytes_read < 0 ? g_strerror(errno) : "short read"),
+                evt_tag_int("expected read length", record_length),
+                evt_tag_int("actually read", bytes_read));
+      return FALSE;
+    }
+
+  return _decompress_record(self, data, record_length, record);
+}
+
 static inline gboolean
 _read_record_from_disk(QDisk *self, GString *record, guint32 record_length)
 {
+  if (self->codec)
+    return _read_compressed_record_from_disk(self, record, record_length);
+
   g_string_set_size(record, record_length);
 
-  gssize bytes_read = pread(self->fd, record->str, record_length, self->hdr->read_head + sizeof(record_length));
+  gssize bytes_read = _pread_with_read_ahead(self, &self->read_ahead, record->str, record_length,
+                                             self->hdr->read_head + sizeof(record_length));
   if (bytes_read != record_length)
     {
       msg_error("Error reading disk-queue file",
@@ -885,14 +1478,14 @@ qdisk_get_next_head_position(QDisk *self)
 gboolean
 qdisk_peek_head(QDisk *self, GString *record)
 {
-  if (self->hdr->read_head == self->hdr->write_head)
+  if (_is_position_at_write_head(self, self->hdr->read_head))
     return FALSE;
 
   if (self->hdr->read_head > self->hdr->write_head)
     self->hdr->read_head = _correct_position_if_max_size_is_reached(self, self->hdr->read_head);
 
   guint32 record_length;
-  if (!_try_reading_record_length(self, self->hdr->read_head, &record_length))
+  if (!_try_reading_record_length(self, &self->read_ahead, self->hdr->read_head, &record_length))
     return FALSE;
 
   if (!_read_record_from_disk(self, record, record_length))
@@ -904,14 +1497,14 @@ qdisk_peek_head(QDisk *self, GString *record)
 gboolean
 qdisk_pop_head(QDisk *self, GString *record)
 {
-  if (self->hdr->read_head == self->hdr->write_head)
+  if (_is_position_at_write_head(self, self->hdr->read_head))
     return FALSE;
 
   if (self->hdr->read_head > self->hdr->write_head)
     self->hdr->read_head = _correct_position_if_max_size_is_reached(self, self->hdr->read_head);
 
   guint32 record_length;
-  if (!_try_reading_record_length(self, self->hdr->read_head, &record_length))
+  if (!_try_reading_record_length(self, &self->read_ahead, self->hdr->read_head, &record_length))
     return FALSE;
 
   if (!_read_record_from_disk(self, record, record_length))
@@ -926,9 +1519,9 @@ qdisk_pop_head(QDisk *self, GString *record)
 }
 
 static gboolean
-_skip_record(QDisk *self, gint64 position, gint64 *new_position)
+_skip_record(QDisk *self, QDiskReadAhead *read_ahead, gint64 position, gint64 *new_position)
 {
-  if (position == self->hdr->write_head)
+  if (_is_position_at_write_head(self, position))
     return FALSE;
 
   if (position > self->hdr->write_head)
@@ -937,7 +1530,7 @@ _skip_record(QDisk *self, gint64 position, gint64 *new_position)
   *new_position = position;
 
   guint32 record_length;
-  if (!_try_reading_record_length(self, *new_position, &record_length))
+  if (!_try_reading_record_length(self, read_ahead, *new_position, &record_length))
     return FALSE;
 
   _update_position_after_read(self, record_length, new_position);
@@ -947,7 +1540,7 @@ _skip_record(QDisk *self, gint64 position, gint64 *new_position)
 gboolean
 qdisk_remove_head(QDisk *self)
 {
-  gboolean success = _skip_record(self, self->hdr->read_head, &self->hdr->read_head);
+  gboolean success = _skip_record(self, &self->read_ahead, self->hdr->read_head, &self->hdr->read_head);
 
   if (success)
     {
@@ -965,7 +1558,7 @@ qdisk_ack_backlog(QDisk *self)
   if (self->hdr->backlog_len == 0)
     return FALSE;
 
-  if (!_skip_record(self, self->hdr->backlog_head, &self->hdr->backlog_head))
+  if (!_skip_record(self, &self->backlog_read_ahead, self->hdr->backlog_head, &self->hdr->backlog_head))
     {
       msg_error("Error acking in disk-queue file", evt_tag_str("filename", qdisk_get_filename(self)));
       return FALSE;
@@ -987,7 +1580,7 @@ qdisk_rewind_backlog(QDisk *self, guint rewind_count)
   gint64 new_read_head = self->hdr->backlog_head;
   for (gint64 i = 0; i < number_of_messages_stay_in_backlog; i++)
     {
-      if (!_skip_record(self, new_read_head, &new_read_head))
+      if (!_skip_record(self, &self->backlog_read_ahead, new_read_head, &new_read_head))
         {
           msg_error("Error rewinding backlog in disk-queue file",
                     evt_tag_str("filename", qdisk_get_filename(self)));
@@ -1357,6 +1950,10 @@ _close_file(QDisk *self)
       self->fd = -1;
     }
 
+  _read_ahead_invalidate(&self->read_ahead);
+  _read_ahead_invalidate(&self->backlog_read_ahead);
+  disk_queue_codec_free(self->codec);
+  self->codec = NULL;
   self->cached_file_size = 0;
 }
 
@@ -1414,6 +2011,46 @@ _open_file(const gchar *filename, gboolean read_only, gint *fd)
   return TRUE;
 }
 
+static gboolean
+_setup_codec(QDisk *self)
+{
+  if (self->hdr->compression == DISKQ_COMPRESSION_NONE)
+    return TRUE;
+
+  self->codec = disk_queue_codec_new(self->hdr->compression);
+  if (!self->codec)
+    {
+      msg_error("Disk-queue file is compressed with a method that is not available in this build of syslog-ng",
+                evt_tag_str("filename", self->filename),
+                evt_tag_str("compression", disk_queue_compression_format(self->hdr->compression)));
+      return FALSE;
+    }
+
+  if (!self->compressed_record)
+    self->compressed_record = g_string_sized_new(4096);
+
+  return TRUE;
+}
+
+static void
+_maybe_switch_compression(QDisk *self)
+{
+  if (self->hdr->compression == self->options->compression || self->options->read_only)
+    return;
+
+  if (!qdisk_is_file_empty(self))
+    {
+      msg_warning("WARNING: compression() has changed since the last syslog-ng run. The existing disk-queue file "
+                  "keeps using the old one until it is emptied",
+                  evt_tag_str("filename", self->filename),
+                  evt_tag_str("active_compression", disk_queue_compression_format(self->hdr->compression)),
+                  evt_tag_str("ignored_new_compression", disk_queue_compression_format(self->options->compression)));
+      return;
+    }
+
+  self->hdr->compression = self->options->compression;
+}
+
 static gboolean
 _create_header(QDisk *self)
 {
@@ -1451,8 +2088,9 @@ _create_header(QDisk *self)
   self->hdr->length = 0;
   self->hdr->use_v1_wrap_condition = FALSE;
   self->hdr->capacity_bytes = self->options->capacity_bytes;
+  self->hdr->compression = self->options->compression;
 
-  return TRUE;
+  return _setup_codec(self);
 }
 
 static inline gboolean
@@ -1482,6 +2120,11 @@ _upgrade_header(QDisk *self)
       self->hdr->capacity_bytes = self->options->capacity_bytes;
     }
 
+  if (self->hdr->version < 4)
+    {
+      self->hdr->compression = DISKQ_COMPRESSION_NONE;
+    }
+
   self->hdr->version = QDISK_HDR_VERSION_CURRENT;
 }
 
@@ -1533,7 +2176,8 @@ _load_header(QDisk *self)
       return FALSE;
     }
 
-  return TRUE;
+  _maybe_switch_compression(self);
+  return _setup_codec(self);
 }
 
 static gboolean
@@ -1555,7 +2199,8 @@ _load_state(QDisk *self, GQueue *front_cache, GQueue *backlog, GQueue *flow_cont
 
       msg_info("Disk-buffer state loaded",
                evt_tag_str("filename", self->filename),
-               evt_tag_long("number_of_messages", _number_of_messages(self)));
+               evt_tag_long("number_of_messages", _number_of_messages(self)),
+               evt_tag_str("compression", disk_queue_compression_format(self->hdr->compression)));
 
       msg_debug("Disk-buffer internal state",
                 evt_tag_str("filename", self->filename),
@@ -1576,7 +2221,8 @@ _load_state(QDisk *self, GQueue *front_cache, GQueue *backlog, GQueue *flow_cont
       self->cached_file_size = st.st_size;
       msg_info("Reliable disk-buffer state loaded",
                evt_tag_str("filename", self->filename),
-               evt_tag_long("number_of_messages", _number_of_messages(self)));
+               evt_tag_long("number_of_messages", _number_of_messages(self)),
+               evt_tag_str("compression", disk_queue_compression_format(self->hdr->compression)));
 
       msg_debug("Reliable disk-buffer internal state",
                 evt_tag_str("filename", self->filename),
@@ -1749,7 +2395,15 @@ qdisk_stop(QDisk *self, GQueue *front_cache, GQueue *backlog, GQueue *flow_contr
   gboolean result = TRUE;
 
   if (!self->options->read_only)
-    result = _save_state(self, front_cache, backlog, flow_control_window);
+    {
+      if (!qdisk_flush_write_batch(self))
+        msg_error("Error flushing pending records to disk-queue file, records are lost",
+                  evt_tag_str("filename", self->filename),
+                  evt_tag_int("lost_messages", self->write_batch.count));
+
+      _reset_write_batch(self);
+      result = _save_state(self, front_cache, backlog, flow_control_window);
+    }
 
   _close_file(self);
 
@@ -1766,6 +2420,8 @@ qdisk_reset_file_if_empty(QDisk *self)
   self->hdr->write_head = QDISK_RESERVED_SPACE;
   self->hdr->backlog_head = QDISK_RESERVED_SPACE;
 
+  _read_ahead_invalidate(&self->read_ahead);
+  _read_ahead_invalidate(&self->backlog_read_ahead);
   _maybe_truncate_file(self, QDISK_RESERVED_SPACE);
 }
 
@@ -1775,10 +2431,38 @@ qdisk_get_options(QDisk *self)
   return self->options;
 }
 
+/*
+ * The period in ms qdisk_flush() needs to be called with, 0 if there is
+ * nothing to flush or sync in the background.  A partial write batch is
+ * flushed within QDISK_IDLE_WRITE_BATCH_FLUSH_INTERVAL even with
+ * write-batch-timeout(0), so it is never held back indefinitely.
+ */
+gint
+qdisk_get_flush_interval(QDisk *self)
+{
+  gint interval = 0;
+
+  if (_is_write_batching_enabled(self))
+    interval = self->options->write_batch_timeout > 0 ? self->options->write_batch_timeout
+               : QDISK_IDLE_WRITE_BATCH_FLUSH_INTERVAL;
+
+  if (self->options->sync_interval > 0)
+    interval = interval > 0 ? MIN(interval, self->options->sync_interval) : self->options->sync_interval;
+
+  return interval;
+}
+
+/* the number of the newest records, that are not written to the file yet */
+gint
+qdisk_get_write_batch_length(QDisk *self)
+{
+  return self->write_batch.count;
+}
+
 gint64
 qdisk_get_length(QDisk *self)
 {
-  return self->hdr->length;
+  return self->hdr->length + self->write_batch.count;
 }
 
 gint64
@@ -1835,9 +2519,29 @@ qdisk_is_read_only(QDisk *self)
   return self->options->read_only;
 }
 
+void
+qdisk_register_stats(QDisk *self, gint stats_level, StatsClusterKeyBuilder *builder)
+{
+  _histogram_register(&self->metrics.write_batch_size, stats_level, builder, "write_batch_messages");
+  _histogram_register(&self->metrics.sync_latency, stats_level, builder, "sync_latency_seconds");
+}
+
+void
+qdisk_unregister_stats(QDisk *self)
+{
+  _histogram_unregister(&self->metrics.write_batch_size);
+  _histogram_unregister(&self->metrics.sync_latency);
+}
+
 void
 qdisk_free(QDisk *self)
 {
+  if (self->write_batch.buffer)
+    g_string_free(self->write_batch.buffer, TRUE);
+  _read_ahead_free(&self->read_ahead);
+  _read_ahead_free(&self->backlog_read_ahead);
+  if (self->compressed_record)
+    g_string_free(self->compressed_record, TRUE);
   self->options = NULL;
   g_free(self->filename);
   g_free(self);
@@ -1854,6 +2558,13 @@ qdisk_new(DiskQueueOptions *options, const gchar *file_id, const gchar *filename
 
   self->file_id = file_id;
   self->filename = g_strdup(filename);
+  self->read_ahead.size = QDISK_READ_AHEAD_SIZE;
+  self->backlog_read_ahead.size = QDISK_BACKLOG_READ_AHEAD_SIZE;
+
+  _histogram_init(&self->metrics.write_batch_size, write_batch_size_bounds, write_batch_size_labels,
+                  G_N_ELEMENTS(write_batch_size_bounds));
+  _histogram_init(&self->metrics.sync_latency, sync_latency_bounds, sync_latency_labels,
+                  G_N_ELEMENTS(sync_latency_bounds));
 
   return self;
 }
@@ -26,6 +26,7 @@
 
 #include "syslog-ng.h"
 #include "diskq-options.h"
+#include "stats/stats-cluster-key-builder.h"
 
 #define LOG_PATH_OPTIONS_FOR_BACKLOG GINT_TO_POINTER(0x80000000)
 #define QDISK_RESERVED_SPACE 4096
@@ -61,6 +62,10 @@ gint64 qdisk_get_max_useful_space(QDisk *self);
 gint64 qdisk_get_empty_space(QDisk *self);
 gint64 qdisk_get_used_useful_space(QDisk *self);
 gboolean qdisk_push_tail(QDisk *self, GString *record);
+gboolean qdisk_flush_write_batch(QDisk *self);
+gboolean qdisk_flush(QDisk *self);
+gint qdisk_get_flush_interval(QDisk *self);
+gint qdisk_get_write_batch_length(QDisk *self);
 gboolean qdisk_pop_head(QDisk *self, GString *record);
 gboolean qdisk_peek_head(QDisk *self, GString *record);
 gboolean qdisk_remove_head(QDisk *self);
@@ -73,6 +78,8 @@ gboolean qdisk_start(QDisk *self, GQueue *front_cache, GQueue *backlog, GQueue *
 gboolean qdisk_stop(QDisk *self, GQueue *front_cache, GQueue *backlog, GQueue *flow_control_window);
 void qdisk_reset_file_if_empty(QDisk *self);
 gboolean qdisk_started(QDisk *self);
+void qdisk_register_stats(QDisk *self, gint stats_level, StatsClusterKeyBuilder *builder);
+void qdisk_unregister_stats(QDisk *self);
 void qdisk_free(QDisk *self);
 
 DiskQueueOptions *qdisk_get_options(QDisk *self);
@@ -574,6 +574,332 @@ Test(qdisk, get_empty_space_wrapped)
   cleanup_qdisk(filename, qdisk);
 }
 
+static QDisk *
+create_batching_qdisk(const gchar *filename, gint64 capacity_bytes, gint write_batch_messages)
+{
+  QDisk *qdisk = create_qdisk(TDISKQ_RELIABLE, filename, capacity_bytes);
+  DiskQueueOptions *opts = qdisk_get_options(qdisk);
+
+  disk_queue_options_set_write_batch_messages(opts, write_batch_messages);
+  disk_queue_options_set_write_batch_bytes(opts, 0);
+  disk_queue_options_set_write_batch_timeout(opts, 0);
+
+  return qdisk;
+}
+
+Test(qdisk, write_batch_advances_write_head_once_per_batch)
+{
+  const gchar *filename = "test_qdisk_write_batch.rqf";
+  QDisk *qdisk = create_batching_qdisk(filename, MiB(1), 4);
+  cr_assert(qdisk_start(qdisk, NULL, NULL, NULL));
+
+  guint record_len = 128;
+  gint64 serialized_record_len = record_len + FRAME_LENGTH;
+
+  for (gint i = 0; i < 3; i++)
+    {
+      cr_assert_eq(qdisk_get_next_tail_position(qdisk), QDISK_RESERVED_SPACE + i * serialized_record_len);
+      cr_assert(push_dummy_record(qdisk, record_len));
+    }
+
+  cr_assert_eq(qdisk_get_writer_head(qdisk), QDISK_RESERVED_SPACE);
+  cr_assert_eq(qdisk_get_length(qdisk), 3);
+
+  cr_assert(push_dummy_record(qdisk, record_len));
+  cr_assert_eq(qdisk_get_writer_head(qdisk), QDISK_RESERVED_SPACE + 4 * serialized_record_len);
+  cr_assert_eq(qdisk_get_length(qdisk), 4);
+
+  GString *popped_data = g_string_new(NULL);
+  for (gint i = 0; i < 4; i++)
+    {
+      cr_assert(reliable_pop_record_without_backlog(qdisk, popped_data));
+      assert_dummy_record(popped_data, record_len);
+    }
+  g_string_free(popped_data, TRUE);
+  cr_assert_eq(qdisk_get_length(qdisk), 0);
+
+  cr_assert(qdisk_stop(qdisk, NULL, NULL, NULL));
+  cleanup_qdisk(filename, qdisk);
+}
+
+Test(qdisk, write_batch_is_flushed_by_readers_and_on_stop)
+{
+  const gchar *filename = "test_qdisk_write_batch_flush.rqf";
+  QDisk *qdisk = create_batching_qdisk(filename, MiB(1), 100);
+  cr_assert(qdisk_start(qdisk, NULL, NULL, NULL));
+
+  guint record_len = 128;
+  cr_assert(push_dummy_record(qdisk, record_len));
+  cr_assert(push_dummy_record(qdisk, record_len));
+
+  GString *popped_data = g_string_new(NULL);
+  cr_assert(reliable_pop_record_without_backlog(qdisk, popped_data));
+  assert_dummy_record(popped_data, record_len);
+  cr_assert_eq(qdisk_get_length(qdisk), 1);
+
+  cr_assert(push_dummy_record(qdisk, record_len));
+  cr_assert(push_dummy_record(qdisk, record_len));
+  cr_assert_eq(qdisk_get_length(qdisk), 3);
+
+  cr_assert(qdisk_stop(qdisk, NULL, NULL, NULL));
+  cr_assert(qdisk_start(qdisk, NULL, NULL, NULL));
+  cr_assert_eq(qdisk_get_length(qdisk), 3);
+
+  for (gint i = 0; i < 3; i++)
+    {
+      cr_assert(reliable_pop_record_without_backlog(qdisk, popped_data));
+      assert_dummy_record(popped_data, record_len);
+    }
+  g_string_free(popped_data, TRUE);
+
+  cr_assert(qdisk_stop(qdisk, NULL, NULL, NULL));
+  cleanup_qdisk(filename, qdisk);
+}
+
+Test(qdisk, write_batch_pending_bytes_are_not_reported_as_empty_space)
+{
+  const gchar *filename = "test_qdisk_write_batch_space.rqf";
+  QDisk *qdisk = create_batching_qdisk(filename, MiB(1), 100);
+  cr_assert(qdisk_start(qdisk, NULL, NULL, NULL));
+
+  guint record_len = 128;
+  gint64 serialized_record_len = record_len + FRAME_LENGTH;
+  gint64 empty_space = qdisk_get_empty_space(qdisk);
+
+  cr_assert(push_dummy_record(qdisk, record_len));
+  cr_assert(push_dummy_record(qdisk, record_len));
+  cr_assert_eq(qdisk_get_writer_head(qdisk), QDISK_RESERVED_SPACE);
+  cr_assert_eq(qdisk_get_empty_space(qdisk), empty_space - 2 * serialized_record_len);
+  cr_assert_eq(qdisk_get_used_useful_space(qdisk), 2 * serialized_record_len);
+
+  cr_assert(qdisk_flush_write_batch(qdisk));
+  cr_assert_eq(qdisk_get_writer_head(qdisk), QDISK_RESERVED_SPACE + 2 * serialized_record_len);
+  cr_assert_eq(qdisk_get_empty_space(qdisk), empty_space - 2 * serialized_record_len);
+  cr_assert_eq(qdisk_get_length(qdisk), 2);
+
+  cr_assert(qdisk_stop(qdisk, NULL, NULL, NULL));
+  cleanup_qdisk(filename, qdisk);
+}
+
+Test(qdisk, flush_interval_covers_write_batches_and_sync_interval)
+{
+  const gchar *filename = "test_qdisk_flush_interval.rqf";
+  QDisk *qdisk = create_qdisk(TDISKQ_RELIABLE, filename, MiB(1));
+  DiskQueueOptions *opts = qdisk_get_options(qdisk);
+
+  disk_queue_options_set_write_batch_timeout(opts, 50);
+  cr_assert_eq(qdisk_get_flush_interval(qdisk), 0);
+
+  disk_queue_options_set_sync_interval(opts, 200);
+  cr_assert_eq(qdisk_get_flush_interval(qdisk), 200);
+
+  disk_queue_options_set_write_batch_messages(opts, 16);
+  cr_assert_eq(qdisk_get_flush_interval(qdisk), 50);
+
+  /* a partial batch is not held back indefinitely without a timeout either */
+  disk_queue_options_set_sync_interval(opts, 0);
+  disk_queue_options_set_write_batch_timeout(opts, 0);
+  cr_assert_gt(qdisk_get_flush_interval(qdisk), 0);
+
+  cleanup_qdisk(filename, qdisk);
+}
+
+Test(qdisk, flush_writes_the_partial_write_batch)
+{
+  const gchar *filename = "test_qdisk_flush.rqf";
+  QDisk *qdisk = create_batching_qdisk(filename, MiB(1), 100);
+  disk_queue_options_set_sync_interval(qdisk_get_options(qdisk), 1);
+  cr_assert(qdisk_start(qdisk, NULL, NULL, NULL));
+
+  guint record_len = 128;
+  gint64 serialized_record_len = record_len + FRAME_LENGTH;
+
+  cr_assert(push_dummy_record(qdisk, record_len));
+  cr_assert(push_dummy_record(qdisk, record_len));
+  cr_assert_eq(qdisk_get_write_batch_length(qdisk), 2);
+  cr_assert_eq(qdisk_get_writer_head(qdisk), QDISK_RESERVED_SPACE);
+
+  cr_assert(qdisk_flush(qdisk));
+  cr_assert_eq(qdisk_get_write_batch_length(qdisk), 0);
+  cr_assert_eq(qdisk_get_writer_head(qdisk), QDISK_RESERVED_SPACE + 2 * serialized_record_len);
+  cr_assert_eq(qdisk_get_length(qdisk), 2);
+
+  /* nothing is pending */
+  cr_assert(qdisk_flush(qdisk));
+
+  cr_assert(qdisk_stop(qdisk, NULL, NULL, NULL));
+  cleanup_qdisk(filename, qdisk);
+}
+
+Test(qdisk, write_batch_positions_are_consistent_when_wrapping)
+{
+  const gchar *filename = "test_qdisk_write_batch_wrap.rqf";
+  QDisk *qdisk = create_batching_qdisk(filename, MiB(1), 3);
+  disk_queue_options_set_sync_bytes(qdisk_get_options(qdisk), 64 * 1024);
+  cr_assert(qdisk_start(qdisk, NULL, NULL, NULL));
+
+  guint record_len = 10 * 1024;
+  GQueue *positions = g_queue_new();
+  GString *popped_data = g_string_new(NULL);
+
+  for (gint round = 0; round < 10; round++)
+    {
+      for (gint i = 0; i < 70; i++)
+        {
+          gint64 position = qdisk_get_next_tail_position(qdisk);
+          if (!push_dummy_record(qdisk, record_len))
+            break;
+
+          g_queue_push_tail(positions, g_memdup2(&position, sizeof(position)));
+        }
+
+      for (gint i = 0; i < 50 && !g_queue_is_empty(positions); i++)
+        {
+          gint64 *position = g_queue_pop_head(positions);
+          cr_assert_eq(qdisk_get_next_head_position(qdisk), *position);
+          g_free(position);
+
+          cr_assert(reliable_pop_record_without_backlog(qdisk, popped_data));
+          assert_dummy_record(popped_data, record_len);
+        }
+    }
+
+  cr_assert_eq(qdisk_get_length(qdisk), g_queue_get_length(positions));
+
+  g_queue_free_full(positions, g_free);
+  g_string_free(popped_data, TRUE);
+
+  cr_assert(qdisk_stop(qdisk, NULL, NULL, NULL));
+  cleanup_qdisk(filename, qdisk);
+}
+
+Test(qdisk, read_ahead_is_not_served_after_the_queue_is_reset)
+{
+  const gchar *filename = "test_qdisk_read_ahead_reset.qf";
+  QDisk *qdisk = create_qdisk(TDISKQ_NON_RELIABLE, filename, MiB(1));
+  cr_assert(qdisk_start(qdisk, NULL, NULL, NULL));
+
+  GString *popped_data = g_string_new(NULL);
+
+  /* the non-reliable qdisk resets its heads to the beginning once emptied */
+  cr_assert(push_dummy_record(qdisk, 100));
+  cr_assert(push_dummy_record(qdisk, 100));
+  cr_assert(qdisk_pop_head(qdisk, popped_data));
+  assert_dummy_record(popped_data, 100);
+  cr_assert(qdisk_pop_head(qdisk, popped_data));
+  assert_dummy_record(popped_data, 100);
+  cr_assert_eq(qdisk_get_reader_head(qdisk), QDISK_RESERVED_SPACE);
+
+  cr_assert(push_dummy_record(qdisk, 300));
+  cr_assert(qdisk_pop_head(qdisk, popped_data));
+  assert_dummy_record(popped_data, 300);
+
+  g_string_free(popped_data, TRUE);
+  cr_assert(qdisk_stop(qdisk, NULL, NULL, NULL));
+  cleanup_qdisk(filename, qdisk);
+}
+
+#if defined(SYSLOG_NG_HAVE_ZSTD) || defined(SYSLOG_NG_HAVE_LZ4)
+
+#if defined(SYSLOG_NG_HAVE_ZSTD)
+#define TEST_COMPRESSION "zstd"
+#else
+#define TEST_COMPRESSION "lz4"
+#endif
+
+static gboolean
+_serialize_random_bytes(SerializeArchive *sa, gpointer user_data)
+{
+  guint size = GPOINTER_TO_UINT(user_data);
+  gchar *data = g_malloc(size);
+
+  for (guint i = 0; i < size; i++)
+    data[i] = g_random_int_range(0, 256);
+
+  serialize_archive_write_bytes(sa, data, size);
+  g_free(data);
+  return TRUE;
+}
+
+static gboolean
+_push_random_record(QDisk *qdisk, guint record_size)
+{
+  GString *data = g_string_new(NULL);
+  GError *error = NULL;
+
+  qdisk_serialize(data, _serialize_random_bytes, GUINT_TO_POINTER(record_size), &error);
+  gboolean success = qdisk_push_tail(qdisk, data);
+  g_string_free(data, TRUE);
+
+  return success;
+}
+
+Test(qdisk, compressed_records_round_trip_and_survive_restart)
+{
+  const gchar *filename = "test_qdisk_compression.rqf";
+  QDisk *qdisk = create_qdisk(TDISKQ_RELIABLE, filename, MiB(1));
+  cr_assert(disk_queue_options_set_compression(qdisk_get_options(qdisk), TEST_COMPRESSION));
+  cr_assert(qdisk_start(qdisk, NULL, NULL, NULL));
+
+  guint record_len = 4096;
+  cr_assert(push_dummy_record(qdisk, record_len));
+  cr_assert_lt(qdisk_get_writer_head(qdisk), QDISK_RESERVED_SPACE + record_len,
+               "a compressible record is expected to take less space on disk");
+
+  gint64 incompressible_start = qdisk_get_writer_head(qdisk);
+  cr_assert(_push_random_record(qdisk, record_len));
+  cr_assert(push_dummy_record(qdisk, 10));
+
+  /* stored as is, with the additional uncompressed length field */
+  cr_assert_leq(qdisk_get_writer_head(qdisk) - incompressible_start,
+                FRAME_LENGTH + sizeof(guint32) + record_len + FRAME_LENGTH + sizeof(guint32) + 10);
+
+  cr_assert(qdisk_stop(qdisk, NULL, NULL, NULL));
+  cr_assert(qdisk_start(qdisk, NULL, NULL, NULL));
+  cr_assert_eq(qdisk_get_length(qdisk), 3);
+
+  GString *popped_data = g_string_new(NULL);
+  cr_assert(reliable_pop_record_without_backlog(qdisk, popped_data));
+  assert_dummy_record(popped_data, record_len);
+  cr_assert(reliable_pop_record_without_backlog(qdisk, popped_data));
+  cr_assert_eq(popped_data->len, record_len);
+  cr_assert(reliable_pop_record_without_backlog(qdisk, popped_data));
+  assert_dummy_record(popped_data, 10);
+  g_string_free(popped_data, TRUE);
+
+  cr_assert(qdisk_stop(qdisk, NULL, NULL, NULL));
+  cleanup_qdisk(filename, qdisk);
+}
+
+Test(qdisk, compression_of_a_non_empty_file_is_not_changed)
+{
+  const gchar *filename = "test_qdisk_compression_change.rqf";
+  QDisk *qdisk = create_qdisk(TDISKQ_RELIABLE, filename, MiB(1));
+  cr_assert(qdisk_start(qdisk, NULL, NULL, NULL));
+  cr_assert(push_dummy_record(qdisk, 100));
+  cr_assert(qdisk_stop(qdisk, NULL, NULL, NULL));
+
+  cr_assert(disk_queue_options_set_compression(qdisk_get_options(qdisk), TEST_COMPRESSION));
+  cr_assert(qdisk_start(qdisk, NULL, NULL, NULL));
+
+  /* the uncompressed record is still readable, new ones are written uncompressed too */
+  cr_assert(push_dummy_record(qdisk, 100));
+  cr_assert_eq(qdisk_get_writer_head(qdisk), QDISK_RESERVED_SPACE + 2 * (100 + FRAME_LENGTH));
+
+  GString *popped_data = g_string_new(NULL);
+  for (gint i = 0; i < 2; i++)
+    {
+      cr_assert(reliable_pop_record_without_backlog(qdisk, popped_data));
+      assert_dummy_record(popped_data, 100);
+    }
+  g_string_free(popped_data, TRUE);
+
+  cr_assert(qdisk_stop(qdisk, NULL, NULL, NULL));
+  cleanup_qdisk(filename, qdisk);
+}
+
+#endif
+
 static void
 setup(void)
 {
@@ -376,6 +376,60 @@ Test(diskq_reliable, test_rewind_backlog)
   _common_cleanup(dq, file_name);
 }
 
+static void
+_push_mark_message(LogQueueDiskReliable *dq)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  LogMessage *mark_message = log_msg_new_mark();
+
+  mark_message->ack_func = _dummy_ack;
+  log_msg_add_ack(mark_message, &path_options);
+  log_queue_push_tail(&dq->super.super, mark_message, &path_options);
+}
+
+Test(diskq_reliable, test_messages_are_acked_once_their_write_batch_is_written)
+{
+  const gchar *file_name = "test_write_batch_ack.rqf";
+  LogQueueDiskReliable *dq = _init_diskq_for_test(file_name, QDISK_RESERVED_SPACE + mark_message_serialized_size * 10 + 1,
+                                                  0);
+  gint i;
+
+  disk_queue_options_set_write_batch_messages(&options, 4);
+
+  for (i = 0; i < 3; i++)
+    _push_mark_message(dq);
+  cr_assert_eq(num_of_ack, 0, "%s", "Messages are acked before their records are written");
+  cr_assert_eq(dq->write_batch_window->length, NUMBER_MESSAGES_IN_QUEUE(3));
+
+  /* the 4th message fills the batch, which is written right away */
+  _push_mark_message(dq);
+  cr_assert_eq(num_of_ack, 4, "%s", "Messages aren't acked after their records are written");
+  cr_assert_eq(dq->write_batch_window->length, 0);
+
+  /* a partial batch is written by the flush timer */
+  _push_mark_message(dq);
+  cr_assert_eq(num_of_ack, 4, "%s", "Messages are acked before their records are written");
+  cr_assert(qdisk_flush(dq->super.qdisk));
+  dq->super.write_batch_flushed(&dq->super);
+  cr_assert_eq(num_of_ack, 5, "%s", "Messages aren't acked after their records are written");
+
+  /* or by the reader, once it reaches the write head */
+  _push_mark_message(dq);
+  for (i = 0; i < 6; i++)
+    {
+      LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+      LogMessage *msg = log_queue_pop_head(&dq->super.super, &path_options);
+
+      cr_assert_not_null(msg, "%s", "Can't read message from queue");
+      log_msg_unref(msg);
+    }
+  cr_assert_eq(num_of_ack, 6, "%s", "Messages aren't acked after their records are written");
+  cr_assert_eq(dq->write_batch_window->length, 0);
+
+  log_queue_ack_backlog(&dq->super.super, 6);
+  _common_cleanup(dq, file_name);
+}
+
 static void
 setup(void)
 {
@@ -54,6 +54,7 @@ typedef struct FilterXFunctionCacheJsonFile_
   FilterXFunction super;
   gchar *filepath;
   FilterXObject *cached_json;
+  GPtrArray *frozen_objects;
 } FilterXFuntionCacheJsonFile;
 
 static gchar *
@@ -143,8 +144,13 @@ _free(FilterXExpr *s)
   FilterXFuntionCacheJsonFile *self = (FilterXFuntionCacheJsonFile *) s;
 
   g_free(self->filepath);
-  if (self->cached_json)
-    filterx_object_unfreeze_and_free(self->cached_json);
+  if (self->frozen_objects)
+    {
+      g_ptr_array_foreach(self->frozen_objects, (GFunc) filterx_object_unfreeze_and_free, NULL);
+      g_ptr_array_free(self->frozen_objects, TRUE);
+    }
+  else
+    filterx_object_unref(self->cached_json);
   filterx_function_free_method(&self->super);
 }
 
@@ -165,7 +171,9 @@ filterx_function_cache_json_file_new(const gchar *function_name, FilterXFunction
   if (!self->cached_json)
     goto error;
 
-  filterx_object_freeze(self->cached_json);
+  /* the cached object is shared between threads, along with its elements */
+  self->frozen_objects = g_ptr_array_new();
+  filterx_json_deep_freeze(self->cached_json, self->frozen_objects);
   filterx_function_args_free(args);
   return &self->super;
 